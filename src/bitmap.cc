@@ -100,3 +100,79 @@ ostream& operator <<(ostream & os, const bitmap& b)
   os << "]";
   return os;
 }
+
+// Bits are numbered from the low bit of the first byte, so on a little
+// endian machine a word is 8 bytes loaded as they are.
+unsigned long long bitmap::word(const char * buf, unsigned int numBits,
+                                unsigned int i)
+{
+  unsigned int nChars = (numBits + 7) / 8;
+  unsigned int first = i * 8;
+  if(first >= nChars)
+    return 0;
+  unsigned long long w = 0;
+  unsigned int n = (nChars - first < 8) ? nChars - first : 8;
+  memcpy(&w, buf + first, n);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  w = __builtin_bswap64(w);
+#endif
+  // clear whatever follows the last bit
+  unsigned int end = numBits - i * 64;
+  if(end < 64)
+    w &= (1ULL << end) - 1;
+  return w;
+}
+
+int bitmap::nextSet(const char * buf, unsigned int numBits,
+                    unsigned int bitNumber)
+{
+  if(bitNumber >= numBits)
+    return numBits;
+  unsigned int nWords = (numBits + 63) / 64;
+  unsigned int i = bitNumber / 64;
+  unsigned long long w = word(buf, numBits, i) & (~0ULL << (bitNumber % 64));
+  // whole words of clear bits are skipped at once
+  while(w == 0) {
+    if(++i == nWords)
+      return numBits;
+    w = word(buf, numBits, i);
+  }
+  return i * 64 + __builtin_ctzll(w);
+}
+
+int bitmap::nextClear(const char * buf, unsigned int numBits,
+                      unsigned int bitNumber)
+{
+  if(bitNumber >= numBits)
+    return numBits;
+  unsigned int nWords = (numBits + 63) / 64;
+  unsigned int i = bitNumber / 64;
+  unsigned long long w = ~word(buf, numBits, i) & (~0ULL << (bitNumber % 64));
+  while(w == 0) {
+    if(++i == nWords)
+      return numBits;
+    w = ~word(buf, numBits, i);
+  }
+  // the bits past the end read as clear - they are not an answer
+  unsigned int r = i * 64 + __builtin_ctzll(w);
+  return (r < numBits) ? r : numBits;
+}
+
+int bitmap::count(const char * buf, unsigned int numBits)
+{
+  int n = 0;
+  for(unsigned int i = 0; i < (numBits + 63) / 64; i++)
+    n += __builtin_popcountll(word(buf, numBits, i));
+  return n;
+}
+
+void RM_PageHdrView::Init(int nextFree)
+{
+  SetNextFree(nextFree);
+  SetInt(1, numSlots);
+  SetNumFreeSlots(numSlots);
+  // bits past the last slot stay clear, as bitmap::set leaves them
+  memset(Map(), 0xff, MapSize(numSlots));
+  if(numSlots % 8 != 0)
+    Map()[numSlots/8] = (1 << (numSlots % 8)) - 1;
+}
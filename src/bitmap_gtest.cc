@@ -83,3 +83,43 @@ TEST_F(bitmapTest, Set16) {
 	}
 
 }
+
+TEST_F(bitmapTest, Words) {
+	// three words, the last one partial
+	int s = 150;
+	bitmap b(s);
+	ASSERT_EQ(3, b.numWords());
+	ASSERT_EQ(0, b.count());
+	ASSERT_EQ(s, b.nextSet(0));
+	ASSERT_EQ(0, b.nextClear(0));
+
+	b.set(3);
+	b.set(63);
+	b.set(64);
+	b.set(149);
+	ASSERT_EQ((1ULL << 3) | (1ULL << 63), b.word(0));
+	ASSERT_EQ(1ULL, b.word(1));
+	ASSERT_EQ(1ULL << (149 - 128), b.word(2));
+	ASSERT_EQ(4, b.count());
+
+	ASSERT_EQ(3, b.nextSet(0));
+	ASSERT_EQ(3, b.nextSet(3));
+	ASSERT_EQ(63, b.nextSet(4));
+	ASSERT_EQ(64, b.nextSet(64));
+	ASSERT_EQ(149, b.nextSet(65));
+	ASSERT_EQ(s, b.nextSet(150));
+
+	b.set();
+	ASSERT_EQ(s, b.count());
+	ASSERT_EQ(s, b.nextClear(0));
+	b.reset(100);
+	ASSERT_EQ(100, b.nextClear(0));
+	ASSERT_EQ(s, b.nextClear(101));
+
+	// bits past the end are not set, whatever the buffer holds
+	char buf[19];
+	b.to_char_buf(buf, 19);
+	buf[18] = (char)0xff;
+	ASSERT_EQ(s - 1, bitmap::count(buf, s));
+	ASSERT_EQ(s, bitmap::nextClear(buf, s, 101));
+}
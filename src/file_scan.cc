@@ -29,12 +29,6 @@ FileScan::FileScan(SM_Manager& smm,
   }
   
   assert(cond.rhsValue.data == NULL || cond.bRhsIsAttr == FALSE); // has to be a value
-  
-  DataAttrInfo condAttr;
-  RID r;
-  if(cond.rhsValue.data != NULL) {
-    smm.GetAttrFromCat(relName, cond.lhsAttr.attrName, condAttr, r);
-  }
 
   rc = prmm->OpenFile(relName, rmh);
   if (rc != 0) { 
@@ -42,25 +36,55 @@ FileScan::FileScan(SM_Manager& smm,
     return;
   }
 
-  rc = rfs.OpenScan(rmh, 
-                    condAttr.attrType,
-                    condAttr.attrLength,
-                    condAttr.offset,
-                    cond.op,
-                    cond.rhsValue.data,
-                    NO_HINT);
-  if (rc != 0) { 
-    status = rc;
-    return;
-  }
-  
   oFilters = new Condition[nOFilters];
   for(int i = 0; i < nOFilters; i++) {
     oFilters[i] = outFilters[i]; // shallow copy
   }
-  
-  RC frc = filter.init(psmm, relName, nOFilters, oFilters);
-  if (frc != 0) { status = frc; return; }
+
+  // the scan condition and the filters all go down to the RM scan, which
+  // checks them against the page before a record is copied
+  Predicate* preds = new Predicate[1 + nOFilters];
+  int nPreds = 0;
+  if(cond.rhsValue.data != NULL) {
+    DataAttrInfo condAttr;
+    RID r;
+    smm.GetAttrFromCat(relName, cond.lhsAttr.attrName, condAttr, r);
+    preds[nPreds++] = Predicate(condAttr.attrType,
+                                condAttr.attrLength,
+                                condAttr.offset,
+                                cond.op,
+                                cond.rhsValue.data,
+                                SEQ_SCAN_HINT);
+  }
+  for(int i = 0; i < nOFilters; i++) {
+    DataAttrInfo lhs, rhs;
+    RID r;
+    if((rc = smm.GetAttrFromCat(relName, oFilters[i].lhsAttr.attrName,
+                                lhs, r)))
+      break;
+    if(oFilters[i].bRhsIsAttr == TRUE) {
+      if((rc = smm.GetAttrFromCat(relName, oFilters[i].rhsAttr.attrName,
+                                  rhs, r)))
+        break;
+      preds[nPreds++] = Predicate(lhs.attrType, lhs.attrLength, lhs.offset,
+                                  oFilters[i].op, NULL, SEQ_SCAN_HINT,
+                                  rhs.offset);
+    } else {
+      preds[nPreds++] = Predicate(lhs.attrType, lhs.attrLength, lhs.offset,
+                                  oFilters[i].op, oFilters[i].rhsValue.data,
+                                  SEQ_SCAN_HINT);
+    }
+  }
+  if(nPreds == 0)
+    preds[nPreds++] = Predicate(INT, sizeof(int), 0, NO_OP, NULL,
+                                SEQ_SCAN_HINT);
+  if(rc == 0)
+    rc = rfs.OpenScan(rmh, nPreds, preds, SEQ_SCAN_HINT);
+  delete [] preds;
+  if (rc != 0) { 
+    status = rc;
+    return;
+  }
   
   explain << "FileScan\n";
   explain << "   relName = " << relName << "\n";
@@ -128,31 +152,14 @@ RC FileScan::GetNext(Tuple &t)
   if(!rfs.IsOpen())
     return RM_FNOTOPEN;
   
-  RM_Record rec;
+  // buf points into the page the scan holds pinned and has passed every
+  // condition already
   RID recrid;
-  bool found = false;
-  RC rc;
-
-  while(!found) {
-    rc = rfs.GetNextRec(rec);
-    if (rc != 0) return rc;
-
-    char * buf;
-    rec.GetData(buf);
-    rec.GetRid(recrid);
-
-    bool recordIn = true;
-    if (!filter.passes(buf)) {
-      recordIn = false;
-    }
-
-    if(recordIn) {
-      t.Set(buf);
-      t.SetRid(recrid);
-      found = true;
-    }
-  } // while
-
-  return rc;
+  char * buf;
+  RC rc = rfs.GetNextRec(buf, recrid);
+  if (rc != 0) return rc;
+  t.Set(buf);
+  t.SetRid(recrid);
+  return 0;
 }
 
@@ -8,7 +8,6 @@
 #include "redbase.h"
 #include "iterator.h"
 #include "rm.h"
-#include "filter_eval.h"
 #include "sm.h"
 
 using namespace std;
@@ -40,6 +39,7 @@ class FileScan: public Iterator {
   virtual int GetNumSlotsPerPage() const { return rfs.GetNumSlotsPerPage(); }
   virtual int GetNumRecords() const { return psmm->GetNumRecords(relName); }
   virtual RC GotoPage(PageNum p) { return rfs.GotoPage(p); }
+  RC SetRingSize(int numPages) { return rfs.SetRingSize(numPages); }
 
  private:
   RM_FileScan rfs;
@@ -49,7 +49,6 @@ class FileScan: public Iterator {
   RM_FileHandle rmh;
   int nOFilters;
   Condition* oFilters;
-  FilterEvaluator filter;
 };
 
 #endif // FILESCAN_H
@@ -189,11 +189,8 @@ RC IndexScan::GetNext(Tuple &t)
     rc = ifs.GetNextEntry(rid);
     if (rc != 0) return rc;
 
-    RM_Record rec;
-    rc = rmh.GetRec(rid, rec);
-    if (rc != 0 ) return rc;
     char * buf;
-    rc = rec.GetData(buf);
+    rc = rmh.PinRec(rid, buf);
     if (rc != 0 ) return rc;
 
     bool recordIn = true;
@@ -206,6 +203,8 @@ RC IndexScan::GetNext(Tuple &t)
       t.SetRid(rid);
       found = true;
     }
+    rc = rmh.UnpinRec(rid);
+    if (rc != 0 ) return rc;
   } // while
   return rc;
 }
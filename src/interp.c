@@ -150,6 +150,11 @@ RC interp(NODE *n)
          errval = pSmm->Print(n->u.PRINT.relname);
          break;
 
+      case N_VACUUM:           /* for Vacuum() */
+
+         errval = pSmm->Vacuum(n->u.VACUUM.relname);
+         break;
+
       case N_QUERY:            /* for Query() */
          {
             int       nSelAttrs = 0;
@@ -683,6 +688,9 @@ static void echo_query(NODE *n)
       case N_PRINT:            /* for Print() */
          printf("print %s;\n", n -> u.PRINT.relname);
          break;
+      case N_VACUUM:           /* for Vacuum() */
+         printf("vacuum %s;\n", n -> u.VACUUM.relname);
+         break;
       case N_SET:                                 /* for Set() */
          printf("set %s = \"%s\";\n", n->u.SET.paramName, n->u.SET.string);
          break;
@@ -747,6 +747,51 @@ BtreeNode* IX_IndexHandle::FetchNode(RID r) const
                        hdr.pageSize);
 }
 
+// position of the child on page p in node, -1 if node does not point to it
+static int ChildPosition(BtreeNode* node, PageNum p)
+{
+  if(node == NULL) return -1;
+  for (int i = 0; i < node->GetNumKeys(); i++)
+    if(node->GetAddr(i).Page() == p)
+      return i;
+  return -1;
+}
+
+// Start reading the leaves a range scan will visit next so that several
+// leaf reads are in flight while it works through leaf. The leaves are
+// found in leaf's parent on the path; once the scan has moved past that
+// parent the path is searched again with leaf's first key. Only the
+// siblings under one parent are prefetched - that is enough to stay ahead
+// of the scan without reading interior nodes it does not need.
+void IX_IndexHandle::PrefetchLeaves(BtreeNode* leaf, int numLeaves, bool desc,
+                                    PageNum stop)
+{
+  if(hdr.height < 2 || leaf == NULL || leaf->GetNumKeys() == 0)
+    return;
+  PageNum p = leaf->GetPageRID().Page();
+  if(p == stop)
+    return;
+
+  int pos = ChildPosition(path[hdr.height-2], p);
+  if(pos == -1) {
+    void* key = NULL;
+    if(leaf->GetKey(0, key) != 0 || FindLeaf(key) == NULL)
+      return;
+    pos = ChildPosition(path[hdr.height-2], p);
+    if(pos == -1) return;
+  }
+
+  BtreeNode* parent = path[hdr.height-2];
+  for (int i = 1; i <= numLeaves; i++) {
+    int sibling = desc ? pos - i : pos + i;
+    if(sibling < 0 || sibling >= parent->GetNumKeys())
+      break;
+    PageNum s = parent->GetAddr(sibling).Page();
+    if(pfHandle->PrefetchPage(s) != 0 || s == stop)
+      break;
+  }
+}
+
 // Search an index entry
 // return -ve if error
 // 0 if found
@@ -27,6 +27,7 @@ struct IX_FileHdr {
 };
 
 const int IX_PAGE_LIST_END = -1;
+const int IX_PREFETCH_LEAVES = 4; // leaves a range scan keeps in flight
 
 //
 // IX_IndexHandle: IX Index File interface
@@ -64,6 +65,7 @@ class IX_IndexHandle {
   int GetNumPages() const { return hdr.numPages; }
   AttrType GetAttrType() const { return hdr.attrType; }
   int GetAttrLength() const { return hdr.attrLength; }
+  int GetPageSize() const { return hdr.pageSize; }
 
   RC GetNewPage(PageNum& pageNum);
   RC DisposePage(const PageNum& pageNum);
@@ -84,6 +86,10 @@ class IX_IndexHandle {
 
   BtreeNode* FetchNode(RID r) const;
   BtreeNode* FetchNode(PageNum p) const;
+  // start reading the numLeaves leaves after leaf (before it if desc),
+  // stopping at the leaf on page stop
+  void PrefetchLeaves(BtreeNode* leaf, int numLeaves, bool desc,
+                      PageNum stop = -1);
   void ResetNode(BtreeNode*& old, PageNum p) const;
   // Reset to the BtreeNode at the RID specified within Btree
   void ResetNode(BtreeNode*& old, RID r) const;
@@ -112,6 +112,7 @@ RC IX_IndexScan::GetNextEntry(void *& k, RID &rid, int& numScanned)
       currNode = pixh->FetchNode(pixh->FindLargestLeaf()->GetPageRID());
       currPos = currNode->GetNumKeys(); // 1 past
     }
+    pixh->PrefetchLeaves(currNode, IX_PREFETCH_LEAVES, desc, LastPage());
     currDeleted = false;
   } else { // check if the entry at curr was deleted
     if (currKey != NULL && currNode != NULL && currPos != -1) {
@@ -236,8 +237,10 @@ RC IX_IndexScan::GetNextEntry(void *& k, RID &rid, int& numScanned)
       delete currNode;
       currNode = NULL;
       currNode = pixh->FetchNode(right);
-      if(currNode != NULL)
+      if(currNode != NULL) {
         pixh->Pin(currNode->GetPageRID().Page());
+        pixh->PrefetchLeaves(currNode, IX_PREFETCH_LEAVES, desc, LastPage());
+      }
       currPos = -1;
     }
     else {
@@ -248,6 +251,7 @@ RC IX_IndexScan::GetNextEntry(void *& k, RID &rid, int& numScanned)
       currNode = pixh->FetchNode(left);
       if(currNode != NULL) {
         pixh->Pin(currNode->GetPageRID().Page());
+        pixh->PrefetchLeaves(currNode, IX_PREFETCH_LEAVES, desc, LastPage());
         currPos = currNode->GetNumKeys();
       }
     }
@@ -50,6 +50,9 @@ class IX_IndexScan {
  private:
   RC OpOptimize(); // Optimizes based on value of c, value and resets state
   RC EarlyExitOptimize(void* now);
+  // page of the leaf the scan stops at, -1 if it runs to the end
+  PageNum LastPage() const
+    { return (lastNode == NULL) ? -1 : lastNode->GetPageRID().Page(); }
  private:
   Predicate* pred;
   IX_IndexHandle* pixh;
@@ -43,7 +43,8 @@ RC IX_Manager::CreateIndex (const char *fileName, int indexNo,
     return IX_FCREATEFAIL;
 
   if(attrLength >= pageSize - (int)sizeof(RID) ||
-     attrLength <= 0)
+     attrLength <= 0 ||
+     pageSize > PF_MAX_PAGE_SIZE)
     return IX_INVALIDSIZE;
 
   if((attrType == INT && (unsigned int)attrLength != sizeof(int)) ||
@@ -59,7 +60,8 @@ RC IX_Manager::CreateIndex (const char *fileName, int indexNo,
 
   //TODO verify that RM file actually exists
 
-  int RC = pfm.CreateFile(newname.str().c_str());
+  // the PF pages are made large enough to hold one node each
+  int RC = pfm.CreateFile(newname.str().c_str(), pageSize);
   if (RC < 0)
   {
     PF_PrintError(RC);
@@ -0,0 +1,317 @@
+//
+// File:        memory_grant.cc
+//
+
+#include "memory_grant.h"
+#include <cassert>
+#include <climits>
+#include <cstring>
+#include <sstream>
+#include <unistd.h>
+
+using namespace std;
+
+MemoryBroker::MemoryBroker(PF_Manager& pfm, int budget_)
+  :ppfm(&pfm), budget(budget_), reserved(0), granted(0), nGrants(0)
+{
+  if(budget < 1)
+    budget = QL_WORKMEM;
+}
+
+MemoryGrant::MemoryGrant(MemoryBroker* broker_, int minBlocks_)
+  :broker(broker_), minBlocks(minBlocks_), promised(0)
+{
+  if(broker != NULL)
+    broker->nGrants++;
+}
+
+MemoryGrant::~MemoryGrant()
+{
+  Release();
+  if(broker != NULL)
+    broker->nGrants--;
+}
+
+int MemoryGrant::GetBlockSize() const
+{
+  int length = PF_PAGE_SIZE;
+  if(broker != NULL)
+    broker->ppfm->GetBlockSize(length);
+  return length;
+}
+
+// an equal share of the budget, but never less than the reservation
+int MemoryGrant::GetLimit() const
+{
+  if(broker == NULL)
+    return INT_MAX;
+  int share = broker->budget / broker->nGrants;
+  return share > minBlocks ? share : minBlocks;
+}
+
+RC MemoryGrant::Reserve()
+{
+  if(broker == NULL || promised > 0 || (int)blocks.size() >= minBlocks)
+    return 0;
+  int want = minBlocks - blocks.size();
+  if(broker->granted + broker->reserved + want > broker->budget)
+    return QL_NOMEM;
+  promised = want;
+  broker->reserved += want;
+  return 0;
+}
+
+RC MemoryGrant::Grow(char*& block)
+{
+  if(broker == NULL) {
+    block = new char[PF_PAGE_SIZE];
+    blocks.push_back(block);
+    return 0;
+  }
+
+  // blocks promised to this grant are taken first; others only while the
+  // grant is under its share and the budget has room after the promises
+  bool bPromised = (promised > 0);
+  if(!bPromised &&
+     ((int)blocks.size() >= GetLimit() ||
+      broker->granted + broker->reserved >= broker->budget))
+    return QL_NOMEM;
+
+  // the buffer pool itself may be full of pinned pages
+  if(broker->ppfm->AllocateBlock(block) != 0)
+    return QL_NOMEM;
+
+  if(bPromised) {
+    promised--;
+    broker->reserved--;
+  }
+  broker->granted++;
+  blocks.push_back(block);
+  return 0;
+}
+
+RC MemoryGrant::Release()
+{
+  RC rc = 0;
+  for(unsigned int i = 0; i < blocks.size(); i++) {
+    if(broker == NULL) {
+      delete [] blocks[i];
+      continue;
+    }
+    RC rc2 = broker->ppfm->DisposeBlock(blocks[i]);
+    if(rc == 0) rc = rc2;
+    broker->granted--;
+  }
+  blocks.clear();
+  if(broker != NULL)
+    broker->reserved -= promised;
+  promised = 0;
+  return rc;
+}
+
+SpillFile::SpillFile(PF_Manager& pfm, int tupleLength_)
+  :ppfm(&pfm), bOpen(false), tupleLength(tupleLength_), pWrite(NULL),
+   writePage(-1)
+{
+  static int nFiles = 0;
+  stringstream name;
+  name << ".spill." << getpid() << "." << nFiles++;
+  fileName = name.str();
+  perPage = PF_PAGE_SIZE / tupleLength;
+  curr.first = -1;
+  curr.count = 0;
+}
+
+SpillFile::~SpillFile()
+{
+  if(!bOpen)
+    return;
+  if(pWrite != NULL)
+    fh.UnpinPage(writePage);
+  ppfm->CloseFile(fh);
+  ppfm->DestroyFile(fileName.c_str());
+}
+
+RC SpillFile::Append(const char* tuple)
+{
+  RC rc;
+  if(perPage < 1)
+    return QL_INVALIDSIZE;
+  if(!bOpen) {
+    ppfm->DestroyFile(fileName.c_str()); // left by an earlier crash
+    if((rc = ppfm->CreateFile(fileName.c_str())) ||
+       (rc = ppfm->OpenFile(fileName.c_str(), fh)))
+      return rc;
+    bOpen = true;
+  }
+
+  int slot = curr.count % perPage;
+  if(pWrite == NULL) {
+    // pages of a run follow one another - only one run is written at a time
+    PF_PageHandle ph;
+    if((rc = fh.AllocatePage(ph)) ||
+       (rc = ph.GetData(pWrite)) ||
+       (rc = ph.GetPageNum(writePage)))
+      return rc;
+    if(curr.count == 0)
+      curr.first = writePage;
+  }
+  memcpy(pWrite + slot * tupleLength, tuple, tupleLength);
+  curr.count++;
+
+  if(slot == perPage - 1) {
+    pWrite = NULL;
+    if((rc = fh.MarkDirty(writePage)) ||
+       (rc = fh.UnpinPage(writePage)))
+      return rc;
+  }
+  return 0;
+}
+
+RC SpillFile::EndRun()
+{
+  if(curr.count == 0)
+    return 0;
+  if(pWrite != NULL) {
+    pWrite = NULL;
+    RC rc;
+    if((rc = fh.MarkDirty(writePage)) ||
+       (rc = fh.UnpinPage(writePage)))
+      return rc;
+  }
+  runs.push_back(curr);
+  curr.first = -1;
+  curr.count = 0;
+  return 0;
+}
+
+RC SpillFile::OpenCursor(int run, SpillCursor& c)
+{
+  assert(run >= 0 && run < (int)runs.size());
+  c.run = runs[run];
+  c.pos = 0;
+  c.pageNum = -1;
+  c.pData = NULL;
+  return 0;
+}
+
+RC SpillFile::Next(SpillCursor& c, const char*& tuple)
+{
+  RC rc;
+  int slot = c.pos % perPage;
+  // the tuple handed out last stays valid until this call - move on now
+  if(c.pData != NULL && (slot == 0 || c.pos >= c.run.count))
+    if((rc = CloseCursor(c)))
+      return rc;
+  if(c.pos >= c.run.count)
+    return QL_EOF;
+
+  if(c.pData == NULL) {
+    PF_PageHandle ph;
+    c.pageNum = c.run.first + c.pos / perPage;
+    if((rc = fh.GetThisPage(c.pageNum, ph)) ||
+       (rc = ph.GetData(c.pData)))
+      return rc;
+  }
+  tuple = c.pData + slot * tupleLength;
+  c.pos++;
+  return 0;
+}
+
+RC SpillFile::CloseCursor(SpillCursor& c)
+{
+  if(c.pData == NULL)
+    return 0;
+  c.pData = NULL;
+  return fh.UnpinPage(c.pageNum);
+}
+
+TupleSpool::TupleSpool(MemoryGrant& grant, int tupleLength_)
+  :pgrant(&grant), tupleLength(tupleLength_), pSpill(NULL), bCursor(false),
+   nSpilled(0), nInMem(0), nRead(0)
+{
+  perBlock = (tupleLength > 0) ? grant.GetBlockSize() / tupleLength : 0;
+}
+
+TupleSpool::~TupleSpool()
+{
+  Clear();
+}
+
+char* TupleSpool::Slot(int i) const
+{
+  return pgrant->GetBlock(i / perBlock) + (i % perBlock) * tupleLength;
+}
+
+RC TupleSpool::Append(const char* tuple)
+{
+  RC rc;
+  if(perBlock < 1)
+    return QL_INVALIDSIZE;
+
+  if(nInMem == pgrant->GetNumBlocks() * perBlock) {
+    char* block;
+    rc = pgrant->Grow(block);
+    if(rc == QL_NOMEM && nInMem > 0) {
+      // refused - move what is in memory out and start over in the blocks
+      if(pSpill == NULL)
+        pSpill = new SpillFile(pgrant->GetBroker()->GetPF_Manager(),
+                               tupleLength);
+      for(int i = 0; i < nInMem; i++)
+        if((rc = pSpill->Append(Slot(i))))
+          return rc;
+      nSpilled += nInMem;
+      nInMem = 0;
+    } else if(rc != 0) {
+      return rc;
+    }
+  }
+  memcpy(Slot(nInMem), tuple, tupleLength);
+  nInMem++;
+  return 0;
+}
+
+RC TupleSpool::Rewind()
+{
+  RC rc;
+  nRead = 0;
+  if(pSpill == NULL)
+    return 0;
+  if(bCursor) {
+    pSpill->CloseCursor(cursor);
+    bCursor = false;
+  }
+  if(pSpill->GetNumRuns() == 0 && (rc = pSpill->EndRun()))
+    return rc;
+  if((rc = pSpill->OpenCursor(0, cursor)))
+    return rc;
+  bCursor = true;
+  return 0;
+}
+
+RC TupleSpool::Next(const char*& tuple)
+{
+  if(nRead >= GetCount())
+    return QL_EOF;
+  if(nRead < nSpilled) {
+    RC rc = pSpill->Next(cursor, tuple);
+    if(rc != 0) return rc;
+  } else {
+    tuple = Slot(nRead - nSpilled);
+  }
+  nRead++;
+  return 0;
+}
+
+RC TupleSpool::Clear()
+{
+  if(bCursor)
+    pSpill->CloseCursor(cursor);
+  bCursor = false;
+  delete pSpill;
+  pSpill = NULL;
+  nSpilled = 0;
+  nInMem = 0;
+  nRead = 0;
+  return 0;
+}
@@ -0,0 +1,153 @@
+//
+// File:        memory_grant.h
+//
+
+#ifndef MEMORY_GRANT_H
+#define MEMORY_GRANT_H
+
+#include "redbase.h"
+#include "pf.h"
+#include "ql_error.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Default scratch memory of one query in blocks - "workmem" param
+const int QL_WORKMEM = 16;
+
+class MemoryGrant;
+
+// Scratch memory of one query.  Operators that hold their input in memory
+// take a MemoryGrant against the broker's budget of PF blocks.  A grant can
+// grow to an equal share of the budget among all grants; when it is
+// refused the operator must spill.
+class MemoryBroker {
+ public:
+  MemoryBroker(PF_Manager& pfm, int budget = QL_WORKMEM);
+  ~MemoryBroker() {}
+
+  PF_Manager& GetPF_Manager() const { return *ppfm; }
+  int GetBudget() const { return budget; }
+  int GetGranted() const { return granted; }
+
+ private:
+  friend class MemoryGrant;
+  PF_Manager* ppfm;
+  int budget;   // blocks all grants together may hold
+  int reserved; // blocks promised by Reserve but not handed out yet
+  int granted;  // blocks handed out
+  int nGrants;
+};
+
+// The blocks one operator holds.  Without a broker blocks come from the
+// heap and are never refused.
+class MemoryGrant {
+ public:
+  MemoryGrant(MemoryBroker* broker = NULL, int minBlocks = 1);
+  ~MemoryGrant();
+
+  // Promise the first minBlocks blocks up front - QL_NOMEM if the budget
+  // cannot cover them
+  RC Reserve();
+  // One more block - QL_NOMEM when refused
+  RC Grow(char*& block);
+  // Give back all blocks and the reservation
+  RC Release();
+
+  MemoryBroker* GetBroker() const { return broker; }
+  int GetBlockSize() const;
+  int GetNumBlocks() const { return blocks.size(); }
+  char* GetBlock(int i) const { return blocks[i]; }
+  // most blocks this grant will be given
+  int GetLimit() const;
+
+ private:
+  MemoryBroker* broker;
+  int minBlocks;
+  int promised; // reserved blocks not taken yet
+  vector<char*> blocks;
+};
+
+// A run of tuples in a SpillFile
+struct SpillRun {
+  PageNum first;
+  int count;
+};
+
+// Position of a reader in a run.  The page it is on stays pinned.
+struct SpillCursor {
+  SpillRun run;
+  int pos;
+  PageNum pageNum;
+  char* pData;
+};
+
+// Scratch PF file for tuples that did not fit in memory, destroyed with the
+// object.  Tuples are written in runs of consecutive pages.
+class SpillFile {
+ public:
+  SpillFile(PF_Manager& pfm, int tupleLength);
+  ~SpillFile();
+
+  // Add a tuple to the run being written
+  RC Append(const char* tuple);
+  // Finish the run being written
+  RC EndRun();
+  int GetNumRuns() const { return runs.size(); }
+  const SpillRun& GetRun(int i) const { return runs[i]; }
+
+  RC OpenCursor(int run, SpillCursor& c);
+  // Next tuple of the run - QL_EOF past the end
+  RC Next(SpillCursor& c, const char*& tuple);
+  RC CloseCursor(SpillCursor& c);
+
+ private:
+  PF_Manager* ppfm;
+  PF_FileHandle fh;
+  string fileName;
+  bool bOpen;
+  int tupleLength;
+  int perPage;
+  vector<SpillRun> runs;
+  SpillRun curr;    // run being written
+  char* pWrite;     // pinned page being written
+  PageNum writePage;
+};
+
+// Tuples of one length appended in granted blocks and read back in the
+// order they were added.  If the grant refuses another block the tuples in
+// memory are written to a SpillFile and the blocks reused.
+class TupleSpool {
+ public:
+  TupleSpool(MemoryGrant& grant, int tupleLength);
+  ~TupleSpool();
+
+  // Not after Rewind until Clear
+  RC Append(const char* tuple);
+  // Start reading from the first tuple
+  RC Rewind();
+  // QL_EOF past the last tuple
+  RC Next(const char*& tuple);
+  bool AtEnd() const { return nRead == GetCount(); }
+  // Drop all tuples, keeping the blocks
+  RC Clear();
+
+  int GetCount() const { return nSpilled + nInMem; }
+  bool IsSpilled() const { return pSpill != NULL; }
+
+ private:
+  char* Slot(int i) const;
+
+  MemoryGrant* pgrant;
+  int tupleLength;
+  int perBlock;
+  SpillFile* pSpill;
+  SpillCursor cursor;
+  bool bCursor;
+  int nSpilled;
+  int nInMem;
+  int nRead;
+};
+
+#endif // MEMORY_GRANT_H
@@ -6,9 +6,11 @@ MergeJoin::MergeJoin(Iterator*    lhsIt,      // access for left i/p to join -R
                      int nJoinConds,
                      int equiCond,        // the join condition that can be used as
                      // the equality consideration.
-                     const Condition joinConds_[])
+                     const Condition joinConds_[],
+                     MemoryBroker* broker)
   :NestedLoopJoin(lhsIt, rhsIt, status, nJoinConds, joinConds_),
    equiPos(equiCond), firstOpen(true), sameValueCross(false),
+   grant(broker), cpspool(grant, TupleLength()),
    lastCpit(false),  pcurrTuple(NULL), potherTuple(NULL)
 {
   Condition* joinConds = new Condition[nJoinConds];
@@ -207,11 +209,15 @@ RC MergeJoin::GetNext(Tuple &t)
             EvalJoin(tup, evaled, &(*it), &(*rit));
             if(evaled) {
               // cerr << "cpvec pushing " << tup << endl;
-              cpvec.push_back(tup);
+              const char * tbuf;
+              tup.GetData(tbuf);
+              RC rc = cpspool.Append(tbuf);
+              if(rc != 0) return rc;
             }
           }
-        cpit = cpvec.begin();
-        if(cpit != cpvec.end()) {
+        RC rc = cpspool.Rewind();
+        if(rc != 0) return rc;
+        if(!cpspool.AtEnd()) {
           joined = true;
         }
         /* if(pcurrTuple != NULL && potherTuple != NULL) */
@@ -263,31 +269,29 @@ RC MergeJoin::GetNext(Tuple &t)
     } // while not joined/eof
   } // if !sameValueCross
 
-  if(sameValueCross && (cpit != cpvec.end())) {
+  if(sameValueCross && !cpspool.AtEnd()) {
     char * buf;
     t.GetData(buf);
     memset(buf, 0, TupleLength());
 
-    char *itbuf;
-    cpit->GetData(itbuf);
+    const char *itbuf;
+    RC rc = cpspool.Next(itbuf);
+    if(rc != 0) return rc;
     memcpy(buf, itbuf, TupleLength());
      
     // cerr << t << " [cp]" << endl;
  
-    cpit++;
-    if(cpit == cpvec.end()) {
-      cpvec.clear();
-      cpit = cpvec.end();
+    if(cpspool.AtEnd()) {
+      cpspool.Clear();
       sameValueCross = false;
       lastCpit = true; // reuse potherTuple and pcurrTuple for tuples
     }
     return 0;
   }
     
-  if(sameValueCross && (cpit == cpvec.end())) {
+  if(sameValueCross && cpspool.AtEnd()) {
     // some matches for join cond, but other conds failed.
-    cpvec.clear();
-    cpit = cpvec.end();
+    cpspool.Clear();
     sameValueCross = false;
     lastCpit = true; // reuse potherTuple and pcurrTuple for tuples
   }
@@ -9,6 +9,7 @@
 #include "redbase.h"
 #include "iterator.h"
 #include "rm.h"
+#include "memory_grant.h"
 #include <vector>
 
 using namespace std;
@@ -22,7 +23,8 @@ class MergeJoin: public NestedLoopJoin {
             int nJoinConds,
             int equiCond,        // the join condition that can be used as
             // the equality consideration.
-            const Condition joinConds_[]);
+            const Condition joinConds_[],
+            MemoryBroker* broker = NULL);
 
   virtual ~MergeJoin() {
     delete pcurrTuple;
@@ -31,9 +33,18 @@ class MergeJoin: public NestedLoopJoin {
 
   virtual RC Open() {
     firstOpen = true;
+    RC rc = grant.Reserve();
+    if(rc != 0) return rc;
     return this->NestedLoopJoin::Open();
   }
 
+  virtual RC Close() {
+    cpspool.Clear();
+    RC rc = grant.Release();
+    if(rc != 0) return rc;
+    return this->NestedLoopJoin::Close();
+  }
+
   virtual RC IsValid()
   {
     if((curr == lhsIt && other == rhsIt) ||
@@ -53,8 +64,8 @@ class MergeJoin: public NestedLoopJoin {
   int equiPos; // position in oFilters of equality condition used as primary
                // for the merge-join.
   bool sameValueCross;
-  vector<Tuple> cpvec; // store cross product of all tuples when both sides are equal
-  vector<Tuple>::iterator cpit;
+  MemoryGrant grant;
+  TupleSpool cpspool; // store cross product of all tuples when both sides are equal
   bool lastCpit; // flag to track if the last tuple of a cross product was returned
                  // in the last call to GetNext
   Tuple* pcurrTuple;
@@ -44,6 +44,13 @@ class NestedBlockJoin: public NestedLoopJoin {
       left_rc = 0;
       right_rc = 0;
 
+      // the outer block is read once per inner tuple - its ring has to
+      // hold the whole block and the first page of the next one, which is
+      // read to find the end of the block.  Twice that leaves room for the
+      // pages read ahead past the end of the block.
+      RC rc = lhsIt->SetRingSize(2 * (blockSize + 1));
+      if(rc != 0) { status = rc; return; }
+
       explain.str("");
       explain << "NestedBlockJoin\n";
       if(nOFilters > 0) {
@@ -179,6 +179,18 @@ NODE *print_node(char *relname)
     return n;
 }
 
+/*
+ * vacuum_node: allocates, initializes, and returns a pointer to a new
+ * vacuum node having the indicated values.
+ */
+NODE *vacuum_node(char *relname)
+{
+    NODE *n = newnode(N_VACUUM);
+
+    n -> u.VACUUM.relname = relname;
+    return n;
+}
+
 /*
  * query_node: allocates, initializes, and returns a pointer to a new
  * query node having the indicated values.
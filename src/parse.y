@@ -86,6 +86,7 @@ QL_Manager *pQlm;          // QL component manager
       RW_SET
       RW_HELP
       RW_PRINT
+      RW_VACUUM
       RW_EXIT
       RW_SELECT
       RW_FROM
@@ -149,6 +150,7 @@ QL_Manager *pQlm;          // QL component manager
       set
       help
       print
+      vacuum
       exit
       query
       insert
@@ -237,6 +239,7 @@ utility
    | set
    | help
    | print
+   | vacuum
    | buffer
    | statistics 
    | queryplans 
@@ -361,6 +364,13 @@ print
    }
    ;
 
+vacuum
+   : RW_VACUUM T_STRING
+   {
+      $$ = vacuum_node($2);
+   }
+   ;
+
 exit
    : RW_EXIT
    {
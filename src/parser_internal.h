@@ -52,6 +52,7 @@ typedef enum{
     N_SET,
     N_HELP,
     N_PRINT,
+    N_VACUUM,
     N_QUERY,
     N_INSERT,
     N_DELETE,
@@ -121,6 +122,11 @@ typedef struct node{
          char *relname;
       } PRINT;
 
+      /* vacuum node */
+      struct{
+         char *relname;
+      } VACUUM;
+
       /* QL component nodes */
       /* query node */
       struct{
@@ -225,6 +231,7 @@ NODE *load_node(char *relname, char *filename);
 NODE *set_node(char *paramName, char *string);
 NODE *help_node(char *relname);
 NODE *print_node(char *relname);
+NODE *vacuum_node(char *relname);
 NODE *query_node(NODE *relattrlist, NODE *rellist, NODE *conditionlist, 
                  NODE *order_relattr, NODE *group_relattr);
 NODE *insert_node(char *relname, NODE *valuelist);
@@ -30,7 +30,49 @@ typedef int PageNum;
 // Unfortunately, we cannot use sizeof(PF_PageHdr) here, but it is an
 // int and we simply use that.
 //
+// PF_PAGE_SIZE is the default.  A file can be created with larger pages;
+// its pages then take the next multiple of 4K on disk, up to 64K, and
+// PF_FileHandle::GetPageSize tells how many bytes they hold.
+//
 const int PF_PAGE_SIZE = 4096 - sizeof(int);
+const int PF_MAX_PAGE_SIZE = 16 * 4096 - sizeof(int);
+
+//
+// Buffer rings
+//
+// A scan that reads each page once can read through a ring: a few buffer
+// frames of its own that it reuses round robin, so that it does not evict
+// the rest of the buffer pool.
+//
+const int PF_NO_RING   = -1;   // read through the shared buffer pool
+const int PF_RING_SIZE = 8;    // default number of frames in a ring
+
+//
+// Extents
+//
+// A file grows an extent of pages at a time: when a page is allocated
+// past the space reserved for the file, the next PF_EXTENT_SIZE pages
+// are reserved on disk with fallocate so that the file system keeps them
+// together.  The reservation does not change the size of the file.
+//
+const int PF_EXTENT_SIZE = 16; // default number of pages per extent
+
+//
+// Options
+//
+// The buffer pool can be put on huge pages, and files can be opened so
+// that their pages bypass the OS page cache, which leaves the buffer pool
+// as the only cache.  Options given to the PF_Manager constructor apply to
+// every file it opens.
+//
+// A file opened PF_MMAP_READONLY is mapped into memory instead.  Its pages
+// are read straight from the mapping without going through the buffer
+// pool, so there is nothing to pin, and anything that would change the
+// file fails with PF_READONLY.
+//
+const int PF_HUGE_PAGES    = 0x1; // back the buffer pool with huge pages
+const int PF_DIRECT_IO     = 0x2; // read and write pages with O_DIRECT
+const int PF_MMAP_READONLY = 0x4; // map the file read-only (OpenFile only)
 
 //
 // PF_PageHandle: PF page interface
@@ -60,12 +102,22 @@ private:
 struct PF_FileHdr {
    int firstFree;     // first free page in the linked list
    int numPages;      // # of pages in the file
+   int pageSize;      // usable bytes per page, 0 in files older than
+                      // page sizes, which use PF_PAGE_SIZE
 };
 
 //
 // PF_FileHandle: PF File interface
 //
+// Threads can share an open file by each using a copy of its handle: the
+// copies refer to the same pages in the buffer.  Pages are allocated and
+// disposed of through one handle only, while no other thread uses the file.
+// A thread that changes a page others may read takes its latch exclusive
+// first, and marks the page dirty before releasing it.
+//
 class PF_BufferMgr;
+struct PF_HotList;
+struct PF_PoolTable;
 
 class PF_FileHandle {
    friend class PF_Manager;
@@ -83,35 +135,88 @@ public:
    RC GetFirstPage(PF_PageHandle &pageHandle) const;
    // Get the next page after current
    RC GetNextPage (PageNum current, PF_PageHandle &pageHandle) const;
-   // Get a specific page
-   RC GetThisPage (PageNum pageNum, PF_PageHandle &pageHandle) const;
+   // Get a specific page, through a buffer ring unless ring is PF_NO_RING
+   RC GetThisPage (PageNum pageNum, PF_PageHandle &pageHandle,
+                   int ring = PF_NO_RING) const;
    // Get the last page
    RC GetLastPage(PF_PageHandle &pageHandle) const;
    // Get the prev page after current
    RC GetPrevPage (PageNum current, PF_PageHandle &pageHandle) const;
 
    RC AllocatePage(PF_PageHandle &pageHandle);    // Allocate a new page
+   // Allocate numPages new pages, one after another at the end of the
+   // file.  They are left unpinned and firstPage is set to the first.
+   RC AllocatePages(int numPages, PageNum &firstPage);
    RC DisposePage (PageNum pageNum);              // Dispose of a page
+   // Cut the file down to its first numPages pages.  None of the pages
+   // dropped may be pinned.
+   RC Truncate    (PageNum numPages);
    RC MarkDirty   (PageNum pageNum) const;        // Mark page as dirty
    RC UnpinPage   (PageNum pageNum) const;        // Unpin the page
 
+   // Latch a page the caller has pinned, shared or exclusive, waiting
+   // until it can; and release the latch
+   RC LatchPage   (PageNum pageNum, int bExclusive = FALSE) const;
+   RC UnlatchPage (PageNum pageNum) const;
+
    // Flush pages from buffer pool.  Will write dirty pages to disk.
    RC FlushPages  () const;
 
    // Force a page or pages to disk (but do not remove from the buffer pool)
    RC ForcePages  (PageNum pageNum=ALL_PAGES) const;
 
+   // Open a buffer ring of numPages frames for use with GetThisPage.  Sets
+   // ring to PF_NO_RING if all rings are in use.
+   RC OpenRing    (int &ring, int numPages = PF_RING_SIZE) const;
+   // Close a ring; its pages stay in the buffer pool
+   RC CloseRing   (int ring) const;
+
+   // Start reading a page that will be asked for soon
+   RC PrefetchPage(PageNum pageNum) const;
+
+   // TRUE if the file was opened PF_MMAP_READONLY
+   int IsReadOnly () const { return pMap != NULL; }
+
+   // Number of bytes a page of this file holds
+   int GetPageSize() const { return hdr.pageSize; }
+
 private:
 
    // IsValidPageNum will return TRUE if page number is valid and FALSE
    // otherwise
    int IsValidPageNum (PageNum pageNum) const;
 
+   // Read ahead when pages are requested in order
+   void ReadAhead (PageNum pageNum, int ring) const;
+
+   // Write the file header back to the file
+   RC WriteHdr    () const;
+
+   // Address of a page in the mapping of a PF_MMAP_READONLY file
+   char *MappedPage(PageNum pageNum) const;
+
+   // Reserve disk space for the first numPages pages of the file
+   void Reserve   (PageNum numPages);
+
    PF_BufferMgr *pBufferMgr;                      // pointer to buffer manager
    PF_FileHdr hdr;                                // file header
    int bFileOpen;                                 // file open flag
    int bHdrChanged;                               // dirty flag for file hdr
    int unixfd;                                    // OS file descriptor
+   int bDirect;                                   // opened with O_DIRECT
+   char *pMap;                                    // read-only mapping of
+                                                  // the file, or NULL
+   size_t mapSize;                                // length of the mapping
+   int extentSize;                                // pages reserved at a
+                                                  // time, 0 for none
+   PageNum numReserved;                           // pages with disk space
+                                                  // reserved for them
+
+   // Sequential access detection for read-ahead
+   mutable PageNum lastPage;                      // last page requested
+   mutable int     raDir;                         // 1 forward, -1 backward,
+                                                  // 0 not sequential
+   mutable PageNum raNext;                        // next page to read ahead
 };
 
 //
@@ -120,20 +225,55 @@ private:
 class PF_Manager {
 public:
    PF_Manager    ();                              // Constructor
+   PF_Manager    (int numBufferPages,             // Constructor for a
+                  int options = 0);               // buffer of that size
+                                                  // with PF_HUGE_PAGES and
+                                                  // PF_DIRECT_IO options
    ~PF_Manager   ();                              // Destructor
-   RC CreateFile    (const char *fileName);       // Create a new file
+   RC CreateFile    (const char *fileName,        // Create a new file
+                     int pageSize = PF_PAGE_SIZE); // with pages that hold
+                                                  // at least pageSize bytes
    RC DestroyFile   (const char *fileName);       // Delete a file
 
    // Open and close file methods
-   RC OpenFile      (const char *fileName, PF_FileHandle &fileHandle);
+   RC OpenFile      (const char *fileName, PF_FileHandle &fileHandle,
+                     int openFlags = 0);         // PF_DIRECT_IO,
+                                                 // PF_MMAP_READONLY or 0
    RC CloseFile     (PF_FileHandle &fileHandle);
 
-   // Three methods that manipulate the buffer manager.  The calls are
+   // Methods that manipulate the buffer manager.  The calls are
    // forwarded to the PF_BufferMgr instance and are called by parse.y
    // when the user types in a system command.
    RC ClearBuffer   ();
    RC PrintBuffer   ();
    RC ResizeBuffer  (int iNewSize);
+   // Select the page replacement policy: "lru", "clock", "2q" or "lruk"
+   RC SetReplacementPolicy(const char *policyName);
+   // Set the read-ahead window in pages, 0 to turn read-ahead off
+   RC SetReadAhead  (int numPages);
+   // Select the page I/O backend: "sync", "threads" or "uring"
+   RC SetIOBackend  (const char *backendName);
+   // Run the page cleaner between the dirty watermarks (percent of the
+   // buffer); a high watermark of 0 turns it off
+   RC SetCleaner    (int highPercent, int lowPercent);
+   // Set the number of pages files opened from now on grow by, 0 to
+   // grow them a page at a time without reserving space
+   RC SetExtentSize (int numPages);
+
+   // Warm restart.  SaveHotPages writes the pages that were in the buffer
+   // when their files were last closed to the list file fileName.  WarmUp
+   // reads such a list back, has the OS read the pages in the background,
+   // and reads each file's pages into the buffer when the file is opened.
+   RC SaveHotPages  (const char *fileName);
+   RC WarmUp        (const char *fileName);
+
+   // Named buffer pools.  CreatePool adds a pool of numPages pages next
+   // to the default one, or resizes it.  AssignPool has a file buffered
+   // in the pool from the next time it is opened; a NULL or empty
+   // poolName sends it back to the default pool.  The set commands apply
+   // to every pool, ResizeBuffer to the default pool only.
+   RC CreatePool    (const char *poolName, int numPages);
+   RC AssignPool    (const char *fileName, const char *poolName);
 
    // Three Methods for manipulating raw memory buffers.  These memory
    // locations are handled by the buffer manager, but are not
@@ -155,7 +295,18 @@ public:
    RC DisposeBlock  (char *buffer);
 
 private:
+   // Read the pending hot pages of a file that was just opened
+   void WarmFile    (const char *fileName, PF_FileHandle &fileHandle);
+   // Buffer pool a file is assigned to
+   PF_BufferMgr *PoolOf(const char *fileName) const;
+   // Pages in all the pools
+   int  NumBufferPages() const;
+
    PF_BufferMgr *pBufferMgr;                      // page-buffer manager
+   int options;                                   // constructor options
+   int extentSize;                                // for files opened next
+   PF_HotList *pHotList;                          // for warm restarts
+   PF_PoolTable *pPools;                          // named buffer pools
 };
 
 //
@@ -172,7 +323,10 @@ void PF_PrintError(RC rc);
 #define PF_PAGEUNPINNED    (START_PF_WARN + 6) // page already unpinned
 #define PF_EOF             (START_PF_WARN + 7) // end of file
 #define PF_TOOSMALL        (START_PF_WARN + 8) // Resize buffer too small
-#define PF_LASTWARN        PF_TOOSMALL
+#define PF_BADPARAM        (START_PF_WARN + 9) // bad buffer parameter
+#define PF_READONLY        (START_PF_WARN + 10) // file is open read-only
+#define PF_NOTLATCHED      (START_PF_WARN + 11) // page latch is not held
+#define PF_LASTWARN        PF_NOTLATCHED
 
 #define PF_NOMEM           (START_PF_ERR - 0)  // no memory
 #define PF_NOBUF           (START_PF_ERR - 1)  // no buffer space
@@ -17,8 +17,15 @@
 
 #include <cstdio>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
 #include <iostream>
 #include <cstdint>
+#include <strings.h>
+#include <algorithm>
+#include <vector>
+#include <thread>
 #include "pf_buffermgr.h"
 
 using namespace std;
@@ -28,8 +35,9 @@ using namespace std;
 #ifdef PF_STATS
 #include "statistics.h"   // For StatisticsMgr interface
 
-// Global variable for the statistics manager
+// Global variable for the statistics manager, shared by the buffer pools
 StatisticsMgr *pStatisticsMgr;
+static int numStatisticsUsers = 0;
 #endif
 
 #ifdef PF_LOG
@@ -85,7 +93,8 @@ void WriteLog(const char *psMessage)
 //       it checks if it is in the buffer.  If so, it pins the page (pages
 //       can be pinned multiple times).  If not, it reads it from the file
 //       and pins it.  If the buffer is full and a new page needs to be
-//       inserted, an unpinned page is replaced according to an LRU
+//       inserted, an unpinned page is replaced according to the active
+//       replacement policy, LRU unless SetReplacementPolicy says otherwise.
 // In:   numPages - the number of pages in the buffer
 //
 // Note: The constructor will initialize the global pStatisticsMgr.  We
@@ -95,15 +104,19 @@ void WriteLog(const char *psMessage)
 // Aut2003
 // numPages changed to _numPages for to eliminate CC warnings
 
-PF_BufferMgr::PF_BufferMgr(int _numPages) : hashTable(PF_HASH_TBL_SIZE)
+PF_BufferMgr::PF_BufferMgr(int _numPages, int _bHugePages)
+   : hashTable(_numPages)
 {
    // Initialize local variables
    this->numPages = _numPages;
    pageSize = PF_PAGE_SIZE + sizeof(PF_PageHdr);
+   bHugePages = _bHugePages;
 
 #ifdef PF_STATS
-   // Initialize the global variable for the statistics manager
-   pStatisticsMgr = new StatisticsMgr();
+   // Initialize the global variable for the statistics manager, unless
+   // another buffer manager did
+   if (numStatisticsUsers++ == 0)
+      pStatisticsMgr = new StatisticsMgr();
 #endif
 
 #ifdef PF_LOG
@@ -116,22 +129,49 @@ PF_BufferMgr::PF_BufferMgr(int _numPages) : hashTable(PF_HASH_TBL_SIZE)
    // Allocate memory for buffer page description table
    bufTable = new PF_BufPageDesc[numPages];
 
-   // Initialize the buffer table and allocate memory for buffer pages.
-   // Initially, the free list contains all pages
+   // Carve the buffer pages out of one arena.  Initially, the free list
+   // contains all pages
+   arena = AllocArena(numPages);
    for (int i = 0; i < numPages; i++) {
-      if ((bufTable[i].pData = new char[pageSize]) == NULL) {
-         cerr << "Not enough memory for buffer\n";
-         exit(1);
-      }
-
-      memset ((void *)bufTable[i].pData, 0, pageSize);
-
+      bufTable[i].pData = arena.pMem + (size_t)i * pageSize;
+      bufTable[i].frameSize = pageSize;
       bufTable[i].prev = i - 1;
       bufTable[i].next = i + 1;
+      bufTable[i].pinCount = PF_PIN_FREE;
+      bufTable[i].latch = 0;
+      bufTable[i].ring = PF_NO_RING;
+      bufTable[i].ioState = PF_IO_NONE;
+      bufTable[i].touched = 0;
    }
    bufTable[0].prev = bufTable[numPages - 1].next = INVALID_SLOT;
    free = 0;
    first = last = INVALID_SLOT;
+   touchHead = INVALID_SLOT;
+
+   // Create the replacement policies and start out with LRU
+   policies[0] = new PF_LRUPolicy();
+   policies[1] = new PF_ClockPolicy();
+   policies[2] = new PF_2QPolicy();
+   policies[3] = new PF_LRUKPolicy();
+   pPolicy = policies[0];
+   pPolicy->Reset(numPages);
+
+   // No buffer rings are open
+   for (int i = 0; i < PF_MAX_RINGS; i++) {
+      rings[i].slots = NULL;
+      rings[i].size = rings[i].next = 0;
+   }
+   readAhead = PF_READAHEAD_PAGES;
+
+   // I/O is synchronous until SetIOBackend says otherwise
+   pIO = PF_IOBackend::Create("sync");
+   numInFlight = 0;
+
+   // The page cleaner is off until SetCleaner turns it on
+   pCleanerIO = NULL;
+   numCleaning = 0;
+   cleanHigh = cleanLow = 0;
+   numDirty = 0;
 
 #ifdef PF_LOG
    WriteLog("Succesfully created the buffer manager.\n");
@@ -145,15 +185,32 @@ PF_BufferMgr::PF_BufferMgr(int _numPages) : hashTable(PF_HASH_TBL_SIZE)
 //
 PF_BufferMgr::~PF_BufferMgr()
 {
+   // Nothing may be in flight into the pages about to be freed
+   Drain();
+   delete pIO;
+   delete pCleanerIO;
+
    // Free up buffer pages and tables
-   for (int i = 0; i < this->numPages; i++)
-      delete [] bufTable[i].pData;
+   for (int i = 0; i < numPages; i++)
+      if (bufTable[i].frameSize > pageSize)
+         munmap(bufTable[i].pData, bufTable[i].frameSize);
+   FreeArena(arena);
+   for (size_t i = 0; i < retired.size(); i++)
+      FreeArena(retired[i]);
 
    delete [] bufTable;
 
+   for (int i = 0; i < PF_NUM_POLICIES; i++)
+      delete policies[i];
+   for (int i = 0; i < PF_MAX_RINGS; i++)
+      delete [] rings[i].slots;
+
 #ifdef PF_STATS
-   // Destroy the global statistics manager
-   delete pStatisticsMgr;
+   // Destroy the global statistics manager with the last buffer manager
+   if (--numStatisticsUsers == 0) {
+      delete pStatisticsMgr;
+      pStatisticsMgr = NULL;
+   }
 #endif
 
 #ifdef PF_LOG
@@ -173,11 +230,16 @@ PF_BufferMgr::~PF_BufferMgr()
 //       pageNum - number of the page to read
 //       bMultiplePins - if FALSE, it is an error to ask for a page that is
 //                       already pinned in the buffer.
+//       ring - if not PF_NO_RING, a page that has to be read goes into a
+//              frame of this ring
 // Out:  ppBuffer - set *ppBuffer to point to the page in the buffer
 // Ret:  PF return code
 //
+// Note: A page that is in the buffer is pinned without the buffer latch,
+// unless bMultiplePins is FALSE.  Only misses take the latch.
+//
 RC PF_BufferMgr::GetPage(int fd, PageNum pageNum, char **ppBuffer,
-      int bMultiplePins)
+      int bMultiplePins, int ring)
 {
    RC  rc;     // return code
    int slot;   // buffer slot where page is located
@@ -188,14 +250,32 @@ RC PF_BufferMgr::GetPage(int fd, PageNum pageNum, char **ppBuffer,
    WriteLog(psMessage);
 #endif
 
+   if (bMultiplePins && hashTable.FindShared(fd, pageNum, slot) == 0 &&
+         TryPin(slot, fd, pageNum)) {
+
+#ifdef PF_STATS
+      pStatisticsMgr->Register(PF_GETPAGE, STAT_ADDONE);
+      pStatisticsMgr->Register(PF_PAGEFOUND, STAT_ADDONE);
+#endif
+      __atomic_load_n(&pPolicy, __ATOMIC_ACQUIRE)->Count(TRUE);
+      Touch(slot, PF_TOUCH_HIT);
+      *ppBuffer = bufTable[slot].pData;
+      return (0);
+   }
+
+   lock_guard<mutex> guard(latch);
 
 #ifdef PF_STATS
    pStatisticsMgr->Register(PF_GETPAGE, STAT_ADDONE);
 #endif
 
-   // Search for page in buffer
-   if ((rc = hashTable.Find(fd, pageNum, slot)) &&
-         (rc != PF_HASHNOTFOUND))
+   // Search for page in buffer.  A page with I/O in flight is not usable
+   // before the I/O is done, and may be gone if a read failed.
+   while (!(rc = hashTable.Find(fd, pageNum, slot)) &&
+         bufTable[slot].ioState != PF_IO_NONE)
+      if ((rc = ReapIO(TRUE)))
+         return (rc);
+   if (rc && (rc != PF_HASHNOTFOUND))
       return (rc);                // unexpected error
 
    // If page not in buffer...
@@ -204,19 +284,23 @@ RC PF_BufferMgr::GetPage(int fd, PageNum pageNum, char **ppBuffer,
 #ifdef PF_STATS
    pStatisticsMgr->Register(PF_PAGENOTFOUND, STAT_ADDONE);
 #endif
+      pPolicy->Count(FALSE);
 
-      // Allocate an empty page, this will also promote the newly allocated
-      // page to the MRU slot
-      if ((rc = InternalAlloc(slot)))
+      // Allocate an empty page, in the ring if there is one
+      if ((rc = (ring == PF_NO_RING) ? InternalAlloc(slot)
+                                     : RingAlloc(ring, slot)))
          return (rc);
 
-      // read the page, insert it into the hash table,
-      // and initialize the page description entry
-      if ((rc = ReadPage(fd, pageNum, bufTable[slot].pData)) ||
+      // read the page into a frame of its size, insert it into the hash
+      // table, and initialize the page description entry
+      if ((rc = SizeFrame(slot, PageSizeOf(fd))) ||
+            (rc = ReadPage(fd, pageNum, bufTable[slot].pData)) ||
             (rc = hashTable.Insert(fd, pageNum, slot)) ||
-            (rc = InitPageDesc(fd, pageNum, slot))) {
+            (rc = InitPageDesc(fd, pageNum, slot, ring))) {
 
          // Put the slot back on the free list before returning the error
+         if (bufTable[slot].ring != PF_NO_RING)
+            Forget(slot);
          Unlink(slot);
          InsertFree(slot);
          return (rc);
@@ -230,23 +314,24 @@ RC PF_BufferMgr::GetPage(int fd, PageNum pageNum, char **ppBuffer,
 #ifdef PF_STATS
    pStatisticsMgr->Register(PF_PAGEFOUND, STAT_ADDONE);
 #endif
+      pPolicy->Count(TRUE);
 
       // Error if we don't want to get a pinned page
-      if (!bMultiplePins && bufTable[slot].pinCount > 0)
+      if (!bMultiplePins && bufTable[slot].Pins() > 0)
          return (PF_PAGEPINNED);
 
       // Page is alredy in memory, just increment pin count
-      bufTable[slot].pinCount++;
+      __atomic_add_fetch(&bufTable[slot].pinCount, 1, __ATOMIC_ACQ_REL);
 #ifdef PF_LOG
       sprintf (psMessage, "Page found in buffer.  %d pin count.\n",
-            bufTable[slot].pinCount);
+            bufTable[slot].Pins());
       WriteLog(psMessage);
 #endif
 
-      // Make this page the most recently used page
-      if ((rc = Unlink(slot)) ||
-            (rc = LinkHead (slot)))
-         return (rc);
+      // Let the replacement policy know the page was requested again.
+      // Pages in a ring stay there and are not promoted.
+      if (bufTable[slot].ring == PF_NO_RING)
+         pPolicy->Accessed(slot);
    }
 
    // Point ppBuffer to page
@@ -276,6 +361,8 @@ RC PF_BufferMgr::AllocatePage(int fd, PageNum pageNum, char **ppBuffer)
    WriteLog(psMessage);
 #endif
 
+   lock_guard<mutex> guard(latch);
+
    // If page is already in buffer, return an error
    if (!(rc = hashTable.Find(fd, pageNum, slot)))
       return (PF_PAGEINBUF);
@@ -286,9 +373,10 @@ RC PF_BufferMgr::AllocatePage(int fd, PageNum pageNum, char **ppBuffer)
    if ((rc = InternalAlloc(slot)))
       return (rc);
 
-   // Insert the page into the hash table,
+   // Give the page a frame of its size, insert it into the hash table,
    // and initialize the page description entry
-   if ((rc = hashTable.Insert(fd, pageNum, slot)) ||
+   if ((rc = SizeFrame(slot, PageSizeOf(fd))) ||
+         (rc = hashTable.Insert(fd, pageNum, slot)) ||
          (rc = InitPageDesc(fd, pageNum, slot))) {
 
       // Put the slot back on the free list before returning the error
@@ -312,7 +400,10 @@ RC PF_BufferMgr::AllocatePage(int fd, PageNum pageNum, char **ppBuffer)
 // MarkDirty
 //
 // Desc: Mark a page dirty so that when it is discarded from the buffer
-//       it will be written back to the file.
+//       it will be written back to the file.  A page that is being
+//       written back is cleared before the write, so a page changed
+//       during the write and then marked dirty is written again later.
+//       Runs without the buffer latch.
 // In:   fd - OS file descriptor of the file associated with the page
 //       pageNum - number of the page to mark dirty
 // Ret:  PF return code
@@ -329,23 +420,18 @@ RC PF_BufferMgr::MarkDirty(int fd, PageNum pageNum)
 #endif
 
    // The page must be found and pinned in the buffer
-   if ((rc = hashTable.Find(fd, pageNum, slot))){
+   if ((rc = hashTable.FindShared(fd, pageNum, slot))){
       if (rc == PF_HASHNOTFOUND)
          return (PF_PAGENOTINBUF);
       else
          return (rc);              // unexpected error
    }
 
-   if (bufTable[slot].pinCount == 0)
+   if (bufTable[slot].Pins() <= 0)
       return (PF_PAGEUNPINNED);
 
    // Mark this page dirty
-   bufTable[slot].bDirty = TRUE;
-
-   // Make this page the most recently used page
-   if ((rc = Unlink(slot)) ||
-         (rc = LinkHead (slot)))
-      return (rc);
+   SetDirty(slot);
 
    // Return ok
    return (0);
@@ -355,6 +441,9 @@ RC PF_BufferMgr::MarkDirty(int fd, PageNum pageNum)
 // UnpinPage
 //
 // Desc: Unpin a page so that it can be discarded from the buffer.
+//       Runs without the buffer latch; releasing the last pin is passed
+//       on to the replacement policy, and to the page cleaner if the page
+//       is dirty, through the touch list.
 // In:   fd - OS file descriptor of the file associated with the page
 //       pageNum - number of the page to unpin
 // Ret:  PF return code
@@ -365,34 +454,96 @@ RC PF_BufferMgr::UnpinPage(int fd, PageNum pageNum)
    int slot;     // buffer slot where page is located
 
    // The page must be found and pinned in the buffer
-   if ((rc = hashTable.Find(fd, pageNum, slot))){
+   if ((rc = hashTable.FindShared(fd, pageNum, slot))){
       if (rc == PF_HASHNOTFOUND)
          return (PF_PAGENOTINBUF);
       else
          return (rc);              // unexpected error
    }
 
-   if (bufTable[slot].pinCount == 0)
-      return (PF_PAGEUNPINNED);
+   int pins = bufTable[slot].Pins();
+   do {
+      if (pins <= 0)
+         return (PF_PAGEUNPINNED);
+   } while (!__atomic_compare_exchange_n(&bufTable[slot].pinCount, &pins,
+         pins - 1, TRUE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
 
 #ifdef PF_LOG
    char psMessage[100];
    sprintf (psMessage, "Unpinning (%d,%d). %d Pin count\n",
-         fd, pageNum, bufTable[slot].pinCount-1);
+         fd, pageNum, pins - 1);
    WriteLog(psMessage);
 #endif
 
-   // If unpinning the last pin, make it the most recently used page
-   if (--(bufTable[slot].pinCount) == 0) {
-      if ((rc = Unlink(slot)) ||
-            (rc = LinkHead (slot)))
-         return (rc);
-   }
+   // If unpinning the last pin, tell the replacement policy
+   if (pins == 1)
+      Touch(slot, PF_TOUCH_UNPIN);
 
    // Return ok
    return (0);
 }
 
+//
+// LatchPage
+//
+// Desc: Take the latch of a page the caller has pinned.  Any number of
+//       threads can hold it shared, or one thread exclusive.  The latch
+//       only orders the threads that take it; the buffer manager itself
+//       never does.  Spins for a while, then yields until it gets it.
+// In:   fd - OS file descriptor of the file associated with the page
+//       pageNum - number of the page
+//       bExclusive - TRUE for an exclusive latch
+// Ret:  PF_PAGENOTINBUF, PF_PAGEUNPINNED or 0
+//
+RC PF_BufferMgr::LatchPage(int fd, PageNum pageNum, int bExclusive)
+{
+   int slot;
+
+   if (hashTable.FindShared(fd, pageNum, slot))
+      return (PF_PAGENOTINBUF);
+   if (bufTable[slot].Pins() <= 0)
+      return (PF_PAGEUNPINNED);
+
+   int *pLatch = &bufTable[slot].latch;
+   for (int tries = 1; ; tries++) {
+      int held = __atomic_load_n(pLatch, __ATOMIC_RELAXED);
+      if ((bExclusive ? held == 0 : held >= 0) &&
+            __atomic_compare_exchange_n(pLatch, &held,
+               bExclusive ? PF_LATCH_EXCLUSIVE : held + 1, FALSE,
+               __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+         return (0);
+      if (tries % PF_LATCH_SPINS == 0)
+         this_thread::yield();
+   }
+}
+
+//
+// UnlatchPage
+//
+// Desc: Release a page latch taken with LatchPage.
+// In:   fd - OS file descriptor of the file associated with the page
+//       pageNum - number of the page
+// Ret:  PF_PAGENOTINBUF, PF_NOTLATCHED or 0
+//
+RC PF_BufferMgr::UnlatchPage(int fd, PageNum pageNum)
+{
+   int slot;
+
+   if (hashTable.FindShared(fd, pageNum, slot))
+      return (PF_PAGENOTINBUF);
+
+   int *pLatch = &bufTable[slot].latch;
+   int held = __atomic_load_n(pLatch, __ATOMIC_RELAXED);
+   do {
+      if (held == 0)
+         return (PF_NOTLATCHED);
+   } while (!__atomic_compare_exchange_n(pLatch, &held,
+         (held == PF_LATCH_EXCLUSIVE) ? 0 : held - 1, TRUE,
+         __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+   return (0);
+}
+
 //
 // FlushPages
 //
@@ -400,6 +551,8 @@ RC PF_BufferMgr::UnpinPage(int fd, PageNum pageNum)
 //       Returns a warning if any of the file's pages are pinned.
 //       A linear search of the buffer is performed.
 //       A better method is not needed because # of buffers are small.
+//       The dirty pages are written first, in page order, with one write
+//       per run of consecutive pages (see WriteBack).
 // In:   fd - file descriptor
 // Ret:  PF_PAGEPINNED or other PF return code
 //
@@ -417,43 +570,46 @@ RC PF_BufferMgr::FlushPages(int fd)
    pStatisticsMgr->Register(PF_FLUSHPAGES, STAT_ADDONE);
 #endif
 
-   // Do a linear scan of the buffer to find pages belonging to the file
-   int slot = first;
-   while (slot != INVALID_SLOT) {
+   lock_guard<mutex> guard(latch);
+
+   // Let write-back and read-ahead in flight finish first
+   if ((rc = Drain()))
+      return (rc);
 
-      int next = bufTable[slot].next;
+   // Take the file's unpinned pages out of reach of other threads, and
+   // write the dirty ones
+   vector<int> claimed, dirty;
+   for (int slot = first; slot != INVALID_SLOT; slot = bufTable[slot].next) {
+      if (bufTable[slot].fd != fd)
+         continue;
+      if (!Claim(slot))
+         rcWarn = PF_PAGEPINNED;
+      else {
+         claimed.push_back(slot);
+         if (bufTable[slot].bDirty)
+            dirty.push_back(slot);
+      }
+   }
+   if ((rc = WriteBack(dirty))) {
+      for (size_t i = 0; i < claimed.size(); i++)
+         __atomic_store_n(&bufTable[claimed[i]].pinCount, 0, __ATOMIC_RELEASE);
+      return (rc);
+   }
 
-      // If the page belongs to the passed-in file descriptor
-      if (bufTable[slot].fd == fd) {
+   // Remove the claimed pages from the buffer
+   for (size_t i = 0; i < claimed.size(); i++) {
+      int slot = claimed[i];
 
 #ifdef PF_LOG
  sprintf (psMessage, "Page (%d) is in buffer manager.\n", bufTable[slot].pageNum);
  WriteLog(psMessage);
 #endif
-         // Ensure the page is not pinned
-         if (bufTable[slot].pinCount) {
-            rcWarn = PF_PAGEPINNED;
-         }
-         else {
-            // Write the page if dirty
-            if (bufTable[slot].bDirty) {
-#ifdef PF_LOG
- sprintf (psMessage, "Page (%d) is dirty\n",bufTable[slot].pageNum);
- WriteLog(psMessage);
-#endif
-               if ((rc = WritePage(fd, bufTable[slot].pageNum, bufTable[slot].pData)))
-                  return (rc);
-               bufTable[slot].bDirty = FALSE;
-            }
-
-            // Remove page from the hash table and add the slot to the free list
-            if ((rc = hashTable.Delete(fd, bufTable[slot].pageNum)) ||
-                  (rc = Unlink(slot)) ||
-                  (rc = InsertFree(slot)))
-               return (rc);
-         }
-      }
-      slot = next;
+      // Remove page from the hash table and add the slot to the free list
+      if ((rc = hashTable.Delete(fd, bufTable[slot].pageNum)) ||
+            (rc = Unlink(slot)) ||
+            (rc = InsertFree(slot)))
+         return (rc);
+      Forget(slot);
    }
 
 #ifdef PF_LOG
@@ -464,11 +620,60 @@ RC PF_BufferMgr::FlushPages(int fd)
    return (rcWarn);
 }
 
+//
+// DiscardPages
+//
+// Desc: Remove the pages of a file from pageNum on from the buffer without
+//       writing them, dirty or not.  Used when the file is cut short.
+// In:   fd - file descriptor
+//       pageNum - first page to remove
+// Ret:  PF_PAGEPINNED if one of the pages is pinned, in which case none is
+//       removed, or other PF error
+//
+RC PF_BufferMgr::DiscardPages(int fd, PageNum pageNum)
+{
+   RC rc;  // return codes
+
+   lock_guard<mutex> guard(latch);
+
+   // I/O in flight on the pages must not land after they are gone
+   if ((rc = Drain()))
+      return (rc);
+
+   vector<int> claimed;
+   for (int slot = first; slot != INVALID_SLOT; slot = bufTable[slot].next) {
+      if (bufTable[slot].fd != fd || bufTable[slot].pageNum < pageNum)
+         continue;
+      if (!Claim(slot)) {
+         for (size_t i = 0; i < claimed.size(); i++)
+            __atomic_store_n(&bufTable[claimed[i]].pinCount, 0,
+                  __ATOMIC_RELEASE);
+         return (PF_PAGEPINNED);
+      }
+      claimed.push_back(slot);
+   }
+
+   for (size_t i = 0; i < claimed.size(); i++) {
+      int slot = claimed[i];
+      ClearDirty(slot);
+      if ((rc = hashTable.Delete(fd, bufTable[slot].pageNum)) ||
+            (rc = Unlink(slot)) ||
+            (rc = InsertFree(slot)))
+         return (rc);
+      Forget(slot);
+   }
+
+   // Return ok
+   return (0);
+}
+
 //
 // ForcePages
 //
 // Desc: If a page is dirty then force the page from the buffer pool
 //       onto disk.  The page will not be forced out of the buffer pool.
+//       When all pages are forced, they are written in page order, with
+//       one write per run of consecutive pages (see WriteBack).
 // In:   The page number, a default value of ALL_PAGES will be used if
 //       the client doesn't provide a value.  This will force all pages.
 // Ret:  Standard PF errors
@@ -484,39 +689,24 @@ RC PF_BufferMgr::ForcePages(int fd, PageNum pageNum)
    WriteLog(psMessage);
 #endif
 
-   // Do a linear scan of the buffer to find the page for the file
-   int slot = first;
-   while (slot != INVALID_SLOT) {
-
-      int next = bufTable[slot].next;
+   lock_guard<mutex> guard(latch);
 
-      // If the page belongs to the passed-in file descriptor
-      if (bufTable[slot].fd == fd &&
-            (pageNum==ALL_PAGES || bufTable[slot].pageNum == pageNum)) {
+   // A page being written back may be written again below
+   if ((rc = Drain()))
+      return (rc);
 
-#ifdef PF_LOG
- sprintf (psMessage, "Page (%d) is in buffer pool.\n", bufTable[slot].pageNum);
- WriteLog(psMessage);
-#endif
-         // I don't care if the page is pinned or not, just write it if
-         // it is dirty.
-         if (bufTable[slot].bDirty) {
-#ifdef PF_LOG
-sprintf (psMessage, "Page (%d) is dirty\n",bufTable[slot].pageNum);
-WriteLog(psMessage);
-#endif
-            if ((rc = WritePage(fd, bufTable[slot].pageNum, bufTable[slot].pData)))
-               return (rc);
-            bufTable[slot].bDirty = FALSE;
-         }
-      }
-      slot = next;
-   }
+   // Do a linear scan of the buffer to find the page for the file.
+   // I don't care if the page is pinned or not, just write it if it is
+   // dirty.
+   vector<int> dirty;
+   for (int slot = first; slot != INVALID_SLOT; slot = bufTable[slot].next)
+      if (bufTable[slot].fd == fd && bufTable[slot].bDirty &&
+            (pageNum==ALL_PAGES || bufTable[slot].pageNum == pageNum))
+         dirty.push_back(slot);
 
-   return 0;
+   return WriteBack(dirty);
 }
 
-
 //
 // PrintBuffer
 //
@@ -528,10 +718,12 @@ WriteLog(psMessage);
 //
 RC PF_BufferMgr::PrintBuffer()
 {
+   lock_guard<mutex> guard(latch);
+
    cout << "Buffer contains " << numPages << " pages of size "
-      << pageSize <<".\n";
-   cout << "Contents in order from most recently used to "
-      << "least recently used.\n";
+      << pageSize << " by default.\n";
+   cout << "Contents in order from most recently to "
+      << "least recently loaded.\n";
 
    int slot, next;
    slot = first;
@@ -541,7 +733,11 @@ RC PF_BufferMgr::PrintBuffer()
       cout << "  fd = " << bufTable[slot].fd << "\n";
       cout << "  pageNum = " << bufTable[slot].pageNum << "\n";
       cout << "  bDirty = " << bufTable[slot].bDirty << "\n";
-      cout << "  pinCount = " << bufTable[slot].pinCount << "\n";
+      cout << "  pinCount = " << bufTable[slot].Pins() << "\n";
+      if (bufTable[slot].frameSize != pageSize)
+         cout << "  size = " << bufTable[slot].frameSize << "\n";
+      if (bufTable[slot].ring != PF_NO_RING)
+         cout << "  ring = " << bufTable[slot].ring << "\n";
       slot = next;
    }
 
@@ -549,6 +745,335 @@ RC PF_BufferMgr::PrintBuffer()
       cout << "Buffer is empty!\n";
    else
       cout << "All remaining slots are free.\n";
+   cout << "I/O backend is " << pIO->Name() << ".\n";
+   if (arena.bHuge == PF_ARENA_HUGETLB)
+      cout << "Buffer pages are on huge pages.\n";
+   else if (arena.bHuge == PF_ARENA_THP)
+      cout << "Buffer pages are on transparent huge pages.\n";
+
+   // Hit ratio of every policy that has served requests
+   cout << "Replacement policy is " << pPolicy->Name() << ".\n";
+   for (int i = 0; i < PF_NUM_POLICIES; i++) {
+      long requests = policies[i]->GetRequests();
+      if (requests == 0)
+         continue;
+      cout << "  " << policies[i]->Name() << ": "
+         << policies[i]->GetHits() << " hits in " << requests
+         << " requests, hit ratio "
+         << (double)policies[i]->GetHits() / requests << "\n";
+   }
+
+   return 0;
+}
+
+//
+// SetReplacementPolicy
+//
+// Desc: Switch to the replacement policy named policyName.  The new policy
+//       starts out knowing only which pages are in the buffer.
+//       This routine will be called via the set command.
+// In:   policyName - "lru", "clock", "2q" or "lruk"
+// Ret:  PF_BADPARAM if there is no such policy
+//
+RC PF_BufferMgr::SetReplacementPolicy(const char *policyName)
+{
+   PF_ReplacementPolicy *pNew = NULL;
+   for (int i = 0; i < PF_NUM_POLICIES; i++)
+      if (strcasecmp(policyName, policies[i]->Name()) == 0)
+         pNew = policies[i];
+   if (pNew == NULL)
+      return (PF_BADPARAM);
+
+   lock_guard<mutex> guard(latch);
+   ApplyTouches();
+   if (pNew != pPolicy) {
+      pNew->Reset(numPages);
+      for (int slot = last; slot != INVALID_SLOT; slot = bufTable[slot].prev) {
+         if (bufTable[slot].ring != PF_NO_RING)
+            continue;
+         pNew->Loaded(slot, bufTable[slot].fd, bufTable[slot].pageNum);
+         if (bufTable[slot].Pins() == 0)
+            pNew->Unpinned(slot);
+      }
+      __atomic_store_n(&pPolicy, pNew, __ATOMIC_RELEASE);
+   }
+
+   return 0;
+}
+
+//
+// ReadAhead
+//
+// Desc: Bring pages into the buffer before they are asked for.  Pages of
+//       the range that are not in the buffer are read run by run, each run
+//       of consecutive pages with one request to the I/O backend into as
+//       many frames.  The pages are left unpinned once they are read; until
+//       then GetPage waits for them.  If no frame can be had for a run, the
+//       kernel is told to prefetch it instead (posix_fadvise WILLNEED).
+// In:   fd - OS file descriptor of the file
+//       pageNum - first page of the range
+//       numPages - number of pages in the range, at most GetReadAhead;
+//                  the caller makes sure they all exist in the file
+//       ring - ring to read the pages into, or PF_NO_RING
+// Ret:  PF return code
+//
+RC PF_BufferMgr::ReadAhead(int fd, PageNum pageNum, int numPages, int ring)
+{
+   lock_guard<mutex> guard(latch);
+   return ReadRuns(fd, pageNum, numPages, ring);
+}
+
+//
+// ReadRuns
+//
+// Desc: Internal.  ReadAhead, with the buffer latch held
+//
+RC PF_BufferMgr::ReadRuns(int fd, PageNum pageNum, int numPages, int ring)
+{
+   RC  rc;
+   if (numPages > PF_MAX_READAHEAD)
+      numPages = PF_MAX_READAHEAD;
+
+   int slots[PF_MAX_READAHEAD];
+   PageNum end = pageNum + numPages;
+   PageNum runStart;
+   int runLength, slot;
+
+   while (pageNum < end) {
+
+      // Skip pages that are already in the buffer
+      if (hashTable.Find(fd, pageNum, slot) == 0) {
+         pageNum++;
+         continue;
+      }
+
+      // Take frames for the run of pages that are not.  A frame stays
+      // claimed once it is taken so that the next one cannot replace it.
+      runStart = pageNum;
+      runLength = 0;
+      rc = 0;
+      while (pageNum < end && hashTable.Find(fd, pageNum, slot) != 0) {
+         if ((rc = (ring == PF_NO_RING) ? InternalAlloc(slot)
+                                        : RingAlloc(ring, slot)))
+            break;
+         slots[runLength++] = slot;
+         pageNum++;
+      }
+
+      // Start reading the run into the frames
+      if (runLength > 0) {
+         RC rcRead = StartRead(fd, runStart, slots, runLength, ring);
+         if (rcRead)
+            return (rcRead);
+#ifdef PF_STATS
+         pStatisticsMgr->Register(PF_READAHEAD, STAT_ADDVALUE, &runLength);
+#endif
+      }
+
+      // Out of frames: leave the rest to the kernel
+      if (rc == PF_NOBUF) {
+         int size = PageSizeOf(fd);
+         posix_fadvise(fd, pageNum * (long)size + PF_FILE_HDR_SIZE,
+               (end - pageNum) * (long)size, POSIX_FADV_WILLNEED);
+         return (0);
+      }
+      else if (rc)
+         return (rc);
+   }
+
+   // Finish whatever the backend is already done with
+   return ReapIO(FALSE);
+}
+
+//
+// PrefetchPage
+//
+// Desc: Start reading a page the caller expects to ask for soon.  With an
+//       asynchronous I/O backend the caller can go on and prefetch more
+//       pages, which are then read concurrently.  The sync backend ignores
+//       prefetches: reading the page now would not save a read later, and
+//       the caller may never ask for it.
+// In:   fd - OS file descriptor of the file
+//       pageNum - page to read; the caller makes sure it exists in the file
+// Ret:  PF return code
+//
+RC PF_BufferMgr::PrefetchPage(int fd, PageNum pageNum)
+{
+   lock_guard<mutex> guard(latch);
+   if (!pIO->IsAsync())
+      return (0);
+   return ReadRuns(fd, pageNum, 1, PF_NO_RING);
+}
+
+//
+// SetReadAhead
+//
+// Desc: Set how many pages PF_FileHandle reads ahead when it sees pages
+//       of a file requested in order.
+//       This routine will be called via the set command.
+// In:   numPages - read-ahead window, 0 turns read-ahead off
+// Ret:  PF_BADPARAM if numPages is negative or above PF_MAX_READAHEAD
+//
+RC PF_BufferMgr::SetReadAhead(int numPages)
+{
+   if (numPages < 0 || numPages > PF_MAX_READAHEAD)
+      return (PF_BADPARAM);
+   __atomic_store_n(&readAhead, numPages, __ATOMIC_RELAXED);
+   return (0);
+}
+
+//
+// GetReadAhead
+//
+// Desc: The read-ahead window, capped so that reading ahead does not
+//       replace pages that were read ahead but not used yet.  Without a
+//       ring the cap is a quarter of the buffer.  A ring reuses its frames
+//       in order and the next window is read halfway through the last
+//       one, so the cap is half the ring.
+// In:   ring - ring the pages will be read through, or PF_NO_RING
+// Ret:  number of pages to read ahead, 0 for none
+//
+int PF_BufferMgr::GetReadAhead(int ring) const
+{
+   int maxPages = (ring == PF_NO_RING) ? numPages / 4 :
+      __atomic_load_n(&rings[ring].size, __ATOMIC_RELAXED) / 2;
+   int window = __atomic_load_n(&readAhead, __ATOMIC_RELAXED);
+   return (window < maxPages) ? window : maxPages;
+}
+
+//
+// SetIOBackend
+//
+// Desc: Switch to the I/O backend named backendName.  I/O in flight on the
+//       old backend is finished first.
+//       This routine will be called via the set command.
+// In:   backendName - "sync", "threads" or "uring"; "uring" falls back to
+//                     "threads" where the kernel does not allow io_uring
+// Ret:  PF_BADPARAM if there is no such backend
+//
+RC PF_BufferMgr::SetIOBackend(const char *backendName)
+{
+   RC rc;
+
+   PF_IOBackend *pNew = PF_IOBackend::Create(backendName);
+   if (pNew == NULL)
+      return (PF_BADPARAM);
+
+   lock_guard<mutex> guard(latch);
+   if ((rc = Drain())) {
+      delete pNew;
+      return (rc);
+   }
+   delete pIO;
+   pIO = pNew;
+
+   return 0;
+}
+
+//
+// SetCleaner
+//
+// Desc: Turn the page cleaner on or off.  The cleaner is a thread that
+//       writes dirty pages back in the background whenever more than
+//       highPercent of the buffer is dirty, until no more than lowPercent
+//       is, so that replacing a page rarely has to wait for a write.
+//       This routine will be called via the set command.
+// In:   highPercent - high watermark in percent of the buffer; 0 turns
+//                     the cleaner off
+//       lowPercent - low watermark, below highPercent
+// Ret:  PF_BADPARAM unless 0 <= lowPercent < highPercent <= 100, or
+//       highPercent is 0
+//
+RC PF_BufferMgr::SetCleaner(int highPercent, int lowPercent)
+{
+   RC rc;
+
+   if (highPercent != 0 && (lowPercent < 0 || lowPercent >= highPercent ||
+         highPercent > 100))
+      return (PF_BADPARAM);
+
+   lock_guard<mutex> guard(latch);
+
+   // Writes of the old setting finish first
+   if ((rc = Drain()))
+      return (rc);
+
+   cleanHigh = highPercent;
+   cleanLow = lowPercent;
+   if (highPercent == 0) {
+      delete pCleanerIO;
+      pCleanerIO = NULL;
+   }
+   else {
+      if (pCleanerIO == NULL)
+         pCleanerIO = new PF_ThreadIO(1);
+      Clean();
+   }
+
+   return 0;
+}
+
+//
+// OpenRing
+//
+// Desc: Reserve a buffer ring.  Pages that GetPage reads through the ring
+//       go into the ring's frames, and once all of them are used the ring
+//       reuses its oldest unpinned frame instead of asking the replacement
+//       policy for a victim.  A sequential scan thus displaces at most
+//       numFrames pages of the buffer pool.
+// In:   numFrames - number of frames in the ring, at most the buffer size
+// Out:  ring - the ring, or PF_NO_RING if all rings are in use
+// Ret:  PF_BADPARAM if numFrames is not positive
+//
+RC PF_BufferMgr::OpenRing(int &ring, int numFrames)
+{
+   if (numFrames <= 0)
+      return (PF_BADPARAM);
+   if (numFrames > numPages)
+      numFrames = numPages;
+
+   lock_guard<mutex> guard(latch);
+   for (ring = 0; ring < PF_MAX_RINGS; ring++)
+      if (rings[ring].size == 0)
+         break;
+
+   // Without a ring the caller simply reads through the buffer pool
+   if (ring == PF_MAX_RINGS) {
+      ring = PF_NO_RING;
+      return 0;
+   }
+
+   rings[ring].slots = new int[numFrames];
+   for (int i = 0; i < numFrames; i++)
+      rings[ring].slots[i] = INVALID_SLOT;
+   rings[ring].next = 0;
+   __atomic_store_n(&rings[ring].size, numFrames, __ATOMIC_RELAXED);
+
+   return 0;
+}
+
+//
+// CloseRing
+//
+// Desc: Release a buffer ring.  The pages in its frames stay in the buffer
+//       and are handed over to the replacement policy.
+// In:   ring - ring returned by OpenRing
+// Ret:  PF_BADPARAM if ring is not open
+//
+RC PF_BufferMgr::CloseRing(int ring)
+{
+   lock_guard<mutex> guard(latch);
+   if (ring < 0 || ring >= PF_MAX_RINGS || rings[ring].size == 0)
+      return (PF_BADPARAM);
+
+   for (int i = 0; i < rings[ring].size; i++)
+      if (rings[ring].slots[i] != INVALID_SLOT)
+         Adopt(rings[ring].slots[i]);
+
+   delete [] rings[ring].slots;
+   rings[ring].slots = NULL;
+   rings[ring].next = 0;
+   __atomic_store_n(&rings[ring].size, 0, __ATOMIC_RELAXED);
 
    return 0;
 }
@@ -569,16 +1094,23 @@ RC PF_BufferMgr::ClearBuffer()
 {
    RC rc;
 
+   lock_guard<mutex> guard(latch);
+   if ((rc = Drain()))
+      return (rc);
+
    int slot, next;
    slot = first;
    while (slot != INVALID_SLOT) {
       next = bufTable[slot].next;
-      if (bufTable[slot].pinCount == 0)
+      if (Claim(slot)) {
+         ClearDirty(slot);
          if ((rc = hashTable.Delete(bufTable[slot].fd,
                bufTable[slot].pageNum)) ||
             (rc = Unlink(slot)) ||
             (rc = InsertFree(slot)))
          return (rc);
+         Forget(slot);
+      }
       slot = next;
    }
 
@@ -593,90 +1125,122 @@ RC PF_BufferMgr::ClearBuffer()
 // In:   The new buffer size
 // Out:  Nothing
 // Ret:  0 for success or,
-//       Some other PF error (probably PF_NOBUF)
+//       PF_TOOSMALL if the pinned pages would not fit, or
+//       some other PF error
 //
-// Notes: This method attempts to copy all the old pages which I am
-// unable to kick out of the old buffer manager into the new buffer
-// manager.  This obviously cannot always be successfull!
+// Notes: Unpinned pages are written back if dirty and dropped from the
+// buffer.  Pinned pages move to the new buffer table, but keep their page
+// memory since clients hold pointers into it.  No other thread may use the
+// buffer meanwhile, since pages are looked up without the latch.
 //
 RC PF_BufferMgr::ResizeBuffer(int iNewSize)
 {
-   int i;
+   int i, slot;
    RC rc;
 
-   // First try and clear out the old buffer!
-   ClearBuffer();
+   lock_guard<mutex> guard(latch);
+   ApplyTouches();
 
-   // Allocate memory for a new buffer table
-   PF_BufPageDesc *pNewBufTable = new PF_BufPageDesc[iNewSize];
+   // Slots are about to move, so no I/O may be in flight into them
+   if ((rc = Drain()))
+      return (rc);
 
-   // Initialize the new buffer table and allocate memory for buffer
-   // pages.  Initially, the free list contains all pages
-   for (i = 0; i < iNewSize; i++) {
-      if ((pNewBufTable[i].pData = new char[pageSize]) == NULL) {
-         cerr << "Not enough memory for buffer\n";
-         exit(1);
+   // All pinned pages must fit into the new buffer
+   int numPinned = 0;
+   for (slot = first; slot != INVALID_SLOT; slot = bufTable[slot].next)
+      if (bufTable[slot].Pins() > 0)
+         numPinned++;
+   if (iNewSize <= 0 || iNewSize < numPinned)
+      return (PF_TOOSMALL);
+
+   // Write out dirty unpinned pages before anything is changed, so that
+   // an I/O error leaves the buffer intact
+   for (slot = first; slot != INVALID_SLOT; slot = bufTable[slot].next) {
+      if (bufTable[slot].Pins() == 0 && bufTable[slot].bDirty) {
+         if ((rc = WritePage(bufTable[slot].fd, bufTable[slot].pageNum,
+               bufTable[slot].pData)))
+            return (rc);
+         ClearDirty(slot);
       }
-
-      memset ((void *)pNewBufTable[i].pData, 0, pageSize);
-
-      pNewBufTable[i].prev = i - 1;
-      pNewBufTable[i].next = i + 1;
    }
-   pNewBufTable[0].prev = pNewBufTable[iNewSize - 1].next = INVALID_SLOT;
 
-   // Now we must remember the old first and last slots and (of course)
-   // the buffer table itself.  Then we use insert methods to insert
-   // each of the entries into the new buffertable
-   int oldFirst = first;
+   // Empty the hash table and size it for the new buffer
+   for (slot = first; slot != INVALID_SLOT; slot = bufTable[slot].next)
+      if ((rc = hashTable.Delete(bufTable[slot].fd, bufTable[slot].pageNum)))
+         return (rc);
+   if ((rc = hashTable.Resize(iNewSize)))
+      return (rc);
+
    PF_BufPageDesc *pOldBufTable = bufTable;
+   PF_BufArena oldArena = arena;
+   int oldNumPages = numPages;
+   int oldLast = last;
 
-   // Setup the new number of pages,  first, last and free
+   bufTable = new PF_BufPageDesc[iNewSize];
+   arena = AllocArena(iNewSize);
    numPages = iNewSize;
-   first = last = INVALID_SLOT;
-   free = 0;
-
-   // Setup the new buffer table
-   bufTable = pNewBufTable;
-
-   // We must first remove from the hashtable any possible entries
-   int slot, next, newSlot;
-   slot = oldFirst;
-   while (slot != INVALID_SLOT) {
-      next = pOldBufTable[slot].next;
-
-      // Must remove the entry from the hashtable from the
-      if ((rc=hashTable.Delete(pOldBufTable[slot].fd, pOldBufTable[slot].pageNum)))
-         return (rc);
-      slot = next;
+   first = last = free = INVALID_SLOT;
+   pPolicy->Reset(iNewSize);
+
+   // Slot numbers change, so the rings start over empty
+   for (i = 0; i < PF_MAX_RINGS; i++) {
+      for (int j = 0; j < rings[i].size; j++)
+         rings[i].slots[j] = INVALID_SLOT;
+      rings[i].next = 0;
    }
 
-   // Now we traverse through the old buffer table and copy any old
-   // entries into the new one
-   slot = oldFirst;
-   while (slot != INVALID_SLOT) {
-
-      next = pOldBufTable[slot].next;
-      // Allocate a new slot for the old page
-      if ((rc = InternalAlloc(newSlot)))
-         return (rc);
-
-      // Insert the page into the hash table,
-      // and initialize the page description entry
-      if ((rc = hashTable.Insert(pOldBufTable[slot].fd,
-            pOldBufTable[slot].pageNum, newSlot)) ||
-            (rc = InitPageDesc(pOldBufTable[slot].fd,
-            pOldBufTable[slot].pageNum, newSlot)))
+   // Move the pinned pages over, least recently used first so that
+   // LinkHead leaves them in their old order
+   int newSlot = 0;
+   for (slot = oldLast; slot != INVALID_SLOT; slot = pOldBufTable[slot].prev) {
+      if (pOldBufTable[slot].pinCount <= 0)
+         continue;
+      bufTable[newSlot] = pOldBufTable[slot];
+      bufTable[newSlot].ring = PF_NO_RING;
+      bufTable[newSlot].touched = 0;
+      if ((rc = hashTable.Insert(bufTable[newSlot].fd,
+            bufTable[newSlot].pageNum, newSlot)) ||
+            (rc = LinkHead(newSlot)))
          return (rc);
+      pPolicy->Loaded(newSlot, bufTable[newSlot].fd, bufTable[newSlot].pageNum);
+      newSlot++;
+   }
 
-      // Put the slot back on the free list before returning the error
-      Unlink(newSlot);
-      InsertFree(newSlot);
-
-      slot = next;
+   // Frames of pages that did not move are given up: those of larger
+   // pages are unmapped, and those of earlier retired arenas released.
+   // The moved pages count the frames they keep in the old arena.  The
+   // remaining slots get page memory from the new arena and go on the
+   // free list
+   for (slot = 0; slot < oldNumPages; slot++) {
+      char *pData = pOldBufTable[slot].pData;
+      if (pOldBufTable[slot].pinCount > 0) {
+         if (pOldBufTable[slot].frameSize <= pageSize &&
+               pData >= oldArena.pMem && pData < oldArena.pMem + oldArena.size)
+            oldArena.numLive++;
+      }
+      else if (pOldBufTable[slot].frameSize > pageSize)
+         munmap(pData, pOldBufTable[slot].frameSize);
+      else
+         ReleaseFrame(pData);
+   }
+   for (i = iNewSize - 1; i >= newSlot; i--) {
+      bufTable[i].pData = arena.pMem + (size_t)i * pageSize;
+      bufTable[i].frameSize = pageSize;
+      bufTable[i].prev = INVALID_SLOT;
+      bufTable[i].bDirty = FALSE;
+      bufTable[i].latch = 0;
+      bufTable[i].ring = PF_NO_RING;
+      bufTable[i].ioState = PF_IO_NONE;
+      bufTable[i].touched = 0;
+      InsertFree(i);
    }
 
-   // Finally, delete the old buffer table
+   // Finally, release the old arena, unless pinned pages still live in it,
+   // and delete the old buffer table
+   if (oldArena.numLive > 0)
+      retired.push_back(oldArena);
+   else
+      FreeArena(oldArena);
    delete [] pOldBufTable;
 
    return 0;
@@ -684,15 +1248,184 @@ RC PF_BufferMgr::ResizeBuffer(int iNewSize)
 
 
 //
-// InsertFree
+// AllocArena
 //
-// Desc: Internal.  Insert a slot at the head of the free list
-// In:   slot - slot number to insert
-// Ret:  PF return code
+// Desc: Internal.  Map zeroed, page-aligned memory for numFrames buffer
+//       pages.  The alignment lets the pages be read and written with
+//       O_DIRECT.  If huge pages were asked for, the arena is rounded up to
+//       whole huge pages and mapped with MAP_HUGETLB; where no huge pages
+//       are reserved, transparent huge pages are requested instead.
+// In:   numFrames - number of buffer pages
+// Ret:  the arena; exits if there is not enough memory
 //
-RC PF_BufferMgr::InsertFree(int slot)
+PF_BufArena PF_BufferMgr::AllocArena(int numFrames)
 {
-   bufTable[slot].next = free;
+   PF_BufArena a;
+   a.size = (size_t)numFrames * pageSize;
+   a.bHuge = PF_ARENA_NORMAL;
+   a.pMem = (char *)MAP_FAILED;
+   a.numLive = 0;
+
+   if (bHugePages) {
+      a.size = (a.size + PF_HUGE_PAGE_SIZE - 1) / PF_HUGE_PAGE_SIZE
+         * PF_HUGE_PAGE_SIZE;
+      a.pMem = (char *)mmap(NULL, a.size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (a.pMem != MAP_FAILED)
+         a.bHuge = PF_ARENA_HUGETLB;
+   }
+   if (a.pMem == MAP_FAILED) {
+      a.pMem = (char *)mmap(NULL, a.size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (a.pMem == MAP_FAILED) {
+         cerr << "Not enough memory for buffer\n";
+         exit(1);
+      }
+      if (bHugePages && madvise(a.pMem, a.size, MADV_HUGEPAGE) == 0)
+         a.bHuge = PF_ARENA_THP;
+   }
+
+   return (a);
+}
+
+//
+// FreeArena
+//
+// Desc: Internal.  Unmap an arena from AllocArena.
+// In:   a - the arena
+//
+void PF_BufferMgr::FreeArena(const PF_BufArena &a)
+{
+   munmap(a.pMem, a.size);
+}
+
+//
+// ReleaseFrame
+//
+// Desc: Internal.  A slot stopped using the default size frame pFrame.  If
+//       the frame is in a retired arena, the arena is unmapped once none
+//       of its frames is used any more.
+// In:   pFrame - the frame
+//
+void PF_BufferMgr::ReleaseFrame(char *pFrame)
+{
+   for (size_t i = 0; i < retired.size(); i++) {
+      PF_BufArena &a = retired[i];
+      if (pFrame < a.pMem || pFrame >= a.pMem + a.size)
+         continue;
+      if (--a.numLive == 0) {
+         FreeArena(a);
+         retired.erase(retired.begin() + i);
+      }
+      return;
+   }
+}
+
+//
+// SetPageSize
+//
+// Desc: Record the page size of a file.  Pages of different files can
+//       have different sizes, and each is read into a frame of its size.
+// In:   fd - OS file descriptor of the file
+//       pageSize - size of its pages, page header included, a multiple
+//                  of the default page size; 0 restores the default
+// Ret:  PF_BADPARAM for a bad fd
+//
+RC PF_BufferMgr::SetPageSize(int fd, int pageSize)
+{
+   if (fd < 0)
+      return (PF_BADPARAM);
+   lock_guard<mutex> guard(latch);
+   if ((size_t)fd >= filePageSizes.size())
+      filePageSizes.resize(fd + 1, 0);
+   filePageSizes[fd] = pageSize;
+   return (0);
+}
+
+//
+// GetResidentPages
+//
+// Desc: List the pages of a file that are in the buffer, for the warm
+//       restart list of PF_Manager.  Pages still being read are left out.
+// In:   fd - OS file descriptor of the file
+// Out:  pages - the page numbers are appended, most recently loaded first
+// Ret:  0
+//
+RC PF_BufferMgr::GetResidentPages(int fd, vector<PageNum> &pages)
+{
+   lock_guard<mutex> guard(latch);
+   for (int slot = first; slot != INVALID_SLOT; slot = bufTable[slot].next)
+      if (bufTable[slot].fd == fd && bufTable[slot].ioState != PF_IO_READ)
+         pages.push_back(bufTable[slot].pageNum);
+   return (0);
+}
+
+//
+// PageSizeOf
+//
+// Desc: Internal.  Size of the pages of a file, page header included
+// In:   fd - OS file descriptor of the file, or MEMORY_FD
+// Ret:  the size SetPageSize recorded, or the default
+//
+int PF_BufferMgr::PageSizeOf(int fd) const
+{
+   if (fd < 0 || (size_t)fd >= filePageSizes.size() ||
+         filePageSizes[fd] == 0)
+      return (pageSize);
+   return (filePageSizes[fd]);
+}
+
+//
+// SizeFrame
+//
+// Desc: Internal.  Make the frame of slot exactly size bytes.  Pages of
+//       the default size live in the slot's frame of the arena; a larger
+//       page gets a mapping of its own, which is unmapped again once the
+//       slot holds a page of another size or becomes free.  A frame left
+//       in a retired arena by ResizeBuffer is given up the same way.
+// In:   slot - slot about to take a page, or going on the free list
+//       size - size of the page, page header included
+// Ret:  PF_NOMEM if a larger frame cannot be mapped; the slot then keeps
+//       a frame of the default size
+//
+RC PF_BufferMgr::SizeFrame(int slot, int size)
+{
+   PF_BufPageDesc &desc = bufTable[slot];
+   char *pFrame = arena.pMem + (size_t)slot * pageSize;
+   if (desc.frameSize == size && (size > pageSize || desc.pData == pFrame))
+      return (0);
+
+   if (desc.frameSize > pageSize)
+      munmap(desc.pData, desc.frameSize);
+   else if (desc.pData != pFrame)
+      ReleaseFrame(desc.pData);
+   desc.pData = pFrame;
+   desc.frameSize = pageSize;
+   if (size <= pageSize)
+      return (0);
+
+   void *pMem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (pMem == MAP_FAILED)
+      return (PF_NOMEM);
+   desc.pData = (char *)pMem;
+   desc.frameSize = size;
+   return (0);
+}
+
+//
+// InsertFree
+//
+// Desc: Internal.  Insert a slot at the head of the free list.  A frame
+//       sized for a larger page goes back to the default size.
+// In:   slot - slot number to insert
+// Ret:  PF return code
+//
+RC PF_BufferMgr::InsertFree(int slot)
+{
+   SizeFrame(slot, pageSize);
+   __atomic_store_n(&bufTable[slot].pinCount, PF_PIN_FREE, __ATOMIC_RELEASE);
+   bufTable[slot].next = free;
    free = slot;
 
    // Return ok
@@ -768,45 +1501,78 @@ RC PF_BufferMgr::Unlink(int slot)
 // Desc: Internal.  Allocate a buffer slot.  The slot is inserted at the
 //       head of the used list.  Here's how it chooses which slot to use:
 //       If there is something on the free list, then use it.
-//       Otherwise, choose a victim to replace.  If a victim cannot be
-//       chosen (because all the pages are pinned), then return an error.
+//       Otherwise, the replacement policy chooses a victim to replace.  If
+//       all of its pages are pinned, an unpinned page of a ring is used,
+//       preferably one of ring.  With an asynchronous I/O backend a dirty
+//       victim is written back in the background, pinned until the write
+//       is done, and the next victim is tried; the clean page is then left
+//       where it was for the policy to pick again.  If a victim cannot be
+//       chosen (because all the pages are pinned and no I/O is in flight
+//       to unpin one), then return an error.
+// In:   ring - ring the slot is for, or PF_NO_RING
 // Out:  slot - set to newly-allocated slot
 // Ret:  PF_NOBUF if all pages are pinned, other PF return code otherwise
 //
-RC PF_BufferMgr::InternalAlloc(int &slot)
+RC PF_BufferMgr::InternalAlloc(int &slot, int ring)
 {
    RC  rc;       // return code
 
-   // If the free list is not empty, choose a slot from the free list
-   if (free != INVALID_SLOT) {
-      slot = free;
-      free = bufTable[slot].next;
-   }
-   else {
+   for (;;) {
 
-      // Choose the least-recently used page that is unpinned
-      for (slot = last; slot != INVALID_SLOT; slot = bufTable[slot].prev) {
-         if (bufTable[slot].pinCount == 0)
-            break;
+      // If the free list is not empty, choose a slot from the free list
+      if (free != INVALID_SLOT) {
+         slot = free;
+         free = bufTable[slot].next;
+         break;
       }
 
-      // Return error if all buffers were pinned
+      // Pages the cleaner has written are clean victims now
+      if (numCleaning > 0 && (rc = ReapIO(FALSE)))
+         return (rc);
+
+      // Ask the replacement policy for an unpinned page, once it has
+      // heard of the pages unpinned without the latch
+      ApplyTouches();
+      slot = pPolicy->Victim(bufTable);
       if (slot == INVALID_SLOT)
-         return (PF_NOBUF);
+         slot = RingVictim(ring);
+
+      // If all buffers are pinned, wait for I/O that unpins some, or
+      // return an error if there is none
+      if (slot == INVALID_SLOT) {
+         if (numInFlight + numCleaning == 0)
+            return (PF_NOBUF);
+         if ((rc = ReapIO(TRUE)))
+            return (rc);
+         continue;
+      }
+
+      // Start writing back a dirty page and look for another victim
+      if (bufTable[slot].bDirty && pIO->IsAsync() &&
+            numInFlight < PF_IO_DEPTH && StartWrite(slot, pIO) == 0)
+         continue;
+
+      // Take the victim before another thread pins it
+      if (!Claim(slot))
+         continue;
 
       // Write out the page if it is dirty
       if (bufTable[slot].bDirty) {
          if ((rc = WritePage(bufTable[slot].fd, bufTable[slot].pageNum,
-               bufTable[slot].pData)))
+               bufTable[slot].pData))) {
+            __atomic_store_n(&bufTable[slot].pinCount, 0, __ATOMIC_RELEASE);
             return (rc);
+         }
 
-         bufTable[slot].bDirty = FALSE;
+         ClearDirty(slot);
       }
 
       // Remove page from the hash table and slot from the used buffer list
       if ((rc = hashTable.Delete(bufTable[slot].fd, bufTable[slot].pageNum)) ||
             (rc = Unlink(slot)))
          return (rc);
+      Forget(slot);
+      break;
    }
 
    // Link slot at the head of the used list
@@ -817,6 +1583,269 @@ RC PF_BufferMgr::InternalAlloc(int &slot)
    return (0);
 }
 
+//
+// RingAlloc
+//
+// Desc: Internal.  Allocate a buffer slot for a page read through ring.
+//       If the ring's next frame holds an unpinned page, that page is
+//       replaced.  Otherwise (the ring is not full yet, or the page there
+//       is still pinned) a slot comes from InternalAlloc and a pinned page
+//       is handed over to the replacement policy.
+// In:   ring - an open ring
+// Out:  slot - set to newly-allocated slot, now owned by the ring
+// Ret:  PF_NOBUF if all pages are pinned, other PF return code otherwise
+//
+RC PF_BufferMgr::RingAlloc(int ring, int &slot)
+{
+   RC  rc;       // return code
+   PF_BufRing &r = rings[ring];
+   int old = r.slots[r.next];
+
+   if (old != INVALID_SLOT && Claim(old)) {
+
+      // Write out the page if it is dirty
+      if (bufTable[old].bDirty) {
+         if ((rc = WritePage(bufTable[old].fd, bufTable[old].pageNum,
+               bufTable[old].pData))) {
+            __atomic_store_n(&bufTable[old].pinCount, 0, __ATOMIC_RELEASE);
+            return (rc);
+         }
+
+         ClearDirty(old);
+      }
+
+      // Remove the page from the hash table, and move the slot to the head
+      // of the used list as InternalAlloc would
+      if ((rc = hashTable.Delete(bufTable[old].fd, bufTable[old].pageNum)) ||
+            (rc = Unlink(old)) ||
+            (rc = LinkHead(old)))
+         return (rc);
+      slot = old;
+
+#ifdef PF_STATS
+      char psKey[32];
+      sprintf(psKey, "%s%d", PF_RINGREUSE, ring);
+      pStatisticsMgr->Register(psKey, STAT_ADDONE);
+#endif
+   }
+   else {
+      if (old != INVALID_SLOT)
+         Adopt(old);
+      if ((rc = InternalAlloc(slot, ring)))
+         return (rc);
+   }
+
+   // The slot becomes the newest frame of the ring
+   r.slots[r.next] = slot;
+   r.next = (r.next + 1) % r.size;
+   bufTable[slot].ring = ring;
+
+   // Return ok
+   return (0);
+}
+
+//
+// Forget
+//
+// Desc: Internal.  The page in slot is leaving the buffer, or its ring is
+//       giving it up.  Remove it from its ring, or tell the replacement
+//       policy if no ring owns it.
+// In:   slot - slot of the page
+//
+void PF_BufferMgr::Forget(int slot)
+{
+   int ring = bufTable[slot].ring;
+
+   if (ring == PF_NO_RING) {
+      pPolicy->Removed(slot, bufTable[slot].fd, bufTable[slot].pageNum);
+      return;
+   }
+
+   for (int i = 0; i < rings[ring].size; i++)
+      if (rings[ring].slots[i] == slot)
+         rings[ring].slots[i] = INVALID_SLOT;
+   bufTable[slot].ring = PF_NO_RING;
+}
+
+//
+// Adopt
+//
+// Desc: Internal.  Take the page in slot away from its ring and make it an
+//       ordinary page of the replacement policy.
+// In:   slot - slot of a page owned by a ring
+//
+void PF_BufferMgr::Adopt(int slot)
+{
+   Forget(slot);
+   pPolicy->Loaded(slot, bufTable[slot].fd, bufTable[slot].pageNum);
+   if (bufTable[slot].Pins() == 0)
+      pPolicy->Unpinned(slot);
+}
+
+//
+// RingVictim
+//
+// Desc: Internal.  Find an unpinned page owned by a ring, looking at the
+//       frames of ring first.  Used when the replacement policy finds no
+//       victim among its own pages.
+// In:   ring - ring to prefer, or PF_NO_RING
+// Ret:  slot of the page, or INVALID_SLOT if there is none
+//
+int PF_BufferMgr::RingVictim(int ring)
+{
+   int slot;
+
+   if (ring != PF_NO_RING)
+      for (int i = 0; i < rings[ring].size; i++) {
+         slot = rings[ring].slots[i];
+         if (slot != INVALID_SLOT && bufTable[slot].Pins() == 0)
+            return (slot);
+      }
+
+   for (slot = first; slot != INVALID_SLOT; slot = bufTable[slot].next)
+      if (bufTable[slot].ring != PF_NO_RING && bufTable[slot].Pins() == 0)
+         return (slot);
+
+   return (INVALID_SLOT);
+}
+
+//
+// TryPin
+//
+// Desc: Internal.  Pin the page in slot without the buffer latch.  The
+//       slot came from FindShared and may have been given to another page
+//       since, or be about to; a frame that is being removed or filled has
+//       pin count PF_PIN_FREE and cannot be pinned, and once pinned it
+//       cannot be removed.
+// In:   slot - slot where FindShared found the page
+//       fd - OS file descriptor of the file associated with the page
+//       pageNum - page the caller is after
+// Ret:  TRUE if the page is pinned, FALSE if GetPage has to take the latch
+//
+int PF_BufferMgr::TryPin(int slot, int fd, PageNum pageNum)
+{
+   PF_BufPageDesc &desc = bufTable[slot];
+
+   int pins = desc.Pins();
+   do {
+      if (pins < 0)
+         return (FALSE);
+   } while (!__atomic_compare_exchange_n(&desc.pinCount, &pins, pins + 1,
+         TRUE, __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE));
+
+   if (__atomic_load_n(&desc.ioState, __ATOMIC_SEQ_CST) == PF_IO_NONE &&
+         desc.fd == fd && desc.pageNum == pageNum)
+      return (TRUE);
+
+   // Wrong page, or I/O in flight: give the pin back
+   if (__atomic_sub_fetch(&desc.pinCount, 1, __ATOMIC_ACQ_REL) == 0)
+      Touch(slot, PF_TOUCH_UNPIN);
+   return (FALSE);
+}
+
+//
+// Claim
+//
+// Desc: Internal.  Take the page in slot out of reach of TryPin, before it
+//       is written and removed.  Latch held.  Storing 0 into the pin count
+//       gives the page back.
+// In:   slot - slot of the page
+//       pins - pins the caller itself holds on the page
+// Ret:  TRUE if no other thread had the page pinned
+//
+int PF_BufferMgr::Claim(int slot, int pins)
+{
+   return __atomic_compare_exchange_n(&bufTable[slot].pinCount, &pins,
+         PF_PIN_FREE, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+}
+
+//
+// Touch
+//
+// Desc: Internal.  Record a hit or a last unpin made without the buffer
+//       latch.  A slot goes on the touch list the first time it is touched
+//       after the policy heard of it.  The touches are applied right away
+//       if the latch is free, and otherwise by whoever holds it.
+// In:   slot - slot of the page
+//       what - PF_TOUCH_HIT or PF_TOUCH_UNPIN
+//
+void PF_BufferMgr::Touch(int slot, int what)
+{
+   PF_BufPageDesc &desc = bufTable[slot];
+
+   if (__atomic_fetch_or(&desc.touched, (char)what, __ATOMIC_ACQ_REL) == 0) {
+      int head = __atomic_load_n(&touchHead, __ATOMIC_RELAXED);
+      do {
+         desc.touchNext = head;
+      } while (!__atomic_compare_exchange_n(&touchHead, &head, slot, TRUE,
+            __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+   }
+
+   if (latch.try_lock()) {
+      ApplyTouches();
+      latch.unlock();
+   }
+}
+
+//
+// ApplyTouches
+//
+// Desc: Internal.  Tell the replacement policy about the pages on the
+//       touch list.  Latch held.  A page that left the buffer since it was
+//       touched is skipped; one that took its place gets the touch.  A
+//       dirty page that was unpinned may put the cleaner to work.
+//
+void PF_BufferMgr::ApplyTouches()
+{
+   int slot = __atomic_exchange_n(&touchHead, INVALID_SLOT, __ATOMIC_ACQUIRE);
+   int bClean = FALSE;
+
+   while (slot != INVALID_SLOT) {
+      PF_BufPageDesc &desc = bufTable[slot];
+      int next = desc.touchNext;
+      int what = __atomic_exchange_n(&desc.touched, 0, __ATOMIC_ACQ_REL);
+      int pins = desc.Pins();
+
+      if (pins >= 0 && desc.ring == PF_NO_RING) {
+         if (what & PF_TOUCH_HIT)
+            pPolicy->Accessed(slot);
+         if ((what & PF_TOUCH_UNPIN) && pins == 0)
+            pPolicy->Unpinned(slot);
+      }
+      if ((what & PF_TOUCH_UNPIN) && pins == 0 && desc.bDirty)
+         bClean = TRUE;
+      slot = next;
+   }
+
+   if (bClean)
+      Clean();
+}
+
+//
+// SetDirty
+//
+// Desc: Internal.  Mark the page in slot dirty.
+//
+void PF_BufferMgr::SetDirty(int slot)
+{
+   if (!__atomic_exchange_n(&bufTable[slot].bDirty, TRUE, __ATOMIC_ACQ_REL))
+      __atomic_add_fetch(&numDirty, 1, __ATOMIC_RELAXED);
+}
+
+//
+// ClearDirty
+//
+// Desc: Internal.  Mark the page in slot clean.
+// Ret:  TRUE if it was dirty
+//
+int PF_BufferMgr::ClearDirty(int slot)
+{
+   if (!__atomic_exchange_n(&bufTable[slot].bDirty, FALSE, __ATOMIC_ACQ_REL))
+      return (FALSE);
+   __atomic_sub_fetch(&numDirty, 1, __ATOMIC_RELAXED);
+   return (TRUE);
+}
+
 //
 // ReadPage
 //
@@ -841,16 +1870,13 @@ RC PF_BufferMgr::ReadPage(int fd, PageNum pageNum, char *dest)
    pStatisticsMgr->Register(PF_READPAGE, STAT_ADDONE);
 #endif
 
-   // seek to the appropriate place (cast to long for PC's)
-   long offset = pageNum * (long)pageSize + PF_FILE_HDR_SIZE;
-   if (lseek(fd, offset, L_SET) < 0)
-      return (PF_UNIX);
-
-   // Read the data
-   int numBytes = read(fd, dest, pageSize);
+   // Read the data at the page's offset (cast to long for PC's)
+   int size = PageSizeOf(fd);
+   long offset = pageNum * (long)size + PF_FILE_HDR_SIZE;
+   int numBytes = pread(fd, dest, size, offset);
    if (numBytes < 0)
       return (PF_UNIX);
-   else if (numBytes != pageSize)
+   else if (numBytes != size)
       return (PF_INCOMPLETEREAD);
    else
       return (0);
@@ -879,37 +1905,386 @@ RC PF_BufferMgr::WritePage(int fd, PageNum pageNum, char *source)
    pStatisticsMgr->Register(PF_WRITEPAGE, STAT_ADDONE);
 #endif
 
-   // seek to the appropriate place (cast to long for PC's)
-   long offset = pageNum * (long)pageSize + PF_FILE_HDR_SIZE;
-   if (lseek(fd, offset, L_SET) < 0)
+   // Write the data at the page's offset (cast to long for PC's)
+   int size = PageSizeOf(fd);
+   long offset = pageNum * (long)size + PF_FILE_HDR_SIZE;
+   int numBytes = pwrite(fd, source, size, offset);
+   if (numBytes < 0)
       return (PF_UNIX);
+   else if (numBytes != size)
+      return (PF_INCOMPLETEWRITE);
+   else
+      return (0);
+}
 
-   // Read the data
-   int numBytes = write(fd, source, pageSize);
+//
+// WriteBack
+//
+// Desc: Internal.  Write dirty pages of one file to disk in page order.
+//       Each run of consecutive pages goes out with a single pwritev of up
+//       to PF_MAX_WRITEBACK pages; PF_WRITESAVED counts the writes this
+//       saves.  The pages are clean afterwards, unless a thread that has
+//       one pinned marks it dirty again while it is written.
+// In:   slots - slots of the dirty pages, in any order; sorted on return
+// Ret:  PF return code
+//
+RC PF_BufferMgr::WriteBack(vector<int> &slots)
+{
+   RC rc;
+
+   sort(slots.begin(), slots.end(), [this](int a, int b)
+         { return bufTable[a].pageNum < bufTable[b].pageNum; });
+
+   size_t start = 0;
+   while (start < slots.size()) {
+      size_t end = start + 1;
+      while (end < slots.size() && (int)(end - start) < PF_MAX_WRITEBACK &&
+            bufTable[slots[end]].pageNum == bufTable[slots[end - 1]].pageNum + 1)
+         end++;
+
+      int runLength = end - start;
+      int slot = slots[start];
+      for (size_t i = start; i < end; i++)
+         ClearDirty(slots[i]);
+      if ((rc = WritePages(bufTable[slot].fd, bufTable[slot].pageNum,
+            &slots[start], runLength))) {
+         for (size_t i = start; i < slots.size(); i++)
+            SetDirty(slots[i]);
+         return (rc);
+      }
+
+#ifdef PF_STATS
+      int saved = runLength - 1;
+      if (saved > 0)
+         pStatisticsMgr->Register(PF_WRITESAVED, STAT_ADDVALUE, &saved);
+#endif
+      start = end;
+   }
+
+   return (0);
+}
+
+//
+// WritePages
+//
+// Desc: Write consecutive pages from buffer slots to disk with one
+//       pwritev call
+//
+// In:   fd - OS file descriptor
+//       pageNum - number of first page to write
+//       slots - slots holding the pages
+//       numPages - number of pages, at most PF_MAX_WRITEBACK
+// Ret:  PF return code
+//
+RC PF_BufferMgr::WritePages(int fd, PageNum pageNum, const int *slots,
+      int numPages)
+{
+   struct iovec iov[PF_MAX_WRITEBACK];
+
+#ifdef PF_LOG
+   char psMessage[100];
+   sprintf (psMessage, "Writing (%d,%d) and %d more.\n", fd, pageNum,
+         numPages - 1);
+   WriteLog(psMessage);
+#endif
+
+#ifdef PF_STATS
+   pStatisticsMgr->Register(PF_WRITEPAGE, STAT_ADDONE);
+#endif
+
+   int size = PageSizeOf(fd);
+   for (int i = 0; i < numPages; i++) {
+      iov[i].iov_base = bufTable[slots[i]].pData;
+      iov[i].iov_len = size;
+   }
+
+   long offset = pageNum * (long)size + PF_FILE_HDR_SIZE;
+   ssize_t numBytes = pwritev(fd, iov, numPages, offset);
    if (numBytes < 0)
       return (PF_UNIX);
-   else if (numBytes != pageSize)
+   else if (numBytes != numPages * (ssize_t)size)
       return (PF_INCOMPLETEWRITE);
    else
       return (0);
 }
 
+//
+// StartRead
+//
+// Desc: Internal.  Enter consecutive pages into the buffer and hand the
+//       read of all of them to the I/O backend.  Each page keeps a pin
+//       until ReapIO sees the read done.
+// In:   fd - OS file descriptor
+//       pageNum - number of the first page
+//       slots - frames for the pages, taken from InternalAlloc or RingAlloc
+//       numPages - number of pages, at most PF_MAX_READAHEAD
+//       ring - ring that owns the frames, or PF_NO_RING
+// Ret:  PF return code; on error the frames are back on the free list
+//
+RC PF_BufferMgr::StartRead(int fd, PageNum pageNum, const int *slots,
+      int numPages, int ring)
+{
+   RC rc = 0;
+   int i, slot;
+   int size = PageSizeOf(fd);
+
+   PF_IORequest *pReq = new PF_IORequest;
+   pReq->op = PF_IO_READ;
+   pReq->fd = fd;
+   pReq->offset = pageNum * (long)size + PF_FILE_HDR_SIZE;
+   pReq->numPages = numPages;
+
+   for (i = 0; i < numPages; i++) {
+      slot = slots[i];
+      if ((rc = SizeFrame(slot, size)) ||
+            (rc = hashTable.Insert(fd, pageNum + i, slot)))
+         break;
+      InitPageDesc(fd, pageNum + i, slot, ring, PF_IO_READ);
+      pReq->iov[i].iov_base = bufTable[slot].pData;
+      pReq->iov[i].iov_len = size;
+      pReq->slots[i] = slot;
+   }
+
+   if (!rc && !(rc = pIO->Submit(pReq))) {
+      numInFlight++;
+#ifdef PF_STATS
+      pStatisticsMgr->Register(PF_READPAGE, STAT_ADDONE);
+#endif
+      return (0);
+   }
+
+   // Take the pages out of the buffer again.  The first i were entered,
+   // and other threads may have pinned them for a moment since.
+   for (int j = 0; j < numPages; j++) {
+      slot = slots[j];
+      if (j < i) {
+         while (!Claim(slot, 1))
+            this_thread::yield();
+         hashTable.Delete(fd, pageNum + j);
+         Forget(slot);
+      }
+      else if (bufTable[slot].ring != PF_NO_RING)
+         Forget(slot);
+      bufTable[slot].ioState = PF_IO_NONE;
+      Unlink(slot);
+      InsertFree(slot);
+   }
+   delete pReq;
+   return (rc);
+}
+
+//
+// StartWrite
+//
+// Desc: Internal.  Hand the write-back of an unpinned dirty page to the
+//       I/O backend or to the page cleaner.  The page is pinned, and so
+//       cannot be replaced, until ReapIO sees the write done.  It is clean
+//       from now on.
+// In:   slot - slot of the page
+//       pBackend - pIO or pCleanerIO
+// Ret:  PF_PAGEPINNED if another thread pinned the page meanwhile, or
+//       other PF return code
+//
+RC PF_BufferMgr::StartWrite(int slot, PF_IOBackend *pBackend)
+{
+   RC rc;
+   int &numReqs = (pBackend == pIO) ? numInFlight : numCleaning;
+
+   // Keep TryPin off the page first, then take the I/O pin if nobody has
+   // pinned it meanwhile
+   int pins = 0;
+   __atomic_store_n(&bufTable[slot].ioState, PF_IO_WRITE, __ATOMIC_SEQ_CST);
+   if (!__atomic_compare_exchange_n(&bufTable[slot].pinCount, &pins, 1,
+         FALSE, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+      __atomic_store_n(&bufTable[slot].ioState, PF_IO_NONE, __ATOMIC_RELEASE);
+      return (PF_PAGEPINNED);
+   }
+
+   PF_IORequest *pReq = new PF_IORequest;
+   pReq->op = PF_IO_WRITE;
+   pReq->fd = bufTable[slot].fd;
+   pReq->offset = bufTable[slot].pageNum * (long)bufTable[slot].frameSize +
+      PF_FILE_HDR_SIZE;
+   pReq->numPages = 1;
+   pReq->iov[0].iov_base = bufTable[slot].pData;
+   pReq->iov[0].iov_len = bufTable[slot].frameSize;
+   pReq->slots[0] = slot;
+
+   ClearDirty(slot);
+   if ((rc = pBackend->Submit(pReq))) {
+      SetDirty(slot);
+      __atomic_store_n(&bufTable[slot].ioState, PF_IO_NONE, __ATOMIC_RELEASE);
+      __atomic_sub_fetch(&bufTable[slot].pinCount, 1, __ATOMIC_RELEASE);
+      delete pReq;
+      return (rc);
+   }
+   numReqs++;
+
+#ifdef PF_STATS
+   pStatisticsMgr->Register(PF_WRITEPAGE, STAT_ADDONE);
+   if (pBackend == pCleanerIO)
+      pStatisticsMgr->Register(PF_CLEANERWRITE, STAT_ADDONE);
+#endif
+   return (0);
+}
+
+//
+// ReapIO
+//
+// Desc: Internal.  Finish the requests the I/O backend and the page
+//       cleaner are done with.
+// In:   bWait - wait for a request if none is done yet but some are in
+//               flight
+// Ret:  PF return code
+//
+RC PF_BufferMgr::ReapIO(int bWait)
+{
+   RC rc;
+   int numReaped = 0;
+
+   if ((rc = ReapFrom(pIO, numInFlight, FALSE, numReaped)) ||
+         (rc = ReapFrom(pCleanerIO, numCleaning, FALSE, numReaped)))
+      return (rc);
+
+   if (bWait && numReaped == 0) {
+      if (numInFlight > 0)
+         return ReapFrom(pIO, numInFlight, TRUE, numReaped);
+      return ReapFrom(pCleanerIO, numCleaning, TRUE, numReaped);
+   }
+   return (0);
+}
+
+//
+// ReapFrom
+//
+// Desc: Internal.  Finish the requests a backend is done with.  A page
+//       that was read loses its I/O pin; a page that could not be read
+//       leaves the buffer.  A page that was written back is clean, and
+//       stays where the replacement policy had it so that it is the next
+//       victim.  A failed write leaves the page dirty, to be written again
+//       when it is next replaced or flushed.
+// In:   pBackend - backend to reap, may be NULL if numReqs is 0
+//       numReqs - requests of pBackend in flight
+//       bWait - wait for a request if none is done yet but some are in
+//               flight
+// Out:  numReqs - decremented for each request finished
+//       numReaped - incremented for each request finished
+// Ret:  PF return code
+//
+RC PF_BufferMgr::ReapFrom(PF_IOBackend *pBackend, int &numReqs, int bWait,
+      int &numReaped)
+{
+   RC rc;
+   PF_IORequest *pReq;
+
+   while (numReqs > 0) {
+      if ((rc = pBackend->Reap(pReq, bWait)))
+         return (rc);
+      if (pReq == NULL)
+         break;
+      numReqs--;
+      numReaped++;
+      bWait = FALSE;
+
+      int bOk = (pReq->result == pReq->numPages * (long)pReq->iov[0].iov_len);
+      for (int i = 0; i < pReq->numPages; i++) {
+         int slot = pReq->slots[i];
+
+         // A page that could not be read leaves the buffer.  Other threads
+         // do not keep it pinned for long, since TryPin sees the I/O.
+         if (pReq->op == PF_IO_READ && !bOk) {
+            while (!Claim(slot, 1))
+               this_thread::yield();
+            bufTable[slot].ioState = PF_IO_NONE;
+            hashTable.Delete(bufTable[slot].fd, bufTable[slot].pageNum);
+            Forget(slot);
+            Unlink(slot);
+            InsertFree(slot);
+            continue;
+         }
+
+         if (pReq->op == PF_IO_WRITE && !bOk)
+            SetDirty(slot);
+         __atomic_store_n(&bufTable[slot].ioState, PF_IO_NONE,
+               __ATOMIC_SEQ_CST);
+         int pins = __atomic_sub_fetch(&bufTable[slot].pinCount, 1,
+               __ATOMIC_ACQ_REL);
+         if (pReq->op == PF_IO_READ && pins == 0 &&
+               bufTable[slot].ring == PF_NO_RING)
+            pPolicy->Unpinned(slot);
+      }
+      delete pReq;
+   }
+
+   return (0);
+}
+
+//
+// Drain
+//
+// Desc: Internal.  Wait for all I/O in flight and finish it.
+// Ret:  PF return code
+//
+RC PF_BufferMgr::Drain()
+{
+   RC rc;
+   while (numInFlight + numCleaning > 0)
+      if ((rc = ReapIO(TRUE)))
+         return (rc);
+   return (0);
+}
+
+//
+// Clean
+//
+// Desc: Internal.  The page cleaner.  Once more than the high watermark of
+//       the buffer is dirty, hand dirty unpinned pages to the cleaner
+//       thread, least recently loaded first, until no more than the low
+//       watermark is left dirty.  Pages of rings and memory blocks are
+//       left alone; rings recycle their own frames.
+//
+void PF_BufferMgr::Clean()
+{
+   int dirty = __atomic_load_n(&numDirty, __ATOMIC_RELAXED);
+   if (pCleanerIO == NULL || dirty <= numPages * cleanHigh / 100)
+      return;
+
+   int low = numPages * cleanLow / 100;
+   for (int slot = last; slot != INVALID_SLOT && dirty > low &&
+         numCleaning < PF_IO_DEPTH; slot = bufTable[slot].prev)
+      if (bufTable[slot].bDirty && bufTable[slot].Pins() == 0 &&
+            bufTable[slot].ring == PF_NO_RING &&
+            StartWrite(slot, pCleanerIO) == 0)
+         dirty--;
+}
+
 //
 // InitPageDesc
 //
 // Desc: Internal.  Initialize PF_BufPageDesc to a newly-pinned page
-//       for a newly pinned page
+//       for a newly pinned page.  Setting the pin count comes last, and
+//       lets TryPin at the page.
 // In:   fd - file descriptor
 //       pageNum - page number
+//       ring - ring that owns the page, or PF_NO_RING
+//       ioState - I/O about to be started on the page
 // Ret:  PF return code
 //
-RC PF_BufferMgr::InitPageDesc(int fd, PageNum pageNum, int slot)
+RC PF_BufferMgr::InitPageDesc(int fd, PageNum pageNum, int slot, int ring,
+      int ioState)
 {
    // set the slot to refer to a newly-pinned page
    bufTable[slot].fd       = fd;
    bufTable[slot].pageNum  = pageNum;
    bufTable[slot].bDirty   = FALSE;
-   bufTable[slot].pinCount = 1;
+   bufTable[slot].latch    = 0;
+   bufTable[slot].ring     = ring;
+   bufTable[slot].ioState  = ioState;
+
+   // The page is new to the replacement policy, unless a ring owns it
+   if (ring == PF_NO_RING)
+      pPolicy->Loaded(slot, fd, pageNum);
+   __atomic_store_n(&bufTable[slot].pinCount, 1, __ATOMIC_RELEASE);
 
    // Return ok
    return (0);
@@ -946,11 +2321,21 @@ RC PF_BufferMgr::AllocateBlock(char *&buffer)
 {
    RC rc = OK_RC;
 
+   lock_guard<mutex> guard(latch);
+
    // Get an empty slot from the buffer pool
    int slot;
    if ((rc = InternalAlloc(slot)) != OK_RC)
       return rc;
 
+   // Give the slot a frame of the default size first, since the frame it
+   // had may be elsewhere
+   if ((rc = SizeFrame(slot, pageSize)) != OK_RC) {
+      Unlink(slot);
+      InsertFree(slot);
+      return rc;
+   }
+
    // Create artificial page number (just needs to be unique for hash table)
    PageNum pageNum = PageNum(reinterpret_cast<uintptr_t>(bufTable[slot].pData));
 
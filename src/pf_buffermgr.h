@@ -11,35 +11,81 @@
 // a particular file.  Allows students to use main memory chunks that
 // are associated with (and limited by) the buffer.
 //
+// Threads
+//
+// Pages that are in the buffer are pinned, unpinned, marked dirty and
+// latched without taking the buffer latch: the hash table is looked up
+// with FindShared and pin counts are changed atomically.  Everything else
+// (reading a page in, replacing one, flushing, and the set commands)
+// happens under the buffer latch.  The replacement policy hears about
+// hits and unpins that happen without the latch through the touch list,
+// which whoever takes the latch next applies.  ResizeBuffer moves the
+// pages and must not run while other threads use the buffer.
+//
 
 #ifndef PF_BUFFERMGR_H
 #define PF_BUFFERMGR_H
 
+#include <vector>
+#include <mutex>
 #include "pf_internal.h"
 #include "pf_hashtable.h"
-
-//
-// Defines
-//
-
-// INVALID_SLOT is used within the PF_BufferMgr class which tracks a list
-// of PF_BufPageDesc.  Inside the PF_BufPageDesc are integer "pointers" to
-// next and prev items.  INVALID_SLOT is used to indicate no previous or
-// next.
-#define INVALID_SLOT  (-1)
+#include "pf_replacement.h"
+#include "pf_io.h"
 
 //
 // PF_BufPageDesc - struct containing data about a page in the buffer
 //
+#define PF_PIN_FREE        (-1)     // pinCount of a frame without a page,
+                                    // or whose page is being removed
+#define PF_LATCH_EXCLUSIVE (-1)     // latch held by a writer
+#define PF_TOUCH_HIT       1        // touched: found by GetPage
+#define PF_TOUCH_UNPIN     2        // touched: last pin released
+
 struct PF_BufPageDesc {
     char       *pData;      // page contents
+    int        frameSize;   // bytes at pData, the size of the page
     int        next;        // next in the linked list of buffer pages
     int        prev;        // prev in the linked list of buffer pages
     int        bDirty;      // TRUE if page is dirty
-    short int  pinCount;    // pin count
+    int        pinCount;    // pin count, or PF_PIN_FREE
     PageNum    pageNum;     // page number for this page
     int        fd;          // OS file descriptor of this page
-} __attribute__((packed));
+    int        latch;       // number of readers holding the page latch,
+                            // or PF_LATCH_EXCLUSIVE
+    int        touchNext;   // next slot on the touch list
+    short int  ring;        // ring that owns this page, or PF_NO_RING
+    char       ioState;     // PF_IO_NONE, or the I/O in flight on the page
+    char       touched;     // PF_TOUCH_ bits not yet applied to the policy
+
+    // Pin count, read while other threads may change it
+    int Pins() const { return __atomic_load_n(&pinCount, __ATOMIC_ACQUIRE); }
+};
+
+//
+// PF_BufRing - frames reserved by a scan through OpenRing.  The pages in
+// a ring's frames are owned by the ring rather than by the replacement
+// policy.
+//
+struct PF_BufRing {
+    int        *slots;      // frames of the ring, INVALID_SLOT if unused
+    int        size;        // number of frames, 0 if the ring is not open
+    int        next;        // index of the next frame to reuse
+};
+
+//
+// PF_BufArena - one mapping that holds the pages of the buffer
+//
+#define PF_ARENA_NORMAL   0         // ordinary pages
+#define PF_ARENA_HUGETLB  1         // MAP_HUGETLB huge pages
+#define PF_ARENA_THP      2         // transparent huge pages requested
+
+struct PF_BufArena {
+    char       *pMem;       // start of the mapping, page aligned
+    size_t     size;        // length of the mapping
+    int        bHuge;       // PF_ARENA_NORMAL, _HUGETLB or _THP
+    int        numLive;     // frames still in use, once retired
+};
 
 //
 // PF_BufferMgr - manage the page buffer
@@ -47,23 +93,42 @@ struct PF_BufPageDesc {
 class PF_BufferMgr {
 public:
 
-    PF_BufferMgr     (int numPages);             // Constructor - allocate
-                                                  // numPages buffer pages
+    PF_BufferMgr     (int numPages,              // Constructor - allocate
+                      int bHugePages = FALSE);    // numPages buffer pages,
+                                                  // on huge pages if asked
     ~PF_BufferMgr    ();                         // Destructor
 
-    // Read pageNum into buffer, point *ppBuffer to location
+    // Read pageNum into buffer, point *ppBuffer to location.  A page that
+    // is not in the buffer is read into a frame of ring, if one is given.
     RC  GetPage      (int fd, PageNum pageNum, char **ppBuffer,
-                      int bMultiplePins = TRUE);
+                      int bMultiplePins = TRUE, int ring = PF_NO_RING);
     // Allocate a new page in the buffer, point *ppBuffer to its location
     RC  AllocatePage (int fd, PageNum pageNum, char **ppBuffer);
 
     RC  MarkDirty    (int fd, PageNum pageNum);  // Mark page dirty
     RC  UnpinPage    (int fd, PageNum pageNum);  // Unpin page from the buffer
+
+    // Take the latch of a pinned page, shared or exclusive, waiting for
+    // it if needed; and release it
+    RC  LatchPage    (int fd, PageNum pageNum, int bExclusive);
+    RC  UnlatchPage  (int fd, PageNum pageNum);
     RC  FlushPages   (int fd);                   // Flush pages for file
+    // Drop the pages of file fd from pageNum on without writing them
+    RC  DiscardPages (int fd, PageNum pageNum);
 
     // Force a page to the disk, but do not remove from the buffer pool
     RC ForcePages    (int fd, PageNum pageNum);
 
+    // Set the size of the pages of file fd, page header included; 0 for
+    // the default
+    RC SetPageSize   (int fd, int pageSize);
+
+    // Append the pages of file fd that are in the buffer to pages, most
+    // recently loaded first
+    RC GetResidentPages(int fd, std::vector<PageNum> &pages);
+    // Number of pages the buffer holds
+    int GetNumPages  () const { return numPages; }
+
 
     // Remove all entries from the Buffer Manager.
     RC  ClearBuffer  ();
@@ -73,6 +138,34 @@ public:
     // Attempts to resize the buffer to the new size
     RC ResizeBuffer  (int iNewSize);
 
+    // Select the page replacement policy by name ("lru", "clock", "2q" or
+    // "lruk").  Returns PF_BADPARAM for an unknown name.
+    RC SetReplacementPolicy(const char *policyName);
+
+    // Read the pages pageNum .. pageNum+numPages-1 that are not in the
+    // buffer yet, unpinned, with as few reads as possible
+    RC  ReadAhead    (int fd, PageNum pageNum, int numPages,
+                      int ring = PF_NO_RING);
+    // Start reading pageNum into the buffer if it is not there yet
+    RC  PrefetchPage (int fd, PageNum pageNum);
+    // Set the number of pages PF_FileHandle reads ahead; 0 turns it off
+    RC  SetReadAhead (int numPages);
+    // Read-ahead window for pages read through ring
+    int GetReadAhead (int ring = PF_NO_RING) const;
+
+    // Select the I/O backend by name ("sync", "threads" or "uring").
+    // Returns PF_BADPARAM for an unknown name.
+    RC SetIOBackend  (const char *backendName);
+    // Write dirty pages back in the background once more than highPercent
+    // of the buffer is dirty, down to lowPercent; highPercent 0 turns the
+    // cleaner off
+    RC SetCleaner    (int highPercent, int lowPercent);
+
+    // Reserve a ring of numPages frames; ring is PF_NO_RING if none is free
+    RC OpenRing      (int &ring, int numPages);
+    // Release a ring, handing its pages over to the replacement policy
+    RC CloseRing     (int ring);
+
     // Three Methods for manipulating raw memory buffers.  These memory
     // locations are handled by the buffer manager, but are not
     // associated with a particular file.  These should be used if you
@@ -90,24 +183,109 @@ private:
     RC  InsertFree   (int slot);                 // Insert slot at head of free
     RC  LinkHead     (int slot);                 // Insert slot at head of used
     RC  Unlink       (int slot);                 // Unlink slot
-    RC  InternalAlloc(int &slot);                // Get a slot to use
+    RC  InternalAlloc(int &slot, int ring = PF_NO_RING);
+                                                  // Get a slot to use
+    RC  RingAlloc    (int ring, int &slot);      // Get a slot for a ring
+
+    // The page in slot left the buffer: tell its ring or the policy
+    void Forget      (int slot);
+    // Hand a page owned by a ring over to the replacement policy
+    void Adopt       (int slot);
+    // Unpinned page of a ring to replace when the policy has none
+    int  RingVictim  (int ring);
+
+    // Pin the page in slot without the latch if it is still page pageNum
+    // of fd and no I/O is in flight on it
+    int  TryPin      (int slot, int fd, PageNum pageNum);
+    // Take the page in slot, with pins pins (the caller's own), out of
+    // reach of TryPin before removing or writing it
+    int  Claim       (int slot, int pins = 0);
+    // Note a hit or last unpin made without the latch for the policy
+    void Touch       (int slot, int what);
+    // Tell the policy about the touched pages; latch held
+    void ApplyTouches();
+    // ReadAhead with the latch held
+    RC   ReadRuns    (int fd, PageNum pageNum, int numPages, int ring);
 
     // Read a page
     RC  ReadPage     (int fd, PageNum pageNum, char *dest);
 
     // Write a page
     RC  WritePage    (int fd, PageNum pageNum, char *source);
+    // Write consecutive pages from slots with a single system call
+    RC  WritePages   (int fd, PageNum pageNum, const int *slots,
+                      int numPages);
+    // Write dirty pages of a file in page order, coalescing runs
+    RC  WriteBack    (std::vector<int> &slots);
+
+    // Hand reads of consecutive pages, or the write-back of an unpinned
+    // dirty page, to the I/O backend
+    RC  StartRead    (int fd, PageNum pageNum, const int *slots,
+                      int numPages, int ring);
+    RC  StartWrite   (int slot, PF_IOBackend *pBackend);
+    // Finish I/O the backend is done with; with bWait set, wait for some
+    // if there is I/O in flight
+    RC  ReapIO       (int bWait);
+    RC  ReapFrom     (PF_IOBackend *pBackend, int &numReqs, int bWait,
+                      int &numReaped);
+    // Finish all I/O in flight
+    RC  Drain        ();
+    // Start the cleaner writing if too much of the buffer is dirty
+    void Clean       ();
+
+    // Map and unmap the memory of the buffer pages
+    PF_BufArena AllocArena(int numFrames);
+    void FreeArena   (const PF_BufArena &a);
+    // A slot no longer uses the frame - unmap a retired arena left unused
+    void ReleaseFrame(char *pFrame);
+    // Size of the pages of file fd, page header included
+    int  PageSizeOf  (int fd) const;
+    // Give slot a frame of size bytes
+    RC   SizeFrame   (int slot, int size);
 
     // Init the page desc entry
-    RC  InitPageDesc (int fd, PageNum pageNum, int slot);
+    RC  InitPageDesc (int fd, PageNum pageNum, int slot,
+                      int ring = PF_NO_RING, int ioState = PF_IO_NONE);
+
+    // Set or clear the dirty flag of slot, keeping numDirty in step.
+    // ClearDirty returns TRUE if the page was dirty.
+    void SetDirty    (int slot);
+    int  ClearDirty  (int slot);
 
+    std::mutex     latch;                         // buffer latch
     PF_BufPageDesc *bufTable;                     // info on buffer pages
+    PF_BufArena    arena;                         // memory of the pages
+    std::vector<PF_BufArena> retired;             // arenas replaced by
+                                                  // ResizeBuffer that still
+                                                  // hold pages in use
+    int            bHugePages;                    // put arenas on huge pages
     PF_HashTable   hashTable;                     // Hash table object
     int            numPages;                      // # of pages in the buffer
-    int            pageSize;                      // Size of pages in the buffer
-    int            first;                         // MRU page slot
-    int            last;                          // LRU page slot
+    int            pageSize;                      // Default size of pages
+    std::vector<int> filePageSizes;               // page size of each file
+                                                  // by fd, 0 for default
+    int            first;                         // head of used list
+    int            last;                          // tail of used list
     int            free;                          // head of free list
+    int            touchHead;                     // head of the touch list
+
+    // Replacement policies, one of which decides the victims.  Each keeps
+    // its own hit counts so they can be compared.
+    PF_ReplacementPolicy *policies[PF_NUM_POLICIES];
+    PF_ReplacementPolicy *pPolicy;                // the active policy
+
+    PF_BufRing     rings[PF_MAX_RINGS];           // buffer rings of scans
+    int            readAhead;                     // read-ahead window
+
+    PF_IOBackend   *pIO;                          // I/O backend
+    int            numInFlight;                   // requests not reaped yet
+
+    PF_IOBackend   *pCleanerIO;                   // page cleaner, NULL if off
+    int            numCleaning;                   // cleaner writes not reaped
+    int            cleanHigh;                     // watermarks in percent
+    int            cleanLow;                      // of the buffer
+    int            numDirty;                      // dirty pages not being
+                                                  // written back
 };
 
 #endif
@@ -25,7 +25,9 @@ static char *PF_WarnMsg[] = {
   (char*)"page already unpinned",
   (char*)"end of file",
   (char*)"attempting to resize the buffer too small",
-  (char*)"invalid filename"
+  (char*)"invalid buffer manager parameter",
+  (char*)"file is open read-only",
+  (char*)"page latch is not held"
 };
 
 static char *PF_ErrorMsg[] = {
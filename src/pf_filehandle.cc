@@ -5,7 +5,10 @@
 //              Dallan Quass (quass@cs.stanford.edu)
 //
 
+#include <cerrno>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include "pf_internal.h"
 #include "pf_buffermgr.h"
@@ -30,6 +33,11 @@ PF_FileHandle::PF_FileHandle()
    // Initialize local variables
    bFileOpen = FALSE;
    pBufferMgr = NULL;
+   bDirect = FALSE;
+   pMap = NULL;
+   mapSize = 0;
+   extentSize = PF_EXTENT_SIZE;
+   numReserved = 0;
 }
 
 //
@@ -58,6 +66,14 @@ PF_FileHandle::PF_FileHandle(const PF_FileHandle &fileHandle)
    this->bFileOpen   = fileHandle.bFileOpen;
    this->bHdrChanged = fileHandle.bHdrChanged;
    this->unixfd      = fileHandle.unixfd;
+   this->bDirect     = fileHandle.bDirect;
+   this->pMap        = fileHandle.pMap;
+   this->mapSize     = fileHandle.mapSize;
+   this->extentSize  = fileHandle.extentSize;
+   this->numReserved = fileHandle.numReserved;
+   this->lastPage    = fileHandle.lastPage;
+   this->raDir       = fileHandle.raDir;
+   this->raNext      = fileHandle.raNext;
 }
 
 //
@@ -80,6 +96,14 @@ PF_FileHandle& PF_FileHandle::operator= (const PF_FileHandle &fileHandle)
       this->bFileOpen   = fileHandle.bFileOpen;
       this->bHdrChanged = fileHandle.bHdrChanged;
       this->unixfd      = fileHandle.unixfd;
+      this->bDirect     = fileHandle.bDirect;
+      this->pMap        = fileHandle.pMap;
+      this->mapSize     = fileHandle.mapSize;
+      this->extentSize  = fileHandle.extentSize;
+      this->numReserved = fileHandle.numReserved;
+      this->lastPage    = fileHandle.lastPage;
+      this->raDir       = fileHandle.raDir;
+      this->raNext      = fileHandle.raNext;
    }
    // Return a reference to this
    return (*this);
@@ -197,12 +221,17 @@ RC PF_FileHandle::GetPrevPage(PageNum current, PF_PageHandle &pageHandle) const
 // Desc: Get a specific page in a file
 //       The file handle must refer to an open file
 // In:   pageNum - the number of the page to get
+//       ring - buffer ring from OpenRing to read the page through, or
+//              PF_NO_RING
 // Out:  pageHandle - becomes a handle to the this page of the file
 //                    this function modifies local var's in pageHandle
-//       The referenced page is pinned in the buffer pool.
+//       The referenced page is pinned in the buffer pool.  For a file
+//       opened PF_MMAP_READONLY it points into the mapping instead, and
+//       ring is ignored.
 // Ret:  PF return code
 //
-RC PF_FileHandle::GetThisPage(PageNum pageNum, PF_PageHandle &pageHandle) const
+RC PF_FileHandle::GetThisPage(PageNum pageNum, PF_PageHandle &pageHandle,
+                              int ring) const
 {
    int  rc;               // return code
    char *pPageBuf;        // address of page in buffer pool
@@ -215,10 +244,23 @@ RC PF_FileHandle::GetThisPage(PageNum pageNum, PF_PageHandle &pageHandle) const
    if (!IsValidPageNum(pageNum))
       return (PF_INVALIDPAGE);
 
+   // A mapped page is used as it is
+   if (pMap != NULL) {
+      pPageBuf = MappedPage(pageNum);
+      if (((PF_PageHdr*)pPageBuf)->nextFree != PF_PAGE_USED)
+         return (PF_INVALIDPAGE);
+      pageHandle.pageNum = pageNum;
+      pageHandle.pPageData = pPageBuf + sizeof(PF_PageHdr);
+      return (0);
+   }
+
    // Get this page from the buffer manager
-   if ((rc = pBufferMgr->GetPage(unixfd, pageNum, &pPageBuf)))
+   if ((rc = pBufferMgr->GetPage(unixfd, pageNum, &pPageBuf, TRUE, ring)))
       return (rc);
 
+   // Read ahead if the pages are being walked in order
+   ReadAhead(pageNum, ring);
+
    // If the page is valid, then set pageHandle to this page and return ok
    if (((PF_PageHdr*)pPageBuf)->nextFree == PF_PAGE_USED) {
 
@@ -257,6 +299,9 @@ RC PF_FileHandle::AllocatePage(PF_PageHandle &pageHandle)
    if (!bFileOpen)
       return (PF_CLOSEDFILE);
 
+   if (pMap != NULL)
+      return (PF_READONLY);
+
    // If the free list isn't empty...
    if (hdr.firstFree != PF_PAGE_LIST_END) {
       pageNum = hdr.firstFree;
@@ -275,6 +320,9 @@ RC PF_FileHandle::AllocatePage(PF_PageHandle &pageHandle)
       // The free list is empty...
       pageNum = hdr.numPages;
 
+      // Make sure the file has room for it on disk
+      Reserve(pageNum + 1);
+
       // Allocate a new page in the file
       if ((rc = pBufferMgr->AllocatePage(unixfd,
             pageNum,
@@ -292,7 +340,7 @@ RC PF_FileHandle::AllocatePage(PF_PageHandle &pageHandle)
    ((PF_PageHdr *)pPageBuf)->nextFree = PF_PAGE_USED;
 
    // Zero out the page data
-   memset(pPageBuf + sizeof(PF_PageHdr), 0, PF_PAGE_SIZE);
+   memset(pPageBuf + sizeof(PF_PageHdr), 0, hdr.pageSize);
 
    // Mark the page dirty because we changed the next pointer
    if ((rc = MarkDirty(pageNum)))
@@ -306,6 +354,59 @@ RC PF_FileHandle::AllocatePage(PF_PageHandle &pageHandle)
    return (0);
 }
 
+//
+// AllocatePages
+//
+// Desc: Allocate numPages new pages at the end of the file, with disk
+//       space for all of them reserved at once.  Disposed pages are not
+//       reused, so the new pages are adjacent in the file.  Each page is
+//       zeroed and marked dirty but left unpinned; use GetThisPage to
+//       fill them.  If an error stops the allocation part way, the pages
+//       allocated so far stay in the file.
+//       The file handle must refer to an open file
+// In:   numPages - number of pages to allocate
+// Out:  firstPage - number of the first page allocated
+// Ret:  PF_BADPARAM if numPages is not positive, or other PF return code
+//
+RC PF_FileHandle::AllocatePages(int numPages, PageNum &firstPage)
+{
+   int     rc;               // return code
+   char    *pPageBuf;        // address of page in buffer pool
+
+   // File must be open
+   if (!bFileOpen)
+      return (PF_CLOSEDFILE);
+
+   if (pMap != NULL)
+      return (PF_READONLY);
+
+   if (numPages <= 0)
+      return (PF_BADPARAM);
+
+   Reserve(hdr.numPages + numPages);
+
+   firstPage = hdr.numPages;
+   for (int i = 0; i < numPages; i++) {
+      PageNum pageNum = hdr.numPages;
+
+      if ((rc = pBufferMgr->AllocatePage(unixfd, pageNum, &pPageBuf)))
+         return (rc);
+      hdr.numPages++;
+      bHdrChanged = TRUE;
+
+      // Mark the page used and zero it as AllocatePage does
+      ((PF_PageHdr *)pPageBuf)->nextFree = PF_PAGE_USED;
+      memset(pPageBuf + sizeof(PF_PageHdr), 0, hdr.pageSize);
+
+      if ((rc = MarkDirty(pageNum)) ||
+            (rc = UnpinPage(pageNum)))
+         return (rc);
+   }
+
+   // Return ok
+   return (0);
+}
+
 //
 // DisposePage
 //
@@ -329,6 +430,9 @@ RC PF_FileHandle::DisposePage(PageNum pageNum)
    if (!IsValidPageNum(pageNum))
       return (PF_INVALIDPAGE);
 
+   if (pMap != NULL)
+      return (PF_READONLY);
+
    // Get the page (but don't re-pin it if it's already pinned)
    if ((rc = pBufferMgr->GetPage(unixfd,
          pageNum,
@@ -364,6 +468,78 @@ RC PF_FileHandle::DisposePage(PageNum pageNum)
    return (0);
 }
 
+//
+// Truncate
+//
+// Desc: Cut the file down to its first numPages pages, giving the disk
+//       space of the rest back.  The pages dropped leave the buffer pool
+//       without being written, and the free list.  The
+//       header goes out before the file is cut, so that it never counts
+//       pages the file does not have.
+//       The file handle must refer to an open file
+// In:   numPages - number of pages to keep
+// Ret:  PF_PAGEPINNED if a page to drop is pinned, or other PF return code
+//
+RC PF_FileHandle::Truncate(PageNum numPages)
+{
+   int     rc;               // return code
+   char    *pPageBuf;        // address of page in buffer pool
+
+   // File must be open
+   if (!bFileOpen)
+      return (PF_CLOSEDFILE);
+
+   if (pMap != NULL)
+      return (PF_READONLY);
+
+   if (numPages < 0 || numPages > hdr.numPages)
+      return (PF_INVALIDPAGE);
+   if (numPages == hdr.numPages)
+      return (0);
+
+   // The free pages that stay, in the order they are in the list
+   vector<PageNum> kept;
+   PageNum next;
+   for (PageNum p = hdr.firstFree; p != PF_PAGE_LIST_END; p = next) {
+      if ((rc = pBufferMgr->GetPage(unixfd, p, &pPageBuf)))
+         return (rc);
+      next = ((PF_PageHdr *)pPageBuf)->nextFree;
+      if ((rc = UnpinPage(p)))
+         return (rc);
+      if (p < numPages)
+         kept.push_back(p);
+   }
+
+   if ((rc = pBufferMgr->DiscardPages(unixfd, numPages)))
+      return (rc);
+
+   // Link them up again without the pages dropped
+   hdr.firstFree = kept.empty() ? PF_PAGE_LIST_END : kept[0];
+   for (size_t i = 0; i < kept.size(); i++) {
+      if ((rc = pBufferMgr->GetPage(unixfd, kept[i], &pPageBuf)))
+         return (rc);
+      ((PF_PageHdr *)pPageBuf)->nextFree =
+         (i + 1 < kept.size()) ? kept[i + 1] : PF_PAGE_LIST_END;
+      if ((rc = MarkDirty(kept[i])) ||
+            (rc = UnpinPage(kept[i])))
+         return (rc);
+   }
+
+   hdr.numPages = numPages;
+   if ((rc = WriteHdr()))
+      return (rc);
+   bHdrChanged = FALSE;
+
+   if (ftruncate(unixfd, PF_FILE_HDR_SIZE +
+         (off_t)numPages * PF_DiskPageSize(hdr.pageSize)) < 0)
+      return (PF_UNIX);
+   if (numReserved > numPages)
+      numReserved = numPages;
+
+   // Return ok
+   return (0);
+}
+
 //
 // MarkDirty
 //
@@ -384,6 +560,9 @@ RC PF_FileHandle::MarkDirty(PageNum pageNum) const
    if (!IsValidPageNum(pageNum))
       return (PF_INVALIDPAGE);
 
+   if (pMap != NULL)
+      return (PF_READONLY);
+
    // Tell the buffer manager to mark the page dirty
    return (pBufferMgr->MarkDirty(unixfd, pageNum));
 }
@@ -395,7 +574,8 @@ RC PF_FileHandle::MarkDirty(PageNum pageNum) const
 //       The page is then free to be written back to disk when necessary.
 //       PF_PageHandle objects referring to this page should not be used
 //       after making this call.
-//       The file handle must refer to an open file.
+//       The file handle must refer to an open file.  Mapped pages are
+//       never pinned, so for them this only checks the page number.
 // In:   pageNum - number of the page to unpin
 // Ret:  PF return code
 //
@@ -409,10 +589,63 @@ RC PF_FileHandle::UnpinPage(PageNum pageNum) const
    if (!IsValidPageNum(pageNum))
       return (PF_INVALIDPAGE);
 
+   if (pMap != NULL)
+      return (0);
+
    // Tell the buffer manager to unpin the page
    return (pBufferMgr->UnpinPage(unixfd, pageNum));
 }
 
+//
+// LatchPage
+//
+// Desc: Take the latch of a pinned page, so that threads sharing the file
+//       do not read a page while another changes it.  Any number of
+//       threads can hold a shared latch, or one thread an exclusive one.
+//       Mapped pages cannot change, so a shared latch is always granted.
+// In:   pageNum - number of a page the caller has pinned
+//       bExclusive - TRUE to latch the page for changing it
+// Ret:  PF return code
+//
+RC PF_FileHandle::LatchPage(PageNum pageNum, int bExclusive) const
+{
+   // File must be open
+   if (!bFileOpen)
+      return (PF_CLOSEDFILE);
+
+   // Validate page number
+   if (!IsValidPageNum(pageNum))
+      return (PF_INVALIDPAGE);
+
+   if (pMap != NULL)
+      return (bExclusive ? PF_READONLY : 0);
+
+   return (pBufferMgr->LatchPage(unixfd, pageNum, bExclusive));
+}
+
+//
+// UnlatchPage
+//
+// Desc: Release a latch taken with LatchPage.
+// In:   pageNum - number of the page
+// Ret:  PF_NOTLATCHED if the page is not latched, or other PF return code
+//
+RC PF_FileHandle::UnlatchPage(PageNum pageNum) const
+{
+   // File must be open
+   if (!bFileOpen)
+      return (PF_CLOSEDFILE);
+
+   // Validate page number
+   if (!IsValidPageNum(pageNum))
+      return (PF_INVALIDPAGE);
+
+   if (pMap != NULL)
+      return (0);
+
+   return (pBufferMgr->UnlatchPage(unixfd, pageNum));
+}
+
 //
 // FlushPages
 //
@@ -429,19 +662,9 @@ RC PF_FileHandle::FlushPages() const
 
    // If the file header has changed, write it back to the file
    if (bHdrChanged) {
-
-      // First seek to the appropriate place
-		 if (lseek(unixfd, 0, L_SET) < 0) {
-			 return (PF_UNIX);
-		 }
-      // Write header
-      int numBytes = write(unixfd,
-            (char *)&hdr,
-            sizeof(PF_FileHdr));
-      if (numBytes < 0)
-         return (PF_UNIX);
-      if (numBytes != sizeof(PF_FileHdr))
-         return (PF_HDRWRITE);
+      RC rc;
+      if ((rc = WriteHdr()))
+         return (rc);
 
       // This function is declared const, but we need to change the
       // bHdrChanged variable.  Cast away the constness
@@ -449,6 +672,10 @@ RC PF_FileHandle::FlushPages() const
       dummy->bHdrChanged = FALSE;
    }
 
+   // A mapped file has nothing in the buffer pool
+   if (pMap != NULL)
+      return (0);
+
    // Tell Buffer Manager to flush pages
    return (pBufferMgr->FlushPages(unixfd));
 }
@@ -471,19 +698,9 @@ RC PF_FileHandle::ForcePages(PageNum pageNum) const
 
    // If the file header has changed, write it back to the file
    if (bHdrChanged) {
-
-      // First seek to the appropriate place
-      if (lseek(unixfd, 0, L_SET) < 0)
-         return (PF_UNIX);
-
-      // Write header
-      int numBytes = write(unixfd,
-            (char *)&hdr,
-            sizeof(PF_FileHdr));
-      if (numBytes < 0)
-         return (PF_UNIX);
-      if (numBytes != sizeof(PF_FileHdr))
-         return (PF_HDRWRITE);
+      RC rc;
+      if ((rc = WriteHdr()))
+         return (rc);
 
       // This function is declared const, but we need to change the
       // bHdrChanged variable.  Cast away the constness
@@ -491,10 +708,185 @@ RC PF_FileHandle::ForcePages(PageNum pageNum) const
       dummy->bHdrChanged = FALSE;
    }
 
+   if (pMap != NULL)
+      return (0);
+
    // Tell Buffer Manager to Force the page
    return (pBufferMgr->ForcePages(unixfd, pageNum));
 }
 
+//
+// OpenRing
+//
+// Desc: Reserve a buffer ring for a scan of this file.  Pages read with
+//       GetThisPage through the ring reuse the ring's frames instead of
+//       evicting other pages from the buffer pool.
+//       The file handle must refer to an open file.
+// In:   numPages - number of frames in the ring
+// Out:  ring - ring to pass to GetThisPage, PF_NO_RING if no ring is free
+//       or the file is mapped
+// Ret:  PF return code
+//
+RC PF_FileHandle::OpenRing(int &ring, int numPages) const
+{
+   // File must be open
+   if (!bFileOpen)
+      return (PF_CLOSEDFILE);
+
+   if (pMap != NULL) {
+      ring = PF_NO_RING;
+      return (0);
+   }
+
+   return (pBufferMgr->OpenRing(ring, numPages));
+}
+
+//
+// CloseRing
+//
+// Desc: Release a buffer ring.  Its pages stay in the buffer pool and are
+//       replaced like any other page.
+// In:   ring - ring returned by OpenRing
+// Ret:  PF return code
+//
+RC PF_FileHandle::CloseRing(int ring) const
+{
+   if (pBufferMgr == NULL)
+      return (PF_CLOSEDFILE);
+
+   return (pBufferMgr->CloseRing(ring));
+}
+
+//
+// PrefetchPage
+//
+// Desc: Start reading a page into the buffer pool without pinning it, so
+//       that a later GetThisPage finds it there.  With an asynchronous I/O
+//       backend several prefetches are in flight at once.  For a mapped
+//       file, the kernel is asked to read the page in.
+//       The file handle must refer to an open file.
+// In:   pageNum - page to prefetch
+// Ret:  PF return code
+//
+RC PF_FileHandle::PrefetchPage(PageNum pageNum) const
+{
+   // File must be open
+   if (!bFileOpen)
+      return (PF_CLOSEDFILE);
+
+   // Validate page number
+   if (!IsValidPageNum(pageNum))
+      return (PF_INVALIDPAGE);
+
+   if (pMap != NULL) {
+      madvise(MappedPage(pageNum), PF_DiskPageSize(hdr.pageSize),
+            MADV_WILLNEED);
+      return (0);
+   }
+
+   return (pBufferMgr->PrefetchPage(unixfd, pageNum));
+}
+
+
+//
+// ReadAhead
+//
+// Desc: Internal.  Called with every page that GetThisPage gets.  Once
+//       a page follows the page before it (or precedes it, for a backward
+//       walk), the next window of pages in that direction is read into
+//       the buffer.  The following window is read when the walk comes
+//       within half a window of the end of the last one, so the reads stay
+//       ahead of the walk.  Asking for the same page again changes nothing;
+//       any other jump ends the sequential run.
+//       Read-ahead is only a hint: if it fails, the error shows up when
+//       the page itself is requested.
+// In:   pageNum - page just read
+//       ring - ring the page was read through
+//
+void PF_FileHandle::ReadAhead(PageNum pageNum, int ring) const
+{
+   int window = pBufferMgr->GetReadAhead(ring);
+   int dir = pageNum - lastPage;
+
+   if (dir == 0)
+      return;
+   lastPage = pageNum;
+   if (window == 0 || (dir != 1 && dir != -1)) {
+      raDir = 0;
+      return;
+   }
+
+   // A new run starts reading right after the current page
+   if (dir != raDir || (raNext - pageNum) * dir <= 0) {
+      raDir = dir;
+      raNext = pageNum + dir;
+   }
+
+   // Far enough ahead still?
+   if ((raNext - pageNum) * dir > window / 2)
+      return;
+
+   // The window in page order, clipped to the file
+   PageNum first = (dir > 0) ? raNext : raNext - window + 1;
+   PageNum end = first + window;
+   if (first < 0)
+      first = 0;
+   if (end > hdr.numPages)
+      end = hdr.numPages;
+   raNext += dir * window;
+   if (first >= end)
+      return;
+
+   pBufferMgr->ReadAhead(unixfd, first, end - first, ring);
+}
+
+//
+// MappedPage
+//
+// Desc: Internal.  Address of a page, page header included, in the
+//       mapping of a file opened PF_MMAP_READONLY.  Pages follow the file
+//       header as they do on disk.
+// In:   pageNum - a valid page number
+// Ret:  address of the page
+//
+char *PF_FileHandle::MappedPage(PageNum pageNum) const
+{
+   return (pMap + PF_FILE_HDR_SIZE +
+         (size_t)pageNum * PF_DiskPageSize(hdr.pageSize));
+}
+
+//
+// WriteHdr
+//
+// Desc: Internal.  Write the file header to the start of the file.  A file
+//       opened with O_DIRECT takes only aligned, whole blocks, so there the
+//       header goes out as the full PF_FILE_HDR_SIZE block from aligned
+//       memory; the rest of that block is unused and zero.
+// Ret:  PF return code
+//
+RC PF_FileHandle::WriteHdr() const
+{
+   int numBytes;
+
+   if (!bDirect) {
+      numBytes = pwrite(unixfd, (char *)&hdr, sizeof(PF_FileHdr), 0);
+      if (numBytes < 0)
+         return (PF_UNIX);
+      if (numBytes != sizeof(PF_FileHdr))
+         return (PF_HDRWRITE);
+      return (0);
+   }
+
+   alignas(PF_FILE_HDR_SIZE) char hdrBuf[PF_FILE_HDR_SIZE];
+   memset(hdrBuf, 0, PF_FILE_HDR_SIZE);
+   memcpy(hdrBuf, &hdr, sizeof(PF_FileHdr));
+   numBytes = pwrite(unixfd, hdrBuf, PF_FILE_HDR_SIZE, 0);
+   if (numBytes < 0)
+      return (PF_UNIX);
+   if (numBytes != PF_FILE_HDR_SIZE)
+      return (PF_HDRWRITE);
+   return (0);
+}
 
 //
 // IsValidPageNum
@@ -511,3 +903,32 @@ int PF_FileHandle::IsValidPageNum(PageNum pageNum) const
          pageNum < hdr.numPages);
 }
 
+//
+// Reserve
+//
+// Desc: Make sure disk space is reserved for the first numPages pages of
+//       the file.  Space is reserved at least an extent at a time, beyond
+//       the end of the file without changing its size, so that pages
+//       written later land next to each other.  Reserving space only
+//       helps layout: if it fails the pages are still written as usual,
+//       and on file systems without fallocate it is not tried again.
+// In:   numPages - number of pages that need space
+//
+void PF_FileHandle::Reserve(PageNum numPages)
+{
+   if (extentSize <= 0 || numPages <= numReserved)
+      return;
+
+   if (numPages < numReserved + extentSize)
+      numPages = numReserved + extentSize;
+
+   int diskPageSize = PF_DiskPageSize(hdr.pageSize);
+   if (fallocate(unixfd, FALLOC_FL_KEEP_SIZE,
+         PF_FILE_HDR_SIZE + (off_t)numReserved * diskPageSize,
+         (off_t)(numPages - numReserved) * diskPageSize) < 0) {
+      if (errno == EOPNOTSUPP || errno == ENOSYS)
+         extentSize = 0;
+      return;
+   }
+   numReserved = numPages;
+}
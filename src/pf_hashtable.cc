@@ -13,19 +13,24 @@
 //
 // Desc: Constructor for PF_HashTable object, which allows search, insert,
 //       and delete of hash table entries.
-// In:   numBuckets - number of hash table buckets
+// In:   numEntries - maximum number of entries the table must hold (the
+//                    number of pages in the buffer)
 //
-PF_HashTable::PF_HashTable(int _numBuckets)
+PF_HashTable::PF_HashTable(int numEntries)
 {
-  // Initialize numBuckets local variable from parameter
-  this->numBuckets = _numBuckets;
+  numBuckets = Capacity(numEntries);
+  numUsed = 0;
+  for (shardShift = 0; (PF_HASH_SHARDS << shardShift) < numBuckets; shardShift++)
+    ;
+  for (int i = 0; i < PF_HASH_SHARDS; i++)
+    versions[i] = 0;
 
   // Allocate memory for hash table
-  hashTable = new PF_HashEntry* [numBuckets];
+  hashTable = new PF_HashEntry[numBuckets];
 
-  // Initialize all buckets to empty
+  // Initialize all entries to empty
   for (int i = 0; i < numBuckets; i++)
-    hashTable[i] = NULL;
+    hashTable[i].slot = PF_HASH_EMPTY;
 }
 
 //
@@ -35,22 +40,41 @@ PF_HashTable::PF_HashTable(int _numBuckets)
 //
 PF_HashTable::~PF_HashTable()
 {
-  // Clear out all buckets
-  for (int i = 0; i < numBuckets; i++) {
-
-    // Delete all entries in the bucket
-    PF_HashEntry *entry = hashTable[i];
-    while (entry != NULL) {
-      PF_HashEntry *next = entry->next;
-      delete entry;
-      entry = next;
-    }
-  }
-
-  // Finally delete the hash table
   delete[] hashTable;
 }
 
+//
+// Capacity
+//
+// Desc: Internal.  Table size needed for numEntries entries: a power of
+//       two that keeps the load factor at or below 1/2.
+//
+int PF_HashTable::Capacity(int numEntries)
+{
+  int capacity = 16;
+  while (capacity < 2 * numEntries)
+    capacity <<= 1;
+  return capacity;
+}
+
+//
+// Hash
+//
+// Desc: Internal.  Mix fd and pageNum into a bucket number.  Page numbers
+//       of a file are consecutive, so a plain sum would cluster; the 64-bit
+//       finalizer from MurmurHash3 spreads them over the whole table.
+//
+int PF_HashTable::Hash(int fd, PageNum pageNum) const
+{
+  uint64_t key = ((uint64_t)(uint32_t)fd << 32) | (uint32_t)pageNum;
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return (int)(key & (numBuckets - 1));
+}
+
 //
 // Find
 //
@@ -60,22 +84,16 @@ PF_HashTable::~PF_HashTable()
 // Out:  slot - set to slot associated with fd and pageNum
 // Ret:  PF return code
 //
-RC PF_HashTable::Find(int fd, PageNum pageNum, int &slot)
+RC PF_HashTable::Find(int fd, PageNum pageNum, int &slot) const
 {
-  // Get which bucket it should be in
-  int bucket = Hash(fd, pageNum);
-
-  if (bucket<0)
-     return (PF_HASHNOTFOUND);
-
-  // Go through the linked list of this bucket
-  for (PF_HashEntry *entry = hashTable[bucket];
-       entry != NULL;
-       entry = entry->next) {
-    if (entry->fd == fd && entry->pageNum == pageNum) {
+  // Probe from the home bucket until the entry or an empty bucket is found
+  for (int bucket = Hash(fd, pageNum);
+       hashTable[bucket].slot != PF_HASH_EMPTY;
+       bucket = (bucket + 1) & (numBuckets - 1)) {
+    if (hashTable[bucket].fd == fd && hashTable[bucket].pageNum == pageNum) {
 
       // Found it
-      slot = entry->slot;
+      slot = hashTable[bucket].slot;
       return (0);
     }
   }
@@ -84,6 +102,67 @@ RC PF_HashTable::Find(int fd, PageNum pageNum, int &slot)
   return (PF_HASHNOTFOUND);
 }
 
+//
+// FindShared
+//
+// Desc: Find a hash table entry while another thread may be inserting or
+//       deleting entries.  The version of every shard the probe passes
+//       through is noted on the way in; if a shard was being written or
+//       has changed by the end, the probe starts over.
+// In:   fd - file descriptor
+//       pageNum - page number
+// Out:  slot - set to slot associated with fd and pageNum
+// Ret:  PF return code
+//
+RC PF_HashTable::FindShared(int fd, PageNum pageNum, int &slot) const
+{
+  int mask = numBuckets - 1;
+
+  for (;;) {
+    // A probe can wrap around into the shard it started in
+    int shards[PF_HASH_SHARDS + 1];
+    unsigned seen[PF_HASH_SHARDS + 1];
+    int numShards = 0;
+    int found = PF_HASH_EMPTY;
+    int bChanged = FALSE;
+
+    for (int bucket = Hash(fd, pageNum); ; bucket = (bucket + 1) & mask) {
+      int shard = bucket >> shardShift;
+      if (numShards == 0 || shards[numShards - 1] != shard) {
+        unsigned version = __atomic_load_n(&versions[shard], __ATOMIC_ACQUIRE);
+        if (version & 1) {
+          bChanged = TRUE;
+          break;
+        }
+        shards[numShards] = shard;
+        seen[numShards++] = version;
+      }
+
+      const PF_HashEntry &entry = hashTable[bucket];
+      int entrySlot = __atomic_load_n(&entry.slot, __ATOMIC_RELAXED);
+      if (entrySlot == PF_HASH_EMPTY)
+        break;
+      if (__atomic_load_n(&entry.fd, __ATOMIC_RELAXED) == fd &&
+          __atomic_load_n(&entry.pageNum, __ATOMIC_RELAXED) == pageNum) {
+        found = entrySlot;
+        break;
+      }
+    }
+
+    // The entries read are only good if no shard changed meanwhile
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    for (int i = 0; i < numShards && !bChanged; i++)
+      bChanged = __atomic_load_n(&versions[shards[i]], __ATOMIC_RELAXED) != seen[i];
+    if (bChanged)
+      continue;
+
+    if (found == PF_HASH_EMPTY)
+      return (PF_HASHNOTFOUND);
+    slot = found;
+    return (0);
+  }
+}
+
 //
 // Insert
 //
@@ -95,31 +174,25 @@ RC PF_HashTable::Find(int fd, PageNum pageNum, int &slot)
 //
 RC PF_HashTable::Insert(int fd, PageNum pageNum, int slot)
 {
-  // Get which bucket it should be in
-  int bucket = Hash(fd, pageNum);
-
-  // Check entry doesn't already exist in the bucket
-  PF_HashEntry *entry;
-  for (entry = hashTable[bucket];
-       entry != NULL;
-       entry = entry->next) {
-    if (entry->fd == fd && entry->pageNum == pageNum)
+  // Keep at least one empty bucket so that probes always terminate
+  if (numUsed + 1 >= numBuckets)
+    return (PF_NOMEM);
+
+  // Check entry doesn't already exist, stopping at the first empty bucket
+  int bucket;
+  for (bucket = Hash(fd, pageNum);
+       hashTable[bucket].slot != PF_HASH_EMPTY;
+       bucket = (bucket + 1) & (numBuckets - 1)) {
+    if (hashTable[bucket].fd == fd && hashTable[bucket].pageNum == pageNum)
       return (PF_HASHPAGEEXIST);
   }
 
-  // Allocate memory for new hash entry
-  if ((entry = new PF_HashEntry) == NULL)
-    return (PF_NOMEM);
-
-  // Insert entry at head of list for this bucket
-  entry->fd = fd;
-  entry->pageNum = pageNum;
-  entry->slot = slot;
-  entry->next = hashTable[bucket];
-  entry->prev = NULL;
-  if (hashTable[bucket] != NULL)
-    hashTable[bucket]->prev = entry;
-  hashTable[bucket] = entry;
+  // Fill in the empty bucket
+  PF_HashEntry entry = { fd, pageNum, slot };
+  BeginWrite(bucket, bucket);
+  Put(bucket, entry);
+  EndWrite(bucket, bucket);
+  numUsed++;
 
   // Return ok
   return (0);
@@ -135,33 +208,130 @@ RC PF_HashTable::Insert(int fd, PageNum pageNum, int slot)
 //
 RC PF_HashTable::Delete(int fd, PageNum pageNum)
 {
-  // Get which bucket it should be in
-  int bucket = Hash(fd, pageNum);
-
-  // Find the entry is in this bucket
-  PF_HashEntry *entry;
-  for (entry = hashTable[bucket];
-       entry != NULL;
-       entry = entry->next) {
-    if (entry->fd == fd && entry->pageNum == pageNum)
+  int mask = numBuckets - 1;
+
+  // Find the entry
+  int bucket;
+  for (bucket = Hash(fd, pageNum);
+       hashTable[bucket].slot != PF_HASH_EMPTY;
+       bucket = (bucket + 1) & mask) {
+    if (hashTable[bucket].fd == fd && hashTable[bucket].pageNum == pageNum)
       break;
   }
 
   // Did we find hash entry?
-  if (entry == NULL)
+  if (hashTable[bucket].slot == PF_HASH_EMPTY)
     return (PF_HASHNOTFOUND);
 
-  // Remove this entry
-  if (entry == hashTable[bucket])
-    hashTable[bucket] = entry->next;
-  if (entry->prev != NULL)
-    entry->prev->next = entry->next;
-  if (entry->next != NULL)
-    entry->next->prev = entry->prev;
-  delete entry;
+  // Entries up to the end of the probe run may move
+  int end = bucket;
+  while (hashTable[(end + 1) & mask].slot != PF_HASH_EMPTY)
+    end = (end + 1) & mask;
+  BeginWrite(bucket, end);
 
-  // Return ook
+  // Remove this entry, then shift back any later entry of the same probe
+  // run whose home bucket does not lie between the hole and itself
+  int hole = bucket;
+  for (int next = (hole + 1) & mask;
+       hashTable[next].slot != PF_HASH_EMPTY;
+       next = (next + 1) & mask) {
+    int home = Hash(hashTable[next].fd, hashTable[next].pageNum);
+    if (((next - home) & mask) >= ((next - hole) & mask)) {
+      Put(hole, hashTable[next]);
+      hole = next;
+    }
+  }
+  __atomic_store_n(&hashTable[hole].slot, PF_HASH_EMPTY, __ATOMIC_RELAXED);
+  EndWrite(bucket, end);
+  numUsed--;
+
+  // Return ok
+  return (0);
+}
+
+//
+// Resize
+//
+// Desc: Reallocate the table for numEntries entries and rehash the
+//       entries it currently holds.
+// In:   numEntries - maximum number of entries the table must hold
+// Ret:  PF return code
+//
+RC PF_HashTable::Resize(int numEntries)
+{
+  if (numEntries < numUsed)
+    return (PF_TOOSMALL);
+
+  PF_HashEntry *oldTable = hashTable;
+  int oldNumBuckets = numBuckets;
+
+  numBuckets = Capacity(numEntries);
+  numUsed = 0;
+  for (shardShift = 0; (PF_HASH_SHARDS << shardShift) < numBuckets; shardShift++)
+    ;
+  hashTable = new PF_HashEntry[numBuckets];
+  for (int i = 0; i < numBuckets; i++)
+    hashTable[i].slot = PF_HASH_EMPTY;
+
+  RC rc;
+  for (int i = 0; i < oldNumBuckets; i++) {
+    if (oldTable[i].slot == PF_HASH_EMPTY)
+      continue;
+    if ((rc = Insert(oldTable[i].fd, oldTable[i].pageNum, oldTable[i].slot))) {
+      delete[] oldTable;
+      return (rc);
+    }
+  }
+
+  delete[] oldTable;
   return (0);
 }
 
+//
+// Put
+//
+// Desc: Internal.  Store an entry into a bucket, field by field, so that
+//       FindShared can read the bucket at the same time.
+//
+void PF_HashTable::Put(int bucket, const PF_HashEntry &entry)
+{
+  __atomic_store_n(&hashTable[bucket].fd, entry.fd, __ATOMIC_RELAXED);
+  __atomic_store_n(&hashTable[bucket].pageNum, entry.pageNum, __ATOMIC_RELAXED);
+  __atomic_store_n(&hashTable[bucket].slot, entry.slot, __ATOMIC_RELAXED);
+}
 
+//
+// BeginWrite, EndWrite
+//
+// Desc: Internal.  Bracket a change to the buckets from..to (wrapping
+//       around the end of the table).  Each increments the version of
+//       every shard the buckets are in, so a version is odd during the
+//       change and different after it.
+//
+void PF_HashTable::BeginWrite(int from, int to)
+{
+  Bump(from, to);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void PF_HashTable::EndWrite(int from, int to)
+{
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  Bump(from, to);
+}
+
+void PF_HashTable::Bump(int from, int to)
+{
+  int mask = numBuckets - 1;
+  int bucket = from;
+  for (;;) {
+    int shard = bucket >> shardShift;
+    __atomic_store_n(&versions[shard], versions[shard] + 1, __ATOMIC_RELAXED);
+
+    // Stop in the shard that holds to, or go on to the next one
+    int shardEnd = bucket | ((1 << shardShift) - 1);
+    if (((to - bucket) & mask) <= ((shardEnd - bucket) & mask))
+      break;
+    bucket = (shardEnd + 1) & mask;
+  }
+}
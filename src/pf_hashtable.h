@@ -4,18 +4,31 @@
 // Authors:     Hugo Rivero (rivero@cs.stanford.edu)
 //              Dallan Quass (quass@cs.stanford.edu)
 //
+// The table maps (fd, pageNum) to a buffer slot.  It is an open-addressing
+// table with linear probing that is allocated once for the size of the
+// buffer pool, so Find/Insert/Delete never touch the heap.  Deletion uses
+// backward shifting instead of tombstones so probe sequences stay short.
+//
+// FindShared may run in other threads while one thread at a time calls
+// Insert and Delete.  The buckets are split into PF_HASH_SHARDS ranges,
+// each with a version that writers make odd while they change it; a
+// reader retries if a range it probed changed under it.  Resize must not
+// run concurrently with anything.
+//
 
 #ifndef PF_HASHTABLE_H
 #define PF_HASHTABLE_H
 
+#include <cstdint>
 #include "pf_internal.h"
 
 //
-// HashEntry - Hash table bucket entries
+// HashEntry - Hash table entries.  An entry with slot == PF_HASH_EMPTY is
+// unused.
 //
+#define PF_HASH_EMPTY (-1)
+
 struct PF_HashEntry {
-    PF_HashEntry *next;   // next hash table element or NULL
-    PF_HashEntry *prev;   // prev hash table element or NULL
     int          fd;      // file descriptor
     PageNum      pageNum; // page number
     int          slot;    // slot of this page in the buffer
@@ -26,20 +39,42 @@ struct PF_HashEntry {
 //
 class PF_HashTable {
 public:
-    PF_HashTable (int numBuckets);           // Constructor
+    PF_HashTable (int numEntries);           // Constructor - room for at
+                                             // least numEntries entries
     ~PF_HashTable();                         // Destructor
-    RC  Find     (int fd, PageNum pageNum, int &slot);
+    RC  Find     (int fd, PageNum pageNum, int &slot) const;
                                              // Set slot to the hash table
                                              // entry for fd and pageNum
+    RC  FindShared(int fd, PageNum pageNum, int &slot) const;
+                                             // Find, safe while another
+                                             // thread inserts and deletes
     RC  Insert   (int fd, PageNum pageNum, int slot);
                                              // Insert a hash table entry
     RC  Delete   (int fd, PageNum pageNum);  // Delete a hash table entry
 
+    // Grow or shrink the table to hold numEntries entries, rehashing the
+    // entries currently in it.
+    RC  Resize   (int numEntries);
+
+    int GetNumEntries() const { return numUsed; }
+
 private:
-    int Hash     (int fd, PageNum pageNum) const
-      { return ((fd + pageNum) % numBuckets); }   // Hash function
-    int numBuckets;                               // Number of hash table buckets
-    PF_HashEntry **hashTable;                     // Hash table
+    int Hash     (int fd, PageNum pageNum) const;  // Hash function
+    static int Capacity(int numEntries);           // table size for entries
+    void Put     (int bucket, const PF_HashEntry &entry);
+                                                  // Store a bucket
+    void BeginWrite(int from, int to);            // Mark the shards of
+    void EndWrite  (int from, int to);            // buckets from..to busy,
+                                                  // then changed
+    void Bump    (int from, int to);              // Advance their versions
+
+    int numBuckets;                               // Number of table entries
+                                                  // (a power of two)
+    int numUsed;                                  // Number of used entries
+    int shardShift;                               // bucket >> shardShift
+                                                  // is the bucket's shard
+    PF_HashEntry *hashTable;                      // Hash table
+    unsigned versions[PF_HASH_SHARDS];            // odd while being written
 };
 
 #endif
@@ -0,0 +1,95 @@
+#include <thread>
+#include <atomic>
+#include <vector>
+#include "pf_internal.h"
+#include "pf_hashtable.h"
+#include "gtest/gtest.h"
+
+class PF_HashTableTest : public ::testing::Test {
+protected:
+	virtual void SetUp() {}
+	virtual void TearDown() {}
+};
+
+TEST_F(PF_HashTableTest, InsertFindDelete) {
+	PF_HashTable ht(1000);
+	int slot;
+
+	// consecutive pages of a few files - the common buffer pool pattern
+	for (int fd = 3; fd < 7; fd++)
+		for (PageNum p = 0; p < 250; p++)
+			ASSERT_EQ(0, ht.Insert(fd, p, fd * 1000 + p));
+	ASSERT_EQ(1000, ht.GetNumEntries());
+	ASSERT_EQ(PF_HASHPAGEEXIST, ht.Insert(4, 17, 0));
+
+	for (int fd = 3; fd < 7; fd++)
+		for (PageNum p = 0; p < 250; p++) {
+			ASSERT_EQ(0, ht.Find(fd, p, slot));
+			ASSERT_EQ(fd * 1000 + p, slot);
+		}
+
+	// delete every other entry and make sure the rest are still reachable
+	for (int fd = 3; fd < 7; fd++)
+		for (PageNum p = 0; p < 250; p += 2)
+			ASSERT_EQ(0, ht.Delete(fd, p));
+	ASSERT_EQ(500, ht.GetNumEntries());
+	ASSERT_EQ(PF_HASHNOTFOUND, ht.Delete(3, 0));
+
+	for (int fd = 3; fd < 7; fd++)
+		for (PageNum p = 0; p < 250; p++) {
+			if (p % 2 == 0) {
+				ASSERT_EQ(PF_HASHNOTFOUND, ht.Find(fd, p, slot));
+			} else {
+				ASSERT_EQ(0, ht.Find(fd, p, slot));
+				ASSERT_EQ(fd * 1000 + p, slot);
+			}
+		}
+}
+
+TEST_F(PF_HashTableTest, Resize) {
+	PF_HashTable ht(10);
+	int slot;
+
+	for (PageNum p = 0; p < 10; p++)
+		ASSERT_EQ(0, ht.Insert(-1, p, p));
+	ASSERT_EQ(PF_TOOSMALL, ht.Resize(5));
+
+	ASSERT_EQ(0, ht.Resize(100000));
+	for (PageNum p = 10; p < 100000; p++)
+		ASSERT_EQ(0, ht.Insert(-1, p, p));
+	for (PageNum p = 0; p < 100000; p++) {
+		ASSERT_EQ(0, ht.Find(-1, p, slot));
+		ASSERT_EQ(p, slot);
+	}
+}
+
+TEST_F(PF_HashTableTest, FindShared) {
+	PF_HashTable ht(64);
+	std::atomic<int> bDone(0), numWrong(0);
+
+	// readers look up pages that stay put while a writer moves the runs
+	// around them by inserting and deleting other pages
+	for (PageNum p = 0; p < 20; p++)
+		ASSERT_EQ(0, ht.Insert(0, p, p));
+
+	std::vector<std::thread> readers;
+	for (int t = 0; t < 3; t++)
+		readers.push_back(std::thread([&]() {
+			int slot;
+			while (!bDone)
+				for (PageNum p = 0; p < 20; p++)
+					if (ht.FindShared(0, p, slot) != 0 || slot != p)
+						numWrong++;
+		}));
+
+	for (int round = 0; round < 2000; round++) {
+		for (PageNum p = 0; p < 30; p++)
+			ASSERT_EQ(0, ht.Insert(1, p, 100 + p));
+		for (PageNum p = 0; p < 30; p++)
+			ASSERT_EQ(0, ht.Delete(1, (p * 7) % 30));
+	}
+	bDone = 1;
+	for (size_t t = 0; t < readers.size(); t++)
+		readers[t].join();
+	ASSERT_EQ(0, numWrong);
+}
@@ -11,18 +11,37 @@
 
 #include <cstdlib>
 #include <cstring>
+#include <string>
+#include <vector>
+#include <map>
 #include "pf.h"
 
 //
 // Constants and defines
 //
-const int PF_BUFFER_SIZE = 40;     // Number of pages in the buffer
-const int PF_HASH_TBL_SIZE = 20;   // Size of hash table
+const int PF_BUFFER_SIZE = 40;     // Default number of pages in the buffer
+const int PF_NUM_POLICIES = 4;     // Number of page replacement policies
+const int PF_MAX_RINGS = 16;       // Number of buffer rings open at once
+const int PF_READAHEAD_PAGES = 0;  // Default read-ahead window - off until set
+const int PF_MAX_READAHEAD = 64;   // Largest read-ahead window in pages
+const int PF_MAX_WRITEBACK = 64;   // Most pages written with one call
+const int PF_IO_THREADS = 4;       // Threads of the "threads" I/O backend
+const int PF_IO_DEPTH = 32;        // Most I/O requests in flight at once
+const long PF_HUGE_PAGE_SIZE = 2 * 1024 * 1024;  // Huge page size
+const int PF_HASH_SHARDS = 16;     // Hash table parts with their own
+                                   // version for latch-free lookups
+const int PF_LATCH_SPINS = 64;     // Tries for a page latch before yielding
 
 #define CREATION_MASK      0600    // r/w privileges to owner only
 #define PF_PAGE_LIST_END  -1       // end of list of free pages
 #define PF_PAGE_USED      -2       // page is being used
 
+// INVALID_SLOT is used within the PF_BufferMgr class which tracks a list
+// of PF_BufPageDesc.  Inside the PF_BufPageDesc are integer "pointers" to
+// next and prev items.  INVALID_SLOT is used to indicate no previous or
+// next.
+#define INVALID_SLOT  (-1)
+
 // L_SET is used to indicate the "whence" argument of the lseek call
 // defined in "/usr/include/unistd.h".  A value of 0 indicates to
 // move to the absolute location specified.
@@ -30,6 +49,46 @@ const int PF_HASH_TBL_SIZE = 20;   // Size of hash table
 #define L_SET              0
 #endif
 
+//
+// PF_HotList: pages of files that were in the buffer when the files were
+// closed, for warm restarts (see PF_Manager::SaveHotPages)
+//
+struct PF_HotPage {
+    std::string fileName;
+    PageNum     pageNum;
+};
+
+struct PF_HotList {
+    std::vector<std::string> names;     // name of the file open as each fd
+    std::vector<PF_HotPage>  pages;     // most recently loaded first
+    std::vector<PF_HotPage>  pending;   // loaded by WarmUp, read into the
+                                        // buffer when their file is opened
+};
+
+//
+// PF_PoolTable: the named buffer pools of a PF_Manager besides its default
+// pool, which files are assigned to them, and the set command values every
+// pool gets
+//
+class PF_BufferMgr;
+
+struct PF_Pool {
+    std::string  name;
+    PF_BufferMgr *pBufferMgr;
+};
+
+struct PF_PoolTable {
+    std::vector<PF_Pool> pools;
+    std::map<std::string, std::string> assigned;  // file name -> pool name
+    std::string policy;                 // replacement policy
+    int         readAhead;              // read-ahead window
+    std::string backend;                // I/O backend
+    int         cleanHigh, cleanLow;    // page cleaner watermarks
+
+    PF_PoolTable() : policy("lru"), readAhead(PF_READAHEAD_PAGES),
+                     backend("sync"), cleanHigh(0), cleanLow(0) {}
+};
+
 //
 // PF_PageHdr: Header structure for pages
 //
@@ -43,4 +102,17 @@ struct PF_PageHdr {
 // Justify the file header to the length of one page
 const int PF_FILE_HDR_SIZE = PF_PAGE_SIZE + sizeof(PF_PageHdr);
 
+// Pages take a multiple of this many bytes on disk
+const int PF_DISK_BLOCK = 4096;
+
+//
+// PF_DiskPageSize: bytes a page that holds pageSize bytes takes on disk
+// and in the buffer, page header included
+//
+inline int PF_DiskPageSize(int pageSize)
+{
+   return (pageSize + (int)sizeof(PF_PageHdr) + PF_DISK_BLOCK - 1) /
+      PF_DISK_BLOCK * PF_DISK_BLOCK;
+}
+
 #endif
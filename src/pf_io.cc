@@ -0,0 +1,301 @@
+//
+// File:        pf_io.cc
+// Description: Page I/O backends for PF_BufferMgr
+//
+
+#include <cerrno>
+#include <cstring>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "pf_io.h"
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+// PF_IOBackend
+//------------------------------------------------------------------------------
+
+//
+// Create
+//
+// Desc: Create a backend by name.  "uring" falls back to the thread pool
+//       when io_uring cannot be set up.
+// In:   name - "sync", "threads" or "uring"
+// Ret:  the new backend, or NULL if there is no backend called name
+//
+PF_IOBackend *PF_IOBackend::Create(const char *name)
+{
+   if (strcasecmp(name, "sync") == 0)
+      return new PF_SyncIO();
+   if (strcasecmp(name, "threads") == 0)
+      return new PF_ThreadIO(PF_IO_THREADS);
+   if (strcasecmp(name, "uring") == 0) {
+      PF_UringIO *pUring = new PF_UringIO();
+      if (pUring->Init(PF_IO_DEPTH) == 0)
+         return pUring;
+      delete pUring;
+      return new PF_ThreadIO(PF_IO_THREADS);
+   }
+   return NULL;
+}
+
+//
+// DoIO
+//
+// Desc: Read or write the pages of a request with one system call and
+//       store the number of bytes transferred in pReq->result.
+//
+void PF_IOBackend::DoIO(PF_IORequest *pReq)
+{
+   ssize_t numBytes;
+   if (pReq->op == PF_IO_READ)
+      numBytes = preadv(pReq->fd, pReq->iov, pReq->numPages, pReq->offset);
+   else
+      numBytes = pwritev(pReq->fd, pReq->iov, pReq->numPages, pReq->offset);
+   pReq->result = (numBytes < 0) ? -1 : numBytes;
+}
+
+//------------------------------------------------------------------------------
+// PF_SyncIO
+//------------------------------------------------------------------------------
+
+RC PF_SyncIO::Submit(PF_IORequest *pReq)
+{
+   DoIO(pReq);
+   done.push_back(pReq);
+   return (0);
+}
+
+RC PF_SyncIO::Reap(PF_IORequest *&pReq, int bWait)
+{
+   pReq = NULL;
+   if (!done.empty()) {
+      pReq = done.front();
+      done.pop_front();
+   }
+   return (0);
+}
+
+//------------------------------------------------------------------------------
+// PF_ThreadIO
+//------------------------------------------------------------------------------
+
+PF_ThreadIO::PF_ThreadIO(int numThreads)
+   : numOutstanding(0), bStop(FALSE)
+{
+   for (int i = 0; i < numThreads; i++)
+      workers.push_back(thread(&PF_ThreadIO::Work, this));
+}
+
+//
+// ~PF_ThreadIO
+//
+// Desc: Stop the workers.  The buffer manager reaps every request before
+//       it destroys a backend, so no request is lost.
+//
+PF_ThreadIO::~PF_ThreadIO()
+{
+   {
+      lock_guard<std::mutex> lock(mutex);
+      bStop = TRUE;
+   }
+   cvPending.notify_all();
+   for (size_t i = 0; i < workers.size(); i++)
+      workers[i].join();
+}
+
+void PF_ThreadIO::Work()
+{
+   unique_lock<std::mutex> lock(mutex);
+   for (;;) {
+      cvPending.wait(lock, [this] { return bStop || !pending.empty(); });
+      if (pending.empty())
+         return;
+      PF_IORequest *pReq = pending.front();
+      pending.pop_front();
+
+      lock.unlock();
+      DoIO(pReq);
+      lock.lock();
+
+      done.push_back(pReq);
+      cvDone.notify_one();
+   }
+}
+
+RC PF_ThreadIO::Submit(PF_IORequest *pReq)
+{
+   {
+      lock_guard<std::mutex> lock(mutex);
+      pending.push_back(pReq);
+      numOutstanding++;
+   }
+   cvPending.notify_one();
+   return (0);
+}
+
+RC PF_ThreadIO::Reap(PF_IORequest *&pReq, int bWait)
+{
+   unique_lock<std::mutex> lock(mutex);
+   if (bWait)
+      cvDone.wait(lock, [this] { return !done.empty() || numOutstanding == 0; });
+
+   pReq = NULL;
+   if (!done.empty()) {
+      pReq = done.front();
+      done.pop_front();
+      numOutstanding--;
+   }
+   return (0);
+}
+
+//------------------------------------------------------------------------------
+// PF_UringIO
+//
+// One submission and one completion queue, shared with the kernel through
+// mmap.  Only this thread produces submissions and consumes completions, so
+// the only ordering needed is against the kernel: acquire loads of the
+// indexes the kernel moves and release stores of the ones we move.
+//------------------------------------------------------------------------------
+
+PF_UringIO::PF_UringIO()
+   : ringFd(-1), numEntries(0), numOutstanding(0),
+     pSqRing(MAP_FAILED), sqRingSize(0), pCqRing(MAP_FAILED), cqRingSize(0),
+     pSqes(MAP_FAILED), sqesSize(0)
+{
+}
+
+PF_UringIO::~PF_UringIO()
+{
+   if (pSqes != MAP_FAILED)
+      munmap(pSqes, sqesSize);
+   if (pCqRing != MAP_FAILED && pCqRing != pSqRing)
+      munmap(pCqRing, cqRingSize);
+   if (pSqRing != MAP_FAILED)
+      munmap(pSqRing, sqRingSize);
+   if (ringFd >= 0)
+      close(ringFd);
+}
+
+//
+// Init
+//
+// Desc: Create the io_uring instance and map its queues.
+// In:   entries - size of the submission queue
+// Ret:  PF_UNIX if the kernel refuses (no io_uring, or not permitted)
+//
+RC PF_UringIO::Init(unsigned entries)
+{
+   struct io_uring_params params;
+   memset(&params, 0, sizeof(params));
+
+   ringFd = syscall(__NR_io_uring_setup, entries, &params);
+   if (ringFd < 0)
+      return (PF_UNIX);
+   numEntries = params.sq_entries;
+
+   sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+   cqRingSize = params.cq_off.cqes +
+      params.cq_entries * sizeof(struct io_uring_cqe);
+   if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      if (cqRingSize > sqRingSize)
+         sqRingSize = cqRingSize;
+      cqRingSize = sqRingSize;
+   }
+
+   pSqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE,
+         MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+   if (pSqRing == MAP_FAILED)
+      return (PF_UNIX);
+   if (params.features & IORING_FEAT_SINGLE_MMAP)
+      pCqRing = pSqRing;
+   else {
+      pCqRing = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+      if (pCqRing == MAP_FAILED)
+         return (PF_UNIX);
+   }
+   sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+   pSqes = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE,
+         MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+   if (pSqes == MAP_FAILED)
+      return (PF_UNIX);
+
+   char *sq = (char *)pSqRing;
+   char *cq = (char *)pCqRing;
+   sqHead  = (unsigned *)(sq + params.sq_off.head);
+   sqTail  = (unsigned *)(sq + params.sq_off.tail);
+   sqMask  = (unsigned *)(sq + params.sq_off.ring_mask);
+   sqArray = (unsigned *)(sq + params.sq_off.array);
+   cqHead  = (unsigned *)(cq + params.cq_off.head);
+   cqTail  = (unsigned *)(cq + params.cq_off.tail);
+   cqMask  = (unsigned *)(cq + params.cq_off.ring_mask);
+   cqes    = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+   sqes    = (struct io_uring_sqe *)pSqes;
+
+   return (0);
+}
+
+RC PF_UringIO::Submit(PF_IORequest *pReq)
+{
+   unsigned tail = *sqTail;
+   unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+   if (tail - head >= numEntries)
+      return (PF_NOBUF);
+
+   unsigned index = tail & *sqMask;
+   struct io_uring_sqe *sqe = &sqes[index];
+   memset(sqe, 0, sizeof(*sqe));
+   sqe->opcode = (pReq->op == PF_IO_READ) ? IORING_OP_READV : IORING_OP_WRITEV;
+   sqe->fd = pReq->fd;
+   sqe->addr = (unsigned long)pReq->iov;
+   sqe->len = pReq->numPages;
+   sqe->off = pReq->offset;
+   sqe->user_data = (unsigned long)pReq;
+   sqArray[index] = index;
+   __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+   int numSubmitted;
+   do
+      numSubmitted = syscall(__NR_io_uring_enter, ringFd, 1, 0, 0, NULL, 0);
+   while (numSubmitted < 0 && errno == EINTR);
+
+   // Without SQPOLL the kernel only consumes SQEs inside io_uring_enter, so
+   // if the entry is still unconsumed it can be withdrawn and the request
+   // failed; once consumed it will complete through Reap whatever enter said.
+   if (numSubmitted <= 0 &&
+         __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) == tail) {
+      __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+      return (PF_UNIX);
+   }
+
+   numOutstanding++;
+   return (0);
+}
+
+RC PF_UringIO::Reap(PF_IORequest *&pReq, int bWait)
+{
+   pReq = NULL;
+   if (numOutstanding == 0)
+      return (0);
+
+   unsigned head = *cqHead;
+   while (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+      if (!bWait)
+         return (0);
+      if (syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS,
+            NULL, 0) < 0 && errno != EINTR)
+         return (PF_UNIX);
+   }
+
+   struct io_uring_cqe *cqe = &cqes[head & *cqMask];
+   pReq = (PF_IORequest *)cqe->user_data;
+   pReq->result = (cqe->res < 0) ? -1 : cqe->res;
+   __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+   numOutstanding--;
+
+   return (0);
+}
@@ -0,0 +1,142 @@
+//
+// File:        pf_io.h
+// Description: Page I/O backends for PF_BufferMgr
+//
+// The buffer manager hands reads and writes of page runs to a backend as
+// PF_IORequests and later reaps them when they are done.  Three backends
+// are provided:
+//
+//   sync     - does the I/O inside Submit; the request is done on return
+//   threads  - a small pool of threads doing preadv/pwritev
+//   uring    - Linux io_uring, driven through the raw system calls.  If the
+//              kernel does not allow io_uring, the thread pool is used.
+//
+// Demand reads that a caller is waiting for do not go through a backend;
+// the backends carry read-ahead, prefetches and eviction write-back.
+//
+
+#ifndef PF_IO_H
+#define PF_IO_H
+
+#include <sys/uio.h>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "pf_internal.h"
+
+//
+// I/O state of a buffer page
+//
+#define PF_IO_NONE   0              // no I/O in flight
+#define PF_IO_READ   1              // being read
+#define PF_IO_WRITE  2              // being written
+
+//
+// PF_IORequest - a read or write of consecutive pages of a file
+//
+struct PF_IORequest {
+    int          op;                          // PF_IO_READ or PF_IO_WRITE
+    int          fd;                          // OS file descriptor
+    long         offset;                      // file offset of the first page
+    int          numPages;                    // number of pages
+    struct iovec iov[PF_MAX_READAHEAD];       // page memory, one per page
+    int          slots[PF_MAX_READAHEAD];     // buffer slots, one per page
+    long         result;                      // bytes transferred, -1 on error
+};
+
+//
+// PF_IOBackend - interface of an I/O backend
+//
+class PF_IOBackend {
+public:
+   virtual ~PF_IOBackend () {}
+
+   // Name used to select the backend and to report it
+   virtual const char *Name() const = 0;
+   // TRUE if requests can still be in flight when Submit returns
+   virtual int  IsAsync() const = 0;
+
+   // Start a request
+   virtual RC   Submit(PF_IORequest *pReq) = 0;
+   // Return a finished request in pReq, NULL if there is none.  With bWait
+   // set, wait for one if any request is in flight.
+   virtual RC   Reap  (PF_IORequest *&pReq, int bWait) = 0;
+
+   // Create the backend called name; NULL for an unknown name
+   static PF_IOBackend *Create(const char *name);
+
+protected:
+   static void DoIO(PF_IORequest *pReq);      // preadv/pwritev a request
+};
+
+//
+// PF_SyncIO - blocking I/O inside Submit
+//
+class PF_SyncIO : public PF_IOBackend {
+public:
+   const char *Name() const { return "sync"; }
+   int  IsAsync() const     { return FALSE; }
+   RC   Submit(PF_IORequest *pReq);
+   RC   Reap  (PF_IORequest *&pReq, int bWait);
+private:
+   std::deque<PF_IORequest *> done;           // finished, not reaped
+};
+
+//
+// PF_ThreadIO - worker threads doing blocking I/O
+//
+class PF_ThreadIO : public PF_IOBackend {
+public:
+   PF_ThreadIO (int numThreads);
+   ~PF_ThreadIO();
+   const char *Name() const { return "threads"; }
+   int  IsAsync() const     { return TRUE; }
+   RC   Submit(PF_IORequest *pReq);
+   RC   Reap  (PF_IORequest *&pReq, int bWait);
+private:
+   void Work();                               // worker thread body
+
+   std::vector<std::thread>   workers;
+   std::mutex                 mutex;          // protects all below
+   std::condition_variable    cvPending;      // a request was queued
+   std::condition_variable    cvDone;         // a request finished
+   std::deque<PF_IORequest *> pending;        // not started yet
+   std::deque<PF_IORequest *> done;           // finished, not reaped
+   int                        numOutstanding; // submitted, not reaped
+   int                        bStop;          // workers should exit
+};
+
+//
+// PF_UringIO - io_uring without liburing
+//
+class PF_UringIO : public PF_IOBackend {
+public:
+   PF_UringIO ();
+   ~PF_UringIO();
+   const char *Name() const { return "uring"; }
+   int  IsAsync() const     { return TRUE; }
+   RC   Init  (unsigned numEntries);          // set up the ring
+   RC   Submit(PF_IORequest *pReq);
+   RC   Reap  (PF_IORequest *&pReq, int bWait);
+private:
+   int      ringFd;                           // io_uring file descriptor
+   unsigned numEntries;                       // submission queue entries
+   int      numOutstanding;                   // submitted, not reaped
+
+   // Memory shared with the kernel
+   void     *pSqRing;
+   size_t   sqRingSize;
+   void     *pCqRing;
+   size_t   cqRingSize;
+   void     *pSqes;
+   size_t   sqesSize;
+
+   unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+   unsigned *cqHead, *cqTail, *cqMask;
+   struct io_uring_sqe *sqes;
+   struct io_uring_cqe *cqes;
+};
+
+#endif
@@ -6,13 +6,19 @@
 //
 
 #include <cstdio>
+#include <cerrno>
+#include <algorithm>
+#include <iostream>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include "pf_internal.h"
 #include "pf_buffermgr.h"
 
+using namespace std;
+
 //
 // PF_Manager
 //
@@ -25,6 +31,33 @@ PF_Manager::PF_Manager()
 {
    // Create Buffer Manager
    pBufferMgr = new PF_BufferMgr(PF_BUFFER_SIZE);
+   options = 0;
+   extentSize = PF_EXTENT_SIZE;
+   pHotList = new PF_HotList;
+   pPools = new PF_PoolTable;
+}
+
+//
+// PF_Manager
+//
+// Desc: Constructor - as above, but with a buffer of numBufferPages pages
+//       instead of the default PF_BUFFER_SIZE.  A non-positive size falls
+//       back to the default.
+// In:   numBufferPages - size of the buffer
+//       options - PF_HUGE_PAGES puts the buffer on huge pages (transparent
+//                 ones where none are reserved); PF_DIRECT_IO opens every
+//                 file with O_DIRECT
+//
+PF_Manager::PF_Manager(int numBufferPages, int options)
+{
+   // Create Buffer Manager
+   if (numBufferPages <= 0)
+      numBufferPages = PF_BUFFER_SIZE;
+   pBufferMgr = new PF_BufferMgr(numBufferPages, (options & PF_HUGE_PAGES) != 0);
+   this->options = options;
+   extentSize = PF_EXTENT_SIZE;
+   pHotList = new PF_HotList;
+   pPools = new PF_PoolTable;
 }
 
 //
@@ -38,20 +71,31 @@ PF_Manager::~PF_Manager()
 {
    // Destroy the buffer manager objects
    delete pBufferMgr;
+   for (size_t i = 0; i < pPools->pools.size(); i++)
+      delete pPools->pools[i].pBufferMgr;
+   delete pPools;
+   delete pHotList;
 }
 
 //
 // CreateFile
 //
-// Desc: Create a new PF file named fileName
+// Desc: Create a new PF file named fileName.  Its pages take the
+//       smallest multiple of 4K on disk that holds pageSize bytes and the
+//       page header, so they may hold somewhat more than pageSize.
 // In:   fileName - name of file to create
-// Ret:  PF return code
+//       pageSize - bytes a page must hold, at most PF_MAX_PAGE_SIZE
+// Ret:  PF_BADPARAM for a bad pageSize, or other PF return code
 //
-RC PF_Manager::CreateFile (const char *fileName)
+RC PF_Manager::CreateFile (const char *fileName, int pageSize)
 {
    int fd;		// unix file descriptor
    int numBytes;		// return code form write syscall
 
+   if (pageSize <= 0 || pageSize > PF_MAX_PAGE_SIZE)
+      return (PF_BADPARAM);
+   pageSize = PF_DiskPageSize(pageSize) - sizeof(PF_PageHdr);
+
    // Create file for exclusive use
    if ((fd = open(fileName,
 #ifdef PC
@@ -71,6 +115,7 @@ RC PF_Manager::CreateFile (const char *fileName)
    PF_FileHdr *hdr = (PF_FileHdr*)hdrBuf;
    hdr->firstFree = PF_PAGE_LIST_END;
    hdr->numPages = 0;
+   hdr->pageSize = pageSize;
 
    // Write header to file
    if((numBytes = write(fd, hdrBuf, PF_FILE_HDR_SIZE))
@@ -108,6 +153,13 @@ RC PF_Manager::DestroyFile (const char *fileName)
    if (unlink(fileName) < 0)
       return (PF_UNIX);
 
+   // Its pages are not hot any more
+   vector<PF_HotPage> *lists[] = { &pHotList->pages, &pHotList->pending };
+   for (int i = 0; i < 2; i++)
+      lists[i]->erase(remove_if(lists[i]->begin(), lists[i]->end(),
+            [fileName](const PF_HotPage &hot)
+            { return hot.fileName == fileName; }), lists[i]->end());
+
    // Return ok
    return (0);
 }
@@ -122,14 +174,23 @@ RC PF_Manager::DestroyFile (const char *fileName)
 //       circumstances, crash the PF layer. Note that even if only one instance
 //       of a file is for writing, problems may occur because some writes may
 //       not be seen by a reader of another instance of the file.
+//       With PF_DIRECT_IO, pages are read and written with O_DIRECT, so
+//       they are cached in the buffer pool only.  Not every file system
+//       supports this; OpenFile then fails with PF_UNIX.
+//       With PF_MMAP_READONLY, the whole file is mapped read-only and
+//       its pages never enter the buffer pool.  The file must not be
+//       changed through another handle while the mapping is open.
 // In:   fileName - name of file to open
+//       openFlags - PF_DIRECT_IO, PF_MMAP_READONLY or 0; the
+//                   constructor's PF_DIRECT_IO applies as well
 // Out:  fileHandle - refer to the open file
 //                    this function modifies local var's in fileHandle
 //       to point to the file data in the file table, and to point to the
 //       buffer manager object
 // Ret:  PF_FILEOPEN or other PF return code
 //
-RC PF_Manager::OpenFile (const char *fileName, PF_FileHandle &fileHandle)
+RC PF_Manager::OpenFile (const char *fileName, PF_FileHandle &fileHandle,
+      int openFlags)
 {
    int rc;                   // return code
 
@@ -155,13 +216,83 @@ RC PF_Manager::OpenFile (const char *fileName, PF_FileHandle &fileHandle)
       }
    }
 
+   // Files from before page sizes have PF_PAGE_SIZE pages
+   if (fileHandle.hdr.pageSize == 0)
+      fileHandle.hdr.pageSize = PF_PAGE_SIZE;
+   if (fileHandle.hdr.pageSize < 0 ||
+         fileHandle.hdr.pageSize > PF_MAX_PAGE_SIZE ||
+         PF_DiskPageSize(fileHandle.hdr.pageSize) !=
+         fileHandle.hdr.pageSize + (int)sizeof(PF_PageHdr)) {
+      rc = PF_HDRREAD;
+      goto err;
+   }
+
+   // Map the header and every page the header counts.  A file shorter
+   // than that would fault on access, so it is refused.
+   fileHandle.pMap = NULL;
+   fileHandle.mapSize = 0;
+   if (openFlags & PF_MMAP_READONLY) {
+      struct stat st;
+      size_t mapSize = PF_FILE_HDR_SIZE + (size_t)fileHandle.hdr.numPages *
+         PF_DiskPageSize(fileHandle.hdr.pageSize);
+      if (fstat(fileHandle.unixfd, &st) < 0) {
+         rc = PF_UNIX;
+         goto err;
+      }
+      if ((size_t)st.st_size < mapSize) {
+         rc = PF_INCOMPLETEREAD;
+         goto err;
+      }
+      void *pMap = mmap(NULL, mapSize, PROT_READ, MAP_SHARED,
+            fileHandle.unixfd, 0);
+      if (pMap == MAP_FAILED) {
+         rc = PF_UNIX;
+         goto err;
+      }
+      fileHandle.pMap = (char *)pMap;
+      fileHandle.mapSize = mapSize;
+   }
+
+   // Page I/O bypasses the OS page cache from here on.  The header was
+   // read above, since it is smaller than O_DIRECT transfers must be.
+   // A mapped file does no page I/O of its own.
+   fileHandle.bDirect = !fileHandle.pMap &&
+      ((openFlags | options) & PF_DIRECT_IO) != 0;
+   if (fileHandle.bDirect) {
+      int flags = fcntl(fileHandle.unixfd, F_GETFL);
+      if (flags < 0 || fcntl(fileHandle.unixfd, F_SETFL, flags | O_DIRECT) < 0) {
+         rc = PF_UNIX;
+         goto err;
+      }
+   }
+
    // Set file header to be not changed
    fileHandle.bHdrChanged = FALSE;
 
+   // Space is reserved from the end of the file on
+   fileHandle.extentSize = extentSize;
+   fileHandle.numReserved = fileHandle.hdr.numPages;
+
+   // No pages have been requested yet
+   fileHandle.lastPage = -1;
+   fileHandle.raDir = 0;
+   fileHandle.raNext = 0;
+
+   // Tell the buffer manager of the file's pool how large its pages are
+   fileHandle.pBufferMgr = PoolOf(fileName);
+   fileHandle.pBufferMgr->SetPageSize(fileHandle.unixfd,
+         PF_DiskPageSize(fileHandle.hdr.pageSize));
+
    // Set local variables in file handle object to refer to open file
-   fileHandle.pBufferMgr = pBufferMgr;
    fileHandle.bFileOpen = TRUE;
 
+   // Remember the name for the hot list, and read the file's pages that
+   // were hot before the last restart
+   if ((size_t)fileHandle.unixfd >= pHotList->names.size())
+      pHotList->names.resize(fileHandle.unixfd + 1);
+   pHotList->names[fileHandle.unixfd] = fileName;
+   WarmFile(fileName, fileHandle);
+
    // Return ok
    return 0;
 
@@ -194,11 +325,43 @@ RC PF_Manager::CloseFile(PF_FileHandle &fileHandle)
    if (!fileHandle.bFileOpen)
       return (PF_CLOSEDFILE);
 
+   // The file's pages in the buffer become the most recent hot pages.
+   // Older ones of the file stay behind them, and the oldest pages of
+   // all are dropped once there are more than the buffer holds.
+   if (fileHandle.pMap == NULL) {
+      vector<PageNum> resident;
+      fileHandle.pBufferMgr->GetResidentPages(fileHandle.unixfd, resident);
+      const string &name = pHotList->names[fileHandle.unixfd];
+      vector<PF_HotPage> hot;
+      for (size_t i = 0; i < resident.size(); i++)
+         hot.push_back(PF_HotPage{name, resident[i]});
+      // Sorted so each old entry is looked up in log time
+      vector<PageNum> sorted(resident);
+      sort(sorted.begin(), sorted.end());
+      for (size_t i = 0; i < pHotList->pages.size(); i++) {
+         const PF_HotPage &old = pHotList->pages[i];
+         if (old.fileName != name ||
+               !binary_search(sorted.begin(), sorted.end(), old.pageNum))
+            hot.push_back(old);
+      }
+      if (hot.size() > (size_t)NumBufferPages())
+         hot.resize(NumBufferPages());
+      pHotList->pages.swap(hot);
+   }
+
    // Flush all buffers for this file and write out the header
    if ((rc = fileHandle.FlushPages()))
       return (rc);
 
-   // Close the file
+   // Unmap a read-only file
+   if (fileHandle.pMap != NULL) {
+      if (munmap(fileHandle.pMap, fileHandle.mapSize) < 0)
+         return (PF_UNIX);
+      fileHandle.pMap = NULL;
+   }
+
+   // Close the file; its descriptor may come back for another one
+   fileHandle.pBufferMgr->SetPageSize(fileHandle.unixfd, 0);
    if (close(fileHandle.unixfd) < 0)
       return (PF_UNIX);
    fileHandle.bFileOpen = FALSE;
@@ -210,10 +373,152 @@ RC PF_Manager::CloseFile(PF_FileHandle &fileHandle)
    return 0;
 }
 
+//
+// SaveHotPages
+//
+// Desc: Write the hot list, the pages that were in the buffer when their
+//       files were last closed, most recently loaded first, to a list
+//       file for WarmUp.  Each line holds a page number and a file name.
+//       The list is written under a temporary name and renamed, so a crash
+//       leaves the old list.
+// In:   fileName - name of the list file
+// Ret:  PF_UNIX if the list cannot be written
+//
+RC PF_Manager::SaveHotPages(const char *fileName)
+{
+   string tmpName = string(fileName) + ".tmp";
+   FILE *f = fopen(tmpName.c_str(), "w");
+   if (f == NULL)
+      return (PF_UNIX);
+
+   for (size_t i = 0; i < pHotList->pages.size(); i++)
+      fprintf(f, "%d %s\n", pHotList->pages[i].pageNum,
+            pHotList->pages[i].fileName.c_str());
+
+   if (fclose(f) != 0 || rename(tmpName.c_str(), fileName) < 0) {
+      unlink(tmpName.c_str());
+      return (PF_UNIX);
+   }
+   return (0);
+}
+
+//
+// WarmUp
+//
+// Desc: Read a list written by SaveHotPages and make it the hot list.
+//       The OS is asked to read the pages in the background (posix_fadvise
+//       WILLNEED), file by file in page order, one request per run of
+//       consecutive pages.  A file's pages are then read into the buffer
+//       when the file is opened (see WarmFile).  Files that are gone are
+//       skipped.
+// In:   fileName - name of the list file
+// Ret:  PF_UNIX if the list exists but cannot be read; a missing list
+//       only means a cold start
+//
+RC PF_Manager::WarmUp(const char *fileName)
+{
+   FILE *f = fopen(fileName, "r");
+   if (f == NULL)
+      return (errno == ENOENT) ? 0 : PF_UNIX;
+
+   vector<PF_HotPage> hot;
+   char line[1024];
+   while (fgets(line, sizeof(line), f) != NULL) {
+      char *pName;
+      long pageNum = strtol(line, &pName, 10);
+      if (pName == line || *pName != ' ' || pageNum < 0)
+         continue;
+      pName++;
+      pName[strcspn(pName, "\n")] = '\0';
+      if (*pName != '\0')
+         hot.push_back(PF_HotPage{pName, (PageNum)pageNum});
+   }
+   fclose(f);
+   pHotList->pages = hot;
+   pHotList->pending = hot;
+
+   // Sorted by file and page, each file's runs are consecutive entries
+   sort(hot.begin(), hot.end(), [](const PF_HotPage &a, const PF_HotPage &b)
+         { return a.fileName != b.fileName ? a.fileName < b.fileName
+                                           : a.pageNum < b.pageNum; });
+
+   size_t i = 0;
+   while (i < hot.size()) {
+      size_t end = i;
+      while (end < hot.size() && hot[end].fileName == hot[i].fileName)
+         end++;
+
+      PF_FileHdr hdr;
+      int fd = open(hot[i].fileName.c_str(), O_RDONLY);
+      if (fd >= 0 && read(fd, &hdr, sizeof(hdr)) == sizeof(hdr)) {
+         long size = PF_DiskPageSize(hdr.pageSize ? hdr.pageSize
+                                                  : PF_PAGE_SIZE);
+         size_t run = i;
+         while (run < end) {
+            size_t runEnd = run + 1;
+            while (runEnd < end &&
+                  hot[runEnd].pageNum <= hot[runEnd - 1].pageNum + 1)
+               runEnd++;
+            posix_fadvise(fd, hot[run].pageNum * size + PF_FILE_HDR_SIZE,
+                  (hot[runEnd - 1].pageNum - hot[run].pageNum + 1) * size,
+                  POSIX_FADV_WILLNEED);
+            run = runEnd;
+         }
+      }
+      if (fd >= 0)
+         close(fd);
+      i = end;
+   }
+
+   return (0);
+}
+
+//
+// WarmFile
+//
+// Desc: Internal.  Start reading the pending hot pages of a file that was
+//       just opened into the buffer, in page order and a run of
+//       consecutive pages at a time.  The pages are read like read-ahead,
+//       in the background if the I/O backend is asynchronous.  A mapped
+//       file has no pages in the buffer and is skipped.
+// In:   fileName - name the file was opened with
+//       fileHandle - the open file
+//
+void PF_Manager::WarmFile(const char *fileName, PF_FileHandle &fileHandle)
+{
+   vector<PageNum> pages;
+   vector<PF_HotPage> &pending = pHotList->pending;
+   // the pages of other files close up behind in the same pass
+   size_t kept = 0;
+   for (size_t i = 0; i < pending.size(); i++)
+      if (pending[i].fileName == fileName) {
+         if (pending[i].pageNum < fileHandle.hdr.numPages)
+            pages.push_back(pending[i].pageNum);
+      }
+      else
+         pending[kept++] = pending[i];
+   pending.resize(kept);
+   if (pages.empty() || fileHandle.pMap != NULL)
+      return;
+
+   sort(pages.begin(), pages.end());
+   size_t run = 0;
+   while (run < pages.size()) {
+      size_t end = run + 1;
+      while (end < pages.size() && (int)(end - run) < PF_MAX_READAHEAD &&
+            pages[end] == pages[end - 1] + 1)
+         end++;
+      if (fileHandle.pBufferMgr->ReadAhead(fileHandle.unixfd, pages[run],
+            end - run))
+         return;
+      run = end;
+   }
+}
+
 //
 // ClearBuffer
 //
-// Desc: Remove all entries from the buffer manager.
+// Desc: Remove all entries from the buffer manager, in every pool.
 //       This routine will be called via the system command and is only
 //       really useful if the user wants to run some performance
 //       comparison starting with an clean buffer.
@@ -224,7 +529,10 @@ RC PF_Manager::CloseFile(PF_FileHandle &fileHandle)
 //
 RC PF_Manager::ClearBuffer()
 {
-   return pBufferMgr->ClearBuffer();
+   RC rc = pBufferMgr->ClearBuffer();
+   for (size_t i = 0; rc == 0 && i < pPools->pools.size(); i++)
+      rc = pPools->pools[i].pBufferMgr->ClearBuffer();
+   return (rc);
 }
 
 //
@@ -239,7 +547,12 @@ RC PF_Manager::ClearBuffer()
 //
 RC PF_Manager::PrintBuffer()
 {
-   return pBufferMgr->PrintBuffer();
+   RC rc = pBufferMgr->PrintBuffer();
+   for (size_t i = 0; rc == 0 && i < pPools->pools.size(); i++) {
+      cout << "\nPool " << pPools->pools[i].name << ":\n";
+      rc = pPools->pools[i].pBufferMgr->PrintBuffer();
+   }
+   return (rc);
 }
 
 //
@@ -258,6 +571,206 @@ RC PF_Manager::ResizeBuffer(int iNewSize)
    return pBufferMgr->ResizeBuffer(iNewSize);
 }
 
+//
+// SetReplacementPolicy
+//
+// Desc: Selects the page replacement policy of the buffer manager.
+//       This routine will be called via the set command.
+// In:   policyName - "lru", "clock", "2q" or "lruk"
+// Ret:  Returns the result of PF_BufferMgr::SetReplacementPolicy,
+//       PF_BADPARAM for an unknown policy.
+//
+RC PF_Manager::SetReplacementPolicy(const char *policyName)
+{
+   RC rc = pBufferMgr->SetReplacementPolicy(policyName);
+   for (size_t i = 0; rc == 0 && i < pPools->pools.size(); i++)
+      rc = pPools->pools[i].pBufferMgr->SetReplacementPolicy(policyName);
+   if (rc == 0)
+      pPools->policy = policyName;
+   return (rc);
+}
+
+//
+// SetReadAhead
+//
+// Desc: Sets how many pages are read ahead when a file handle walks the
+//       pages of a file in order.
+//       This routine will be called via the set command.
+// In:   numPages - read-ahead window, 0 turns read-ahead off
+// Ret:  Returns the result of PF_BufferMgr::SetReadAhead, PF_BADPARAM
+//       for a window below 0 or above PF_MAX_READAHEAD.
+//
+RC PF_Manager::SetReadAhead(int numPages)
+{
+   RC rc = pBufferMgr->SetReadAhead(numPages);
+   for (size_t i = 0; rc == 0 && i < pPools->pools.size(); i++)
+      rc = pPools->pools[i].pBufferMgr->SetReadAhead(numPages);
+   if (rc == 0)
+      pPools->readAhead = numPages;
+   return (rc);
+}
+
+//
+// SetIOBackend
+//
+// Desc: Selects how the buffer manager does read-ahead, prefetches and
+//       write-back: "sync" does them in place, "threads" on a pool of I/O
+//       threads and "uring" through io_uring, which falls back to the
+//       threads where the kernel does not allow it.
+//       This routine will be called via the set command.
+// In:   backendName - "sync", "threads" or "uring"
+// Ret:  Returns the result of PF_BufferMgr::SetIOBackend, PF_BADPARAM
+//       for an unknown backend.
+//
+RC PF_Manager::SetIOBackend(const char *backendName)
+{
+   RC rc = pBufferMgr->SetIOBackend(backendName);
+   for (size_t i = 0; rc == 0 && i < pPools->pools.size(); i++)
+      rc = pPools->pools[i].pBufferMgr->SetIOBackend(backendName);
+   if (rc == 0)
+      pPools->backend = backendName;
+   return (rc);
+}
+
+//
+// SetCleaner
+//
+// Desc: Turns the background page cleaner on or off.  While it is on, it
+//       writes dirty pages back whenever more than highPercent of the
+//       buffer is dirty, until no more than lowPercent is.
+//       This routine will be called via the set command.
+// In:   highPercent - high watermark, 0 turns the cleaner off
+//       lowPercent - low watermark
+// Ret:  Returns the result of PF_BufferMgr::SetCleaner, PF_BADPARAM for
+//       watermarks out of order or above 100.
+//
+RC PF_Manager::SetCleaner(int highPercent, int lowPercent)
+{
+   RC rc = pBufferMgr->SetCleaner(highPercent, lowPercent);
+   for (size_t i = 0; rc == 0 && i < pPools->pools.size(); i++)
+      rc = pPools->pools[i].pBufferMgr->SetCleaner(highPercent, lowPercent);
+   if (rc == 0) {
+      pPools->cleanHigh = highPercent;
+      pPools->cleanLow = lowPercent;
+   }
+   return (rc);
+}
+
+//
+// SetExtentSize
+//
+// Desc: Sets how many pages at a time files grow by.  Disk space for a
+//       whole extent is reserved when a page is allocated past the end of
+//       the space already reserved.  Files that are already open keep the
+//       extent size they were opened with.
+//       This routine will be called via the set command.
+// In:   numPages - pages per extent, 0 to reserve no space ahead
+// Ret:  PF_BADPARAM for a negative size, 0 otherwise
+//
+RC PF_Manager::SetExtentSize(int numPages)
+{
+   if (numPages < 0)
+      return (PF_BADPARAM);
+   extentSize = numPages;
+   return (0);
+}
+
+//
+// CreatePool
+//
+// Desc: Add a named buffer pool of numPages pages, or resize the pool of
+//       that name.  Files assigned to the pool with AssignPool compete
+//       only with each other for its pages, so a few small, hot files can
+//       be kept apart from large scans.  The pool starts out with the
+//       replacement policy, read-ahead window, I/O backend and cleaner of
+//       the other pools.
+//       This routine will be called via the set command.
+// In:   poolName - name of the pool
+//       numPages - size of the pool
+// Ret:  PF_BADPARAM for an empty name or a size below 1, PF_TOOSMALL if
+//       the pool is resized below its pinned pages, or other PF return code
+//
+RC PF_Manager::CreatePool(const char *poolName, int numPages)
+{
+   if (poolName == NULL || *poolName == '\0' || numPages <= 0)
+      return (PF_BADPARAM);
+
+   for (size_t i = 0; i < pPools->pools.size(); i++)
+      if (pPools->pools[i].name == poolName)
+         return pPools->pools[i].pBufferMgr->ResizeBuffer(numPages);
+
+   PF_Pool pool;
+   pool.name = poolName;
+   pool.pBufferMgr = new PF_BufferMgr(numPages,
+         (options & PF_HUGE_PAGES) != 0);
+   pool.pBufferMgr->SetReplacementPolicy(pPools->policy.c_str());
+   pool.pBufferMgr->SetReadAhead(pPools->readAhead);
+   pool.pBufferMgr->SetIOBackend(pPools->backend.c_str());
+   pool.pBufferMgr->SetCleaner(pPools->cleanHigh, pPools->cleanLow);
+   pPools->pools.push_back(pool);
+   return (0);
+}
+
+//
+// AssignPool
+//
+// Desc: Have a file buffered in a named pool.  The file uses the pool
+//       from the next time it is opened.
+//       This routine will be called via the set command.
+// In:   fileName - name the file is opened with
+//       poolName - pool made with CreatePool; NULL or "" for the default
+//                  pool
+// Ret:  PF_BADPARAM if there is no such pool
+//
+RC PF_Manager::AssignPool(const char *fileName, const char *poolName)
+{
+   if (fileName == NULL)
+      return (PF_BADPARAM);
+
+   if (poolName == NULL || *poolName == '\0') {
+      pPools->assigned.erase(fileName);
+      return (0);
+   }
+
+   for (size_t i = 0; i < pPools->pools.size(); i++)
+      if (pPools->pools[i].name == poolName) {
+         pPools->assigned[fileName] = poolName;
+         return (0);
+      }
+   return (PF_BADPARAM);
+}
+
+//
+// PoolOf
+//
+// Desc: Internal.  The buffer pool of a file
+// In:   fileName - name the file is opened with
+// Ret:  buffer manager of the pool the file is assigned to, or the
+//       default one
+//
+PF_BufferMgr *PF_Manager::PoolOf(const char *fileName) const
+{
+   map<string, string>::const_iterator it = pPools->assigned.find(fileName);
+   if (it != pPools->assigned.end())
+      for (size_t i = 0; i < pPools->pools.size(); i++)
+         if (pPools->pools[i].name == it->second)
+            return pPools->pools[i].pBufferMgr;
+   return pBufferMgr;
+}
+
+//
+// NumBufferPages
+//
+// Desc: Internal.  Pages in all the buffer pools together
+//
+int PF_Manager::NumBufferPages() const
+{
+   int numPages = pBufferMgr->GetNumPages();
+   for (size_t i = 0; i < pPools->pools.size(); i++)
+      numPages += pPools->pools[i].pBufferMgr->GetNumPages();
+   return (numPages);
+}
+
 //------------------------------------------------------------------------------
 // Three Methods for manipulating raw memory buffers.  These memory
 // locations are handled by the buffer manager, but are not
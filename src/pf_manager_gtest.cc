@@ -1,7 +1,16 @@
+#include <sys/stat.h>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <unistd.h>
 #include "pf_internal.h"
 #include "pf.h"
+#include "statistics.h"
 #include "gtest/gtest.h"
 
+// defined in pf_buffermgr.cc
+extern StatisticsMgr *pStatisticsMgr;
+
 
 class PF_ManagerTest : public ::testing::Test {
 protected:
@@ -57,6 +66,760 @@ TEST_F(PF_ManagerTest, Header) {
 
 }
 
+TEST_F(PF_ManagerTest, ResizeBuffer) {
+	PF_PageHandle ph;
+	char * pData;
+	PageNum pinned;
+
+	// fill more pages than the default buffer holds
+	for (int i = 0; i < 100; i++) {
+		ASSERT_EQ(0, fh.AllocatePage(ph));
+		ph.GetData(pData);
+		ph.GetPageNum(pinned);
+		memcpy(pData, &i, sizeof(i));
+		ASSERT_EQ(0, fh.MarkDirty(pinned));
+		if (i != 42) {
+			ASSERT_EQ(0, fh.UnpinPage(pinned));
+		}
+	}
+
+	// page 42 stays pinned - its memory must survive the resize
+	ASSERT_EQ(0, fh.GetThisPage(42, ph));
+	ASSERT_EQ(0, fh.UnpinPage(42));
+	ph.GetData(pData);
+
+	ASSERT_EQ(PF_TOOSMALL, pfm.ResizeBuffer(0));
+	ASSERT_EQ(0, pfm.ResizeBuffer(1));
+	ASSERT_EQ(PF_NOBUF, fh.GetThisPage(0, ph));
+	ASSERT_EQ(0, pfm.ResizeBuffer(100000));
+	ASSERT_EQ(42, *(int*)pData);
+	ASSERT_EQ(0, fh.UnpinPage(42));
+
+	for (int i = 0; i < 100; i++) {
+		ASSERT_EQ(0, fh.GetThisPage(i, ph));
+		ph.GetData(pData);
+		ASSERT_EQ(i, *(int*)pData);
+		ASSERT_EQ(0, fh.UnpinPage(i));
+	}
+
+	// resizing again gives up the frame page 42 still had in an old arena
+	ASSERT_EQ(0, fh.GetThisPage(7, ph));
+	ASSERT_EQ(0, pfm.ResizeBuffer(50));
+	ASSERT_EQ(0, fh.UnpinPage(7));
+	ASSERT_EQ(0, pfm.ResizeBuffer(60));
+	for (int i = 0; i < 100; i++) {
+		ASSERT_EQ(0, fh.GetThisPage(i, ph));
+		ph.GetData(pData);
+		ASSERT_EQ(i, *(int*)pData);
+		ASSERT_EQ(0, fh.UnpinPage(i));
+	}
+	ASSERT_EQ(0, pfm.CloseFile(fh));
+}
+
+TEST_F(PF_ManagerTest, ReplacementPolicy) {
+	PF_PageHandle ph;
+	char * pData;
+	PageNum pageNum;
+	const char * policies[] = { "clock", "2q", "lruk", "LRU" };
+
+	ASSERT_EQ(PF_BADPARAM, pfm.SetReplacementPolicy("mru"));
+	ASSERT_EQ(0, pfm.ResizeBuffer(10));
+
+	for (int i = 0; i < 100; i++) {
+		ASSERT_EQ(0, fh.AllocatePage(ph));
+		ph.GetData(pData);
+		ph.GetPageNum(pageNum);
+		memcpy(pData, &i, sizeof(i));
+		ASSERT_EQ(0, fh.MarkDirty(pageNum));
+		ASSERT_EQ(0, fh.UnpinPage(pageNum));
+	}
+
+	for (int p = 0; p < 4; p++) {
+		// switch with page 0 pinned, then scan twice while re-reading a
+		// hot page so every policy has to evict
+		ASSERT_EQ(0, fh.GetThisPage(0, ph));
+		ASSERT_EQ(0, pfm.SetReplacementPolicy(policies[p]));
+		for (int pass = 0; pass < 2; pass++) {
+			for (int i = 1; i < 100; i++) {
+				ASSERT_EQ(0, fh.GetThisPage(i, ph));
+				ph.GetData(pData);
+				ASSERT_EQ(i, *(int*)pData);
+				ASSERT_EQ(0, fh.UnpinPage(i));
+				if (i % 5 == 0) {
+					ASSERT_EQ(0, fh.GetThisPage(1, ph));
+					ASSERT_EQ(0, fh.UnpinPage(1));
+				}
+			}
+		}
+		ASSERT_EQ(0, fh.UnpinPage(0));
+
+		// with every slot pinned there is no victim
+		for (int i = 0; i < 10; i++)
+			ASSERT_EQ(0, fh.GetThisPage(i, ph));
+		ASSERT_EQ(PF_NOBUF, fh.GetThisPage(50, ph));
+		for (int i = 0; i < 10; i++)
+			ASSERT_EQ(0, fh.UnpinPage(i));
+	}
+	ASSERT_EQ(0, pfm.PrintBuffer());
+	ASSERT_EQ(0, pfm.CloseFile(fh));
+}
+
+TEST_F(PF_ManagerTest, BufferRing) {
+	PF_PageHandle ph;
+	char * pData;
+	PageNum pageNum;
+	int ring, rings[PF_MAX_RINGS];
+
+	// count frames without read-ahead in the way
+	ASSERT_EQ(0, pfm.SetReadAhead(0));
+	ASSERT_EQ(0, pfm.ResizeBuffer(20));
+	for (int i = 0; i < 100; i++) {
+		ASSERT_EQ(0, fh.AllocatePage(ph));
+		ph.GetData(pData);
+		ph.GetPageNum(pageNum);
+		memcpy(pData, &i, sizeof(i));
+		ASSERT_EQ(0, fh.MarkDirty(pageNum));
+		ASSERT_EQ(0, fh.UnpinPage(pageNum));
+	}
+
+	// bring the hot pages 0..9 into an otherwise empty buffer pool
+	ASSERT_EQ(0, fh.FlushPages());
+	for (int i = 0; i < 10; i++) {
+		ASSERT_EQ(0, fh.GetThisPage(i, ph));
+		ASSERT_EQ(0, fh.UnpinPage(i));
+	}
+
+	// scan the rest through a ring of 4 frames, modifying a few pages
+	ASSERT_EQ(0, fh.OpenRing(ring, 4));
+	ASSERT_NE(PF_NO_RING, ring);
+	for (int i = 10; i < 100; i++) {
+		ASSERT_EQ(0, fh.GetThisPage(i, ph, ring));
+		ph.GetData(pData);
+		ASSERT_EQ(i, *(int*)pData);
+		if (i % 10 == 0) {
+			*(int*)pData = -i;
+			ASSERT_EQ(0, fh.MarkDirty(i));
+		}
+		ASSERT_EQ(0, fh.UnpinPage(i));
+	}
+
+	// the hot pages are still in the buffer
+	int *piBefore = pStatisticsMgr->Get(PF_READPAGE);
+	for (int i = 0; i < 10; i++) {
+		ASSERT_EQ(0, fh.GetThisPage(i, ph));
+		ASSERT_EQ(0, fh.UnpinPage(i));
+	}
+	int *piAfter = pStatisticsMgr->Get(PF_READPAGE);
+	ASSERT_EQ(*piBefore, *piAfter);
+	delete piBefore;
+	delete piAfter;
+
+	char psKey[32];
+	sprintf(psKey, "%s%d", PF_RINGREUSE, ring);
+	int *piReused = pStatisticsMgr->Get(psKey);
+	ASSERT_TRUE(piReused != NULL);
+	ASSERT_EQ(90 - 4, *piReused);
+	delete piReused;
+	ASSERT_EQ(0, fh.CloseRing(ring));
+	ASSERT_EQ(PF_BADPARAM, fh.CloseRing(ring));
+
+	// pages written by the ring made it to disk
+	ASSERT_EQ(0, fh.FlushPages());
+	for (int i = 10; i < 100; i++) {
+		ASSERT_EQ(0, fh.GetThisPage(i, ph));
+		ph.GetData(pData);
+		ASSERT_EQ(i % 10 == 0 ? -i : i, *(int*)pData);
+		ASSERT_EQ(0, fh.UnpinPage(i));
+	}
+
+	// once all rings are taken a scan reads through the buffer pool
+	for (int i = 0; i < PF_MAX_RINGS; i++)
+		ASSERT_EQ(0, fh.OpenRing(rings[i]));
+	ASSERT_EQ(0, fh.OpenRing(ring));
+	ASSERT_EQ(PF_NO_RING, ring);
+	for (int i = 0; i < PF_MAX_RINGS; i++)
+		ASSERT_EQ(0, fh.CloseRing(rings[i]));
+
+	ASSERT_EQ(0, pfm.CloseFile(fh));
+}
+
+TEST_F(PF_ManagerTest, ReadAhead) {
+	PF_PageHandle ph;
+	char * pData;
+	PageNum pageNum;
+
+	ASSERT_EQ(PF_BADPARAM, pfm.SetReadAhead(-1));
+	ASSERT_EQ(PF_BADPARAM, pfm.SetReadAhead(PF_MAX_READAHEAD + 1));
+
+	for (int i = 0; i < 100; i++) {
+		ASSERT_EQ(0, fh.AllocatePage(ph));
+		ph.GetData(pData);
+		ph.GetPageNum(pageNum);
+		memcpy(pData, &i, sizeof(i));
+		ASSERT_EQ(0, fh.MarkDirty(pageNum));
+		ASSERT_EQ(0, fh.UnpinPage(pageNum));
+	}
+
+	// walk forward, then backward, with and without read-ahead
+	int windows[] = { 0, 8 };
+	for (int w = 0; w < 2; w++) {
+		ASSERT_EQ(0, pfm.SetReadAhead(windows[w]));
+		for (int dir = 0; dir < 2; dir++) {
+			ASSERT_EQ(0, fh.FlushPages());
+			int zero = 0;
+			pStatisticsMgr->Register(PF_READPAGE, STAT_SETVALUE, &zero);
+			RC rc = dir == 0 ? fh.GetFirstPage(ph) : fh.GetLastPage(ph);
+			int n = 0;
+			while (rc == 0) {
+				ph.GetData(pData);
+				ph.GetPageNum(pageNum);
+				ASSERT_EQ(pageNum, *(int*)pData);
+				ASSERT_EQ(0, fh.UnpinPage(pageNum));
+				n++;
+				rc = dir == 0 ? fh.GetNextPage(pageNum, ph)
+				              : fh.GetPrevPage(pageNum, ph);
+			}
+			ASSERT_EQ(PF_EOF, rc);
+			ASSERT_EQ(100, n);
+
+			int *piRP = pStatisticsMgr->Get(PF_READPAGE);
+			if (windows[w] == 0)
+				ASSERT_EQ(100, *piRP);
+			else
+				ASSERT_GT(100 / 4, *piRP);
+			delete piRP;
+		}
+	}
+	ASSERT_EQ(0, pfm.CloseFile(fh));
+}
+
+TEST_F(PF_ManagerTest, CoalescedWriteBack) {
+	PF_PageHandle ph;
+	char * pData;
+	PageNum pageNum;
+
+	// 30 dirty pages fit into the buffer, allocated in MRU order
+	for (int i = 0; i < 30; i++) {
+		ASSERT_EQ(0, fh.AllocatePage(ph));
+		ph.GetData(pData);
+		ph.GetPageNum(pageNum);
+		memcpy(pData, &i, sizeof(i));
+		ASSERT_EQ(0, fh.MarkDirty(pageNum));
+		ASSERT_EQ(0, fh.UnpinPage(pageNum));
+	}
+
+	int zero = 0;
+	pStatisticsMgr->Register(PF_WRITEPAGE, STAT_SETVALUE, &zero);
+	pStatisticsMgr->Register(PF_WRITESAVED, STAT_SETVALUE, &zero);
+
+	// page 10 is written on its own, which leaves two runs
+	ASSERT_EQ(0, fh.ForcePages(10));
+	ASSERT_EQ(0, fh.FlushPages());
+	int *piWP = pStatisticsMgr->Get(PF_WRITEPAGE);
+	int *piWS = pStatisticsMgr->Get(PF_WRITESAVED);
+	ASSERT_EQ(3, *piWP);
+	ASSERT_EQ(29 - 2, *piWS);
+	delete piWP;
+	delete piWS;
+
+	for (int i = 0; i < 30; i++) {
+		ASSERT_EQ(0, fh.GetThisPage(i, ph));
+		ph.GetData(pData);
+		ASSERT_EQ(i, *(int*)pData);
+		ASSERT_EQ(0, fh.UnpinPage(i));
+	}
+	ASSERT_EQ(0, pfm.CloseFile(fh));
+}
+
+TEST_F(PF_ManagerTest, PageCleaner) {
+	PF_PageHandle ph;
+	char * pData;
+	PageNum pageNum;
+
+	ASSERT_EQ(PF_BADPARAM, pfm.SetCleaner(10, 20));
+	ASSERT_EQ(PF_BADPARAM, pfm.SetCleaner(101, 20));
+	ASSERT_EQ(PF_BADPARAM, pfm.SetCleaner(20, -1));
+	ASSERT_EQ(0, pfm.SetCleaner(25, 10));
+
+	int zero = 0;
+	pStatisticsMgr->Register(PF_CLEANERWRITE, STAT_SETVALUE, &zero);
+
+	// 200 dirty pages through a 40 page buffer
+	for (int i = 0; i < 200; i++) {
+		ASSERT_EQ(0, fh.AllocatePage(ph));
+		ph.GetData(pData);
+		ph.GetPageNum(pageNum);
+		memcpy(pData, &i, sizeof(i));
+		ASSERT_EQ(0, fh.MarkDirty(pageNum));
+		ASSERT_EQ(0, fh.UnpinPage(pageNum));
+	}
+	int *piCW = pStatisticsMgr->Get(PF_CLEANERWRITE);
+	ASSERT_TRUE(piCW != NULL);
+	ASSERT_LT(0, *piCW);
+	delete piCW;
+
+	ASSERT_EQ(0, pfm.SetCleaner(0, 0));
+	ASSERT_EQ(0, fh.FlushPages());
+	for (int i = 0; i < 200; i++) {
+		ASSERT_EQ(0, fh.GetThisPage(i, ph));
+		ph.GetData(pData);
+		ASSERT_EQ(i, *(int*)pData);
+		ASSERT_EQ(0, fh.UnpinPage(i));
+	}
+	ASSERT_EQ(0, pfm.CloseFile(fh));
+}
+
+TEST_F(PF_ManagerTest, IOBackend) {
+	PF_PageHandle ph;
+	char * pData;
+	PageNum pageNum;
+
+	ASSERT_EQ(PF_BADPARAM, pfm.SetIOBackend("aio"));
+
+	// the buffer holds 40 pages, so writing 200 evicts dirty pages
+	// throughout, and each backend rewrites all of them
+	const char *backends[] = { "sync", "threads", "uring" };
+	for (int b = 0; b < 3; b++) {
+		ASSERT_EQ(0, pfm.SetIOBackend(backends[b]));
+		for (int i = 0; i < 200; i++) {
+			if (b == 0) {
+				ASSERT_EQ(0, fh.AllocatePage(ph));
+			} else {
+				ASSERT_EQ(0, fh.GetThisPage(i, ph));
+			}
+			ph.GetData(pData);
+			ph.GetPageNum(pageNum);
+			int v = pageNum * 10 + b;
+			memcpy(pData, &v, sizeof(v));
+			ASSERT_EQ(0, fh.MarkDirty(pageNum));
+			ASSERT_EQ(0, fh.UnpinPage(pageNum));
+		}
+
+		// prefetch some pages, then read everything back with read-ahead
+		ASSERT_EQ(0, fh.FlushPages());
+		for (int i = 150; i < 200; i += 7)
+			ASSERT_EQ(0, fh.PrefetchPage(i));
+		ASSERT_EQ(PF_INVALIDPAGE, fh.PrefetchPage(200));
+		RC rc = fh.GetFirstPage(ph);
+		int n = 0;
+		while (rc == 0) {
+			ph.GetData(pData);
+			ph.GetPageNum(pageNum);
+			ASSERT_EQ(pageNum * 10 + b, *(int*)pData);
+			ASSERT_EQ(0, fh.UnpinPage(pageNum));
+			n++;
+			rc = fh.GetNextPage(pageNum, ph);
+		}
+		ASSERT_EQ(PF_EOF, rc);
+		ASSERT_EQ(200, n);
+	}
+	ASSERT_EQ(0, pfm.CloseFile(fh));
+}
+
+TEST_F(PF_ManagerTest, DirectIO) {
+	PF_PageHandle ph;
+	PF_FileHandle fh2;
+	char *pData;
+	PageNum pageNum;
+	ASSERT_EQ(0, pfm.CloseFile(fh));
+
+	// write more pages than the buffer holds, so most go out O_DIRECT
+	ASSERT_EQ(0, pfm.OpenFile("pftestfile", fh2, PF_DIRECT_IO));
+	for (int i = 0; i < 100; i++) {
+		ASSERT_EQ(0, fh2.AllocatePage(ph));
+		ph.GetData(pData);
+		ph.GetPageNum(pageNum);
+		// frames are page aligned, as O_DIRECT needs
+		ASSERT_EQ(0, (long)(pData - sizeof(PF_PageHdr)) % PF_FILE_HDR_SIZE);
+		memset(pData, 'a' + i % 26, PF_PAGE_SIZE);
+		ASSERT_EQ(0, fh2.MarkDirty(pageNum));
+		ASSERT_EQ(0, fh2.UnpinPage(pageNum));
+	}
+	ASSERT_EQ(0, pfm.CloseFile(fh2));
+
+	// read back through the page cache
+	ASSERT_EQ(0, pfm.ClearBuffer());
+	ASSERT_EQ(0, pfm.OpenFile("pftestfile", fh));
+	for (int i = 0; i < 100; i++) {
+		ASSERT_EQ(0, fh.GetThisPage(i, ph));
+		ph.GetData(pData);
+		ASSERT_EQ('a' + i % 26, pData[0]);
+		ASSERT_EQ('a' + i % 26, pData[PF_PAGE_SIZE - 1]);
+		ASSERT_EQ(0, fh.UnpinPage(i));
+	}
+	ASSERT_EQ(0, pfm.CloseFile(fh));
+}
+
+TEST_F(PF_ManagerTest, MmapReadOnly) {
+	PF_PageHandle ph;
+	PF_FileHandle fh2;
+	char *pData;
+	PageNum pageNum;
+
+	for (int i = 0; i < 20; i++) {
+		ASSERT_EQ(0, fh.AllocatePage(ph));
+		ph.GetData(pData);
+		ph.GetPageNum(pageNum);
+		memcpy(pData, &i, sizeof(i));
+		ASSERT_EQ(0, fh.MarkDirty(pageNum));
+		ASSERT_EQ(0, fh.UnpinPage(pageNum));
+	}
+	ASSERT_EQ(0, fh.DisposePage(7));
+	ASSERT_EQ(0, pfm.CloseFile(fh));
+
+	// pages come straight from the mapping and skip the disposed one
+	ASSERT_EQ(0, pfm.OpenFile("pftestfile", fh2, PF_MMAP_READONLY));
+	ASSERT_TRUE(fh2.IsReadOnly());
+	RC rc = fh2.GetFirstPage(ph);
+	int n = 0;
+	while (rc == 0) {
+		ph.GetData(pData);
+		ph.GetPageNum(pageNum);
+		ASSERT_EQ(pageNum, *(int*)pData);
+		ASSERT_NE(7, pageNum);
+		ASSERT_EQ(0, fh2.UnpinPage(pageNum));
+		n++;
+		rc = fh2.GetNextPage(pageNum, ph);
+	}
+	ASSERT_EQ(PF_EOF, rc);
+	ASSERT_EQ(19, n);
+	ASSERT_EQ(PF_INVALIDPAGE, fh2.GetThisPage(7, ph));
+	ASSERT_EQ(0, fh2.PrefetchPage(12));
+
+	// nothing can change the file
+	ASSERT_EQ(PF_READONLY, fh2.AllocatePage(ph));
+	ASSERT_EQ(PF_READONLY, fh2.MarkDirty(3));
+	ASSERT_EQ(PF_READONLY, fh2.DisposePage(3));
+	ASSERT_EQ(0, pfm.CloseFile(fh2));
+}
+
+TEST_F(PF_ManagerTest, PageSize) {
+	PF_PageHandle ph;
+	PF_FileHandle fh2;
+	char *pData;
+	PageNum pageNum;
+
+	// sizes are rounded up to whole disk blocks
+	ASSERT_EQ(PF_PAGE_SIZE, fh.GetPageSize());
+	ASSERT_EQ(PF_BADPARAM, pfm.CreateFile("pftestbig", PF_MAX_PAGE_SIZE + 1));
+	ASSERT_EQ(0, pfm.CreateFile("pftestbig", 3 * 4096));
+	ASSERT_EQ(0, pfm.OpenFile("pftestbig", fh2));
+	ASSERT_EQ(4 * 4096 - (int)sizeof(int), fh2.GetPageSize());
+	ASSERT_EQ(0, pfm.CloseFile(fh2));
+	ASSERT_EQ(0, pfm.DestroyFile("pftestbig"));
+
+	// interleave large and default pages through a buffer too small for
+	// either file so frames keep changing size
+	ASSERT_EQ(0, pfm.CreateFile("pftestbig", PF_MAX_PAGE_SIZE));
+	ASSERT_EQ(0, pfm.OpenFile("pftestbig", fh2));
+	ASSERT_EQ(PF_MAX_PAGE_SIZE, fh2.GetPageSize());
+	for (int i = 0; i < 2 * PF_BUFFER_SIZE; i++) {
+		ASSERT_EQ(0, fh2.AllocatePage(ph));
+		ph.GetData(pData);
+		ph.GetPageNum(pageNum);
+		memset(pData, 'a' + i % 26, PF_MAX_PAGE_SIZE);
+		ASSERT_EQ(0, fh2.MarkDirty(pageNum));
+		ASSERT_EQ(0, fh2.UnpinPage(pageNum));
+
+		ASSERT_EQ(0, fh.AllocatePage(ph));
+		ph.GetData(pData);
+		ph.GetPageNum(pageNum);
+		memset(pData, 'A' + i % 26, PF_PAGE_SIZE);
+		ASSERT_EQ(0, fh.MarkDirty(pageNum));
+		ASSERT_EQ(0, fh.UnpinPage(pageNum));
+	}
+	ASSERT_EQ(0, pfm.CloseFile(fh2));
+	ASSERT_EQ(0, pfm.CloseFile(fh));
+
+	ASSERT_EQ(0, pfm.OpenFile("pftestbig", fh2));
+	ASSERT_EQ(0, pfm.OpenFile("pftestfile", fh));
+	ASSERT_EQ(PF_MAX_PAGE_SIZE, fh2.GetPageSize());
+	for (int i = 0; i < 2 * PF_BUFFER_SIZE; i++) {
+		ASSERT_EQ(0, fh2.GetThisPage(i, ph));
+		ph.GetData(pData);
+		ASSERT_EQ('a' + i % 26, pData[0]);
+		ASSERT_EQ('a' + i % 26, pData[PF_MAX_PAGE_SIZE - 1]);
+		ASSERT_EQ(0, fh2.UnpinPage(i));
+
+		ASSERT_EQ(0, fh.GetThisPage(i, ph));
+		ph.GetData(pData);
+		ASSERT_EQ('A' + i % 26, pData[0]);
+		ASSERT_EQ('A' + i % 26, pData[PF_PAGE_SIZE - 1]);
+		ASSERT_EQ(0, fh.UnpinPage(i));
+	}
+	ASSERT_EQ(0, pfm.CloseFile(fh2));
+	ASSERT_EQ(0, pfm.DestroyFile("pftestbig"));
+}
+
+TEST_F(PF_ManagerTest, AllocatePages) {
+	PF_PageHandle ph;
+	char *pData;
+	PageNum pageNum, first;
+	struct stat st;
+
+	ASSERT_EQ(0, fh.AllocatePage(ph));
+	ph.GetPageNum(pageNum);
+	ASSERT_EQ(0, fh.UnpinPage(pageNum));
+	ASSERT_EQ(0, fh.DisposePage(pageNum));
+	ASSERT_EQ(PF_BADPARAM, fh.AllocatePages(0, first));
+
+	// the disposed page is skipped so the new ones are adjacent
+	ASSERT_EQ(0, fh.AllocatePages(3 * PF_BUFFER_SIZE, first));
+	ASSERT_EQ(1, first);
+
+	// space for all of them is reserved before any is written
+	ASSERT_EQ(0, stat("pftestfile", &st));
+	ASSERT_GE((long)st.st_blocks * 512,
+	          (long)(3 * PF_BUFFER_SIZE + 1) * 4096);
+
+	for (int i = first; i < first + 3 * PF_BUFFER_SIZE; i++) {
+		ASSERT_EQ(0, fh.GetThisPage(i, ph));
+		ph.GetData(pData);
+		ASSERT_EQ(0, pData[0]);
+		memcpy(pData, &i, sizeof(i));
+		ASSERT_EQ(0, fh.MarkDirty(i));
+		ASSERT_EQ(0, fh.UnpinPage(i));
+	}
+	ASSERT_EQ(0, pfm.CloseFile(fh));
+
+	// the disposed page is still there to be reused
+	ASSERT_EQ(0, pfm.SetExtentSize(0));
+	ASSERT_EQ(0, pfm.OpenFile("pftestfile", fh));
+	ASSERT_EQ(0, fh.AllocatePage(ph));
+	ph.GetPageNum(pageNum);
+	ASSERT_EQ(0, pageNum);
+	ASSERT_EQ(0, fh.UnpinPage(pageNum));
+	for (int i = first; i < first + 3 * PF_BUFFER_SIZE; i++) {
+		ASSERT_EQ(0, fh.GetThisPage(i, ph));
+		ph.GetData(pData);
+		ASSERT_EQ(i, *(int*)pData);
+		ASSERT_EQ(0, fh.UnpinPage(i));
+	}
+	ASSERT_EQ(PF_BADPARAM, pfm.SetExtentSize(-1));
+}
+
+TEST_F(PF_ManagerTest, Truncate) {
+	PF_PageHandle ph;
+	char *pData;
+	PageNum pageNum;
+	struct stat st;
+
+	for (int i = 0; i < 20; i++) {
+		ASSERT_EQ(0, fh.AllocatePage(ph));
+		ph.GetData(pData);
+		memcpy(pData, &i, sizeof(i));
+		ASSERT_EQ(0, fh.MarkDirty(i));
+		ASSERT_EQ(0, fh.UnpinPage(i));
+	}
+	ASSERT_EQ(0, fh.DisposePage(15));
+	ASSERT_EQ(0, fh.DisposePage(4));
+	ASSERT_EQ(0, fh.DisposePage(17));
+	ASSERT_EQ(PF_INVALIDPAGE, fh.Truncate(21));
+
+	// a pinned page stops it before anything changes
+	ASSERT_EQ(0, fh.GetThisPage(12, ph));
+	ASSERT_EQ(PF_PAGEPINNED, fh.Truncate(10));
+	ASSERT_EQ(0, fh.UnpinPage(12));
+	ASSERT_EQ(0, fh.GetThisPage(19, ph));
+	ASSERT_EQ(0, fh.UnpinPage(19));
+
+	// the dirty pages dropped are never written
+	ASSERT_EQ(0, fh.Truncate(10));
+	ASSERT_EQ(PF_INVALIDPAGE, fh.GetThisPage(12, ph));
+	ASSERT_EQ(0, pfm.CloseFile(fh));
+	ASSERT_EQ(0, stat("pftestfile", &st));
+	ASSERT_EQ(PF_FILE_HDR_SIZE + 10 * PF_DiskPageSize(PF_PAGE_SIZE),
+	          st.st_size);
+
+	// of the free pages only the one that stayed is reused
+	ASSERT_EQ(0, pfm.OpenFile("pftestfile", fh));
+	ASSERT_EQ(0, fh.AllocatePage(ph));
+	ph.GetPageNum(pageNum);
+	ASSERT_EQ(4, pageNum);
+	ASSERT_EQ(0, fh.UnpinPage(pageNum));
+	ASSERT_EQ(0, fh.AllocatePage(ph));
+	ph.GetPageNum(pageNum);
+	ASSERT_EQ(10, pageNum);
+	ph.GetData(pData);
+	ASSERT_EQ(0, *(int*)pData);
+	ASSERT_EQ(0, fh.UnpinPage(pageNum));
+	for (int i = 0; i < 10; i++) {
+		if (i == 4)
+			continue;
+		ASSERT_EQ(0, fh.GetThisPage(i, ph));
+		ph.GetData(pData);
+		ASSERT_EQ(i, *(int*)pData);
+		ASSERT_EQ(0, fh.UnpinPage(i));
+	}
+	ASSERT_EQ(0, fh.Truncate(0));
+	ASSERT_EQ(PF_EOF, fh.GetFirstPage(ph));
+}
+
+TEST_F(PF_ManagerTest, Threads) {
+	PF_PageHandle ph;
+	char *pData;
+	const int numPages = 100;
+	const int numThreads = 4;
+	const int numRounds = 2000;
+
+	// page 0 holds a counter, the others their own page number
+	for (int i = 0; i < numPages; i++) {
+		ASSERT_EQ(0, fh.AllocatePage(ph));
+		ph.GetData(pData);
+		int value = (i == 0) ? 0 : i;
+		memcpy(pData, &value, sizeof(value));
+		ASSERT_EQ(0, fh.MarkDirty(i));
+		ASSERT_EQ(0, fh.UnpinPage(i));
+	}
+
+	// each thread reads through its own copy of the handle, with more
+	// pages than fit in the buffer, and now and then bumps the counter
+	std::atomic<int> numWrong(0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < numThreads; t++)
+		threads.push_back(std::thread([&, t]() {
+			PF_FileHandle fh2 = fh;
+			PF_PageHandle ph2;
+			char *pData2;
+			unsigned seed = t + 1;
+			for (int r = 0; r < numRounds; r++) {
+				PageNum p = 1 + rand_r(&seed) % (numPages - 1);
+				if (fh2.GetThisPage(p, ph2) || ph2.GetData(pData2) ||
+				    *(int*)pData2 != p || fh2.UnpinPage(p))
+					numWrong++;
+				if (r % 10 != 0)
+					continue;
+				if (fh2.GetThisPage(0, ph2) || ph2.GetData(pData2) ||
+				    fh2.LatchPage(0, TRUE)) {
+					numWrong++;
+					continue;
+				}
+				(*(int*)pData2)++;
+				if (fh2.MarkDirty(0) || fh2.UnlatchPage(0) || fh2.UnpinPage(0))
+					numWrong++;
+			}
+		}));
+	for (int t = 0; t < numThreads; t++)
+		threads[t].join();
+	ASSERT_EQ(0, numWrong);
+
+	ASSERT_EQ(0, fh.GetThisPage(0, ph));
+	ph.GetData(pData);
+	ASSERT_EQ(numThreads * numRounds / 10, *(int*)pData);
+	ASSERT_EQ(0, fh.LatchPage(0));
+	ASSERT_EQ(0, fh.LatchPage(0));
+	ASSERT_EQ(0, fh.UnlatchPage(0));
+	ASSERT_EQ(0, fh.UnlatchPage(0));
+	ASSERT_EQ(PF_NOTLATCHED, fh.UnlatchPage(0));
+	ASSERT_EQ(0, fh.UnpinPage(0));
+
+	// no pins were left behind
+	ASSERT_EQ(0, fh.FlushPages());
+}
+
+TEST_F(PF_ManagerTest, WarmRestart) {
+	PF_PageHandle ph;
+	char *pData;
+	PageNum pageNum;
+	PageNum hot[] = { 30, 31, 32, 10, 50 };
+
+	for (int i = 0; i < 60; i++) {
+		ASSERT_EQ(0, fh.AllocatePage(ph));
+		ph.GetData(pData);
+		ph.GetPageNum(pageNum);
+		memcpy(pData, &i, sizeof(i));
+		ASSERT_EQ(0, fh.MarkDirty(pageNum));
+		ASSERT_EQ(0, fh.UnpinPage(pageNum));
+	}
+	ASSERT_EQ(0, fh.FlushPages());
+
+	// only the pages asked for are in the buffer when the file is closed
+	ASSERT_EQ(0, pfm.SetReadAhead(0));
+	for (int i = 0; i < 5; i++) {
+		ASSERT_EQ(0, fh.GetThisPage(hot[i], ph));
+		ASSERT_EQ(0, fh.UnpinPage(hot[i]));
+	}
+	ASSERT_EQ(0, pfm.CloseFile(fh));
+	ASSERT_EQ(0, pfm.SaveHotPages("pfhotlist"));
+
+	// most recently loaded first
+	char line[100];
+	FILE *f = fopen("pfhotlist", "r");
+	ASSERT_TRUE(f != NULL);
+	ASSERT_TRUE(fgets(line, sizeof(line), f) != NULL);
+	ASSERT_STREQ("50 pftestfile\n", line);
+	fclose(f);
+
+	// after a restart the pages are read when the file is opened
+	ASSERT_EQ(0, pfm.WarmUp("no such list"));
+	ASSERT_EQ(0, pfm.WarmUp("pfhotlist"));
+	ASSERT_EQ(0, pfm.OpenFile("pftestfile", fh));
+	int zero = 0;
+	pStatisticsMgr->Register(PF_READPAGE, STAT_SETVALUE, &zero);
+	for (int i = 0; i < 5; i++) {
+		ASSERT_EQ(0, fh.GetThisPage(hot[i], ph));
+		ph.GetData(pData);
+		ASSERT_EQ(hot[i], *(int*)pData);
+		ASSERT_EQ(0, fh.UnpinPage(hot[i]));
+	}
+	int *piRP = pStatisticsMgr->Get(PF_READPAGE);
+	ASSERT_EQ(0, *piRP);
+	delete piRP;
+	unlink("pfhotlist");
+}
+
+TEST_F(PF_ManagerTest, Pools) {
+	PF_PageHandle ph;
+	char *pData;
+	PageNum pageNum;
+	PF_FileHandle dims;
+
+	ASSERT_EQ(PF_BADPARAM, pfm.CreatePool("", 4));
+	ASSERT_EQ(PF_BADPARAM, pfm.CreatePool("dims", 0));
+	ASSERT_EQ(0, pfm.CreatePool("dims", 4));
+	ASSERT_EQ(0, pfm.CreatePool("dims", 5));
+	ASSERT_EQ(PF_BADPARAM, pfm.AssignPool("pfdims", "nosuchpool"));
+	ASSERT_EQ(0, pfm.AssignPool("pfdims", "dims"));
+	ASSERT_EQ(0, pfm.SetReadAhead(0));
+
+	system("rm -f pfdims");
+	ASSERT_EQ(0, pfm.CreateFile("pfdims"));
+	ASSERT_EQ(0, pfm.OpenFile("pfdims", dims));
+	for (int i = 0; i < 4; i++) {
+		ASSERT_EQ(0, dims.AllocatePage(ph));
+		ph.GetData(pData);
+		ph.GetPageNum(pageNum);
+		memcpy(pData, &i, sizeof(i));
+		ASSERT_EQ(0, dims.MarkDirty(pageNum));
+		ASSERT_EQ(0, dims.UnpinPage(pageNum));
+	}
+
+	// a scan larger than the default pool does not push out the pool's pages
+	for (int i = 0; i < 3 * PF_BUFFER_SIZE; i++) {
+		ASSERT_EQ(0, fh.AllocatePage(ph));
+		ph.GetPageNum(pageNum);
+		ASSERT_EQ(0, fh.MarkDirty(pageNum));
+		ASSERT_EQ(0, fh.UnpinPage(pageNum));
+	}
+	ASSERT_EQ(0, fh.FlushPages());
+
+	int zero = 0;
+	pStatisticsMgr->Register(PF_READPAGE, STAT_SETVALUE, &zero);
+	for (int i = 0; i < 4; i++) {
+		ASSERT_EQ(0, dims.GetThisPage(i, ph));
+		ph.GetData(pData);
+		ASSERT_EQ(i, *(int*)pData);
+		ASSERT_EQ(0, dims.UnpinPage(i));
+	}
+	int *piRP = pStatisticsMgr->Get(PF_READPAGE);
+	ASSERT_EQ(0, *piRP);
+	delete piRP;
+
+	ASSERT_EQ(0, pfm.CloseFile(dims));
+	ASSERT_EQ(0, pfm.AssignPool("pfdims", NULL));
+	ASSERT_EQ(0, pfm.DestroyFile("pfdims"));
+}
+
 // TEST_F(PF_ManagerTest, Persist) {
 // 	RC rc;
 // 	PF_Handle fh2;
@@ -0,0 +1,411 @@
+//
+// File:        pf_replacement.cc
+// Description: Page replacement policies for PF_BufferMgr
+//
+
+#include <cstring>
+#include "pf_internal.h"
+#include "pf_buffermgr.h"
+#include "pf_replacement.h"
+
+//------------------------------------------------------------------------------
+// PF_SlotList
+//------------------------------------------------------------------------------
+
+PF_SlotList::PF_SlotList()
+   : next(NULL), prev(NULL), bIn(NULL),
+     head(INVALID_SLOT), tail(INVALID_SLOT), length(0)
+{
+}
+
+PF_SlotList::~PF_SlotList()
+{
+   delete [] next;
+   delete [] prev;
+   delete [] bIn;
+}
+
+//
+// Reset
+//
+// Desc: Empty the list and size it for slots 0 .. numSlots-1
+//
+void PF_SlotList::Reset(int numSlots)
+{
+   delete [] next;
+   delete [] prev;
+   delete [] bIn;
+   next = new int[numSlots];
+   prev = new int[numSlots];
+   bIn = new bool[numSlots];
+   for (int i = 0; i < numSlots; i++)
+      bIn[i] = false;
+   head = tail = INVALID_SLOT;
+   length = 0;
+}
+
+void PF_SlotList::LinkHead(int slot)
+{
+   next[slot] = head;
+   prev[slot] = INVALID_SLOT;
+   if (head != INVALID_SLOT)
+      prev[head] = slot;
+   head = slot;
+   if (tail == INVALID_SLOT)
+      tail = slot;
+   bIn[slot] = true;
+   length++;
+}
+
+void PF_SlotList::Unlink(int slot)
+{
+   if (!bIn[slot])
+      return;
+   if (head == slot)
+      head = next[slot];
+   if (tail == slot)
+      tail = prev[slot];
+   if (next[slot] != INVALID_SLOT)
+      prev[next[slot]] = prev[slot];
+   if (prev[slot] != INVALID_SLOT)
+      next[prev[slot]] = next[slot];
+   bIn[slot] = false;
+   length--;
+}
+
+//
+// OldestUnpinned
+//
+// Desc: Internal.  Walk list from the tail and return the first slot that
+//       is not pinned, or INVALID_SLOT.
+//
+static int OldestUnpinned(const PF_SlotList &list,
+                          const PF_BufPageDesc *bufTable)
+{
+   for (int slot = list.Tail(); slot != INVALID_SLOT; slot = list.Prev(slot))
+      if (bufTable[slot].Pins() == 0)
+         return slot;
+   return INVALID_SLOT;
+}
+
+//------------------------------------------------------------------------------
+// PF_LRUPolicy
+//
+// A page becomes most recently used when it is loaded, requested again, and
+// when its last pin is released.
+//------------------------------------------------------------------------------
+
+void PF_LRUPolicy::Reset(int numPages)
+{
+   used.Reset(numPages);
+}
+
+void PF_LRUPolicy::Loaded(int slot, int fd, PageNum pageNum)
+{
+   used.LinkHead(slot);
+}
+
+void PF_LRUPolicy::Accessed(int slot)
+{
+   used.Unlink(slot);
+   used.LinkHead(slot);
+}
+
+void PF_LRUPolicy::Unpinned(int slot)
+{
+   used.Unlink(slot);
+   used.LinkHead(slot);
+}
+
+void PF_LRUPolicy::Removed(int slot, int fd, PageNum pageNum)
+{
+   used.Unlink(slot);
+}
+
+int PF_LRUPolicy::Victim(const PF_BufPageDesc *bufTable)
+{
+   return OldestUnpinned(used, bufTable);
+}
+
+//------------------------------------------------------------------------------
+// PF_ClockPolicy
+//
+// Hits and unpins only set the reference bit of the slot.  The hand sweeps
+// the slots, clearing reference bits, and stops at the first unpinned page
+// whose bit is already clear.
+//------------------------------------------------------------------------------
+
+PF_ClockPolicy::PF_ClockPolicy()
+   : refBit(NULL), bResident(NULL), numSlots(0), hand(0)
+{
+}
+
+PF_ClockPolicy::~PF_ClockPolicy()
+{
+   delete [] refBit;
+   delete [] bResident;
+}
+
+void PF_ClockPolicy::Reset(int numPages)
+{
+   delete [] refBit;
+   delete [] bResident;
+   numSlots = numPages;
+   refBit = new char[numSlots];
+   bResident = new char[numSlots];
+   memset(refBit, 0, numSlots);
+   memset(bResident, 0, numSlots);
+   hand = 0;
+}
+
+void PF_ClockPolicy::Loaded(int slot, int fd, PageNum pageNum)
+{
+   bResident[slot] = TRUE;
+   refBit[slot] = TRUE;
+}
+
+void PF_ClockPolicy::Accessed(int slot)
+{
+   refBit[slot] = TRUE;
+}
+
+void PF_ClockPolicy::Unpinned(int slot)
+{
+   refBit[slot] = TRUE;
+}
+
+void PF_ClockPolicy::Removed(int slot, int fd, PageNum pageNum)
+{
+   bResident[slot] = FALSE;
+   refBit[slot] = FALSE;
+}
+
+int PF_ClockPolicy::Victim(const PF_BufPageDesc *bufTable)
+{
+   // The first sweep clears every unpinned reference bit, so two sweeps
+   // find a victim if there is one
+   for (int i = 0; i < 2 * numSlots; i++) {
+      int slot = hand;
+      hand = (hand + 1) % numSlots;
+      if (!bResident[slot] || bufTable[slot].Pins() != 0)
+         continue;
+      if (refBit[slot]) {
+         refBit[slot] = FALSE;
+         continue;
+      }
+      return slot;
+   }
+   return INVALID_SLOT;
+}
+
+//------------------------------------------------------------------------------
+// PF_2QPolicy
+//
+// New pages go to the head of A1in.  Pages evicted from A1in are remembered
+// in A1out; a page found in A1out when it is loaded again goes to Am.  A
+// hit moves a page to the head of Am only if it is already there, so a
+// single scan never displaces the Am pages.
+//------------------------------------------------------------------------------
+
+PF_2QPolicy::PF_2QPolicy()
+   : kin(0), pGhosts(NULL), ghostRing(NULL), kout(0), ghostHead(0)
+{
+}
+
+PF_2QPolicy::~PF_2QPolicy()
+{
+   delete pGhosts;
+   delete [] ghostRing;
+}
+
+void PF_2QPolicy::Reset(int numPages)
+{
+   a1in.Reset(numPages);
+   am.Reset(numPages);
+   kin = numPages / 4 > 0 ? numPages / 4 : 1;
+   kout = numPages / 2 > 0 ? numPages / 2 : 1;
+
+   delete pGhosts;
+   delete [] ghostRing;
+   pGhosts = new PF_HashTable(kout);
+   ghostRing = new PF_HashEntry[kout];
+   for (int i = 0; i < kout; i++)
+      ghostRing[i].slot = PF_HASH_EMPTY;
+   ghostHead = 0;
+}
+
+void PF_2QPolicy::Loaded(int slot, int fd, PageNum pageNum)
+{
+   int ghost;
+   if (pGhosts->Find(fd, pageNum, ghost) == 0) {
+      pGhosts->Delete(fd, pageNum);
+      ghostRing[ghost].slot = PF_HASH_EMPTY;
+      am.LinkHead(slot);
+   }
+   else
+      a1in.LinkHead(slot);
+}
+
+void PF_2QPolicy::Accessed(int slot)
+{
+   if (am.Contains(slot)) {
+      am.Unlink(slot);
+      am.LinkHead(slot);
+   }
+}
+
+void PF_2QPolicy::Unpinned(int slot)
+{
+}
+
+void PF_2QPolicy::Removed(int slot, int fd, PageNum pageNum)
+{
+   if (a1in.Contains(slot)) {
+      a1in.Unlink(slot);
+      Remember(fd, pageNum);
+   }
+   else
+      am.Unlink(slot);
+}
+
+//
+// Remember
+//
+// Desc: Internal.  Add a page to A1out, forgetting the oldest entry if
+//       A1out is full.
+//
+void PF_2QPolicy::Remember(int fd, PageNum pageNum)
+{
+   PF_HashEntry &entry = ghostRing[ghostHead];
+   if (entry.slot != PF_HASH_EMPTY)
+      pGhosts->Delete(entry.fd, entry.pageNum);
+
+   entry.fd = fd;
+   entry.pageNum = pageNum;
+   entry.slot = (pGhosts->Insert(fd, pageNum, ghostHead) == 0)
+      ? ghostHead : PF_HASH_EMPTY;
+   ghostHead = (ghostHead + 1) % kout;
+}
+
+int PF_2QPolicy::Victim(const PF_BufPageDesc *bufTable)
+{
+   int slot = INVALID_SLOT;
+   if (a1in.Length() > kin)
+      slot = OldestUnpinned(a1in, bufTable);
+   if (slot == INVALID_SLOT)
+      slot = OldestUnpinned(am, bufTable);
+   if (slot == INVALID_SLOT)
+      slot = OldestUnpinned(a1in, bufTable);
+   return slot;
+}
+
+//------------------------------------------------------------------------------
+// PF_LRUKPolicy
+//
+// Each slot keeps the times of its last two requests.  The victim is the
+// unpinned page with the oldest second-to-last request; pages requested only
+// once go first, oldest first.  Requests in a row for the same page (the RM
+// layer often pins a page twice per record) are correlated and count once.
+// The resident pages are kept in victim order, so the search only passes
+// over the pinned pages at the front.
+//------------------------------------------------------------------------------
+
+PF_LRUKPolicy::PF_LRUKPolicy()
+   : last(NULL), prev(NULL), numSlots(0), tick(0),
+     pHistory(NULL), historyRing(NULL), historyLast(NULL), historyPrev(NULL),
+     historySize(0), historyHead(0)
+{
+}
+
+PF_LRUKPolicy::~PF_LRUKPolicy()
+{
+   delete [] last;
+   delete [] prev;
+   delete pHistory;
+   delete [] historyRing;
+   delete [] historyLast;
+   delete [] historyPrev;
+}
+
+void PF_LRUKPolicy::Reset(int numPages)
+{
+   delete [] last;
+   delete [] prev;
+   numSlots = numPages;
+   last = new long[numSlots];
+   prev = new long[numSlots];
+   order.clear();
+
+   // Retain history for as many evicted pages as the buffer holds
+   delete pHistory;
+   delete [] historyRing;
+   delete [] historyLast;
+   delete [] historyPrev;
+   historySize = numPages;
+   pHistory = new PF_HashTable(historySize);
+   historyRing = new PF_HashEntry[historySize];
+   historyLast = new long[historySize];
+   historyPrev = new long[historySize];
+   for (int i = 0; i < historySize; i++)
+      historyRing[i].slot = PF_HASH_EMPTY;
+   historyHead = 0;
+}
+
+void PF_LRUKPolicy::Reference(int slot)
+{
+   order.erase(KeyOf(slot));
+   tick++;
+   if (tick - last[slot] > 1)
+      prev[slot] = last[slot];
+   last[slot] = tick;
+   order.insert(KeyOf(slot));
+}
+
+void PF_LRUKPolicy::Loaded(int slot, int fd, PageNum pageNum)
+{
+   int h;
+   if (pHistory->Find(fd, pageNum, h) == 0) {
+      pHistory->Delete(fd, pageNum);
+      historyRing[h].slot = PF_HASH_EMPTY;
+      last[slot] = historyLast[h];
+      prev[slot] = historyPrev[h];
+   }
+   else
+      last[slot] = prev[slot] = 0;
+   Reference(slot);
+}
+
+void PF_LRUKPolicy::Accessed(int slot)
+{
+   Reference(slot);
+}
+
+void PF_LRUKPolicy::Unpinned(int slot)
+{
+}
+
+void PF_LRUKPolicy::Removed(int slot, int fd, PageNum pageNum)
+{
+   order.erase(KeyOf(slot));
+
+   PF_HashEntry &entry = historyRing[historyHead];
+   if (entry.slot != PF_HASH_EMPTY)
+      pHistory->Delete(entry.fd, entry.pageNum);
+
+   entry.fd = fd;
+   entry.pageNum = pageNum;
+   entry.slot = (pHistory->Insert(fd, pageNum, historyHead) == 0)
+      ? historyHead : PF_HASH_EMPTY;
+   historyLast[historyHead] = last[slot];
+   historyPrev[historyHead] = prev[slot];
+   historyHead = (historyHead + 1) % historySize;
+}
+
+int PF_LRUKPolicy::Victim(const PF_BufPageDesc *bufTable)
+{
+   for (std::set<Key>::const_iterator it = order.begin();
+         it != order.end(); ++it)
+      if (bufTable[it->second].Pins() == 0)
+         return (it->second);
+   return (INVALID_SLOT);
+}
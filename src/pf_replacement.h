@@ -0,0 +1,198 @@
+//
+// File:        pf_replacement.h
+// Description: Page replacement policies for PF_BufferMgr
+//
+// The buffer manager tells the active policy when a page is loaded into a
+// slot, found there again, released by its last pin, and removed.  The
+// policy keeps whatever ordering it needs in arrays indexed by slot and
+// picks the victim when the buffer is full.  Four policies are provided:
+//
+//   lru    - least recently unpinned page (the original PF behavior)
+//   clock  - second chance; a hit only sets a reference bit
+//   2q     - Johnson & Shasha's 2Q: pages enter a FIFO (A1in) and are
+//            promoted to an LRU queue (Am) only if they are requested again
+//            after being evicted, which a ghost list (A1out) remembers
+//   lruk   - O'Neil's LRU-K with K = 2: evict the page whose second most
+//            recent request is oldest, keeping history for evicted pages
+//
+
+#ifndef PF_REPLACEMENT_H
+#define PF_REPLACEMENT_H
+
+#include <set>
+#include <utility>
+#include "pf_internal.h"
+#include "pf_hashtable.h"
+
+struct PF_BufPageDesc;
+
+//
+// PF_SlotList - doubly linked list threaded through buffer slot numbers
+//
+class PF_SlotList {
+public:
+   PF_SlotList  ();
+   ~PF_SlotList ();
+
+   void Reset   (int numSlots);               // Empty list for numSlots
+   void LinkHead(int slot);                   // Insert slot at the head
+   void Unlink  (int slot);                   // Remove slot from the list
+
+   bool Contains(int slot) const { return bIn[slot]; }
+   int  Head    () const         { return head; }
+   int  Tail    () const         { return tail; }
+   int  Prev    (int slot) const { return prev[slot]; }
+   int  Length  () const         { return length; }
+
+private:
+   int  *next;
+   int  *prev;
+   bool *bIn;
+   int  head;
+   int  tail;
+   int  length;
+};
+
+//
+// PF_ReplacementPolicy - interface of a page replacement policy
+//
+class PF_ReplacementPolicy {
+public:
+   PF_ReplacementPolicy () : numRequests(0), numHits(0) {}
+   virtual ~PF_ReplacementPolicy () {}
+
+   // Name used to select the policy and to report it
+   virtual const char *Name() const = 0;
+
+   // Forget all pages and prepare for a buffer of numPages slots
+   virtual void Reset   (int numPages) = 0;
+   // A page was read or allocated into slot
+   virtual void Loaded  (int slot, int fd, PageNum pageNum) = 0;
+   // GetPage found the page already in slot
+   virtual void Accessed(int slot) = 0;
+   // The last pin on the page in slot was released
+   virtual void Unpinned(int slot) = 0;
+   // The page in slot left the buffer
+   virtual void Removed (int slot, int fd, PageNum pageNum) = 0;
+   // Choose an unpinned page to replace; INVALID_SLOT if all are pinned
+   virtual int  Victim  (const PF_BufPageDesc *bufTable) = 0;
+
+   // Hit ratio bookkeeping for GetPage requests served under this policy;
+   // hits are counted without the buffer latch
+   void Count      (int bHit)  {
+      __atomic_add_fetch(&numRequests, 1, __ATOMIC_RELAXED);
+      if (bHit) __atomic_add_fetch(&numHits, 1, __ATOMIC_RELAXED);
+   }
+   long GetRequests() const    { return numRequests; }
+   long GetHits    () const    { return numHits; }
+
+private:
+   long numRequests;
+   long numHits;
+};
+
+//
+// PF_LRUPolicy - least recently used
+//
+class PF_LRUPolicy : public PF_ReplacementPolicy {
+public:
+   const char *Name() const { return "lru"; }
+   void Reset   (int numPages);
+   void Loaded  (int slot, int fd, PageNum pageNum);
+   void Accessed(int slot);
+   void Unpinned(int slot);
+   void Removed (int slot, int fd, PageNum pageNum);
+   int  Victim  (const PF_BufPageDesc *bufTable);
+private:
+   PF_SlotList used;                             // MRU at the head
+};
+
+//
+// PF_ClockPolicy - second chance with a clock hand over the slots
+//
+class PF_ClockPolicy : public PF_ReplacementPolicy {
+public:
+   PF_ClockPolicy ();
+   ~PF_ClockPolicy();
+   const char *Name() const { return "clock"; }
+   void Reset   (int numPages);
+   void Loaded  (int slot, int fd, PageNum pageNum);
+   void Accessed(int slot);
+   void Unpinned(int slot);
+   void Removed (int slot, int fd, PageNum pageNum);
+   int  Victim  (const PF_BufPageDesc *bufTable);
+private:
+   char *refBit;                                 // referenced since the
+                                                 // hand last passed
+   char *bResident;                              // slot holds a page
+   int  numSlots;
+   int  hand;
+};
+
+//
+// PF_2QPolicy - full 2Q with Kin = 1/4 and Kout = 1/2 of the buffer
+//
+class PF_2QPolicy : public PF_ReplacementPolicy {
+public:
+   PF_2QPolicy ();
+   ~PF_2QPolicy();
+   const char *Name() const { return "2q"; }
+   void Reset   (int numPages);
+   void Loaded  (int slot, int fd, PageNum pageNum);
+   void Accessed(int slot);
+   void Unpinned(int slot);
+   void Removed (int slot, int fd, PageNum pageNum);
+   int  Victim  (const PF_BufPageDesc *bufTable);
+private:
+   void Remember(int fd, PageNum pageNum);       // add to A1out
+
+   PF_SlotList  a1in;                            // FIFO of new pages
+   PF_SlotList  am;                              // LRU of re-requested pages
+   int          kin;                             // target length of A1in
+
+   PF_HashTable *pGhosts;                        // A1out: page -> ring index
+   PF_HashEntry *ghostRing;                      // A1out in FIFO order
+   int          kout;                            // length of A1out
+   int          ghostHead;                       // next ring entry to reuse
+};
+
+//
+// PF_LRUKPolicy - LRU-K with K = 2
+//
+class PF_LRUKPolicy : public PF_ReplacementPolicy {
+public:
+   PF_LRUKPolicy ();
+   ~PF_LRUKPolicy();
+   const char *Name() const { return "lruk"; }
+   void Reset   (int numPages);
+   void Loaded  (int slot, int fd, PageNum pageNum);
+   void Accessed(int slot);
+   void Unpinned(int slot);
+   void Removed (int slot, int fd, PageNum pageNum);
+   int  Victim  (const PF_BufPageDesc *bufTable);
+private:
+   void Reference(int slot);                     // record a request
+
+   // (prev, last) of a resident slot, and the slot
+   typedef std::pair<std::pair<long, long>, int> Key;
+   Key  KeyOf(int slot) const
+      { return Key(std::make_pair(prev[slot], last[slot]), slot); }
+
+   long *last;                                   // time of last request
+   long *prev;                                   // time of the one before;
+                                                 // 0 if there was none
+   std::set<Key> order;                          // resident slots, the
+                                                 // next victim first
+   int  numSlots;
+   long tick;                                    // logical clock
+
+   // Request history of pages that have left the buffer
+   PF_HashTable *pHistory;                       // page -> ring index
+   PF_HashEntry *historyRing;
+   long         *historyLast;
+   long         *historyPrev;
+   int          historySize;
+   int          historyHead;
+};
+
+#endif
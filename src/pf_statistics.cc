@@ -12,8 +12,9 @@
 //
 #ifdef PF_STATS
 
+#include <cstdio>
 #include <iostream>
-#include "pf.h"
+#include "pf_internal.h"
 #include "statistics.h"
 
 using namespace std;
@@ -30,6 +31,9 @@ void PF_Statistics()
    int *piRP = pStatisticsMgr->Get(PF_READPAGE);
    int *piWP = pStatisticsMgr->Get(PF_WRITEPAGE);
    int *piFP = pStatisticsMgr->Get(PF_FLUSHPAGES);
+   int *piRA = pStatisticsMgr->Get(PF_READAHEAD);
+   int *piWS = pStatisticsMgr->Get(PF_WRITESAVED);
+   int *piCW = pStatisticsMgr->Get(PF_CLEANERWRITE);
 
    cout << "PF Layer Statistics\n";
    cout << "-------------------\n";
@@ -44,13 +48,35 @@ void PF_Statistics()
 
    cout << "Number of read requests: ";
    if (piRP) cout << *piRP; else cout << "None";
+   cout << "\n  Pages read ahead: ";
+   if (piRA) cout << *piRA; else cout << "None";
    cout << "\nNumber of write requests: ";
    if (piWP) cout << *piWP; else cout << "None";
+   cout << "\n  Writes saved by coalescing: ";
+   if (piWS) cout << *piWS; else cout << "None";
+   cout << "\n  Writes by the page cleaner: ";
+   if (piCW) cout << *piCW; else cout << "None";
    cout << "\n-------------------\n";
    cout << "Number of flushes: ";
    if (piFP) cout << *piFP; else cout << "None";
    cout << "\n-------------------\n";
 
+   // One counter per buffer ring that has reused a frame
+   cout << "Frames reused by buffer rings: ";
+   int iRings = 0;
+   for (int i = 0; i < PF_MAX_RINGS; i++) {
+      char psKey[32];
+      sprintf(psKey, "%s%d", PF_RINGREUSE, i);
+      int *piRR = pStatisticsMgr->Get(psKey);
+      if (piRR) {
+         cout << "\n  ring " << i << ": " << *piRR;
+         iRings++;
+      }
+      delete piRR;
+   }
+   if (iRings == 0) cout << "None";
+   cout << "\n-------------------\n";
+
    // Must delete the memory returned from StatisticsMgr::Get
    delete piGP;
    delete piPF;
@@ -58,6 +84,9 @@ void PF_Statistics()
    delete piRP;
    delete piWP;
    delete piFP;
+   delete piRA;
+   delete piWS;
+   delete piCW;
 }
 
 #endif
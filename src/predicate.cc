@@ -7,8 +7,13 @@
 #include <cstdio>
 #include <cstring>
 #include <iostream>
+#include <functional>
 #include <type_traits>
 #include "predicate.h"
+#include "rm.h"
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
@@ -33,7 +38,7 @@ bool AlmostEqualRelative(float A, float B, float maxRelativeError=0.000001)
 
 
 bool Predicate::eval(const char *buf, CompOp c) const {
-  return this->eval(buf, NULL, c);
+  return this->eval(buf, (rhsOffset >= 0) ? buf + rhsOffset : NULL, c);
 }
 
 bool Predicate::eval(const char *buf, const char* rhs, CompOp c) const {
@@ -94,3 +99,236 @@ bool Predicate::eval(const char *buf, const char* rhs, CompOp c) const {
   assert("Bad value for c - should never get here.");
   return true;
 }
+
+// Page filters.  A kernel compares the INT or FLOAT key of up to 64 records,
+// stride bytes apart, against one value and returns the results as the bits
+// of a word.  The SSE2 and AVX2 kernels compare 4 and 8 keys at a time; the
+// scalar one is used elsewhere and for what is left over.  Keys 4 bytes
+// apart - a minipage of an RM_PAX page - are loaded rather than gathered.
+namespace {
+
+typedef unsigned long long Word;
+
+Word LowBits(int n)
+{
+  return (n >= 64) ? ~0ULL : (1ULL << n) - 1;
+}
+
+template<typename T, typename Cmp>
+Word ScalarLoop(const char *p, int stride, int from, int n, T v, Cmp cmp)
+{
+  Word w = 0;
+  for(int k = from; k < n; k++)
+    if(cmp(read_unaligned<T>(p + k * stride), v))
+      w |= 1ULL << k;
+  return w;
+}
+
+template<typename T>
+Word ScalarKernel(const char *p, int stride, int from, int n, CompOp c, T v)
+{
+  switch(c) {
+  case EQ_OP: return ScalarLoop(p, stride, from, n, v, std::equal_to<T>());
+  case NE_OP: return ScalarLoop(p, stride, from, n, v, std::not_equal_to<T>());
+  case LT_OP: return ScalarLoop(p, stride, from, n, v, std::less<T>());
+  case GT_OP: return ScalarLoop(p, stride, from, n, v, std::greater<T>());
+  case LE_OP: return ScalarLoop(p, stride, from, n, v, std::less_equal<T>());
+  case GE_OP: return ScalarLoop(p, stride, from, n, v,
+                                std::greater_equal<T>());
+  default:    return LowBits(n) & ~LowBits(from);
+  }
+}
+
+#if defined(__x86_64__)
+
+// Integer kernels only see EQ_OP, LT_OP and GT_OP - the others are their
+// complements.  Float kernels take all six since NaN compares false to
+// everything.
+
+Word Sse2Ints(const char *p, int stride, int n, CompOp c, int v)
+{
+  __m128i val = _mm_set1_epi32(v);
+  Word w = 0;
+  int k = 0;
+  for(; k + 4 <= n; k += 4) {
+    const char *q = p + k * stride;
+    __m128i x = (stride == sizeof(int)) ?
+      _mm_loadu_si128((const __m128i *)q) :
+      _mm_setr_epi32(read_unaligned<int>(q),
+                     read_unaligned<int>(q + stride),
+                     read_unaligned<int>(q + 2 * stride),
+                     read_unaligned<int>(q + 3 * stride));
+    __m128i m = (c == EQ_OP) ? _mm_cmpeq_epi32(x, val) :
+                (c == LT_OP) ? _mm_cmplt_epi32(x, val) :
+                               _mm_cmpgt_epi32(x, val);
+    w |= (Word)_mm_movemask_ps(_mm_castsi128_ps(m)) << k;
+  }
+  return w | ScalarKernel<int>(p, stride, k, n, c, v);
+}
+
+Word Sse2Floats(const char *p, int stride, int n, CompOp c, float v)
+{
+  __m128 val = _mm_set1_ps(v);
+  Word w = 0;
+  int k = 0;
+  for(; k + 4 <= n; k += 4) {
+    const char *q = p + k * stride;
+    __m128 x = (stride == sizeof(float)) ?
+      _mm_loadu_ps((const float *)q) :
+      _mm_setr_ps(read_unaligned<float>(q),
+                  read_unaligned<float>(q + stride),
+                  read_unaligned<float>(q + 2 * stride),
+                  read_unaligned<float>(q + 3 * stride));
+    __m128 m;
+    switch(c) {
+    case EQ_OP: m = _mm_cmpeq_ps(x, val); break;
+    case NE_OP: m = _mm_cmpneq_ps(x, val); break;
+    case LT_OP: m = _mm_cmplt_ps(x, val); break;
+    case GT_OP: m = _mm_cmpgt_ps(x, val); break;
+    case LE_OP: m = _mm_cmple_ps(x, val); break;
+    default:    m = _mm_cmpge_ps(x, val); break;
+    }
+    w |= (Word)_mm_movemask_ps(m) << k;
+  }
+  return w | ScalarKernel<float>(p, stride, k, n, c, v);
+}
+
+// AVX2 gathers the 8 keys straight from the records
+__attribute__((target("avx2")))
+Word Avx2Ints(const char *p, int stride, int n, CompOp c, int v)
+{
+  __m256i idx = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                   _mm256_set1_epi32(stride));
+  __m256i val = _mm256_set1_epi32(v);
+  Word w = 0;
+  int k = 0;
+  for(; k + 8 <= n; k += 8) {
+    __m256i x = (stride == sizeof(int)) ?
+      _mm256_loadu_si256((const __m256i *)(p + k * stride)) :
+      _mm256_i32gather_epi32((const int *)(p + k * stride), idx, 1);
+    __m256i m = (c == EQ_OP) ? _mm256_cmpeq_epi32(x, val) :
+                (c == LT_OP) ? _mm256_cmpgt_epi32(val, x) :
+                               _mm256_cmpgt_epi32(x, val);
+    w |= (Word)_mm256_movemask_ps(_mm256_castsi256_ps(m)) << k;
+  }
+  return w | ScalarKernel<int>(p, stride, k, n, c, v);
+}
+
+template<int P>
+__attribute__((target("avx2")))
+Word Avx2FloatLoop(const char *p, int stride, int n, float v, int& k)
+{
+  __m256i idx = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                   _mm256_set1_epi32(stride));
+  __m256 val = _mm256_set1_ps(v);
+  Word w = 0;
+  for(k = 0; k + 8 <= n; k += 8) {
+    __m256 x = (stride == sizeof(float)) ?
+      _mm256_loadu_ps((const float *)(p + k * stride)) :
+      _mm256_i32gather_ps((const float *)(p + k * stride), idx, 1);
+    w |= (Word)_mm256_movemask_ps(_mm256_cmp_ps(x, val, P)) << k;
+  }
+  return w;
+}
+
+__attribute__((target("avx2")))
+Word Avx2Floats(const char *p, int stride, int n, CompOp c, float v)
+{
+  Word w;
+  int k;
+  switch(c) {
+  case EQ_OP: w = Avx2FloatLoop<_CMP_EQ_OQ>(p, stride, n, v, k); break;
+  case NE_OP: w = Avx2FloatLoop<_CMP_NEQ_UQ>(p, stride, n, v, k); break;
+  case LT_OP: w = Avx2FloatLoop<_CMP_LT_OQ>(p, stride, n, v, k); break;
+  case GT_OP: w = Avx2FloatLoop<_CMP_GT_OQ>(p, stride, n, v, k); break;
+  case LE_OP: w = Avx2FloatLoop<_CMP_LE_OQ>(p, stride, n, v, k); break;
+  default:    w = Avx2FloatLoop<_CMP_GE_OQ>(p, stride, n, v, k); break;
+  }
+  return w | ScalarKernel<float>(p, stride, k, n, c, v);
+}
+
+#else
+
+Word ScalarInts(const char *p, int stride, int n, CompOp c, int v)
+{
+  return ScalarKernel<int>(p, stride, 0, n, c, v);
+}
+
+Word ScalarFloats(const char *p, int stride, int n, CompOp c, float v)
+{
+  return ScalarKernel<float>(p, stride, 0, n, c, v);
+}
+
+#endif // __x86_64__
+
+struct Kernels {
+  Word (*ints)(const char *p, int stride, int n, CompOp c, int v);
+  Word (*floats)(const char *p, int stride, int n, CompOp c, float v);
+};
+
+// the widest the CPU runs, picked once
+const Kernels& PickKernels()
+{
+#if defined(__x86_64__)
+  static const Kernels k = __builtin_cpu_supports("avx2") ?
+    Kernels{ Avx2Ints, Avx2Floats } : Kernels{ Sse2Ints, Sse2Floats };
+#else
+  static const Kernels k = { ScalarInts, ScalarFloats };
+#endif
+  return k;
+}
+
+} // namespace
+
+void Predicate::evalPage(const char *recs, int recSize, int n,
+                         const char *freeMap, char *match) const
+{
+  for(int i = 0; i < (n + 63) / 64; i++) {
+    int len = (n - i * 64 < 64) ? n - i * 64 : 64;
+    Word used = ~bitmap::word(freeMap, n, i) & LowBits(len);
+    Word w = evalWord(recs + i * 64 * recSize, recSize, len, used);
+    for(int b = 0; b * 8 < len; b++)
+      match[i * 8 + b] = (char)(w >> (b * 8));
+  }
+}
+
+void Predicate::refinePage(const char *recs, int recSize, int n,
+                           char *match) const
+{
+  for(int i = 0; i < (n + 63) / 64; i++) {
+    int len = (n - i * 64 < 64) ? n - i * 64 : 64;
+    Word w = evalWord(recs + i * 64 * recSize, recSize, len,
+                      bitmap::word(match, n, i));
+    for(int b = 0; b * 8 < len; b++)
+      match[i * 8 + b] = (char)(w >> (b * 8));
+  }
+}
+
+// The bits of slots that satisfy the predicate among the n (up to 64)
+// records from recs
+Word Predicate::evalWord(const char *p, int recSize, int n, Word slots) const
+{
+  const Kernels& kern = PickKernels();
+  if(slots == 0 || compOp == NO_OP || (value == NULL && rhsOffset < 0))
+    return slots;
+  if(rhsOffset < 0 && attrType == INT) {
+    int v = read_unaligned<int>(value);
+    CompOp c = compOp;
+    bool bNot = (c == NE_OP || c == GE_OP || c == LE_OP);
+    if(bNot)
+      c = (c == NE_OP) ? EQ_OP : (c == GE_OP) ? LT_OP : GT_OP;
+    Word m = kern.ints(p + attrOffset, recSize, n, c, v);
+    return slots & (bNot ? ~m : m);
+  }
+  if(rhsOffset < 0 && attrType == FLOAT)
+    return slots & kern.floats(p + attrOffset, recSize, n, compOp,
+                               read_unaligned<float>(value));
+  // strings and attribute to attribute comparisons one record at a time
+  Word w = slots;
+  for(Word rest = slots; rest != 0; rest &= rest - 1) {
+    int k = __builtin_ctzll(rest);
+    if(!eval(p + k * recSize, compOp))
+      w &= ~(1ULL << k);
+  }
+  return w;
+}
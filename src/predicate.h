@@ -15,7 +15,7 @@ using namespace std;
 
 class Predicate {
 public:
-  Predicate() {}
+  Predicate(): compOp(NO_OP), value(NULL), rhsOffset(-1) {}
   ~Predicate() {}
 
   Predicate(AttrType   attrTypeIn,       
@@ -23,7 +23,8 @@ public:
             int        attrOffsetIn,
             CompOp     compOpIn,
             void       *valueIn,
-            ClientHint pinHintIn) 
+            ClientHint pinHintIn,
+            int        rhsOffsetIn = -1) 
     {
       attrType = attrTypeIn;       
       attrLength = attrLengthIn;
@@ -31,19 +32,40 @@ public:
       compOp = compOpIn;
       value = valueIn;
       pinHint = pinHintIn;
+      rhsOffset = rhsOffsetIn;
     }
 
   CompOp initOp() const { return compOp; }
+  AttrType GetAttrType() const { return attrType; }
+  int GetAttrLength() const { return attrLength; }
+  int GetAttrOffset() const { return attrOffset; }
+  void* GetValue() const { return value; }
+  // offset of the attribute compared against, -1 when it is a value
+  int GetRhsOffset() const { return rhsOffset; }
+
   bool eval(const char *buf, CompOp c) const;
   bool eval(const char *lhsBuf, const char* rhsValue, CompOp c) const;
+  // Evaluate over the n slots of a page, the records recSize bytes apart
+  // from recs.  Bit i of match - (n+7)/8 bytes laid out like a bitmap - is
+  // set when slot i is in use (clear in freeMap) and its record satisfies
+  // the predicate.
+  void evalPage(const char *recs, int recSize, int n,
+                const char *freeMap, char *match) const;
+  // The same, but only over the slots already set in match - the bits of
+  // records that fail are cleared.  For a conjunction of predicates.
+  void refinePage(const char *recs, int recSize, int n, char *match) const;
 
  private:
+  unsigned long long evalWord(const char *recs, int recSize, int n,
+                              unsigned long long slots) const;
+
   AttrType   attrType;
   int        attrLength;
   int        attrOffset;
   CompOp     compOp;
   void*      value;
   ClientHint pinHint;
+  int        rhsOffset;
 };
 
 #endif // PRED_H
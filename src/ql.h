@@ -17,6 +17,7 @@
 #include "ix.h"
 #include "sm.h"
 #include "iterator.h"
+#include "memory_grant.h"
 
 //
 // QL_Manager: query language (DML)
@@ -70,7 +71,8 @@ class QL_Manager {
                       int nSelAttrs, const AggRelAttr selAttrs[],
                       int nRelations, const char * const relations[],
                       int order, RelAttr orderAttr,
-                      bool group, RelAttr groupAttr) const;
+                      bool group, RelAttr groupAttr,
+                      MemoryBroker* broker = NULL) const;
 
   RC PrintIterator(Iterator* it) const;
 
@@ -19,6 +19,7 @@ const char *QL_WarnMsg[] = {
   (char*)"QL_INVALIDSIZE invalid number of attributes",
   (char*)"key,rid already exists in index",
   (char*)"key,rid combination does not exist in index",
+  (char*)"QL_NOMEM memory grant refused",
 };
 
 const char *QL_ErrorMsg[] = {
@@ -18,8 +18,9 @@ void QL_PrintError(RC rc);
                                                // exists in index
 #define QL_NOSUCHENTRY    (START_QL_WARN + 3)  // key,rid combination
                                                // does not exist in index
+#define QL_NOMEM          (START_QL_WARN + 4)  // memory grant refused
 
-#define QL_LASTWARN QL_ENTRYEXISTS
+#define QL_LASTWARN QL_NOMEM
 
 
 #define QL_BADJOINKEY      (START_QL_ERR - 0)
@@ -274,12 +274,17 @@ RC QL_Manager::Select(int nSelAttrs, const AggRelAttr selAttrs_[],
 
   // cerr << "sem checks done" << endl;
 
+  // scratch memory the sorts and merge joins of this query share
+  string workmem("");
+  smm.Get("workmem", workmem);
+  MemoryBroker broker(rmm.GetPF_Manager(), atoi(workmem.c_str()));
+
   Iterator* it = NULL;
 
   if(nRelations == 1) {
     it = GetLeafIterator(relations[0], nConditions, conditions, 0, NULL, order, &orderAttr);
     RC rc = MakeRootIterator(it, nSelAttrs, selAggAttrs, nRelations, relations,
-                             order, orderAttr, group, groupAttr);
+                             order, orderAttr, group, groupAttr, &broker);
     if(rc != 0) return rc;
     rc = PrintIterator(it);
     if(rc != 0) return rc;
@@ -385,7 +390,8 @@ RC QL_Manager::Select(int nSelAttrs, const AggRelAttr selAttrs_[],
 
       if(indexMergeCond > -1 && i == 1) { //both have to be indexscans
         RC status = -1;
-        newit = new MergeJoin(lixit, rixit, status, jcount, indexMergeCond, jcond);
+        newit = new MergeJoin(lixit, rixit, status, jcount, indexMergeCond, jcond,
+                              &broker);
         if (status != 0) return status;
       } else {
         if(rixit != NULL && nlijoin) {
@@ -405,7 +411,7 @@ RC QL_Manager::Select(int nSelAttrs, const AggRelAttr selAttrs_[],
 
       if(i == nRelations - 1) {
         RC rc = MakeRootIterator(newit, nSelAttrs, selAggAttrs, nRelations, relations,
-                                 order, orderAttr, group, groupAttr);
+                                 order, orderAttr, group, groupAttr, &broker);
         if(rc != 0) return rc;
       }
 
@@ -475,7 +481,8 @@ RC QL_Manager::MakeRootIterator(Iterator*& newit,
                                 int nSelAttrs, const AggRelAttr selAttrs[],
                                 int nRelations, const char * const relations[],
                                 int order, RelAttr orderAttr,
-                                bool group, RelAttr groupAttr) const
+                                bool group, RelAttr groupAttr,
+                                MemoryBroker* broker) const
 {
   RC status = -1;
 
@@ -507,7 +514,8 @@ RC QL_Manager::MakeRootIterator(Iterator*& newit,
       // cout << "already sorted - no need for sort operator - agg\n";
     } else {
       // cout << "Making sort iterator - agg\n";
-      newit = new Sort(newit, d.attrType, d.attrLength, d.offset, status, desc);
+      newit = new Sort(newit, d.attrType, d.attrLength, d.offset, status, desc,
+                       broker);
       if(status != 0) return status;
     }
 
@@ -587,7 +595,8 @@ RC QL_Manager::MakeRootIterator(Iterator*& newit,
       // cout << "already sorted - no need for sort operator\n";
     } else {
       // cout << "Making sort iterator\n";
-      newit = new Sort(newit, d.attrType, d.attrLength, d.offset, status, desc);
+      newit = new Sort(newit, d.attrType, d.attrLength, d.offset, status, desc,
+                       broker);
       if(status != 0) return status;
     }
   }
@@ -7,6 +7,7 @@
 
 #include <iostream>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <unistd.h>
 #include "redbase.h"
@@ -29,17 +30,31 @@ int main(int argc, char *argv[])
 {
   RC rc;
 
-  // Look for 2 arguments.  The first is always the name of the program
-  // that was executed, and the second should be the name of the
-  // database.
-  if (argc != 2) {
-    cerr << "Usage: " << argv[0] << " dbname\n";
+  // The first argument is always the name of the program that was
+  // executed, and the last should be the name of the database.
+  // "-b numPages" sets the number of pages in the buffer pool, "-H" puts
+  // it on huge pages and "-D" opens files with direct I/O.
+  int numBufferPages = 0;
+  int options = 0;
+  int i;
+  for (i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "-b") == 0 && i + 1 < argc - 1)
+      numBufferPages = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-H") == 0)
+      options |= PF_HUGE_PAGES;
+    else if (strcmp(argv[i], "-D") == 0)
+      options |= PF_DIRECT_IO;
+    else
+      break;
+  }
+  if (argc < 2 || i != argc - 1) {
+    cerr << "Usage: " << argv[0] << " [-b numPages] [-H] [-D] dbname\n";
     exit(1);
   }
-  char *dbname = argv[1];
+  char *dbname = argv[argc - 1];
 
   // initialize RedBase components
-  PF_Manager pfm;
+  PF_Manager pfm(numBufferPages, options);
   RM_Manager rmm(pfm);
   IX_Manager ixm(pfm);
   SM_Manager smm(ixm, rmm);
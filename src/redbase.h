@@ -87,7 +87,9 @@ enum AggFun {
 // Pin Strategy Hint
 //
 enum ClientHint {
-    NO_HINT                                     // default value
+    NO_HINT,                                    // default value
+    SEQ_SCAN_HINT                               // each page is read once, in
+                                                // order; use a buffer ring
 };
 
 //
@@ -24,13 +24,36 @@
 #include "pf.h"
 #include "predicate.h"
 
+//
+// Record formats
+//
+#define RM_FIXED    0  // records in fixed-size slots found by a bitmap
+#define RM_SLOTTED  1  // a slot directory, STRING fields at their length
+#define RM_PAX      2  // fixed-size slots, each field in a minipage of its own
+#define RM_COMPRESSED 3 // RM_PAX with each minipage encoded to fit more slots
+
+//
+// RM_Fields: fields of a record, in order of offset.  For RM_SLOTTED the
+// fields stored at their real length, each a NUL-padded string of at most
+// MAXSTRINGLEN bytes.  For RM_PAX and RM_COMPRESSED the fields that get a
+// minipage, which cover the record from start to end.
+//
+struct RM_Fields {
+  int n;
+  short offset[MAXATTRS];
+  short length[MAXATTRS];
+} __attribute__((packed));
+
 //
 // RM_FileHdr: Header structure for files
 //
 struct RM_FileHdr {
-  int firstFree;     // first free page in the linked list
+  int firstFree;     // first page that may have free slots - none before
+                     // it do.  Where the free-space map search starts.
   int numPages;      // # of pages in the file
   int extRecordSize;  // record size as seen by users.
+  int format;        // RM_FIXED, RM_SLOTTED, RM_PAX or RM_COMPRESSED
+  RM_Fields fields;  // none for RM_FIXED
 } __attribute__((packed));
 
 class bitmap {
@@ -48,6 +71,28 @@ public:
   int numChars() const; // return size of char buffer to hold bitmap
   int to_char_buf(char *, int len) const; //serialize content to char buffer
   int getSize() const { return size; } 
+
+  // 64 bits at a time - bit j of word i is bit 64*i+j, bits past the end
+  // read as 0
+  int numWords() const { return (size + 63) / 64; }
+  unsigned long long word(unsigned int i) const
+    { return word(buffer, size, i); }
+  // first set/clear bit from bitNumber on, getSize() if there is none
+  int nextSet(unsigned int bitNumber) const
+    { return nextSet(buffer, size, bitNumber); }
+  int nextClear(unsigned int bitNumber) const
+    { return nextClear(buffer, size, bitNumber); }
+  // number of set bits
+  int count() const { return count(buffer, size); }
+
+  // the same on a serialized bitmap of numBits bits, e.g. one on a page
+  static unsigned long long word(const char * buf, unsigned int numBits,
+                                 unsigned int i);
+  static int nextSet(const char * buf, unsigned int numBits,
+                     unsigned int bitNumber);
+  static int nextClear(const char * buf, unsigned int numBits,
+                       unsigned int bitNumber);
+  static int count(const char * buf, unsigned int numBits);
 private:
   unsigned int size;
   char * buffer;
@@ -62,10 +107,8 @@ ostream& operator <<(ostream & os, const bitmap& b);
 #define RM_PAGE_FULLY_USED      -2       // page is fully used with no free slots
 // not a member of the free list
 struct RM_PageHdr {
-  int nextFree;       // nextFree can be any of these values:
-                      //  - the number of the next free page
-                      //  - RM_PAGE_LIST_END if this is last free page
-                      //  - RM_PAGE_FULLY_USED if the page is not free
+  int nextFree;       // left from the free page list the free-space map
+                      // replaced - RM_PAGE_LIST_END on new pages
   char * freeSlotMap; // A bitmap that tracks the free slots within 
                       // the page
   int numSlots;
@@ -106,6 +149,199 @@ RM_PageHdr(int numSlots) : numSlots(numSlots), numFreeSlots(numSlots)
     }
 };
 
+//
+// RM_PageHdrView: RM_PageHdr read and written where it sits on a pinned
+// page, with nothing copied out or allocated.  The layout is the one
+// RM_PageHdr::to_buf writes; a set bit in the map means the slot is free.
+//
+class RM_PageHdrView {
+public:
+  RM_PageHdrView(char * pageData, int numSlots)
+    : buf(pageData), numSlots(numSlots) {}
+
+  int GetNextFree() const { return GetInt(0); }
+  void SetNextFree(int nextFree) { SetInt(0, nextFree); }
+  int GetNumFreeSlots() const { return GetInt(2); }
+  void SetNumFreeSlots(int numFree) { SetInt(2, numFree); }
+
+  bool IsFree(int slot) const
+    { return (Map()[slot/8] >> (slot%8)) & 1; }
+  void SetFree(int slot) { Map()[slot/8] |= (1 << (slot%8)); }
+  void SetUsed(int slot) { Map()[slot/8] &= ~(1 << (slot%8)); }
+
+  // first free slot, numSlots if the page is full
+  int FirstFree() const { return bitmap::nextSet(Map(), numSlots, 0); }
+  // first free slot from slot on, numSlots if there is none
+  int NextFree(int slot) const
+    { return bitmap::nextSet(Map(), numSlots, slot); }
+  // first slot from slot on that holds a record, numSlots if none does
+  int NextUsed(int slot) const
+    { return bitmap::nextClear(Map(), numSlots, slot); }
+  int CountFree() const { return bitmap::count(Map(), numSlots); }
+  // the slot map itself - a bitmap of numSlots bits, set if free
+  const char * GetFreeMap() const { return Map(); }
+  // header of a new page with every slot free
+  void Init(int nextFree);
+
+  // bytes of the header of a page with numSlots slots - slots follow it
+  static int Size(int numSlots) { return 3 * sizeof(int) + MapSize(numSlots); }
+  static int MapSize(int numSlots) { return (numSlots + 7) / 8; }
+
+private:
+  char * Map() const { return buf + 3 * sizeof(int); }
+  int GetInt(int i) const
+    { int v; memcpy(&v, buf + i * sizeof(int), sizeof(int)); return v; }
+  void SetInt(int i, int v) { memcpy(buf + i * sizeof(int), &v, sizeof(int)); }
+
+  char * buf;
+  int numSlots;
+};
+
+//
+// RM_SlottedPageView: a page of an RM_SLOTTED file, read and written where
+// it sits.  After the header comes the slot directory, one entry for each
+// slot giving the offset and length of its record; records are packed from
+// the end of the page down.  An offset of 0 marks a free slot.  The first
+// byte of a stored record tells whether it is the record (RM_REC), a stub
+// holding the RID it moved to (RM_MOVED) or a record moved in, led by the
+// RID of its stub (RM_MOVEDIN).
+//
+#define RM_REC      0
+#define RM_MOVED    1
+#define RM_MOVEDIN  2
+// a stored record has room for a stub
+#define RM_MIN_STORED (1 + 2 * (int)sizeof(int))
+
+class RM_SlottedPageView {
+public:
+  RM_SlottedPageView(char * pageData, int pageSize)
+    : buf(pageData), pageSize(pageSize) {}
+
+  int GetNumSlots() const { return GetInt(0); }
+  // start of the records - free space ends here
+  int GetFreeEnd() const { return GetInt(1); }
+  // bytes the records take
+  int GetUsed() const { return GetInt(2); }
+
+  int GetOffset(int slot) const { return GetShort(slot, 0); }
+  int GetLength(int slot) const { return GetShort(slot, 1); }
+  bool IsFree(int slot) const
+    { return slot >= GetNumSlots() || GetOffset(slot) == 0; }
+  char * GetRec(int slot) const { return buf + GetOffset(slot); }
+
+  // bytes free for records and directory entries, counting the holes left
+  // by records that were freed or shrunk
+  int FreeBytes() const
+    { return pageSize - Size(GetNumSlots()) - GetUsed(); }
+  // first free slot, GetNumSlots() when a new entry is needed
+  int FreeSlot() const;
+  // whether a record of len bytes can go in a free slot
+  bool Fits(int len) const
+    { return FreeBytes() >= len +
+        (FreeSlot() == GetNumSlots() ? 2 * (int)sizeof(short) : 0); }
+  // Give slot - from FreeSlot - len bytes, compacting the page if the free
+  // space is in pieces.  The record goes where the result points.
+  char * Place(int slot, int len);
+  // Change the length of the record in slot, moving it if it grows
+  char * Resize(int slot, int len);
+  void Free(int slot);
+  void Init();
+
+  static int Size(int numSlots)
+    { return 3 * sizeof(int) + numSlots * 2 * sizeof(short); }
+
+private:
+  void Compact();
+  int GetInt(int i) const
+    { int v; memcpy(&v, buf + i * sizeof(int), sizeof(int)); return v; }
+  void SetInt(int i, int v) { memcpy(buf + i * sizeof(int), &v, sizeof(int)); }
+  int GetShort(int slot, int i) const
+    { unsigned short v;
+      memcpy(&v, buf + Size(slot) + i * sizeof(short), sizeof(short));
+      return v; }
+  void SetSlot(int slot, int offset, int length);
+
+  char * buf;
+  int pageSize;
+};
+
+//
+// RM_PackedPageView: a page of an RM_COMPRESSED file.  The RM_PageHdr and
+// its slot bitmap come first, then the number of slots encoded - one past
+// the last in use - and a header for each field telling how its minipage is
+// encoded.  The minipages follow.  Each time the page is written every
+// minipage is encoded the smallest way for the values on the page; a free
+// slot takes the value of the slot before it, which costs next to nothing.
+//
+#define RM_RAW   0  // the values one after another
+#define RM_DICT  1  // n distinct values, then a code of bits bits per slot
+#define RM_RLE   2  // n runs: their values, then the slot each ends before
+#define RM_FOR   3  // 4 byte ints as offsets of bits bits from base
+
+struct RM_ColHdr {
+  char enc;
+  char bits;
+  unsigned short offset; // of the minipage from the first one
+  unsigned short n;      // values of a dictionary or runs
+  int base;
+} __attribute__((packed));
+
+class RM_PackedPageView {
+public:
+  RM_PackedPageView(char * pageData, int numSlots, const RM_Fields &fields,
+                    int pageSize)
+    : buf(pageData), numSlots(numSlots), fields(&fields),
+      pageSize(pageSize) {}
+
+  // slots encoded - none from here on is in use
+  int GetTop() const
+    { int v; memcpy(&v, buf + RM_PageHdrView::Size(numSlots), sizeof(int));
+      return v; }
+  RM_ColHdr GetCol(int f) const
+    { RM_ColHdr c; memcpy(&c, ColHdr(f), sizeof(c)); return c; }
+  const char * GetData(int f) const
+    { return buf + Size(numSlots, fields->n) + GetCol(f).offset; }
+  // bytes the minipages may take
+  int DataSpace() const { return pageSize - Size(numSlots, fields->n); }
+
+  // the code of slot s in a DICT minipage, its offset in a FOR one
+  unsigned int Code(int f, int s) const;
+  void ReadField(int f, int s, char * out) const;
+  // the record in slot s
+  void Read(int s, char * pData) const;
+  // field f of each slot up to GetTop() into out, one after another
+  void Unpack(int f, char * out) const;
+  // every field into cols, laid out as the slots of an RM_PAX page
+  void UnpackAll(char * cols) const;
+  // bytes the minipages would take for the slots in use, their records in
+  // cols laid out as UnpackAll leaves them
+  int PackedSize(const char * cols) const;
+  // Encode the records in use in cols.  False, and the page as it was, if
+  // they would leave less than reserve bytes free.
+  bool Pack(const char * cols, int reserve);
+  void Init();
+
+  // bytes before the first minipage
+  static int Size(int numSlots, int numFields)
+    { return RM_PageHdrView::Size(numSlots) + sizeof(int) +
+        numFields * sizeof(RM_ColHdr); }
+
+private:
+  char * ColHdr(int f) const
+    { return buf + RM_PageHdrView::Size(numSlots) + sizeof(int) +
+        f * sizeof(RM_ColHdr); }
+  // encoding of each field and the bytes all take - src[s] is the slot
+  // whose value slot s stores
+  int Plan(const char * cols, const int * src, int top,
+           RM_ColHdr * hdrs) const;
+  int Top() const;
+
+  char * buf;
+  int numSlots;
+  const RM_Fields * fields;
+  int pageSize;
+};
+
 //
 // RM_Record: RM Record interface
 //
@@ -147,11 +383,33 @@ public:
 
   // Given a RID, return the record
   RC GetRec     (const RID &rid, RM_Record &rec) const;
+  // Given a RID, pin its page and point pData at the record in the buffer
+  // pool instead of copying it.  pData is good until UnpinRec.  Records of
+  // an RM_SLOTTED, RM_PAX or RM_COMPRESSED file are put together in a
+  // buffer of the handle that the next PinRec reuses.
+  RC PinRec     (const RID &rid, char *&pData) const;
+  RC UnpinRec   (const RID &rid) const;
 
   RC InsertRec  (const char *pData, RID &rid);       // Insert a new record
+  // Insert n records stored one after another at rows, their RIDs going to
+  // rids.  Each page is filled with as many as it takes before moving on,
+  // and new pages are allocated together.
+  RC InsertRecs (const char *rows, int n, RID *rids);
 
   RC DeleteRec  (const RID &rid);                    // Delete a record
-  RC UpdateRec  (const RM_Record &rec);              // Update a record
+  // Update a record.  RM_PAGEFULL if the record no longer fits on its
+  // RM_COMPRESSED page once encoded.
+  RC UpdateRec  (const RM_Record &rec);
+
+  // Move records off the last pages of the file into free space on earlier
+  // ones, at most n of them.  Each moved record goes to rows, one after
+  // another, with the RID it had in from and the one it has now in to, in
+  // the order they moved.  nMoved is less than n once the records are on
+  // as few pages as they will go.
+  RC Vacuum     (int n, char *rows, RID *from, RID *to, int &nMoved);
+  // Give back the pages left empty at the end of the file.  Anything still
+  // holding the RIDs records had there must have been updated first.
+  RC Truncate   ();
 
   // Forces a page (along with any contents stored in this class)
   // from the buffer pool to disk.  Default value forces all pages.
@@ -161,19 +419,84 @@ public:
   bool hdrChanged() const { return bHdrChanged; }
   int fullRecordSize() const { return hdr.extRecordSize; }
   int GetNumPages() const { return hdr.numPages; }
+  // records a page holds - for RM_SLOTTED the most it can hold
   int GetNumSlots() const;
+  int GetFormat() const { return hdr.format; }
+  bool IsSlotted() const { return hdr.format == RM_SLOTTED; }
+  bool IsPax() const { return hdr.format == RM_PAX; }
+  bool IsCompressed() const { return hdr.format == RM_COMPRESSED; }
 
   RC IsValid() const;
 private:
   bool IsValidPageNum (const PageNum pageNum) const;
   bool IsValidRID(const RID rid) const;
 
-  // Return next free page or allocate one as needed.
-  RC GetNextFreePage(PageNum& pageNum);
-  RC GetNextFreeSlot(PF_PageHandle& ph, PageNum& pageNum, SlotNum&);
-  RC GetPageHeader(PF_PageHandle ph, RM_PageHdr & pHdr) const;
-  RC SetPageHeader(PF_PageHandle ph, const RM_PageHdr& pHdr);
+  // Return the next page whose map entry is at least minCat, or allocate
+  // nPages new ones and return the first
+  RC GetNextFreePage(PageNum& pageNum, int nPages = 1, int minCat = 1);
+  // Allocate nPages pages and return the first that is not a map page -
+  // RM_NOSPACE while spaceEnd is set
+  RC NewPages(int nPages, PageNum& pageNum);
+  // first slot on page p with anything in it, -1 if none
+  RC FirstUsed(PageNum p, SlotNum& s) const;
+
+  // Free-space map: 4 bits for each data page giving how much of it is
+  // free - see SpaceCat.  The entries for the first pages follow the file
+  // header on page 0; after those come map pages, each followed by the data
+  // pages it covers.
+  static int SpaceCat(int numFree, int numSlots);
+  // the same for free bytes of an RM_SLOTTED page - an entry of c means
+  // at least c fifteenths of SlottedSpace() are free
+  int SlottedCat(int freeBytes) const;
+  int SlottedSpace() const;
+  int HdrMapEntries() const;
+  int MapPageEntries() const;
+  bool IsMapPage(PageNum p) const;
+  // map page holding the entry of data page p, and the entry's byte and
+  // nibble on it
+  void MapEntry(PageNum p, PageNum& mapPage, int& byte, int& shift) const;
+  RC SetSpace(PageNum p, int cat);
+  // first page from p on whose map entry is at least minCat, -1 if none
+  // - none from spaceEnd on
+  RC FindSpace(PageNum from, int minCat, PageNum& p) const;
+
+  // RM_SLOTTED format - rm_slotted.cc
+  // bytes a record takes on a page, the leading byte included
+  int StoredSize(const char *pData) const;
+  // write the record with the leading byte flag, StoredSize bytes
+  void Encode(const char *pData, char flag, char *pStored) const;
+  void Decode(const char *pStored, char *pData) const;
+  // decode the record of a stub into pData
+  RC GetMoved(const char *pStub, char *pData) const;
+  RC PinSlotted(const RID &rid, char *&pData) const;
+  RC InsertSlotted(const char *rows, int n, RID *rids);
+  RC DeleteSlotted(const RID &rid);
+  RC UpdateSlotted(const RID &rid, const char *pData);
+  // store the record of stub, flagged RM_MOVEDIN, on some page other than
+  // the stub's
+  RC PlaceMoved(const char *pData, const RID &stub, RID &rid);
+  // free the slot of a moved record
+  RC FreeMoved(const char *pStub);
+  RC SetSlottedSpace(PageNum p, int oldFree, int newFree);
+  // Vacuum the record or stub in slot s of page p.  A record moved in is
+  // placed again and its stub pointed there, keeping its RID.
+  RC MoveSlotted(PageNum p, SlotNum s, char *rows, RID *from, RID *to,
+                 int &nMoved);
+
+  // RM_COMPRESSED format - rm_packed.cc
+  RC InsertPacked(const char *rows, int n, RID *rids);
+  RC UpdatePacked(char *pPage, SlotNum s, const char *pData);
+  // bytes an insert leaves free on a page for its records to grow
+  int PackReserve() const { return pfHandle->GetPageSize() / 16; }
+
   RC GetSlotPointer(PF_PageHandle ph, SlotNum s, char *& pData) const;
+  // Copy a record into or out of slot s, pSlots being where the slots of a
+  // page start.  An RM_PAX record is spread over the minipages, as is an
+  // RM_COMPRESSED one in the records of a page it decoded.
+  void WriteSlot(char *pSlots, int numSlots, SlotNum s,
+                 const char *pData) const;
+  void ReadSlot(const char *pSlots, int numSlots, SlotNum s,
+                char *pData) const;
 
   // write hdr member using a newly open file's header page
   RC GetFileHeader(PF_PageHandle ph);
@@ -184,6 +507,10 @@ private:
   RM_FileHdr hdr;                                // file header
   bool bFileOpen;                                // file open flag
   bool bHdrChanged;                              // dirty flag for file hdr
+  mutable char * recBuf;                         // record PinRec put together
+  char * packBuf;              // records of an RM_COMPRESSED page, decoded
+  PageNum spaceEnd;            // while vacuuming, no record goes on this
+                               // page or after it - otherwise -1
 };
 
 //
@@ -201,17 +528,61 @@ class RM_FileScan {
                 CompOp     compOp,
                 void       *value,
                 ClientHint pinHint = NO_HINT); // Initialize a file scan
+  // Scan for the records that satisfy all of nPreds predicates.  Each is
+  // evaluated against the records in the pinned page before anything is
+  // copied; a predicate may compare two attributes of the record.
+  RC OpenScan  (const RM_FileHandle &fileHandle,
+                int        nPreds,
+                const Predicate preds[],
+                ClientHint pinHint = NO_HINT);
   RC GetNextRec(RM_Record &rec);               // Get next matching record
+  // Get next matching record without copying it.  The page being scanned
+  // stays pinned while its slots are read, so pData points into the buffer
+  // pool - or a buffer of the scan for RM_SLOTTED and RM_PAX files - and is
+  // good until the next call, resetState or CloseScan.
+  RC GetNextRec(char *&pData, RID &rid);
   RC CloseScan ();                             // Close the scan
+  // Read through a buffer ring of numPages frames from now on
+  RC SetRingSize(int numPages);
   bool IsOpen() const { return (bOpen && prmh != NULL && pred != NULL); }
-  void resetState() { current = RID(1, -1); }
+  void resetState();
   RC GotoPage(PageNum p);
   int GetNumSlotsPerPage() const { return prmh->GetNumSlots(); }
  private:
-  Predicate * pred;
+  // Move to the next matching slot, leaving its page pinned
+  RC NextSlot(char *&pData);
+  RC NextSlotted(char *&pData);
+  RC UnpinPage();
+  // Evaluate the predicates over the whole of the pinned page
+  void FilterPage(PageNum p);
+  void FilterPax(RM_PageHdrView &pHdr);
+  void FilterPacked(RM_PageHdrView &pHdr);
+  void SetColumns();
+  bool Matches(const char *pData) const;
+
+  Predicate * pred; // nPreds of them, all must hold
+  int nPreds;
   RM_FileHandle * prmh;
   RID current;
   bool bOpen;
+  int ring; // PF buffer ring of a SEQ_SCAN_HINT scan or PF_NO_RING
+  PageNum pinned;  // page the scan holds pinned or -1
+  char * pPage;    // its data
+  int numSlots;
+  int slotOffset;  // first slot from the start of a page
+  char * match;    // slots of matchPage that satisfy the predicates
+  PageNum matchPage; // -1 if none
+  bool bMatchPinned; // match was made under the pin held now
+  char * recBuf;   // record of a slotted or PAX file, put together
+  // RM_PAX: pred rebased onto the minipage of its attribute, which starts
+  // colStart bytes into the slots and holds a value every colStride bytes.
+  // A colStride of 0 means the predicate needs the whole record.  The
+  // same for RM_COMPRESSED, colField being the field of the minipage.
+  Predicate * colPred;
+  int * colStart;
+  int * colStride;
+  int * colField;
+  char * colBuf;   // a minipage of an RM_COMPRESSED page, decoded
 };
 
 //
@@ -222,12 +593,17 @@ public:
   RM_Manager    (PF_Manager &pfm);
   ~RM_Manager   ();
 
-  RC CreateFile (const char *fileName, int recordSize);
+  RC CreateFile (const char *fileName, int recordSize,
+                 int pageSize = PF_PAGE_SIZE, int format = RM_FIXED,
+                 const RM_Fields *fields = NULL);
   RC DestroyFile(const char *fileName);
-  RC OpenFile   (const char *fileName, RM_FileHandle &fileHandle);
+  RC OpenFile   (const char *fileName, RM_FileHandle &fileHandle,
+                 int openFlags = 0);
 
   RC CloseFile  (RM_FileHandle &fileHandle);
 
+  PF_Manager& GetPF_Manager() const { return pfm; }
+
 private:
   PF_Manager&   pfm; // A reference to the external PF_Manager
 };
@@ -21,6 +21,7 @@ using namespace std;
 const char *RM_WarnMsg[] = {
   (char*)"bad record size <= 0",
   (char*)"This rid has no record",
+  (char*)"no room for the record on the pages before the bound",
 };
 
 const char *RM_ErrorMsg[] = {
@@ -33,6 +34,7 @@ const char *RM_ErrorMsg[] = {
   (char*)"file is not open",
   (char*)"Bad RID - invalid page num or slot num",
   (char*)"end of file",
+  (char*)"record does not fit on its page any more",
 };
 
 //
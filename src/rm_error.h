@@ -15,8 +15,9 @@ void PrintErrorAll(RC rc);
 
 #define RM_BADRECSIZE      (START_RM_WARN + 0)  // rec size invalid <= 0
 #define RM_NORECATRID      (START_RM_WARN + 1)  // This rid has no record
+#define RM_NOSPACE         (START_RM_WARN + 2)  // no room before the bound
 
-#define RM_LASTWARN RM_NORECATRID
+#define RM_LASTWARN RM_NOSPACE
 
 #define RM_SIZETOOBIG      (START_RM_ERR - 0)  // record size too big
 #define RM_PF              (START_RM_ERR - 1)  // error in PF
@@ -27,7 +28,8 @@ void PrintErrorAll(RC rc);
 #define RM_FNOTOPEN        (START_RM_ERR - 6)
 #define RM_BAD_RID         (START_RM_ERR - 7)
 #define RM_EOF             (START_RM_ERR - 8)  // end of file
+#define RM_PAGEFULL        (START_RM_ERR - 9)  // no room left on the page
 
-#define RM_LASTERROR RM_EOF
+#define RM_LASTERROR RM_PAGEFULL
 
 #endif // RM_ERROR_H
@@ -9,6 +9,7 @@
 #include <cstdio>
 #include <iostream>
 #include <cassert>
+#include <algorithm>
 #include "rm.h"
 
 using namespace std;
@@ -21,7 +22,8 @@ using namespace std;
 // information on every page).
 
 RM_FileHandle::RM_FileHandle() 
-  :pfHandle(NULL), bFileOpen(false), bHdrChanged(false)
+  :pfHandle(NULL), bFileOpen(false), bHdrChanged(false), recBuf(NULL),
+   packBuf(NULL), spaceEnd(-1)
 {
 }
 
@@ -53,9 +55,14 @@ RC RM_FileHandle::Open(PF_FileHandle* pfh, int size)
 
   this->GetFileHeader(ph); // write into hdr
   // std::cerr << "RM_FileHandle::Open hdr.numPages" << hdr.numPages << std::endl;
+  if(IsSlotted() || IsPax() || IsCompressed())
+    recBuf = new char[hdr.extRecordSize];
+  if(IsCompressed())
+    packBuf = new char[GetNumSlots() * hdr.extRecordSize];
 
   
-  bHdrChanged = true;
+  // a read-only (mapped) file cannot take the header back
+  bHdrChanged = !pfHandle->IsReadOnly();
   RC invalid = IsValid(); if(invalid) return invalid; 
 
   return 0;
@@ -68,139 +75,191 @@ RC RM_FileHandle::GetPF_FileHandle(PF_FileHandle &lvalue) const
   return 0;
 }
 
-RC RM_FileHandle::GetNextFreeSlot(PF_PageHandle & ph, PageNum& pageNum, SlotNum& slotNum)
+RC RM_FileHandle::GetNextFreePage(PageNum& pageNum, int nPages, int minCat) 
 {
   RC invalid = IsValid(); if(invalid) return invalid; 
+  RC rc;
+  if((rc = FindSpace(hdr.firstFree, minCat, pageNum)))
+    return rc;
+  if(pageNum == -1 && (rc = NewPages(nPages, pageNum)))
+    return rc;
+  // when any space would do, every page before it is full
+  if(pageNum != hdr.firstFree && minCat == 1) {
+    hdr.firstFree = pageNum;
+    bHdrChanged = true;
+  }
+  return 0;
+}
 
-  RM_PageHdr pHdr(this->GetNumSlots());
+RC RM_FileHandle::NewPages(int nPages, PageNum& pageNum)
+{
+  PageNum first;
   RC rc;
-  
-  if ((rc= this->GetNextFreePage(pageNum)) 
-      || (rc = pfHandle->GetThisPage(pageNum, ph))
-      // Needs to be called everytime GetThisPage is called.
-      || (rc = pfHandle->UnpinPage(pageNum)) 
-      || (rc = this->GetPageHeader(ph, pHdr)))
+  if(spaceEnd != -1)
+    return RM_NOSPACE;
+  if((rc = pfHandle->AllocatePages(nPages, first)))
+    return rc;
+  assert(first == hdr.numPages); // pages only go back from the end
+  hdr.numPages += nPages;
+  bHdrChanged = true;
+
+  pageNum = -1;
+  for(PageNum p = first; p < first + nPages; p++) {
+    // a map page comes zeroed - no space on any page it covers yet
+    if(IsMapPage(p))
+      continue;
+    PF_PageHandle ph;
+    char *pData;
+    if ((rc = pfHandle->GetThisPage(p, ph)) ||
+        (rc = ph.GetData(pData)))
       return rc;
-  bitmap b(pHdr.freeSlotMap, this->GetNumSlots());  
-  // std::cerr << "RM_FileHandle::GetNextFreeSlot from pHdr" << b << endl;
-  for (int i = 0; i < this->GetNumSlots(); i++) 
-  {
-    if (b.test(i)) { 
-      slotNum = i;
-      return 0;
+    // Add page header - initially all slots are free
+    int cat;
+    if(IsSlotted()) {
+      RM_SlottedPageView v(pData, pfHandle->GetPageSize());
+      v.Init();
+      cat = SlottedCat(v.FreeBytes());
+    } else {
+      RM_PageHdrView(pData, GetNumSlots()).Init(RM_PAGE_LIST_END);
+      if(IsCompressed())
+        RM_PackedPageView(pData, GetNumSlots(), hdr.fields,
+                          pfHandle->GetPageSize()).Init();
+      cat = SpaceCat(GetNumSlots(), GetNumSlots());
     }
+    if ((rc = pfHandle->MarkDirty(p)) ||
+        (rc = pfHandle->UnpinPage(p)) ||
+        (rc = SetSpace(p, cat)))
+      return rc;
+    if(pageNum == -1)
+      pageNum = p;
   }
-  // This page is full
-  return -1; // unexpected error
+  if(pageNum == -1) // the one page was a map page
+    return NewPages(nPages, pageNum);
+  return 0;
 }
 
-RC RM_FileHandle::GetNextFreePage(PageNum& pageNum) 
+// Map entry of a page with numFree of numSlots slots free - the sixteenths
+// free rounded down, but 0 only for a full page
+int RM_FileHandle::SpaceCat(int numFree, int numSlots)
 {
-  RC invalid = IsValid(); if(invalid) return invalid; 
-  PF_PageHandle ph;
-  RM_PageHdr pHdr(this->GetNumSlots());
-  PageNum p;
-
-  if(hdr.firstFree != RM_PAGE_LIST_END) 
-  {
-    // this last page on the free list might actually be full
-    RC rc;
-    if ((rc = pfHandle->GetThisPage(hdr.firstFree, ph))
-        || (rc = ph.GetPageNum(p))
-        || (rc = pfHandle->MarkDirty(p))
-        // Needs to be called everytime GetThisPage is called.
-        || (rc = pfHandle->UnpinPage(hdr.firstFree))
-        || (rc = this->GetPageHeader(ph, pHdr)))
-      return rc;
+  if(numFree <= 0)
+    return 0;
+  int c = numFree * 15 / numSlots;
+  return (c > 0) ? c : 1;
+}
 
-  }
-  if( //we need to allocate a new page
-      // because this is the firs time
-    hdr.numPages == 1 || 
-    hdr.firstFree == RM_PAGE_LIST_END ||
-    // or due to a full page
-//      (pHdr.numFreeSlots == 0 && pHdr.nextFree == RM_PAGE_FULLY_USED)
-    (pHdr.numFreeSlots == 0)
-    ) 
-  {
-
-    if(pHdr.nextFree == RM_PAGE_FULLY_USED)
-    {
-      // std::cerr << "RM_FileHandle::GetNextFreePage - Page Full!" << endl;
-    }
-    {
-      char *pData;
-
-      RC rc;
-      if ((rc = pfHandle->AllocatePage(ph)) ||
-          (rc = ph.GetData(pData)) ||
-          (rc = ph.GetPageNum(pageNum)))
-        return(rc);
-      
-      // Add page header
-      RM_PageHdr phdr(this->GetNumSlots());
-      phdr.nextFree = RM_PAGE_LIST_END;
-      bitmap b(this->GetNumSlots());
-      b.set(); // Initially all slots are free
-      b.to_char_buf(phdr.freeSlotMap, b.numChars());
-      // std::cerr << "RM_FileHandle::GetNextFreePage new!!" << b << endl;
-      phdr.to_buf(pData);
-
-      // the default behavior of the buffer pool is to pin pages
-      // let us make sure that we unpin explicitly after setting
-      // things up
-      if (
-//        (rc = pfHandle->MarkDirty(pageNum)) ||
-        (rc = pfHandle->UnpinPage(pageNum)))
-        return rc;
-    }
+// Rounded down all the way, so that a record that needs at most c
+// fifteenths of a page fits on any page with an entry of c
+int RM_FileHandle::SlottedCat(int freeBytes) const
+{
+  return (freeBytes > 0) ? freeBytes * 15 / SlottedSpace() : 0;
+}
 
-    { // testing
-      PF_PageHandle ph;
-      pfHandle->GetThisPage(pageNum, ph);
-      // Needs to be called everytime GetThisPage is called.
-      pfHandle->UnpinPage(pageNum);
+int RM_FileHandle::SlottedSpace() const
+{
+  return pfHandle->GetPageSize() - RM_SlottedPageView::Size(0);
+}
 
-      RM_PageHdr pHdr(this->GetNumSlots());
-      RC rc;
-      (rc = this->GetPageHeader(ph, pHdr));
-      bitmap b(pHdr.freeSlotMap, this->GetNumSlots());
+int RM_FileHandle::HdrMapEntries() const
+{
+  return (pfHandle->GetPageSize() - sizeof(RM_FileHdr)) * 2;
+}
 
-      // std::cerr << "RM_FileHandle::GetNextFreePage regen" << b << endl;
-    }
+int RM_FileHandle::MapPageEntries() const
+{
+  return pfHandle->GetPageSize() * 2;
+}
 
+bool RM_FileHandle::IsMapPage(PageNum p) const
+{
+  return p > HdrMapEntries() &&
+    (p - HdrMapEntries() - 1) % (MapPageEntries() + 1) == 0;
+}
 
-    // add page to the free list
-    hdr.firstFree = pageNum;
-    hdr.numPages++;
-    assert(hdr.numPages > 1); // page num 1 would be header page
-    // std::cerr << "RM_FileHandle::GetNextFreePage hdr.numPages is " 
-    //           << hdr.numPages 
-    //           << " method " << this->GetNumPages()
-    //           << endl;
-    bHdrChanged = true;
-    return 0; // pageNum is set correctly
+void RM_FileHandle::MapEntry(PageNum p, PageNum& mapPage, int& byte,
+                             int& shift) const
+{
+  assert(p > 0 && !IsMapPage(p));
+  int e;
+  if(p <= HdrMapEntries()) {
+    mapPage = 0;
+    e = p - 1;
+    byte = sizeof(RM_FileHdr);
+  } else {
+    int q = (p - HdrMapEntries() - 1) % (MapPageEntries() + 1);
+    mapPage = p - q;
+    e = q - 1;
+    byte = 0;
   }
-  // return existing free page
-  pageNum = hdr.firstFree;
-  return 0;
+  byte += e / 2;
+  shift = (e % 2) * 4;
 }
 
-RC RM_FileHandle::GetPageHeader(PF_PageHandle ph, RM_PageHdr& pHdr) const
+RC RM_FileHandle::SetSpace(PageNum p, int cat)
 {
-  char * buf;
-  RC rc = ph.GetData(buf);
-  pHdr.from_buf(buf);
-  return rc;
+  PageNum mapPage;
+  int byte, shift;
+  MapEntry(p, mapPage, byte, shift);
+  PF_PageHandle ph;
+  char * pData;
+  RC rc;
+  if((rc = pfHandle->GetThisPage(mapPage, ph)))
+    return rc;
+  if((rc = ph.GetData(pData)) ||
+     (rc = pfHandle->MarkDirty(mapPage))) {
+    pfHandle->UnpinPage(mapPage);
+    return rc;
+  }
+  pData[byte] = (pData[byte] & ~(0xf << shift)) |
+    (cat << shift);
+  return pfHandle->UnpinPage(mapPage);
 }
 
-RC RM_FileHandle::SetPageHeader(PF_PageHandle ph, const RM_PageHdr& pHdr) 
+RC RM_FileHandle::FindSpace(PageNum from, int minCat, PageNum& p) const
 {
-  char * buf;
   RC rc;
-  if((rc = ph.GetData(buf)))
-    return rc;
-  pHdr.to_buf(buf);
+  p = -1;
+  if(from < 1)
+    from = 1;
+  PageNum end = (spaceEnd != -1) ? spaceEnd : hdr.numPages;
+  while(from < end) {
+    if(IsMapPage(from)) {
+      from++;
+      continue;
+    }
+    // the entries from here on that are on the same map page
+    PageNum mapPage;
+    int byte, shift;
+    MapEntry(from, mapPage, byte, shift);
+    PageNum last = (mapPage == 0) ? HdrMapEntries()
+                                  : mapPage + MapPageEntries();
+    if(last > end - 1)
+      last = end - 1;
+
+    PF_PageHandle ph;
+    char * pData;
+    if((rc = pfHandle->GetThisPage(mapPage, ph)) ||
+       (rc = ph.GetData(pData)))
+      return rc;
+    for(PageNum q = from; q <= last; ) {
+      MapEntry(q, mapPage, byte, shift);
+      unsigned char b = pData[byte];
+      if(shift == 0 && b == 0) { // two full pages
+        q += 2;
+        continue;
+      }
+      if(((b >> shift) & 0xf) >= minCat) {
+        p = q;
+        break;
+      }
+      q++;
+    }
+    if((rc = pfHandle->UnpinPage(mapPage)))
+      return rc;
+    if(p != -1)
+      return 0;
+    from = last + 1;
+  }
   return 0;
 }
 
@@ -222,13 +281,39 @@ RC RM_FileHandle::SetFileHeader(PF_PageHandle ph) const
   return rc;
 }
 
+void RM_FileHandle::WriteSlot(char *pSlots, int numSlots, SlotNum s,
+                              const char *pData) const
+{
+  if(!IsPax() && !IsCompressed()) {
+    memcpy(pSlots + s * fullRecordSize(), pData, fullRecordSize());
+    return;
+  }
+  // the minipage of a field holds its values of all numSlots slots
+  const RM_Fields &f = hdr.fields;
+  for(int i = 0; i < f.n; i++)
+    memcpy(pSlots + numSlots * f.offset[i] + s * f.length[i],
+           pData + f.offset[i], f.length[i]);
+}
+
+void RM_FileHandle::ReadSlot(const char *pSlots, int numSlots, SlotNum s,
+                             char *pData) const
+{
+  if(!IsPax() && !IsCompressed()) {
+    memcpy(pData, pSlots + s * fullRecordSize(), fullRecordSize());
+    return;
+  }
+  const RM_Fields &f = hdr.fields;
+  for(int i = 0; i < f.n; i++)
+    memcpy(pData + f.offset[i],
+           pSlots + numSlots * f.offset[i] + s * f.length[i], f.length[i]);
+}
+
 RC RM_FileHandle::GetSlotPointer(PF_PageHandle ph, SlotNum s, char *& pData) const
 {
   RC invalid = IsValid(); if(invalid) return invalid; 
   RC rc = ph.GetData(pData);
   if (rc >= 0 ) {
-    bitmap b(this->GetNumSlots());
-    pData = pData + (RM_PageHdr(this->GetNumSlots()).size());
+    pData = pData + RM_PageHdrView::Size(this->GetNumSlots());
     pData = pData + s * this->fullRecordSize();
   }
   
@@ -237,14 +322,19 @@ RC RM_FileHandle::GetSlotPointer(PF_PageHandle ph, SlotNum s, char *& pData) con
  
 int RM_FileHandle::GetNumSlots() const
 {
+  if(IsSlotted() && this->fullRecordSize() != 0)
+    return SlottedSpace() / (RM_MIN_STORED + 2 * sizeof(short));
   if(this->fullRecordSize() != 0) {
-    int bytes_available = PF_PAGE_SIZE - sizeof(RM_PageHdr);
+    // pages hold PF_PAGE_SIZE bytes unless the file was created with
+    // another page size
+    int pageSize = pfHandle->GetPageSize();
+    int bytes_available = pageSize - sizeof(RM_PageHdr);
     int slots = floor(1.0 * bytes_available/ (this->fullRecordSize() + 1/8));
-    int r = sizeof(RM_PageHdr) + bitmap(slots).numChars();
+    int r = sizeof(RM_PageHdr) + RM_PageHdrView::MapSize(slots);
     
-    while ((slots*this->fullRecordSize()) + r > PF_PAGE_SIZE) {
+    while ((slots*this->fullRecordSize()) + r > pageSize) {
        slots--;
-      r = sizeof(RM_PageHdr) + bitmap(slots).numChars();
+      r = sizeof(RM_PageHdr) + RM_PageHdrView::MapSize(slots);
       // std::cerr << "PF_PAGE_SIZE " << PF_PAGE_SIZE << std::endl;
       // std::cerr << " slots*frs " << slots*this->fullRecordSize()
       //           << " r "<< r 
@@ -252,6 +342,11 @@ int RM_FileHandle::GetNumSlots() const
       //           <<  std::endl;
     }
     
+    // an encoded page may hold up to four times as many, with its slot
+    // bitmap taking at most a sixteenth of the page
+    if(IsCompressed())
+      return min(4 * slots, pageSize / 2);
+
     // std::cerr << "Final  " << std::endl;
     // std::cerr << " slots*frs " << slots*this->fullRecordSize()
     //           << " r "<< r 
@@ -267,76 +362,133 @@ RM_FileHandle::~RM_FileHandle()
 {
   if(pfHandle != NULL)
     delete pfHandle;
+  delete [] recBuf;
+  delete [] packBuf;
 }
 
 // Given a RID, return the record
 RC RM_FileHandle::GetRec     (const RID &rid, RM_Record &rec) const 
+{
+  char * pData = NULL;
+  RC rc = this->PinRec(rid, pData);
+  if(rc != 0)
+    return rc;
+  rec.Set(pData, hdr.extRecordSize, rid);
+  return this->UnpinRec(rid);
+}
+
+// Given a RID, pin its page and point pData at the record in the buffer
+// pool.  The caller has to UnpinRec when it is done with pData.
+RC RM_FileHandle::PinRec     (const RID &rid, char *&pData) const 
 {
   RC invalid = IsValid(); if(invalid) return invalid; 
   if(!this->IsValidRID(rid))
     return RM_BAD_RID;
+  if(IsSlotted())
+    return PinSlotted(rid, pData);
   PageNum p;
   SlotNum s;
   rid.GetPageNum(p);
   rid.GetSlotNum(s);
   RC rc = 0;
   PF_PageHandle ph;
-  RM_PageHdr pHdr(this->GetNumSlots());
-  if((rc = pfHandle->GetThisPage(p, ph)) ||
-     // Needs to be called everytime GetThisPage is called.
-     (rc = pfHandle->UnpinPage(p)) ||
-     (rc = this->GetPageHeader(ph, pHdr))
-    )
+  if((rc = pfHandle->GetThisPage(p, ph)))
+    return rc;
+  if((rc = this->GetSlotPointer(ph, s, pData))) {
+    pfHandle->UnpinPage(p);
     return rc;
-  bitmap b(pHdr.freeSlotMap, this->GetNumSlots());
+  }
 
-  if(b.test(s)) // already free
+  char * pPage;
+  ph.GetData(pPage);
+  if(RM_PageHdrView(pPage, GetNumSlots()).IsFree(s)) { // already free
+    pfHandle->UnpinPage(p);
     return RM_NORECATRID;
+  }
+  if(IsPax()) {
+    ReadSlot(pPage + RM_PageHdrView::Size(GetNumSlots()), GetNumSlots(), s,
+             recBuf);
+    pData = recBuf;
+  }
+  if(IsCompressed()) {
+    RM_PackedPageView(pPage, GetNumSlots(), hdr.fields,
+                      pfHandle->GetPageSize()).Read(s, recBuf);
+    pData = recBuf;
+  }
+  return 0;
+}
 
-  char * pData = NULL;
-  if(RC rc = this->GetSlotPointer(ph, s, pData))
+RC RM_FileHandle::UnpinRec   (const RID &rid) const 
+{
+  RC invalid = IsValid(); if(invalid) return invalid; 
+  PageNum p;
+  RC rc = rid.GetPageNum(p);
+  if(rc != 0)
     return rc;
-
-  rec.Set(pData, hdr.extRecordSize, rid);
-  return 0;
+  return pfHandle->UnpinPage(p);
 }
 
 
 RC RM_FileHandle::InsertRec  (const char *pData, RID &rid)
+{
+  return InsertRecs(pData, 1, &rid);
+}
+
+RC RM_FileHandle::InsertRecs (const char *rows, int n, RID *rids)
 {
   RC invalid = IsValid(); if(invalid) return invalid; 
-  if(pData == NULL)
+  if(rows == NULL || rids == NULL)
     return RM_NULLRECORD;
+  if(IsSlotted())
+    return InsertSlotted(rows, n, rids);
+  if(IsCompressed())
+    return InsertPacked(rows, n, rids);
+
+  int numSlots = GetNumSlots();
+  int recSize = this->fullRecordSize();
+  int done = 0;
+  while(done < n) {
+    PF_PageHandle ph;
+    PageNum p;
+    RC rc;
+    char * pPage;
+    int nPages = (n - done + numSlots - 1) / numSlots;
+    if((rc = this->GetNextFreePage(p, nPages)) ||
+       (rc = pfHandle->GetThisPage(p, ph)))
+      return rc;
+    // dirty before it is written - a read-only file fails here
+    if((rc = ph.GetData(pPage)) ||
+       (rc = pfHandle->MarkDirty(p))) {
+      pfHandle->UnpinPage(p);
+      return rc;
+    }
 
-  PF_PageHandle ph;
-  RM_PageHdr pHdr(this->GetNumSlots());
-  PageNum p;
-  SlotNum s;
-  RC rc;
-  char * pSlot;
-  if((rc = this->GetNextFreeSlot(ph, p, s)))
-    return rc;
-  if((rc = this->GetPageHeader(ph, pHdr)))
-    return rc;
-  bitmap b(pHdr.freeSlotMap, this->GetNumSlots());
-  // std::cerr << "RM_FileHandle::InsertRec befor" << b << std::endl;
-  // TODO GetSlotPtr is trashing the pHdr
-  if((rc = this->GetSlotPointer(ph, s, pSlot)))
-    return rc;
-  rid = RID(p, s);
-  memcpy(pSlot, pData, this->fullRecordSize());
-  
-  b.reset(s); // slot s is no longer free
-  pHdr.numFreeSlots--;
-  if(pHdr.numFreeSlots == 0) {
-    // remove from free list 
-    hdr.firstFree = pHdr.nextFree;
-    pHdr.nextFree = RM_PAGE_FULLY_USED;
+    // as many as fit go on this page while it is pinned
+    RM_PageHdrView pHdr(pPage, numSlots);
+    char * pSlots = pPage + RM_PageHdrView::Size(numSlots);
+    int numFree = pHdr.GetNumFreeSlots();
+    int added = 0;
+    for(SlotNum s = pHdr.FirstFree(); s < numSlots && done < n;
+        s = pHdr.NextFree(s + 1)) {
+      WriteSlot(pSlots, numSlots, s, rows + done * recSize);
+      pHdr.SetUsed(s); // slot s is no longer free
+      rids[done++] = RID(p, s);
+      added++;
+    }
+    if(added == 0) {
+      // This page is full
+      pfHandle->UnpinPage(p);
+      return -1; // unexpected error
+    }
+    pHdr.SetNumFreeSlots(numFree - added);
+    // Needs to be called everytime GetThisPage is called.
+    if((rc = pfHandle->UnpinPage(p)))
+      return rc;
+    // the map only changes when the page moves to another category
+    if(SpaceCat(numFree - added, numSlots) != SpaceCat(numFree, numSlots) &&
+       (rc = SetSpace(p, SpaceCat(numFree - added, numSlots))))
+      return rc;
   }
-  // std::cerr << "RM_FileHandle::InsertRec numFreeSlots in page " << pHdr.numFreeSlots << std::endl;
-  b.to_char_buf(pHdr.freeSlotMap, b.numChars());
-  rc = this->SetPageHeader(ph, pHdr);
-  // std::cerr << "RM_FileHandle::InsertRec after" << b << std::endl;
   return 0;
 }
 
@@ -345,42 +497,46 @@ RC RM_FileHandle::DeleteRec  (const RID &rid)
   RC invalid = IsValid(); if(invalid) return invalid; 
   if(!this->IsValidRID(rid))
     return RM_BAD_RID;
+  if(IsSlotted())
+    return DeleteSlotted(rid);
   PageNum p;
   SlotNum s;
   rid.GetPageNum(p);
   rid.GetSlotNum(s);
   RC rc = 0;
   PF_PageHandle ph;
-  RM_PageHdr pHdr(this->GetNumSlots());
-  if((rc = pfHandle->GetThisPage(p, ph)) ||
-     (rc = pfHandle->MarkDirty(p)) ||
-     // Needs to be called everytime GetThisPage is called.
-     (rc = pfHandle->UnpinPage(p)) ||
-     (rc = this->GetPageHeader(ph, pHdr))
-    )
+  char * pPage;
+  if((rc = pfHandle->GetThisPage(p, ph)))
     return rc;
+  if((rc = ph.GetData(pPage)) ||
+     (rc = pfHandle->MarkDirty(p))) {
+    pfHandle->UnpinPage(p);
+    return rc;
+  }
 
-  bitmap b(pHdr.freeSlotMap, this->GetNumSlots());
-
-  if(b.test(s)) // already free
+  RM_PageHdrView pHdr(pPage, GetNumSlots());
+  if(pHdr.IsFree(s)) { // already free
+    pfHandle->UnpinPage(p);
     return RM_NORECATRID;
+  }
 
   // TODO considering zero-ing record - IOs though
-  b.set(s); // s is now free
-  if(pHdr.numFreeSlots == 0)
-  {
-    // this page used to be full and used to not be on the free list
-    // add it to the free list now.
-    pHdr.nextFree = hdr.firstFree;
-    hdr.firstFree = p; 
+  pHdr.SetFree(s); // s is now free
+  int numFree = pHdr.GetNumFreeSlots();
+  pHdr.SetNumFreeSlots(numFree + 1);
+  // Needs to be called everytime GetThisPage is called.
+  if((rc = pfHandle->UnpinPage(p)))
+    return rc;
+
+  if(SpaceCat(numFree + 1, GetNumSlots()) != SpaceCat(numFree, GetNumSlots())
+     && (rc = SetSpace(p, SpaceCat(numFree + 1, GetNumSlots()))))
+    return rc;
+  // inserts look here again
+  if(p < hdr.firstFree) {
+    hdr.firstFree = p;
+    bHdrChanged = true;
   }
-  pHdr.numFreeSlots++;
-  // std::cerr << "RM_FileHandle::DeleteRec numFreeSlots in page " 
-  //           << pHdr.numFreeSlots 
-  //           << std::endl;
-  b.to_char_buf(pHdr.freeSlotMap, b.numChars());
-  rc = this->SetPageHeader(ph, pHdr);
-  return rc;
+  return 0;
 }
 
 // TODO write insert in terms of update
@@ -396,30 +552,142 @@ RC RM_FileHandle::UpdateRec  (const RM_Record &rec)
 
   if(!this->IsValidRID(rid))
     return RM_BAD_RID;
+  if(IsSlotted()) {
+    char * pData = NULL;
+    rec.GetData(pData);
+    return UpdateSlotted(rid, pData);
+  }
 
   PF_PageHandle ph;
-  char * pSlot;
+  char * pPage;
   RC rc;
-  RM_PageHdr pHdr(this->GetNumSlots());
-  if((rc = pfHandle->GetThisPage(p, ph)) ||
-     (rc = pfHandle->MarkDirty(p)) ||
-     // Needs to be called everytime GetThisPage is called.
-     (rc = pfHandle->UnpinPage(p)) ||
-     (rc = this->GetPageHeader(ph, pHdr))
-    )
+  if((rc = pfHandle->GetThisPage(p, ph)))
     return rc;
+  if((rc = ph.GetData(pPage)) ||
+     (rc = pfHandle->MarkDirty(p))) {
+    pfHandle->UnpinPage(p);
+    return rc;
+  }
 
-  bitmap b(pHdr.freeSlotMap, this->GetNumSlots());
-
-  if(b.test(s)) // free - cannot update
+  if(RM_PageHdrView(pPage, GetNumSlots()).IsFree(s)) { // free - cannot update
+    pfHandle->UnpinPage(p);
     return RM_NORECATRID;
+  }
 
   char * pData = NULL;
   rec.GetData(pData);
 
-  if(RC rc = this->GetSlotPointer(ph, s, pSlot))
+  if(IsCompressed()) {
+    rc = UpdatePacked(pPage, s, pData);
+    RC rc2 = pfHandle->UnpinPage(p);
+    return (rc != 0) ? rc : rc2;
+  }
+  WriteSlot(pPage + RM_PageHdrView::Size(GetNumSlots()), GetNumSlots(), s,
+            pData);
+  // Needs to be called everytime GetThisPage is called.
+  return pfHandle->UnpinPage(p);
+}
+
+RC RM_FileHandle::FirstUsed(PageNum p, SlotNum &s) const
+{
+  PF_PageHandle ph;
+  char * pPage;
+  RC rc;
+  if((rc = pfHandle->GetThisPage(p, ph)))
     return rc;
-  memcpy(pSlot, pData, this->fullRecordSize());
+  ph.GetData(pPage);
+  s = -1;
+  if(IsSlotted()) {
+    RM_SlottedPageView v(pPage, pfHandle->GetPageSize());
+    for(int i = 0; i < v.GetNumSlots() && s == -1; i++)
+      if(!v.IsFree(i))
+        s = i;
+  } else {
+    s = RM_PageHdrView(pPage, GetNumSlots()).NextUsed(0);
+    if(s == GetNumSlots())
+      s = -1;
+  }
+  return pfHandle->UnpinPage(p);
+}
+
+// The last page is emptied onto the first pages with room, then the one
+// before it, until a record finds no room before its page.  Inserts look
+// for room from the start of the file, so a record only lands on a page
+// that is emptied later when every page before that one is full.
+RC RM_FileHandle::Vacuum(int n, char *rows, RID *from, RID *to, int &nMoved)
+{
+  RC invalid = IsValid(); if(invalid) return invalid;
+  if(rows == NULL || from == NULL || to == NULL)
+    return RM_NULLRECORD;
+
+  nMoved = 0;
+  int recSize = this->fullRecordSize();
+  PageNum p = hdr.numPages - 1;
+  RC rc = 0;
+  while(p > 0 && nMoved < n) {
+    if(IsMapPage(p)) {
+      p--;
+      continue;
+    }
+    SlotNum s;
+    if((rc = FirstUsed(p, s)))
+      break;
+    if(s == -1) {
+      p--;
+      continue;
+    }
+
+    spaceEnd = p;
+    if(IsSlotted()) {
+      rc = MoveSlotted(p, s, rows, from, to, nMoved);
+    } else {
+      RID rid(p, s);
+      char * row = rows + nMoved * recSize;
+      char * pData;
+      if((rc = PinRec(rid, pData)))
+        break;
+      memcpy(row, pData, recSize);
+      if((rc = UnpinRec(rid)) ||
+         (rc = InsertRecs(row, 1, &to[nMoved])) ||
+         (rc = DeleteRec(rid)))
+        break;
+      from[nMoved++] = rid;
+    }
+    if(rc != 0)
+      break;
+  }
+  spaceEnd = -1;
+  if(rc != 0 && rc != RM_NOSPACE)
+    return rc;
+  return 0;
+}
+
+RC RM_FileHandle::Truncate()
+{
+  RC invalid = IsValid(); if(invalid) return invalid;
+
+  // the last page that still has records
+  PageNum p = hdr.numPages - 1;
+  while(p > 0) {
+    SlotNum s = -1;
+    RC rc;
+    if(!IsMapPage(p) && (rc = FirstUsed(p, s)))
+      return rc;
+    if(s != -1)
+      break;
+    p--;
+  }
+
+  PageNum numPages = p + 1;
+  if(numPages < hdr.numPages) {
+    RC rc;
+    if((rc = pfHandle->Truncate(numPages)))
+      return rc;
+    hdr.numPages = numPages;
+    if(hdr.firstFree > numPages)
+      hdr.firstFree = numPages;
+    bHdrChanged = true;
+  }
   return 0;
 }
 
@@ -447,7 +715,8 @@ bool RM_FileHandle::IsValidPageNum(const PageNum pageNum) const
 {
    return (bFileOpen &&
          pageNum >= 0 &&
-         pageNum < hdr.numPages);
+         pageNum < hdr.numPages &&
+         !IsMapPage(pageNum));
 }
 
 //
@@ -256,3 +256,294 @@ TEST_F(RM_FileHandleTest, over40pages) {
     ASSERT_EQ(rid, RID(page, fh.GetNumSlots()-1));
   }
 }
+
+TEST_F(RM_FileHandleTest, FreeSpaceMap) {
+	// one record to a page, and enough pages to need a map page after the
+	// entries on the header page
+	const int size = 3000;
+	RM_FileHandle bfh;
+	RC rc;
+	system("rm -f gtestfilebig");
+	ASSERT_EQ(0, rmm.CreateFile("gtestfilebig", size));
+	ASSERT_EQ(0, rmm.OpenFile("gtestfilebig", bfh));
+	ASSERT_EQ(1, bfh.GetNumSlots());
+
+	PF_FileHandle pfh;
+	ASSERT_EQ(0, bfh.GetPF_FileHandle(pfh));
+	int hdrEntries = (pfh.GetPageSize() - sizeof(RM_FileHdr)) * 2;
+	PageNum mapPage = hdrEntries + 1;
+	int count = hdrEntries + 100;
+
+	std::vector<char> rows(count * size);
+	for( int i = 0; i < count; i++)
+		memcpy(&rows[i * size], &i, sizeof(int));
+	std::vector<RID> rids(count);
+	ASSERT_EQ(0, bfh.InsertRecs(&rows[0], count, &rids[0]));
+	// the pages follow one another except for the map page
+	ASSERT_EQ(RID(1, 0), rids[0]);
+	ASSERT_EQ(RID(mapPage - 1, 0), rids[hdrEntries - 1]);
+	ASSERT_EQ(RID(mapPage + 1, 0), rids[hdrEntries]);
+	ASSERT_EQ(count + 2, bfh.GetNumPages());
+	RM_Record rec;
+	ASSERT_EQ(RM_BAD_RID, bfh.GetRec(RID(mapPage, 0), rec));
+
+	// a scan goes past the map page
+	RM_FileScan fs;
+	ASSERT_EQ(0, fs.OpenScan(bfh, INT, sizeof(int), 0, NO_OP, NULL));
+	int numRecs = 0;
+	char * pData;
+	RID rid;
+	while((rc = fs.GetNextRec(pData, rid)) == 0) {
+		int v;
+		memcpy(&v, pData, sizeof(int));
+		ASSERT_EQ(numRecs, v);
+		ASSERT_EQ(rids[numRecs], rid);
+		numRecs++;
+	}
+	ASSERT_EQ(RM_EOF, rc);
+	ASSERT_EQ(0, fs.CloseScan());
+	ASSERT_EQ(count, numRecs);
+
+	// freed slots on both sides of the map page are found again, the
+	// earlier first, also once the file is reopened
+	ASSERT_EQ(0, bfh.DeleteRec(rids[count - 10]));
+	ASSERT_EQ(0, bfh.DeleteRec(rids[5]));
+	ASSERT_EQ(0, rmm.CloseFile(bfh));
+	RM_FileHandle bfh2;
+	ASSERT_EQ(0, rmm.OpenFile("gtestfilebig", bfh2));
+	RID r;
+	ASSERT_EQ(0, bfh2.InsertRec(&rows[0], r));
+	ASSERT_EQ(rids[5], r);
+	ASSERT_EQ(0, bfh2.InsertRec(&rows[0], r));
+	ASSERT_EQ(rids[count - 10], r);
+	ASSERT_EQ(0, bfh2.InsertRec(&rows[0], r));
+	ASSERT_EQ(RID(count + 2, 0), r);
+	ASSERT_EQ(0, rmm.CloseFile(bfh2));
+	rmm.DestroyFile("gtestfilebig");
+}
+
+TEST_F(RM_FileHandleTest, InsertRecs) {
+	std::vector<TestRec> rows(250);
+	for( int i = 0; i < 250; i++)
+		rows[i].num = i;
+	std::vector<RID> rids(250);
+	ASSERT_EQ(RM_NULLRECORD, fh.InsertRecs(NULL, 1, &rids[0]));
+	ASSERT_EQ(0, fh.InsertRecs((char*) &rows[0], 0, &rids[0]));
+	ASSERT_EQ(1, fh.GetNumPages());
+
+	// a batch fills pages in slot order
+	ASSERT_EQ(0, fh.InsertRecs((char*) &rows[0], 250, &rids[0]));
+	ASSERT_EQ(4, fh.GetNumPages());
+	for( int i = 0; i < 250; i++) {
+		ASSERT_EQ(RID(1 + i / fh.GetNumSlots(), i % fh.GetNumSlots()), rids[i]);
+		RM_Record rec;
+		ASSERT_EQ(0, fh.GetRec(rids[i], rec));
+		TestRec * pBuf;
+		rec.GetData((char*&)pBuf);
+		ASSERT_EQ(i, pBuf->num);
+	}
+
+	// holes are filled before the last page
+	ASSERT_EQ(0, fh.DeleteRec(rids[3]));
+	ASSERT_EQ(0, fh.DeleteRec(rids[150]));
+	ASSERT_EQ(0, fh.InsertRecs((char*) &rows[0], 3, &rids[0]));
+	ASSERT_EQ(RID(1, 3), rids[0]);
+	ASSERT_EQ(RID(2, 150 - fh.GetNumSlots()), rids[1]);
+	ASSERT_EQ(RID(3, 250 - 2 * fh.GetNumSlots()), rids[2]);
+}
+
+TEST_F(RM_FileHandleTest, Vacuum) {
+	const int count = 1000;
+	std::vector<TestRec> rows(count);
+	for( int i = 0; i < count; i++)
+		rows[i].num = i;
+	std::vector<RID> rids(count);
+	ASSERT_EQ(0, fh.InsertRecs((char*) &rows[0], count, &rids[0]));
+	int numPages = fh.GetNumPages();
+
+	// every fifth record is left, on all of the pages
+	for( int i = 0; i < count; i++) {
+		if(i % 5 != 0) {
+			ASSERT_EQ(0, fh.DeleteRec(rids[i]));
+		}
+	}
+
+	// moves come back in order, a batch at a time
+	const int n = 16;
+	std::vector<TestRec> moved(n);
+	RID from[n], to[n];
+	int nMoved, total = 0;
+	do {
+		ASSERT_EQ(0, fh.Vacuum(n, (char*) &moved[0], from, to, nMoved));
+		for( int j = 0; j < nMoved; j++) {
+			ASSERT_EQ(rids[moved[j].num], from[j]);
+			rids[moved[j].num] = to[j];
+		}
+		total += nMoved;
+	} while(nMoved == n);
+	ASSERT_GT(total, 0);
+	// the emptied pages stay until the file is truncated
+	ASSERT_EQ(numPages, fh.GetNumPages());
+	ASSERT_EQ(0, fh.Truncate());
+	int perPage = fh.GetNumSlots();
+	ASSERT_EQ(1 + (count / 5 + perPage - 1) / perPage, fh.GetNumPages());
+	ASSERT_LT(fh.GetNumPages(), numPages);
+	for( int i = 0; i < count; i += 5) {
+		RM_Record rec;
+		ASSERT_EQ(0, fh.GetRec(rids[i], rec));
+		TestRec * pBuf;
+		rec.GetData((char*&)pBuf);
+		ASSERT_EQ(i, pBuf->num);
+	}
+
+	// nothing more moves, and new records go after the ones left
+	ASSERT_EQ(0, fh.Vacuum(n, (char*) &moved[0], from, to, nMoved));
+	ASSERT_EQ(0, nMoved);
+	numPages = fh.GetNumPages();
+	ASSERT_EQ(0, fh.Truncate());
+	ASSERT_EQ(numPages, fh.GetNumPages());
+	RID r;
+	for( int i = 0; i < perPage; i++)
+		ASSERT_EQ(0, fh.InsertRec((char*) &rows[0], r));
+	ASSERT_EQ(numPages + 1, fh.GetNumPages());
+	ASSERT_EQ(numPages, r.Page());
+
+	// a slotted file with records moved in from their stubs
+	RM_Fields vars;
+	vars.n = 1;
+	vars.offset[0] = 0;
+	vars.length[0] = STRLEN;
+	RM_FileHandle sfh;
+	system("rm -f gtestfileslot");
+	ASSERT_EQ(0, rmm.CreateFile("gtestfileslot", sizeof(TestRec),
+	                            PF_PAGE_SIZE, RM_SLOTTED, &vars));
+	ASSERT_EQ(0, rmm.OpenFile("gtestfileslot", sfh));
+	memset(&rows[0], 0, count * sizeof(TestRec));
+	for( int i = 0; i < count; i++) {
+		sprintf(rows[i].str, "r%d", i);
+		rows[i].num = i;
+	}
+	ASSERT_EQ(0, sfh.InsertRecs((char*) &rows[0], count, &rids[0]));
+	for( int i = 0; i < count; i += 3) {
+		memset(rows[i].str, 'x', STRLEN - 1);
+		RM_Record rec;
+		ASSERT_EQ(0, rec.Set((char*) &rows[i], sizeof(TestRec), rids[i]));
+		ASSERT_EQ(0, sfh.UpdateRec(rec));
+	}
+	for( int i = 0; i < count; i++) {
+		if(i % 3 != 0 && i % 4 != 0) {
+			ASSERT_EQ(0, sfh.DeleteRec(rids[i]));
+		}
+	}
+	numPages = sfh.GetNumPages();
+	do {
+		ASSERT_EQ(0, sfh.Vacuum(n, (char*) &moved[0], from, to, nMoved));
+		for( int j = 0; j < nMoved; j++) {
+			ASSERT_EQ(rids[moved[j].num], from[j]);
+			rids[moved[j].num] = to[j];
+		}
+	} while(nMoved == n);
+	ASSERT_EQ(0, sfh.Truncate());
+	ASSERT_LT(sfh.GetNumPages(), numPages);
+	for( int i = 0; i < count; i++) {
+		RM_Record rec;
+		if(i % 3 != 0 && i % 4 != 0)
+			continue;
+		ASSERT_EQ(0, sfh.GetRec(rids[i], rec));
+		TestRec * pBuf;
+		rec.GetData((char*&)pBuf);
+		ASSERT_EQ(0, memcmp(&rows[i], pBuf, sizeof(TestRec)));
+	}
+	// records moved in again still lead back to their stubs
+	for( int i = 0; i < count; i += 3) {
+		rows[i].str[STRLEN - 2] = 0;
+		RM_Record rec;
+		ASSERT_EQ(0, rec.Set((char*) &rows[i], sizeof(TestRec), rids[i]));
+		ASSERT_EQ(0, sfh.UpdateRec(rec));
+		ASSERT_EQ(0, sfh.GetRec(rids[i], rec));
+		TestRec * pBuf;
+		rec.GetData((char*&)pBuf);
+		ASSERT_EQ(0, memcmp(&rows[i], pBuf, sizeof(TestRec)));
+	}
+	ASSERT_EQ(0, rmm.CloseFile(sfh));
+	rmm.DestroyFile("gtestfileslot");
+}
+
+TEST_F(RM_FileHandleTest, Slotted) {
+	RM_Fields vars;
+	vars.n = 1;
+	vars.offset[0] = 0;
+	vars.length[0] = STRLEN;
+	RM_FileHandle sfh;
+	RC rc;
+	system("rm -f gtestfileslot");
+	ASSERT_EQ(0, rmm.CreateFile("gtestfileslot", sizeof(TestRec),
+	                            PF_PAGE_SIZE, RM_SLOTTED, &vars));
+	ASSERT_EQ(0, rmm.OpenFile("gtestfileslot", sfh));
+	ASSERT_TRUE(sfh.IsSlotted());
+
+	// short strings take less room than the fixed format would give them
+	const int count = 500;
+	std::vector<TestRec> rows(count);
+	memset(&rows[0], 0, count * sizeof(TestRec));
+	for( int i = 0; i < count; i++) {
+		sprintf(rows[i].str, "r%d", i);
+		rows[i].num = i;
+	}
+	std::vector<RID> rids(count);
+	ASSERT_EQ(0, sfh.InsertRecs((char*) &rows[0], count, &rids[0]));
+	ASSERT_GT(count / fh.GetNumSlots(), sfh.GetNumPages() - 1);
+
+	// records that grow past the room on their page keep their RID
+	for( int i = 0; i < 100; i++) {
+		memset(rows[i].str, 'x', STRLEN - 1);
+		RM_Record rec;
+		ASSERT_EQ(0, rec.Set((char*) &rows[i], sizeof(TestRec), rids[i]));
+		ASSERT_EQ(0, sfh.UpdateRec(rec));
+	}
+	for( int i = 0; i < count; i++) {
+		RM_Record rec;
+		ASSERT_EQ(0, sfh.GetRec(rids[i], rec));
+		TestRec * pBuf;
+		rec.GetData((char*&)pBuf);
+		ASSERT_EQ(0, memcmp(&rows[i], pBuf, sizeof(TestRec)));
+	}
+
+	// a scan sees each record once, at its RID
+	RM_FileScan fs;
+	ASSERT_EQ(0, fs.OpenScan(sfh, INT, sizeof(int), offsetof(TestRec, num),
+	                         NO_OP, NULL));
+	int numRecs = 0;
+	char * pData;
+	RID rid;
+	while((rc = fs.GetNextRec(pData, rid)) == 0) {
+		int v;
+		memcpy(&v, pData + offsetof(TestRec, num), sizeof(int));
+		ASSERT_EQ(rids[v], rid);
+		ASSERT_EQ(0, memcmp(&rows[v], pData, sizeof(TestRec)));
+		numRecs++;
+	}
+	ASSERT_EQ(RM_EOF, rc);
+	ASSERT_EQ(0, fs.CloseScan());
+	ASSERT_EQ(count, numRecs);
+
+	// the predicates see the decoded strings
+	char key[STRLEN];
+	memset(key, 'x', STRLEN);
+	key[STRLEN - 1] = '\0';
+	ASSERT_EQ(0, fs.OpenScan(sfh, STRING, STRLEN, 0, EQ_OP, key));
+	for(numRecs = 0; (rc = fs.GetNextRec(pData, rid)) == 0; numRecs++);
+	ASSERT_EQ(RM_EOF, rc);
+	ASSERT_EQ(0, fs.CloseScan());
+	ASSERT_EQ(100, numRecs);
+
+	// moved or not, deleted records are gone
+	for( int i = 0; i < 100; i += 2)
+		ASSERT_EQ(0, sfh.DeleteRec(rids[i]));
+	for( int i = 0; i < 100; i++) {
+		RM_Record rec;
+		ASSERT_EQ(i % 2 ? 0 : RM_NORECATRID, sfh.GetRec(rids[i], rec));
+	}
+	ASSERT_EQ(0, rmm.CloseFile(sfh));
+	rmm.DestroyFile("gtestfileslot");
+}
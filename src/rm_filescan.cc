@@ -4,15 +4,22 @@
 
 #include <cerrno>
 #include <cassert>
+#include <climits>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 #include "rm.h"
 
 using namespace std;
 
-RM_FileScan::RM_FileScan(): bOpen(false)
+RM_FileScan::RM_FileScan(): bOpen(false), ring(PF_NO_RING), pinned(-1),
+                            pPage(NULL), match(NULL), matchPage(-1),
+                            bMatchPinned(false), recBuf(NULL),
+                            colPred(NULL), colStart(NULL), colStride(NULL),
+                            colField(NULL), colBuf(NULL)
 {
   pred = NULL;
+  nPreds = 0;
   prmh = NULL;
   current = RID(1,-1);
 }
@@ -28,6 +35,20 @@ RC RM_FileScan::OpenScan(const RM_FileHandle &fileHandle,
                          CompOp     compOp,
                          void       *value,
                          ClientHint pinHint) 
+{
+  Predicate p(attrType,
+              attrLength,
+              attrOffset,
+              compOp,
+              value,
+              pinHint);
+  return OpenScan(fileHandle, 1, &p, pinHint);
+}
+
+RC RM_FileScan::OpenScan(const RM_FileHandle &fileHandle,
+                         int        nPredsIn,
+                         const Predicate predsIn[],
+                         ClientHint pinHint)
 {
   if (bOpen)
   {
@@ -40,7 +61,20 @@ RC RM_FileScan::OpenScan(const RM_FileHandle &fileHandle,
      prmh->IsValid() != 0)
     return RM_FCREATEFAIL;
 
-  if(value != NULL) { // allow lazy init - dont check cond if value if NULL
+  if(nPredsIn < 1 || predsIn == NULL)
+    return RM_FCREATEFAIL;
+
+  for(int i = 0; i < nPredsIn; i++) {
+    const Predicate& p = predsIn[i];
+    // allow lazy init - dont check cond if value if NULL
+    if(p.GetValue() == NULL && p.GetRhsOffset() < 0)
+      continue;
+
+    CompOp compOp = p.initOp();
+    AttrType attrType = p.GetAttrType();
+    int attrLength = p.GetAttrLength();
+    int attrOffset = p.GetAttrOffset();
+
     if((compOp < NO_OP) ||
        compOp > GE_OP)
       return RM_FCREATEFAIL;
@@ -64,15 +98,35 @@ RC RM_FileScan::OpenScan(const RM_FileHandle &fileHandle,
     if((attrOffset >= prmh->fullRecordSize()) ||
        attrOffset < 0)
       return RM_FCREATEFAIL;
+
+    if(p.GetRhsOffset() >= prmh->fullRecordSize())
+      return RM_FCREATEFAIL;
+  }
+
+  // a sequential scan reads each page once - keep it from flushing the
+  // rest of the buffer pool
+  if(pinHint == SEQ_SCAN_HINT) {
+    RC rc = prmh->pfHandle->OpenRing(ring);
+    if(rc != 0)
+      return rc;
   }
 
+  numSlots = prmh->GetNumSlots();
+  slotOffset = RM_PageHdrView::Size(numSlots);
+  match = new char[RM_PageHdrView::MapSize(numSlots)];
+  matchPage = -1;
+  if(prmh->IsSlotted() || prmh->IsPax() || prmh->IsCompressed())
+    recBuf = new char[prmh->fullRecordSize()];
+  if(prmh->IsCompressed())
+    colBuf = new char[numSlots * prmh->fullRecordSize()];
+
   bOpen = true;
-  pred = new Predicate(attrType,       
-                       attrLength,
-                       attrOffset,
-                       compOp,
-                       value,
-                       pinHint) ;
+  nPreds = nPredsIn;
+  pred = new Predicate[nPreds];
+  for(int i = 0; i < nPreds; i++)
+    pred[i] = predsIn[i];
+  if(prmh->IsPax() || prmh->IsCompressed())
+    SetColumns();
   return 0;
 }
 
@@ -99,43 +153,282 @@ RC RM_FileScan::GetNextRec     (RM_Record &rec)
     return RM_FNOTOPEN;
   assert(prmh != NULL && pred != NULL && bOpen);
 
-  PF_PageHandle ph;
-  RM_PageHdr pHdr(prmh->GetNumSlots());
+  char * pData = NULL;
+  RC rc = NextSlot(pData);
+  if(rc != 0)
+    return rc;
+  if((rc = rec.Set(pData, prmh->fullRecordSize(), current)))
+    return rc;
+  // the record was copied - callers of this form may change the file
+  // before the next call, so the page is not held
+  return UnpinPage();
+}
+
+RC RM_FileScan::GetNextRec     (char *&pData, RID &rid)
+{
+  if(!bOpen)
+    return RM_FNOTOPEN;
+  assert(prmh != NULL && pred != NULL && bOpen);
+
+  RC rc = NextSlot(pData);
+  if(rc != 0)
+    return rc;
+  rid = current;
+  return 0;
+}
+
+RC RM_FileScan::NextSlot(char *&pData)
+{
+  if(prmh->IsSlotted())
+    return NextSlotted(pData);
   RC rc;
-  
   for( int j = current.Page(); j < prmh->GetNumPages(); j++) {
-    if((rc = prmh->pfHandle->GetThisPage(j, ph))
-       // Needs to be called everytime GetThisPage is called.
-       || (rc = prmh->pfHandle->UnpinPage(j)))
-      return rc;
-
-    if((rc = prmh->GetPageHeader(ph, pHdr)))
-      return rc;
-    bitmap b(pHdr.freeSlotMap, prmh->GetNumSlots());
+    if(prmh->IsMapPage(j))
+      continue;
+    if(j != pinned) {
+      PF_PageHandle ph;
+      if((rc = UnpinPage()) ||
+         (rc = prmh->pfHandle->GetThisPage(j, ph, ring)))
+        return rc;
+      pinned = j;
+      if((rc = ph.GetData(pPage)))
+        return rc;
+    }
+    if(j != matchPage)
+      FilterPage(j);
+    RM_PageHdrView pHdr(pPage, numSlots);
     int i = -1;
     if(current.Page() == j)
       i = current.Slot()+1;
     else
       i = 0;
-    for (; i < prmh->GetNumSlots(); i++) 
+    for (i = bitmap::nextSet(match, numSlots, i); i < numSlots;
+         i = bitmap::nextSet(match, numSlots, i + 1))
     {
-      if (!b.test(i)) { 
-        // not free - means this is useful data to us
-        current = RID(j, i);
-        prmh->GetRec(current, rec);
-        // std::cerr << "GetNextRec ret RID " << current << std::endl;
-        char * pData = NULL;
-        rec.GetData(pData);
-        if(pred->eval(pData, pred->initOp())) {
-          // std::cerr << "GetNextRec pred match for RID " << current << std::endl;
-          return 0;
-        } else {
-          // get next rec
-        }
+      current = RID(j, i);
+      pData = pPage + slotOffset + i * prmh->fullRecordSize();
+      if(prmh->IsPax()) {
+        prmh->ReadSlot(pPage + slotOffset, numSlots, i, recBuf);
+        pData = recBuf;
+      }
+      if(prmh->IsCompressed()) {
+        RM_PackedPageView(pPage, numSlots, prmh->hdr.fields,
+                          prmh->pfHandle->GetPageSize()).Read(i, recBuf);
+        pData = recBuf;
+      }
+      // a match made before the page was last let go is checked again
+      if(bMatchPinned || (!pHdr.IsFree(i) && Matches(pData)))
+        return 0;
+    }
+  }
+  RC rc2 = UnpinPage();
+  return (rc2 != 0) ? rc2 : RM_EOF;
+}
+
+// Records of a slotted file are not where their fields say, so each one is
+// decoded before the predicates look at it.  A moved record is seen at the
+// slot of its stub.
+RC RM_FileScan::NextSlotted(char *&pData)
+{
+  RC rc;
+  for( int j = current.Page(); j < prmh->GetNumPages(); j++) {
+    if(prmh->IsMapPage(j))
+      continue;
+    if(j != pinned) {
+      PF_PageHandle ph;
+      if((rc = UnpinPage()) ||
+         (rc = prmh->pfHandle->GetThisPage(j, ph, ring)))
+        return rc;
+      pinned = j;
+      if((rc = ph.GetData(pPage)))
+        return rc;
+    }
+    RM_SlottedPageView v(pPage, prmh->pfHandle->GetPageSize());
+    int i = (current.Page() == j) ? current.Slot() + 1 : 0;
+    for (; i < v.GetNumSlots(); i++) {
+      if(v.IsFree(i) || v.GetRec(i)[0] == RM_MOVEDIN)
+        continue;
+      if(v.GetRec(i)[0] == RM_MOVED) {
+        if((rc = prmh->GetMoved(v.GetRec(i), recBuf)))
+          return rc;
+      } else {
+        prmh->Decode(v.GetRec(i), recBuf);
+      }
+      current = RID(j, i);
+      if(Matches(recBuf)) {
+        pData = recBuf;
+        return 0;
+      }
+    }
+  }
+  RC rc2 = UnpinPage();
+  return (rc2 != 0) ? rc2 : RM_EOF;
+}
+
+RC RM_FileScan::UnpinPage()
+{
+  if(pinned == -1)
+    return 0;
+  PageNum p = pinned;
+  pinned = -1;
+  pPage = NULL;
+  bMatchPinned = false;
+  return prmh->pfHandle->UnpinPage(p);
+}
+
+// One pass of each predicate over every slot in use.  The legacy
+// GetNextRec does not hold the page between calls and its callers may
+// delete or update records in between, so once the page has been let go
+// NextSlot checks each match again before handing it out.
+void RM_FileScan::FilterPage(PageNum p)
+{
+  RM_PageHdrView pHdr(pPage, numSlots);
+  if(prmh->IsPax() || prmh->IsCompressed()) {
+    if(prmh->IsPax())
+      FilterPax(pHdr);
+    else
+      FilterPacked(pHdr);
+    matchPage = p;
+    bMatchPinned = true;
+    return;
+  }
+  pred[0].evalPage(pPage + slotOffset, prmh->fullRecordSize(), numSlots,
+                   pHdr.GetFreeMap(), match);
+  // the rest only look at the records that are still in
+  for(int i = 1; i < nPreds; i++)
+    pred[i].refinePage(pPage + slotOffset, prmh->fullRecordSize(), numSlots,
+                       match);
+  matchPage = p;
+  bMatchPinned = true;
+}
+
+// On a PAX page a predicate only reads the minipage of its attribute, the
+// values side by side.  Records are put together for the predicates that
+// need more than one attribute, and then only those still matching.
+void RM_FileScan::FilterPax(RM_PageHdrView &pHdr)
+{
+  char * pSlots = pPage + slotOffset;
+  Predicate().evalPage(NULL, 0, numSlots, pHdr.GetFreeMap(), match);
+  for(int i = 0; i < nPreds; i++) {
+    if(colStride[i] > 0) {
+      colPred[i].refinePage(pSlots + colStart[i], colStride[i], numSlots,
+                            match);
+      continue;
+    }
+    for(int s = bitmap::nextSet(match, numSlots, 0); s < numSlots;
+        s = bitmap::nextSet(match, numSlots, s + 1)) {
+      prmh->ReadSlot(pSlots, numSlots, s, recBuf);
+      if(!pred[i].eval(recBuf, pred[i].initOp()))
+        match[s / 8] &= ~(1 << (s % 8));
+    }
+  }
+}
+
+// A predicate on an encoded minipage is tried once on each value of a
+// dictionary or run rather than on every slot.  One on the ints of a FOR
+// minipage compares their offsets against the value less the base.
+void RM_FileScan::FilterPacked(RM_PageHdrView &pHdr)
+{
+  const RM_Fields &f = prmh->hdr.fields;
+  RM_PackedPageView v(pPage, numSlots, f, prmh->pfHandle->GetPageSize());
+  int top = v.GetTop();
+  Predicate().evalPage(NULL, 0, numSlots, pHdr.GetFreeMap(), match);
+  for(int i = 0; i < nPreds; i++) {
+    if(colStride[i] == 0) {
+      for(int s = bitmap::nextSet(match, numSlots, 0); s < numSlots;
+          s = bitmap::nextSet(match, numSlots, s + 1)) {
+        v.Read(s, recBuf);
+        if(!pred[i].eval(recBuf, pred[i].initOp()))
+          match[s / 8] &= ~(1 << (s % 8));
       }
+      continue;
+    }
+
+    const Predicate &p = colPred[i];
+    int k = colField[i];
+    int len = colStride[i];
+    int delta = colStart[i] - numSlots * f.offset[k];
+    RM_ColHdr c = v.GetCol(k);
+    const char * d = v.GetData(k);
+    if(c.enc == RM_RAW) {
+      p.refinePage(d + delta, len, top, match);
+    } else if(c.enc == RM_DICT) {
+      for(int e = 0; e < c.n; e++)
+        colBuf[e] = p.eval(d + e * len + delta, p.initOp());
+      for(int s = bitmap::nextSet(match, numSlots, 0); s < numSlots;
+          s = bitmap::nextSet(match, numSlots, s + 1))
+        if(!colBuf[v.Code(k, s)])
+          match[s / 8] &= ~(1 << (s % 8));
+    } else if(c.enc == RM_RLE) {
+      const char * ends = d + c.n * len;
+      for(int r = 0, s = 0; r < c.n; r++) {
+        unsigned short end;
+        memcpy(&end, ends + r * sizeof(end), sizeof(end));
+        if(!p.eval(d + r * len + delta, p.initOp()))
+          for(; s < end; s++)
+            match[s / 8] &= ~(1 << (s % 8));
+        s = end;
+      }
+    } else if(c.enc == RM_FOR && p.GetAttrType() == INT && delta == 0 &&
+              p.GetValue() != NULL) {
+      // offsets are below 2^30, so clamping the value keeps the result
+      int value;
+      memcpy(&value, p.GetValue(), sizeof(int));
+      long long off = (long long)value - c.base;
+      int offset = (off < 0) ? -1 : (off > INT_MAX) ? INT_MAX : (int)off;
+      for(int s = 0; s < top; s++) {
+        int code = v.Code(k, s);
+        memcpy(colBuf + s * sizeof(int), &code, sizeof(int));
+      }
+      Predicate(INT, sizeof(int), 0, p.initOp(), &offset, NO_HINT)
+        .refinePage(colBuf, sizeof(int), top, match);
+    } else {
+      v.Unpack(k, colBuf);
+      p.refinePage(colBuf + delta, len, top, match);
     }
   }
-  return RM_EOF;
+}
+
+// Find the minipage of the attribute of each predicate
+void RM_FileScan::SetColumns()
+{
+  const RM_Fields &f = prmh->hdr.fields;
+  colPred = new Predicate[nPreds];
+  colStart = new int[nPreds];
+  colStride = new int[nPreds];
+  colField = new int[nPreds];
+  for(int i = 0; i < nPreds; i++) {
+    const Predicate &p = pred[i];
+    colStride[i] = 0;
+    if(p.GetRhsOffset() >= 0)
+      continue;
+    for(int k = 0; k < f.n; k++) {
+      int delta = p.GetAttrOffset() - f.offset[k];
+      if(delta < 0 || delta + p.GetAttrLength() > f.length[k])
+        continue;
+      colPred[i] = Predicate(p.GetAttrType(), p.GetAttrLength(), 0,
+                             p.initOp(), p.GetValue(), NO_HINT);
+      colStart[i] = numSlots * f.offset[k] + delta;
+      colStride[i] = f.length[k];
+      colField[i] = k;
+      break;
+    }
+  }
+}
+
+bool RM_FileScan::Matches(const char *pData) const
+{
+  for(int i = 0; i < nPreds; i++)
+    if(!pred[i].eval(pData, pred[i].initOp()))
+      return false;
+  return true;
+}
+
+void RM_FileScan::resetState()
+{
+  UnpinPage();
+  matchPage = -1;
+  current = RID(1, -1);
 }
 
 RC RM_FileScan::CloseScan()
@@ -144,8 +437,53 @@ RC RM_FileScan::CloseScan()
     return RM_FNOTOPEN;
   assert(prmh != NULL && pred != NULL);
   bOpen = false;
-  if (pred != NULL)
-    delete pred;
+  delete [] pred;
+  pred = NULL;
+  nPreds = 0;
+  delete [] match;
+  match = NULL;
+  matchPage = -1;
+  delete [] recBuf;
+  recBuf = NULL;
+  delete [] colPred;
+  colPred = NULL;
+  delete [] colStart;
+  colStart = NULL;
+  delete [] colStride;
+  colStride = NULL;
+  delete [] colField;
+  colField = NULL;
+  delete [] colBuf;
+  colBuf = NULL;
+  RC rc = UnpinPage();
+  if(rc != 0)
+    return rc;
   current = RID(1,-1);
+  if(ring != PF_NO_RING) {
+    rc = prmh->pfHandle->CloseRing(ring);
+    ring = PF_NO_RING;
+    if(rc != 0)
+      return rc;
+  }
   return 0;
 }
+
+// Switch the scan to a buffer ring of numPages frames, replacing the ring
+// it had.  Used when pages are read more than once, e.g. by the outer of a
+// nested block join, so the ring has to hold a whole block.
+RC RM_FileScan::SetRingSize(int numPages)
+{
+  if(!bOpen)
+    return RM_FNOTOPEN;
+  RC rc;
+  // the page the scan holds came through the old ring
+  if((rc = UnpinPage()))
+    return rc;
+  if(ring != PF_NO_RING) {
+    rc = prmh->pfHandle->CloseRing(ring);
+    ring = PF_NO_RING;
+    if(rc != 0)
+      return rc;
+  }
+  return prmh->pfHandle->OpenRing(ring, numPages);
+}
@@ -1,6 +1,8 @@
 #include "rm_rid.h"
 #include "rm.h"
 #include "gtest/gtest.h"
+#include <cmath>
+#include <cstring>
 
 #define STRLEN 29
 struct TestRec {
@@ -381,3 +383,429 @@ TEST_F(RM_FileScanTest, DeleteDuring) {
   ASSERT_EQ(numRecs, count-10);
 
 }
+
+TEST_F(RM_FileScanTest, ReadOnlyMmap) {
+	RM_FileScan fs;
+	RM_FileHandle rofh;
+	RC rc;
+
+  TestRec t;
+  RID r;
+	int count = 400;
+	for( int i = 0; i < count; i++)
+	{
+		t.num = i;
+		ASSERT_EQ(0, fh.InsertRec((char*) &t, r));
+	}
+  ASSERT_EQ(0, rmm.CloseFile(fh));
+
+  ASSERT_EQ(0, rmm.OpenFile("gtestfile", rofh, PF_MMAP_READONLY));
+  int v = 100;
+  (rc=fs.OpenScan(rofh,INT,sizeof(int),offsetof(TestRec, num),
+                  LT_OP, &v, SEQ_SCAN_HINT));
+  ASSERT_EQ(rc, 0);
+
+  int numRecs = 0;
+  RM_Record rec; 
+  while((rc = fs.GetNextRec(rec)) == 0) {
+    TestRec * pBuf;
+		rec.GetData((char*&)pBuf);
+    EXPECT_LT(pBuf->num, v);
+    numRecs++;
+  }  
+  ASSERT_EQ(rc, RM_EOF);
+  ASSERT_EQ(0, fs.CloseScan());
+  ASSERT_EQ(numRecs, v);
+
+  // writes fail before they touch the mapping
+  ASSERT_EQ(PF_READONLY, rofh.InsertRec((char*) &t, r));
+  ASSERT_EQ(PF_READONLY, rofh.DeleteRec(r));
+  ASSERT_EQ(0, rmm.CloseFile(rofh));
+}
+
+TEST_F(RM_FileScanTest, Pinned) {
+	RM_FileScan fs;
+	RC rc;
+
+  TestRec t;
+  RID r;
+	int count = 400;
+	for( int i = 0; i < count; i++)
+	{
+		t.num = i;
+		ASSERT_EQ(0, fh.InsertRec((char*) &t, r));
+	}
+
+  int v = 300;
+  (rc=fs.OpenScan(fh,INT,sizeof(int),offsetof(TestRec, num),
+                  LT_OP, &v, SEQ_SCAN_HINT));
+  ASSERT_EQ(rc, 0);
+
+  PF_FileHandle pfh;
+  ASSERT_EQ(0, fh.GetPF_FileHandle(pfh));
+  int numRecs = 0;
+  char * pData;
+  RID rid;
+  while((rc = fs.GetNextRec(pData, rid)) == 0) {
+    TestRec * pBuf = (TestRec*) pData;
+    EXPECT_EQ(numRecs, pBuf->num);
+    // pData is the record in the buffer pool, not a copy
+    char * pRec;
+    ASSERT_EQ(0, fh.PinRec(rid, pRec));
+    EXPECT_EQ(pData, pRec);
+    ASSERT_EQ(0, fh.UnpinRec(rid));
+    // the page being scanned is held
+    if(numRecs == 0) {
+      EXPECT_EQ(PF_PAGEPINNED, pfh.FlushPages());
+    }
+    numRecs++;
+  }  
+  ASSERT_EQ(rc, RM_EOF);
+  ASSERT_EQ(numRecs, v);
+  // nothing is held once the scan runs out
+  ASSERT_EQ(0, pfh.FlushPages());
+
+  // closing early lets go of the page too
+  fs.resetState();
+  ASSERT_EQ(0, fs.GetNextRec(pData, rid));
+  ASSERT_EQ(0, fs.CloseScan());
+  ASSERT_EQ(0, pfh.FlushPages());
+
+  ASSERT_EQ(RM_BAD_RID, fh.PinRec(RID(-1, -1), pData));
+  ASSERT_EQ(0, fh.DeleteRec(rid));
+  ASSERT_EQ(RM_NORECATRID, fh.PinRec(rid, pData));
+  ASSERT_EQ(0, pfh.FlushPages());
+}
+
+TEST_F(RM_FileScanTest, PageFilter) {
+	RM_FileScan fs;
+	RC rc;
+
+  // keys repeat so every operator has matches, some deleted
+  TestRec t;
+  memset(&t, 0, sizeof(t));
+  RID r;
+  std::vector<TestRec> recs;
+  std::vector<RID> rids;
+	int count = 1000;
+	for( int i = 0; i < count; i++)
+	{
+		t.num = (i * 37) % 101 - 50;
+		t.r = (i % 3 == 0) ? NAN : t.num / 4.0f;
+		sprintf(t.str, "k%03d", i % 50);
+		ASSERT_EQ(0, fh.InsertRec((char*) &t, r));
+		recs.push_back(t);
+		rids.push_back(r);
+	}
+	for( int i = 0; i < count; i += 7)
+		ASSERT_EQ(0, fh.DeleteRec(rids[i]));
+
+  int iv = 10;
+  float fv = 2.5f;
+  char sv[STRLEN] = "k025";
+  for(int op = NO_OP; op <= GE_OP; op++) {
+    CompOp c = (CompOp) op;
+    int expect[3] = {0, 0, 0};
+    for( int i = 0; i < count; i++) {
+      if(i % 7 == 0)
+        continue;
+      float x = recs[i].r;
+      int n = recs[i].num;
+      int s = strcmp(recs[i].str, sv);
+      switch(c) {
+      case NO_OP: expect[0]++; expect[1]++; expect[2]++; break;
+      case EQ_OP: expect[0] += n == iv; expect[1] += x == fv;
+        expect[2] += s == 0; break;
+      case NE_OP: expect[0] += n != iv; expect[1] += !(x == fv);
+        expect[2] += s != 0; break;
+      case LT_OP: expect[0] += n < iv; expect[1] += x < fv;
+        expect[2] += s < 0; break;
+      case GT_OP: expect[0] += n > iv; expect[1] += x > fv;
+        expect[2] += s > 0; break;
+      case LE_OP: expect[0] += n <= iv; expect[1] += x <= fv;
+        expect[2] += s <= 0; break;
+      case GE_OP: expect[0] += n >= iv; expect[1] += x >= fv;
+        expect[2] += s >= 0; break;
+      }
+    }
+
+    AttrType types[3] = { INT, FLOAT, STRING };
+    int lengths[3] = { sizeof(int), sizeof(float), STRLEN };
+    int offsets[3] = { offsetof(TestRec, num), offsetof(TestRec, r),
+                       offsetof(TestRec, str) };
+    void * values[3] = { &iv, &fv, sv };
+    for(int a = 0; a < 3; a++) {
+      ASSERT_EQ(0, fs.OpenScan(fh, types[a], lengths[a], offsets[a], c,
+                               values[a], SEQ_SCAN_HINT));
+      int numRecs = 0;
+      char * pData;
+      while((rc = fs.GetNextRec(pData, r)) == 0) {
+        RM_Record rec;
+        ASSERT_EQ(0, fh.GetRec(r, rec));
+        numRecs++;
+      }
+      ASSERT_EQ(RM_EOF, rc);
+      ASSERT_EQ(0, fs.CloseScan());
+      EXPECT_EQ(expect[a], numRecs) << "op " << op << " type " << a;
+    }
+  }
+}
+
+TEST_F(RM_FileScanTest, Conjunction) {
+	RM_FileScan fs;
+	RC rc;
+
+  // the first bytes of str hold a second int to compare num against
+  TestRec t;
+  memset(&t, 0, sizeof(t));
+  RID r;
+	int count = 1000;
+	for( int i = 0; i < count; i++)
+	{
+		t.num = i;
+		int other = (i * 7) % count;
+		memcpy(t.str, &other, sizeof(int));
+		t.r = i % 10;
+		ASSERT_EQ(0, fh.InsertRec((char*) &t, r));
+	}
+
+  int hi = 600;
+  float fv = 5;
+  Predicate preds[3] = {
+    Predicate(INT, sizeof(int), offsetof(TestRec, num), LT_OP, &hi, NO_HINT),
+    Predicate(INT, sizeof(int), offsetof(TestRec, num), GE_OP, NULL, NO_HINT,
+              offsetof(TestRec, str)),
+    Predicate(FLOAT, sizeof(float), offsetof(TestRec, r), NE_OP, &fv, NO_HINT)
+  };
+  int expect = 0;
+  for( int i = 0; i < hi; i++)
+    if(i >= (i * 7) % count && i % 10 != 5)
+      expect++;
+
+  // the pinned form and the copying form see the same records
+  for(int pass = 0; pass < 2; pass++) {
+    ASSERT_EQ(0, fs.OpenScan(fh, 3, preds, SEQ_SCAN_HINT));
+    int numRecs = 0;
+    while(1) {
+      TestRec * pBuf;
+      RM_Record rec;
+      if(pass == 0) {
+        char * pData;
+        rc = fs.GetNextRec(pData, r);
+        pBuf = (TestRec*) pData;
+      } else {
+        rc = fs.GetNextRec(rec);
+        if(rc == 0)
+          rec.GetData((char*&)pBuf);
+      }
+      if(rc != 0)
+        break;
+      int other;
+      memcpy(&other, pBuf->str, sizeof(int));
+      EXPECT_LT(pBuf->num, hi);
+      EXPECT_GE(pBuf->num, other);
+      EXPECT_NE(pBuf->r, fv);
+      numRecs++;
+    }
+    ASSERT_EQ(RM_EOF, rc);
+    ASSERT_EQ(0, fs.CloseScan());
+    EXPECT_EQ(expect, numRecs);
+  }
+
+  ASSERT_EQ(RM_FCREATEFAIL, fs.OpenScan(fh, 0, preds));
+  Predicate bad(INT, sizeof(int), 0, EQ_OP, NULL, NO_HINT, 4096);
+  ASSERT_EQ(RM_FCREATEFAIL, fs.OpenScan(fh, 1, &bad));
+}
+
+TEST_F(RM_FileScanTest, Pax) {
+	RM_FileScan fs;
+	RC rc;
+
+	// str with the padding after it, num and r each in a minipage
+	RM_Fields fields;
+	fields.n = 3;
+	fields.offset[0] = 0;
+	fields.length[0] = offsetof(TestRec, num);
+	fields.offset[1] = offsetof(TestRec, num);
+	fields.length[1] = sizeof(int);
+	fields.offset[2] = offsetof(TestRec, r);
+	fields.length[2] = sizeof(float);
+	fields.offset[1] = 1;
+	ASSERT_EQ(RM_FCREATEFAIL, rmm.CreateFile("gtestfilepax", sizeof(TestRec),
+	                                         PF_PAGE_SIZE, RM_PAX, &fields));
+	fields.offset[1] = offsetof(TestRec, num);
+	RM_FileHandle pfh;
+	system("rm -f gtestfilepax");
+	ASSERT_EQ(0, rmm.CreateFile("gtestfilepax", sizeof(TestRec), PF_PAGE_SIZE,
+	                            RM_PAX, &fields));
+	ASSERT_EQ(0, rmm.OpenFile("gtestfilepax", pfh));
+	ASSERT_EQ(fh.GetNumSlots(), pfh.GetNumSlots());
+
+  // the same records as in Conjunction, in a fixed file and a PAX one
+  TestRec t;
+  memset(&t, 0, sizeof(t));
+  RID r, pr;
+	int count = 1000;
+	for( int i = 0; i < count; i++)
+	{
+		t.num = i;
+		int other = (i * 7) % count;
+		memcpy(t.str, &other, sizeof(int));
+		t.r = i % 10;
+		ASSERT_EQ(0, fh.InsertRec((char*) &t, r));
+		ASSERT_EQ(0, pfh.InsertRec((char*) &t, pr));
+		ASSERT_EQ(r, pr);
+	}
+
+  // a record put together from its minipages
+  RM_Record rec;
+  TestRec * pBuf;
+  ASSERT_EQ(0, pfh.GetRec(RID(2, 7), rec));
+  rec.GetData((char*&)pBuf);
+  ASSERT_EQ(pfh.GetNumSlots() + 7, pBuf->num);
+  pBuf->r = 5;
+  ASSERT_EQ(0, pfh.UpdateRec(rec));
+  ASSERT_EQ(0, fh.UpdateRec(rec));
+
+  int hi = 600;
+  float fv = 5;
+  Predicate preds[3] = {
+    Predicate(INT, sizeof(int), offsetof(TestRec, num), LT_OP, &hi, NO_HINT),
+    Predicate(INT, sizeof(int), offsetof(TestRec, num), GE_OP, NULL, NO_HINT,
+              offsetof(TestRec, str)),
+    Predicate(FLOAT, sizeof(float), offsetof(TestRec, r), NE_OP, &fv, NO_HINT)
+  };
+  // each predicate alone and all of them give the records the fixed file
+  // gives, at the same RIDs
+  for(int n = 0; n < 4; n++) {
+    RM_FileScan ffs;
+    const Predicate * p = (n < 3) ? &preds[n] : preds;
+    int np = (n < 3) ? 1 : 3;
+    ASSERT_EQ(0, fs.OpenScan(pfh, np, p));
+    ASSERT_EQ(0, ffs.OpenScan(fh, np, p));
+    int numRecs = 0;
+    char * pData, * pFixed;
+    while((rc = fs.GetNextRec(pData, pr)) == 0) {
+      ASSERT_EQ(0, ffs.GetNextRec(pFixed, r));
+      ASSERT_EQ(r, pr);
+      ASSERT_EQ(0, memcmp(pFixed, pData, sizeof(TestRec)));
+      numRecs++;
+    }
+    ASSERT_EQ(RM_EOF, rc);
+    ASSERT_EQ(RM_EOF, ffs.GetNextRec(pFixed, r));
+    ASSERT_EQ(0, fs.CloseScan());
+    ASSERT_EQ(0, ffs.CloseScan());
+    ASSERT_GT(numRecs, 0);
+  }
+  ASSERT_EQ(0, rmm.CloseFile(pfh));
+  rmm.DestroyFile("gtestfilepax");
+}
+
+TEST_F(RM_FileScanTest, Compressed) {
+	RM_FileScan fs;
+	RC rc;
+
+	RM_Fields fields;
+	fields.n = 3;
+	fields.offset[0] = 0;
+	fields.length[0] = offsetof(TestRec, num);
+	fields.offset[1] = offsetof(TestRec, num);
+	fields.length[1] = sizeof(int);
+	fields.offset[2] = offsetof(TestRec, r);
+	fields.length[2] = sizeof(float);
+	RM_FileHandle cfh;
+	system("rm -f gtestfilecomp");
+	ASSERT_EQ(0, rmm.CreateFile("gtestfilecomp", sizeof(TestRec),
+	                            PF_PAGE_SIZE, RM_COMPRESSED, &fields));
+	ASSERT_EQ(0, rmm.OpenFile("gtestfilecomp", cfh));
+
+  // few distinct strings, ints in a narrow range and long runs of floats
+  const char * names[3] = { "1-URGENT", "2-HIGH", "5-LOW" };
+  int count = 2000;
+  std::vector<TestRec> rows(count);
+  memset(&rows[0], 0, count * sizeof(TestRec));
+  for( int i = 0; i < count; i++) {
+    strcpy(rows[i].str, names[(i * 7) % 3]);
+    rows[i].num = 1000 + i;
+    rows[i].r = i / 100;
+  }
+  std::vector<RID> rids(count);
+  ASSERT_EQ(0, cfh.InsertRecs((char*) &rows[0], count / 2, &rids[0]));
+  for( int i = count / 2; i < count; i++)
+    ASSERT_EQ(0, cfh.InsertRec((char*) &rows[i], rids[i]));
+  // more to a page than the fixed format holds
+  ASSERT_LT(cfh.GetNumPages() - 1, count / fh.GetNumSlots());
+  PF_FileHandle pfh;
+  PF_PageHandle ph;
+  char * pPage;
+  ASSERT_EQ(0, cfh.GetPF_FileHandle(pfh));
+  ASSERT_EQ(0, pfh.GetThisPage(1, ph));
+  ASSERT_EQ(0, ph.GetData(pPage));
+  RM_PackedPageView v(pPage, cfh.GetNumSlots(), fields, pfh.GetPageSize());
+  ASSERT_EQ(RM_DICT, v.GetCol(0).enc);
+  ASSERT_EQ(RM_FOR, v.GetCol(1).enc);
+  ASSERT_EQ(RM_RLE, v.GetCol(2).enc);
+  ASSERT_EQ(0, pfh.UnpinPage(1));
+  for( int i = 0; i < count; i += 37) {
+    RM_Record rec;
+    TestRec * pBuf;
+    ASSERT_EQ(0, cfh.GetRec(rids[i], rec));
+    rec.GetData((char*&)pBuf);
+    ASSERT_EQ(0, memcmp(&rows[i], pBuf, sizeof(TestRec)));
+  }
+
+  // records change in place; the ones deleted make room again
+  for( int i = 0; i < count; i += 50) {
+    rows[i].num = -i;
+    strcpy(rows[i].str, "3-MEDIUM");
+    RM_Record rec;
+    ASSERT_EQ(0, rec.Set((char*) &rows[i], sizeof(TestRec), rids[i]));
+    ASSERT_EQ(0, cfh.UpdateRec(rec));
+  }
+  ASSERT_EQ(0, cfh.DeleteRec(rids[5]));
+  RID r;
+  ASSERT_EQ(0, cfh.InsertRec((char*) &rows[5], r));
+  ASSERT_EQ(rids[5], r);
+
+  int lo = 1500;
+  float fv = 7;
+  char key[STRLEN];
+  memset(key, 0, STRLEN);
+  strcpy(key, "2-HIGH");
+  Predicate preds[4] = {
+    Predicate(INT, sizeof(int), offsetof(TestRec, num), GE_OP, &lo, NO_HINT),
+    Predicate(STRING, STRLEN, 0, EQ_OP, key, NO_HINT),
+    Predicate(FLOAT, sizeof(float), offsetof(TestRec, r), NE_OP, &fv, NO_HINT),
+    Predicate(FLOAT, sizeof(float), offsetof(TestRec, r), GT_OP, NULL, NO_HINT,
+              offsetof(TestRec, num))
+  };
+  // each predicate alone and all of them
+  for(int n = 0; n < 5; n++) {
+    const Predicate * p = (n < 4) ? &preds[n] : preds;
+    int np = (n < 4) ? 1 : 4;
+    int expect = 0;
+    for( int i = 0; i < count; i++) {
+      bool b = true;
+      for(int j = 0; j < np; j++)
+        b = b && p[j].eval((char*) &rows[i], p[j].initOp());
+      expect += b;
+    }
+    ASSERT_EQ(0, fs.OpenScan(cfh, np, p));
+    int numRecs = 0;
+    char * pData;
+    while((rc = fs.GetNextRec(pData, r)) == 0) {
+      int i = ((TestRec*) pData)->num - 1000;
+      if(i < 0)
+        i = -((TestRec*) pData)->num;
+      ASSERT_EQ(rids[i], r);
+      ASSERT_EQ(0, memcmp(&rows[i], pData, sizeof(TestRec)));
+      numRecs++;
+    }
+    ASSERT_EQ(RM_EOF, rc);
+    ASSERT_EQ(0, fs.CloseScan());
+    ASSERT_EQ(expect, numRecs);
+    ASSERT_GT(numRecs, 0);
+  }
+  ASSERT_EQ(0, rmm.CloseFile(cfh));
+  rmm.DestroyFile("gtestfilecomp");
+}
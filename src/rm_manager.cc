@@ -42,17 +42,62 @@ RM_Manager::~RM_Manager()
 // with recordSize as the fixed size of records.
 // In:   fileName - name of file to create
 // In:   recordSize
+// In:   pageSize - bytes per page, see PF_Manager::CreateFile
+// In:   format - RM_FIXED, RM_SLOTTED, RM_PAX or RM_COMPRESSED
+// In:   fields - see RM_Fields.  None if NULL; for RM_PAX and
+//                RM_COMPRESSED that is one field of the whole record
 // Ret:  RM return code
 //
-RC RM_Manager::CreateFile (const char *fileName, int recordSize)
+RC RM_Manager::CreateFile (const char *fileName, int recordSize,
+                           int pageSize, int format,
+                           const RM_Fields *fields)
 {
-   if(recordSize >= PF_PAGE_SIZE - (int)sizeof(RM_PageHdr))
+   if(recordSize >= pageSize - (int)sizeof(RM_PageHdr))
       return RM_SIZETOOBIG;
 
-   if(recordSize <= 0)
+   if(recordSize <= 0 || pageSize > PF_MAX_PAGE_SIZE)
       return RM_BADRECSIZE;
 
-   int RC = pfm.CreateFile(fileName);
+   RM_Fields none;
+   none.n = 0;
+   bool bMinipages = (format == RM_PAX || format == RM_COMPRESSED);
+   if(bMinipages) {
+      none.n = 1;
+      none.offset[0] = 0;
+      none.length[0] = recordSize;
+   }
+   if(fields == NULL || format == RM_FIXED)
+      fields = &none;
+   if(format != RM_FIXED && format != RM_SLOTTED && !bMinipages)
+      return RM_FCREATEFAIL;
+   if(fields->n < 0 || fields->n > MAXATTRS)
+      return RM_FCREATEFAIL;
+   // in order and inside the record
+   int end = 0;
+   for(int i = 0; i < fields->n; i++) {
+      if(fields->offset[i] < end || fields->length[i] <= 0
+         || fields->offset[i] + fields->length[i] > recordSize)
+         return RM_FCREATEFAIL;
+      // short enough for a 1 byte length, or with no gap before it
+      if((format == RM_SLOTTED && fields->length[i] > MAXSTRINGLEN) ||
+         (bMinipages && fields->offset[i] != end))
+         return RM_FCREATEFAIL;
+      end = fields->offset[i] + fields->length[i];
+   }
+   if(bMinipages && (fields->n == 0 || end != recordSize))
+      return RM_FCREATEFAIL;
+   // a page with the most slots it can have still has to take one record
+   // and leave the reserve free
+   if(format == RM_COMPRESSED &&
+      RM_PackedPageView::Size(pageSize / 2, fields->n) + recordSize +
+      pageSize / 16 > pageSize)
+      return RM_SIZETOOBIG;
+   // a record at its longest has to fit on a page with its directory entry
+   if(format == RM_SLOTTED &&
+      1 + recordSize + fields->n + RM_SlottedPageView::Size(1) > pageSize)
+      return RM_SIZETOOBIG;
+
+   int RC = pfm.CreateFile(fileName, pageSize);
    if (RC < 0)
    {
       PF_PrintError(RC);
@@ -86,6 +131,8 @@ RC RM_Manager::CreateFile (const char *fileName, int recordSize)
    hdr.firstFree = RM_PAGE_LIST_END;
    hdr.numPages = 1; // hdr page
    hdr.extRecordSize = recordSize;
+   hdr.format = format;
+   hdr.fields = *fields;
 
    memcpy(pData, &hdr, sizeof(hdr));
    //TODO - remove PF_PrintError or make it #define optional
@@ -135,16 +182,19 @@ RC RM_Manager::DestroyFile (const char *fileName)
 // OpenFile
 //
 // In:   fileName - name of file to open
+//       openFlags - passed on to PF_Manager::OpenFile; PF_MMAP_READONLY
+//                   gives a read-only handle whose writes fail
 // Out:  fileHandle - refer to the open file
 //                    this function modifies local var's in fileHandle
 //       to point to the file data in the file table, and to point to the
 //       buffer manager object
 // Ret:  PF_FILEOPEN or other RM return code
 //
-RC RM_Manager::OpenFile (const char *fileName, RM_FileHandle &rmh)
+RC RM_Manager::OpenFile (const char *fileName, RM_FileHandle &rmh,
+                         int openFlags)
 {
    PF_FileHandle pfh;
-   RC rc = pfm.OpenFile(fileName, pfh);
+   RC rc = pfm.OpenFile(fileName, pfh, openFlags);
    if (rc < 0)
    {
       PF_PrintError(rc);
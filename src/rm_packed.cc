@@ -0,0 +1,419 @@
+//
+// File:        rm_packed.cc
+// Description: RM_FileHandle for files in the RM_COMPRESSED format
+//
+// Reads decode a record or a minipage at a time where it sits on the page.
+// Writes decode the whole page, change it and encode it again.
+//
+
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+#include <vector>
+#include "rm.h"
+
+using namespace std;
+
+namespace {
+
+// bits to tell n values apart
+int BitsFor(unsigned long long n)
+{
+  int b = 0;
+  while((1ULL << b) < n)
+    b++;
+  return b;
+}
+
+int PackedBytes(int n, int bits)
+{
+  return (int)(((long long)n * bits + 7) / 8);
+}
+
+// value i of those packed bits bits each from p, lowest bits first
+unsigned int GetBits(const char *p, int i, int bits)
+{
+  if(bits == 0)
+    return 0;
+  long long bit = (long long)i * bits;
+  const unsigned char * q = (const unsigned char *)p + bit / 8;
+  int shift = bit % 8;
+  unsigned long long w = 0;
+  for(int k = 0; k * 8 < shift + bits; k++)
+    w |= (unsigned long long)q[k] << (k * 8);
+  return (w >> shift) & ((1ULL << bits) - 1);
+}
+
+// the bits of value i must still be zero
+void PutBits(char *p, int i, int bits, unsigned int v)
+{
+  if(bits == 0)
+    return;
+  long long bit = (long long)i * bits;
+  unsigned char * q = (unsigned char *)p + bit / 8;
+  int shift = bit % 8;
+  unsigned long long w = (unsigned long long)v << shift;
+  for(int k = 0; k * 8 < shift + bits; k++)
+    q[k] |= (unsigned char)(w >> (k * 8));
+}
+
+unsigned short GetEnd(const char *ends, int r)
+{
+  unsigned short v;
+  memcpy(&v, ends + r * sizeof(v), sizeof(v));
+  return v;
+}
+
+// The slot whose value each slot up to top stores - for a free one the
+// used slot before it, or after it at the start of the page
+void Sources(const RM_PageHdrView &pHdr, int top, vector<int> &src)
+{
+  src.resize(top);
+  int last = pHdr.NextUsed(0);
+  for(int s = 0; s < top; s++) {
+    if(!pHdr.IsFree(s))
+      last = s;
+    src[s] = last;
+  }
+}
+
+// slots of col in the order of their values
+void SortValues(const char *col, int len, const vector<int> &src,
+                vector<int> &order)
+{
+  order = src;
+  sort(order.begin(), order.end(), [col, len](int a, int b) {
+      return memcmp(col + a * len, col + b * len, len) < 0; });
+}
+
+} // namespace
+
+int RM_PackedPageView::Top() const
+{
+  RM_PageHdrView pHdr(buf, numSlots);
+  int top = 0;
+  for(int s = pHdr.NextUsed(0); s < numSlots; s = pHdr.NextUsed(s + 1))
+    top = s + 1;
+  return top;
+}
+
+void RM_PackedPageView::Init()
+{
+  int top = 0;
+  memcpy(buf + RM_PageHdrView::Size(numSlots), &top, sizeof(int));
+  memset(ColHdr(0), 0, fields->n * sizeof(RM_ColHdr));
+}
+
+unsigned int RM_PackedPageView::Code(int f, int s) const
+{
+  RM_ColHdr c = GetCol(f);
+  const char * d = GetData(f);
+  if(c.enc == RM_DICT)
+    d += c.n * fields->length[f];
+  return GetBits(d, s, c.bits);
+}
+
+void RM_PackedPageView::ReadField(int f, int s, char *out) const
+{
+  RM_ColHdr c = GetCol(f);
+  const char * d = GetData(f);
+  int len = fields->length[f];
+  switch(c.enc) {
+  case RM_DICT:
+    memcpy(out, d + GetBits(d + c.n * len, s, c.bits) * len, len);
+    break;
+  case RM_FOR: {
+    int v = c.base + (int)GetBits(d, s, c.bits);
+    memcpy(out, &v, sizeof(int));
+    break;
+  }
+  case RM_RLE: {
+    // the first run that ends after s
+    const char * ends = d + c.n * len;
+    int lo = 0, hi = c.n - 1;
+    while(lo < hi) {
+      int mid = (lo + hi) / 2;
+      if(GetEnd(ends, mid) > s)
+        hi = mid;
+      else
+        lo = mid + 1;
+    }
+    memcpy(out, d + lo * len, len);
+    break;
+  }
+  default:
+    memcpy(out, d + s * len, len);
+  }
+}
+
+void RM_PackedPageView::Read(int s, char *pData) const
+{
+  for(int f = 0; f < fields->n; f++)
+    ReadField(f, s, pData + fields->offset[f]);
+}
+
+void RM_PackedPageView::Unpack(int f, char *out) const
+{
+  RM_ColHdr c = GetCol(f);
+  const char * d = GetData(f);
+  int len = fields->length[f];
+  int top = GetTop();
+  switch(c.enc) {
+  case RM_DICT: {
+    const char * codes = d + c.n * len;
+    for(int s = 0; s < top; s++)
+      memcpy(out + s * len, d + GetBits(codes, s, c.bits) * len, len);
+    break;
+  }
+  case RM_FOR:
+    for(int s = 0; s < top; s++) {
+      int v = c.base + (int)GetBits(d, s, c.bits);
+      memcpy(out + s * len, &v, sizeof(int));
+    }
+    break;
+  case RM_RLE: {
+    const char * ends = d + c.n * len;
+    for(int r = 0, s = 0; r < c.n; r++)
+      for(; s < GetEnd(ends, r); s++)
+        memcpy(out + s * len, d + r * len, len);
+    break;
+  }
+  default:
+    memcpy(out, d, top * len);
+  }
+}
+
+void RM_PackedPageView::UnpackAll(char *cols) const
+{
+  for(int f = 0; f < fields->n; f++)
+    Unpack(f, cols + numSlots * fields->offset[f]);
+}
+
+// Each field takes the smallest of the encodings that can hold its values
+int RM_PackedPageView::Plan(const char *cols, const int *src, int top,
+                            RM_ColHdr *hdrs) const
+{
+  int total = 0;
+  vector<int> srcs(src, src + top), order;
+  for(int f = 0; f < fields->n; f++) {
+    int len = fields->length[f];
+    const char * col = cols + numSlots * fields->offset[f];
+    RM_ColHdr &c = hdrs[f];
+    memset(&c, 0, sizeof(c));
+    c.enc = RM_RAW;
+    c.offset = total;
+    int best = top * len;
+    if(top == 0)
+      continue;
+
+    if(len == sizeof(int)) {
+      int lo, hi;
+      memcpy(&lo, col + src[0] * len, sizeof(int));
+      hi = lo;
+      for(int s = 1; s < top; s++) {
+        int v;
+        memcpy(&v, col + src[s] * len, sizeof(int));
+        lo = min(lo, v);
+        hi = max(hi, v);
+      }
+      // offsets stay clear of the sign bit, for predicates on them
+      int bits = BitsFor((unsigned long long)((long long)hi - lo) + 1);
+      if(bits <= 30 && PackedBytes(top, bits) < best) {
+        best = PackedBytes(top, bits);
+        c.enc = RM_FOR;
+        c.bits = bits;
+        c.base = lo;
+      }
+    }
+
+    SortValues(col, len, srcs, order);
+    int distinct = 1;
+    for(int s = 1; s < top; s++)
+      if(memcmp(col + order[s] * len, col + order[s - 1] * len, len) != 0)
+        distinct++;
+    int bits = BitsFor(distinct);
+    if(distinct * len + PackedBytes(top, bits) < best) {
+      best = distinct * len + PackedBytes(top, bits);
+      c.enc = RM_DICT;
+      c.bits = bits;
+      c.n = distinct;
+    }
+
+    int runs = 1;
+    for(int s = 1; s < top; s++)
+      if(memcmp(col + src[s] * len, col + src[s - 1] * len, len) != 0)
+        runs++;
+    if(runs * (len + (int)sizeof(short)) < best) {
+      best = runs * (len + sizeof(short));
+      c.enc = RM_RLE;
+      c.bits = 0;
+      c.n = runs;
+    }
+    total += best;
+  }
+  return total;
+}
+
+int RM_PackedPageView::PackedSize(const char *cols) const
+{
+  int top = Top();
+  vector<int> src;
+  Sources(RM_PageHdrView(buf, numSlots), top, src);
+  vector<RM_ColHdr> hdrs(fields->n);
+  return Plan(cols, src.data(), top, hdrs.data());
+}
+
+bool RM_PackedPageView::Pack(const char *cols, int reserve)
+{
+  int top = Top();
+  vector<int> src;
+  Sources(RM_PageHdrView(buf, numSlots), top, src);
+  vector<RM_ColHdr> hdrs(fields->n);
+  int total = Plan(cols, src.data(), top, hdrs.data());
+  if(total + reserve > DataSpace())
+    return false;
+
+  memcpy(buf + RM_PageHdrView::Size(numSlots), &top, sizeof(int));
+  char * data = buf + Size(numSlots, fields->n);
+  memset(data, 0, total);
+  vector<int> order;
+  for(int f = 0; f < fields->n; f++) {
+    const RM_ColHdr &c = hdrs[f];
+    memcpy(ColHdr(f), &c, sizeof(c));
+    int len = fields->length[f];
+    const char * col = cols + numSlots * fields->offset[f];
+    char * d = data + c.offset;
+    switch(c.enc) {
+    case RM_FOR:
+      for(int s = 0; s < top; s++) {
+        int v;
+        memcpy(&v, col + src[s] * len, sizeof(int));
+        PutBits(d, s, c.bits, (unsigned int)((long long)v - c.base));
+      }
+      break;
+    case RM_DICT: {
+      // the distinct values in order, then the code of each slot
+      SortValues(col, len, src, order);
+      int n = 0;
+      for(int s = 0; s < top; s++)
+        if(n == 0 || memcmp(col + order[s] * len, d + (n - 1) * len, len))
+          memcpy(d + n++ * len, col + order[s] * len, len);
+      char * codes = d + c.n * len;
+      for(int s = 0; s < top; s++) {
+        int lo = 0, hi = c.n - 1;
+        while(lo < hi) {
+          int mid = (lo + hi) / 2;
+          if(memcmp(d + mid * len, col + src[s] * len, len) < 0)
+            lo = mid + 1;
+          else
+            hi = mid;
+        }
+        PutBits(codes, s, c.bits, lo);
+      }
+      break;
+    }
+    case RM_RLE: {
+      char * ends = d + c.n * len;
+      int r = 0;
+      for(int s = 0; s <= top; s++) {
+        if(s > 0 && (s == top ||
+           memcmp(col + src[s] * len, col + src[s - 1] * len, len))) {
+          unsigned short end = s;
+          memcpy(ends + (r - 1) * sizeof(end), &end, sizeof(end));
+        }
+        if(s < top &&
+           (s == 0 || memcmp(col + src[s] * len, col + src[s - 1] * len, len)))
+          memcpy(d + r++ * len, col + src[s] * len, len);
+      }
+      break;
+    }
+    default:
+      for(int s = 0; s < top; s++)
+        memcpy(d + s * len, col + src[s] * len, len);
+    }
+  }
+  return true;
+}
+
+RC RM_FileHandle::InsertPacked(const char *rows, int n, RID *rids)
+{
+  int numSlots = GetNumSlots();
+  int recSize = this->fullRecordSize();
+  int done = 0;
+  vector<int> slots;
+  while(done < n) {
+    PF_PageHandle ph;
+    PageNum p;
+    RC rc;
+    char * pPage;
+    int nPages = (n - done + numSlots - 1) / numSlots;
+    if((rc = this->GetNextFreePage(p, nPages)) ||
+       (rc = pfHandle->GetThisPage(p, ph)))
+      return rc;
+    // dirty before it is written - a read-only file fails here
+    if((rc = ph.GetData(pPage)) ||
+       (rc = pfHandle->MarkDirty(p))) {
+      pfHandle->UnpinPage(p);
+      return rc;
+    }
+
+    // the next records go in the first free slots, as many as still leave
+    // the reserve free once the page is encoded
+    RM_PageHdrView pHdr(pPage, numSlots);
+    RM_PackedPageView v(pPage, numSlots, hdr.fields, pfHandle->GetPageSize());
+    v.UnpackAll(packBuf);
+    slots.clear();
+    for(SlotNum s = pHdr.FirstFree(); s < numSlots &&
+          done + (int)slots.size() < n; s = pHdr.NextFree(s + 1)) {
+      WriteSlot(packBuf, numSlots, s, rows + (done + slots.size()) * recSize);
+      slots.push_back(s);
+    }
+    int lo = 0, hi = slots.size();
+    while(lo < hi) {
+      int mid = (lo + hi + 1) / 2;
+      for(int j = 0; j < mid; j++)
+        pHdr.SetUsed(slots[j]);
+      bool bFits = (v.PackedSize(packBuf) + PackReserve() <= v.DataSpace());
+      for(int j = 0; j < mid; j++)
+        pHdr.SetFree(slots[j]);
+      if(bFits)
+        lo = mid;
+      else
+        hi = mid - 1;
+    }
+    int numFree = pHdr.GetNumFreeSlots();
+    if(lo == 0 && numFree == numSlots) {
+      // not even one on an empty page
+      pfHandle->UnpinPage(p);
+      return RM_SIZETOOBIG;
+    }
+    for(int j = 0; j < lo; j++) {
+      pHdr.SetUsed(slots[j]);
+      rids[done++] = RID(p, slots[j]);
+    }
+    if(lo > 0 && !v.Pack(packBuf, PackReserve())) {
+      pfHandle->UnpinPage(p);
+      return -1; // unexpected error
+    }
+    pHdr.SetNumFreeSlots(numFree - lo);
+    if((rc = pfHandle->UnpinPage(p)))
+      return rc;
+    // out of bytes before slots, the page takes no more
+    int cat = SpaceCat(numFree - lo, numSlots);
+    if(lo < (int)slots.size())
+      cat = 0;
+    if(cat != SpaceCat(numFree, numSlots) && (rc = SetSpace(p, cat)))
+      return rc;
+  }
+  return 0;
+}
+
+RC RM_FileHandle::UpdatePacked(char *pPage, SlotNum s, const char *pData)
+{
+  int numSlots = GetNumSlots();
+  RM_PackedPageView v(pPage, numSlots, hdr.fields, pfHandle->GetPageSize());
+  v.UnpackAll(packBuf);
+  WriteSlot(packBuf, numSlots, s, pData);
+  // the reserve inserts leave is there for this
+  return v.Pack(packBuf, 0) ? 0 : RM_PAGEFULL;
+}
@@ -59,3 +59,37 @@ TEST_F(RM_RecordTest, RM_PageHdr) {
 	bitmap b2(h2.freeSlotMap, 4);
 	std::cerr << b2 << std::endl;
 }
+
+TEST_F(RM_RecordTest, RM_PageHdrView) {
+	char buf[40];
+	RM_PageHdrView v(buf, 20);
+	v.Init(RM_PAGE_LIST_END);
+	ASSERT_EQ(3 * (int)sizeof(int) + 3, RM_PageHdrView::Size(20));
+	ASSERT_EQ(RM_PageHdr(20).size(), RM_PageHdrView::Size(20));
+	ASSERT_EQ(0, v.FirstFree());
+	ASSERT_EQ(20, v.NextUsed(0));
+
+	v.SetUsed(0);
+	v.SetUsed(17);
+	v.SetNumFreeSlots(18);
+	ASSERT_EQ(1, v.FirstFree());
+	ASSERT_EQ(0, v.NextUsed(0));
+	ASSERT_EQ(17, v.NextUsed(1));
+	ASSERT_EQ(20, v.NextUsed(18));
+
+	// same bytes as the copying header
+	RM_PageHdr h(20);
+	h.from_buf(buf);
+	ASSERT_EQ(RM_PAGE_LIST_END, h.nextFree);
+	ASSERT_EQ(20, h.numSlots);
+	ASSERT_EQ(18, h.numFreeSlots);
+	bitmap b(h.freeSlotMap, 20);
+	for (int i = 0; i < 20; i++)
+		ASSERT_EQ(b.test(i), v.IsFree(i));
+
+	for (int i = 1; i < 20; i++)
+		v.SetUsed(i);
+	ASSERT_EQ(20, v.FirstFree());
+	v.SetFree(9);
+	ASSERT_EQ(9, v.FirstFree());
+}
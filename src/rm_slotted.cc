@@ -0,0 +1,517 @@
+//
+// File:        rm_slotted.cc
+// Description: RM_FileHandle for files in the RM_SLOTTED format
+//
+// A record is stored as its fixed-size layout with each of the file's
+// variable fields replaced by a length byte and the bytes of the string up
+// to its NUL.  A record that grows past the room on its page moves to
+// another page; a stub with its new RID keeps its place so that the RID
+// does not change.
+//
+
+#include <cstring>
+#include <cassert>
+#include "rm.h"
+
+using namespace std;
+
+int RM_SlottedPageView::FreeSlot() const
+{
+  int n = GetNumSlots();
+  for(int i = 0; i < n; i++)
+    if(GetOffset(i) == 0)
+      return i;
+  return n;
+}
+
+void RM_SlottedPageView::Init()
+{
+  SetInt(0, 0);
+  SetInt(1, pageSize);
+  SetInt(2, 0);
+}
+
+void RM_SlottedPageView::SetSlot(int slot, int offset, int length)
+{
+  unsigned short v[2] = { (unsigned short)offset, (unsigned short)length };
+  memcpy(buf + Size(slot), v, sizeof(v));
+}
+
+// Move the records up against the end of the page so that the free space
+// is in one piece after the directory
+void RM_SlottedPageView::Compact()
+{
+  int n = GetNumSlots();
+  char * tmp = new char[pageSize];
+  int end = pageSize;
+  for(int i = 0; i < n; i++) {
+    if(GetOffset(i) == 0)
+      continue;
+    int len = GetLength(i);
+    end -= len;
+    memcpy(tmp + end, buf + GetOffset(i), len);
+    SetSlot(i, end, len);
+  }
+  memcpy(buf + end, tmp + end, pageSize - end);
+  delete [] tmp;
+  SetInt(1, end);
+}
+
+char * RM_SlottedPageView::Place(int slot, int len)
+{
+  int n = GetNumSlots();
+  int newN = (slot == n) ? n + 1 : n;
+  if(GetFreeEnd() - Size(newN) < len)
+    Compact();
+  assert(GetFreeEnd() - Size(newN) >= len);
+  SetInt(0, newN);
+  int offset = GetFreeEnd() - len;
+  SetSlot(slot, offset, len);
+  SetInt(1, offset);
+  SetInt(2, GetUsed() + len);
+  return buf + offset;
+}
+
+// The bytes of the record are not kept if it has to move
+char * RM_SlottedPageView::Resize(int slot, int len)
+{
+  int old = GetLength(slot);
+  if(len <= old) {
+    // the rest becomes a hole until the page is compacted
+    SetSlot(slot, GetOffset(slot), len);
+    SetInt(2, GetUsed() - old + len);
+    return GetRec(slot);
+  }
+  SetSlot(slot, 0, 0);
+  SetInt(2, GetUsed() - old);
+  return Place(slot, len);
+}
+
+void RM_SlottedPageView::Free(int slot)
+{
+  SetInt(2, GetUsed() - GetLength(slot));
+  SetSlot(slot, 0, 0);
+  // free entries at the end of the directory go back to the records
+  int n = GetNumSlots();
+  while(n > 0 && GetOffset(n - 1) == 0)
+    n--;
+  SetInt(0, n);
+}
+
+int RM_FileHandle::StoredSize(const char *pData) const
+{
+  const RM_Fields &v = hdr.fields;
+  int size = 1 + hdr.extRecordSize;
+  for(int i = 0; i < v.n; i++)
+    size += 1 + strnlen(pData + v.offset[i], v.length[i]) - v.length[i];
+  return (size > RM_MIN_STORED) ? size : RM_MIN_STORED;
+}
+
+void RM_FileHandle::Encode(const char *pData, char flag, char *pStored) const
+{
+  const RM_Fields &v = hdr.fields;
+  char * out = pStored;
+  *out++ = flag;
+  int pos = 0;
+  for(int i = 0; i < v.n; i++) {
+    memcpy(out, pData + pos, v.offset[i] - pos);
+    out += v.offset[i] - pos;
+    int len = strnlen(pData + v.offset[i], v.length[i]);
+    *out++ = (char)len;
+    memcpy(out, pData + v.offset[i], len);
+    out += len;
+    pos = v.offset[i] + v.length[i];
+  }
+  memcpy(out, pData + pos, hdr.extRecordSize - pos);
+  out += hdr.extRecordSize - pos;
+  if(out - pStored < RM_MIN_STORED)
+    memset(out, 0, RM_MIN_STORED - (out - pStored));
+}
+
+void RM_FileHandle::Decode(const char *pStored, char *pData) const
+{
+  const RM_Fields &v = hdr.fields;
+  const char * in = pStored + 1;
+  int pos = 0;
+  for(int i = 0; i < v.n; i++) {
+    memcpy(pData + pos, in, v.offset[i] - pos);
+    in += v.offset[i] - pos;
+    int len = (unsigned char)*in++;
+    memcpy(pData + v.offset[i], in, len);
+    memset(pData + v.offset[i] + len, 0, v.length[i] - len);
+    in += len;
+    pos = v.offset[i] + v.length[i];
+  }
+  memcpy(pData + pos, in, hdr.extRecordSize - pos);
+}
+
+// A stub is RM_MOVED followed by the page and slot of the record
+static RID StubRID(const char *pStub)
+{
+  int v[2];
+  memcpy(v, pStub + 1, sizeof(v));
+  return RID(v[0], v[1]);
+}
+
+static void SetStub(char *pStub, const RID &rid)
+{
+  int v[2] = { rid.Page(), rid.Slot() };
+  pStub[0] = RM_MOVED;
+  memcpy(pStub + 1, v, sizeof(v));
+}
+
+// A record moved in starts the same way with RM_MOVEDIN and the page and
+// slot of its stub, and goes on with the record as it is stored anywhere
+// else
+static void SetMovedIn(char *pStored, const RID &stub)
+{
+  SetStub(pStored, stub);
+  pStored[0] = RM_MOVEDIN;
+}
+
+static char * MovedInRec(char *pStored)
+{
+  return pStored + RM_MIN_STORED;
+}
+
+RC RM_FileHandle::GetMoved(const char *pStub, char *pData) const
+{
+  RID to = StubRID(pStub);
+  PF_PageHandle ph;
+  char * pPage;
+  RC rc;
+  if((rc = pfHandle->GetThisPage(to.Page(), ph)))
+    return rc;
+  ph.GetData(pPage);
+  RM_SlottedPageView v(pPage, pfHandle->GetPageSize());
+  assert(!v.IsFree(to.Slot()) && v.GetRec(to.Slot())[0] == RM_MOVEDIN);
+  Decode(MovedInRec(v.GetRec(to.Slot())), pData);
+  return pfHandle->UnpinPage(to.Page());
+}
+
+RC RM_FileHandle::PinSlotted(const RID &rid, char *&pData) const
+{
+  PageNum p = rid.Page();
+  SlotNum s = rid.Slot();
+  PF_PageHandle ph;
+  char * pPage;
+  RC rc;
+  if((rc = pfHandle->GetThisPage(p, ph)))
+    return rc;
+  ph.GetData(pPage);
+
+  RM_SlottedPageView v(pPage, pfHandle->GetPageSize());
+  // a record moved in is reached through its stub only
+  if(v.IsFree(s) || v.GetRec(s)[0] == RM_MOVEDIN) {
+    pfHandle->UnpinPage(p);
+    return RM_NORECATRID;
+  }
+  if(v.GetRec(s)[0] == RM_MOVED) {
+    if((rc = GetMoved(v.GetRec(s), recBuf))) {
+      pfHandle->UnpinPage(p);
+      return rc;
+    }
+  } else {
+    Decode(v.GetRec(s), recBuf);
+  }
+  pData = recBuf;
+  return 0;
+}
+
+RC RM_FileHandle::SetSlottedSpace(PageNum p, int oldFree, int newFree)
+{
+  if(SlottedCat(oldFree) == SlottedCat(newFree))
+    return 0;
+  // inserts look here again
+  if(newFree > oldFree && p < hdr.firstFree) {
+    hdr.firstFree = p;
+    bHdrChanged = true;
+  }
+  return SetSpace(p, SlottedCat(newFree));
+}
+
+RC RM_FileHandle::InsertSlotted(const char *rows, int n, RID *rids)
+{
+  int recSize = this->fullRecordSize();
+  int entry = 2 * sizeof(short);
+  // bytes all the records still to go will take, for new pages
+  long rest = 0;
+  for(int i = 0; i < n; i++)
+    rest += StoredSize(rows + i * recSize) + entry;
+
+  int done = 0;
+  while(done < n) {
+    // a page that surely has room for the next record
+    int need = StoredSize(rows + done * recSize) + entry;
+    int minCat = (need * 15 + SlottedSpace() - 1) / SlottedSpace();
+    int nPages = (rest + SlottedSpace() - 1) / SlottedSpace();
+    PF_PageHandle ph;
+    PageNum p;
+    RC rc;
+    char * pPage;
+    if((rc = this->GetNextFreePage(p, nPages, minCat)) ||
+       (rc = pfHandle->GetThisPage(p, ph)))
+      return rc;
+    // dirty before it is written - a read-only file fails here
+    if((rc = ph.GetData(pPage)) ||
+       (rc = pfHandle->MarkDirty(p))) {
+      pfHandle->UnpinPage(p);
+      return rc;
+    }
+
+    // as many as fit go on this page while it is pinned
+    RM_SlottedPageView v(pPage, pfHandle->GetPageSize());
+    int before = v.FreeBytes();
+    int added = 0;
+    while(done < n) {
+      const char * row = rows + done * recSize;
+      int len = StoredSize(row);
+      if(!v.Fits(len))
+        break;
+      int s = v.FreeSlot();
+      Encode(row, RM_REC, v.Place(s, len));
+      rids[done++] = RID(p, s);
+      rest -= len + entry;
+      added++;
+    }
+    int after = v.FreeBytes();
+    if(added == 0) {
+      pfHandle->UnpinPage(p);
+      return -1; // unexpected error
+    }
+    if((rc = pfHandle->UnpinPage(p)) ||
+       (rc = SetSlottedSpace(p, before, after)))
+      return rc;
+  }
+  return 0;
+}
+
+RC RM_FileHandle::PlaceMoved(const char *pData, const RID &stub, RID &rid)
+{
+  PageNum avoid = stub.Page();
+  int len = RM_MIN_STORED + StoredSize(pData);
+  int need = len + 2 * sizeof(short);
+  int minCat = (need * 15 + SlottedSpace() - 1) / SlottedSpace();
+  PageNum p;
+  RC rc;
+  if((rc = FindSpace(hdr.firstFree, minCat, p)))
+    return rc;
+  if(p == avoid && (rc = FindSpace(avoid + 1, minCat, p)))
+    return rc;
+  if(p == -1 && (rc = NewPages(1, p)))
+    return rc;
+
+  PF_PageHandle ph;
+  char * pPage;
+  if((rc = pfHandle->GetThisPage(p, ph)))
+    return rc;
+  if((rc = ph.GetData(pPage)) ||
+     (rc = pfHandle->MarkDirty(p))) {
+    pfHandle->UnpinPage(p);
+    return rc;
+  }
+  RM_SlottedPageView v(pPage, pfHandle->GetPageSize());
+  assert(v.Fits(len));
+  int before = v.FreeBytes();
+  int s = v.FreeSlot();
+  char * pStored = v.Place(s, len);
+  SetMovedIn(pStored, stub);
+  Encode(pData, RM_REC, MovedInRec(pStored));
+  int after = v.FreeBytes();
+  rid = RID(p, s);
+  if((rc = pfHandle->UnpinPage(p)))
+    return rc;
+  return SetSlottedSpace(p, before, after);
+}
+
+RC RM_FileHandle::FreeMoved(const char *pStub)
+{
+  RID to = StubRID(pStub);
+  PF_PageHandle ph;
+  char * pPage;
+  RC rc;
+  if((rc = pfHandle->GetThisPage(to.Page(), ph)))
+    return rc;
+  if((rc = ph.GetData(pPage)) ||
+     (rc = pfHandle->MarkDirty(to.Page()))) {
+    pfHandle->UnpinPage(to.Page());
+    return rc;
+  }
+  RM_SlottedPageView v(pPage, pfHandle->GetPageSize());
+  int before = v.FreeBytes();
+  v.Free(to.Slot());
+  int after = v.FreeBytes();
+  if((rc = pfHandle->UnpinPage(to.Page())))
+    return rc;
+  return SetSlottedSpace(to.Page(), before, after);
+}
+
+RC RM_FileHandle::DeleteSlotted(const RID &rid)
+{
+  PageNum p = rid.Page();
+  SlotNum s = rid.Slot();
+  PF_PageHandle ph;
+  char * pPage;
+  RC rc;
+  if((rc = pfHandle->GetThisPage(p, ph)))
+    return rc;
+  if((rc = ph.GetData(pPage)) ||
+     (rc = pfHandle->MarkDirty(p))) {
+    pfHandle->UnpinPage(p);
+    return rc;
+  }
+
+  RM_SlottedPageView v(pPage, pfHandle->GetPageSize());
+  if(v.IsFree(s) || v.GetRec(s)[0] == RM_MOVEDIN) {
+    pfHandle->UnpinPage(p);
+    return RM_NORECATRID;
+  }
+  if(v.GetRec(s)[0] == RM_MOVED && (rc = FreeMoved(v.GetRec(s)))) {
+    pfHandle->UnpinPage(p);
+    return rc;
+  }
+  int before = v.FreeBytes();
+  v.Free(s);
+  int after = v.FreeBytes();
+  if((rc = pfHandle->UnpinPage(p)))
+    return rc;
+  return SetSlottedSpace(p, before, after);
+}
+
+RC RM_FileHandle::UpdateSlotted(const RID &rid, const char *pData)
+{
+  PageNum p = rid.Page();
+  SlotNum s = rid.Slot();
+  PF_PageHandle ph;
+  char * pPage;
+  RC rc;
+  if((rc = pfHandle->GetThisPage(p, ph)))
+    return rc;
+  if((rc = ph.GetData(pPage)) ||
+     (rc = pfHandle->MarkDirty(p))) {
+    pfHandle->UnpinPage(p);
+    return rc;
+  }
+
+  RM_SlottedPageView v(pPage, pfHandle->GetPageSize());
+  if(v.IsFree(s) || v.GetRec(s)[0] == RM_MOVEDIN) {
+    pfHandle->UnpinPage(p);
+    return RM_NORECATRID;
+  }
+
+  // a moved record is written where it went if it still fits there,
+  // otherwise it is placed again as if only the stub were here
+  int len = StoredSize(pData);
+  int before = v.FreeBytes();
+  if(v.GetRec(s)[0] == RM_MOVED) {
+    RID to = StubRID(v.GetRec(s));
+    PF_PageHandle tph;
+    char * pTo;
+    if((rc = pfHandle->GetThisPage(to.Page(), tph)) ||
+       (rc = tph.GetData(pTo)) ||
+       (rc = pfHandle->MarkDirty(to.Page()))) {
+      pfHandle->UnpinPage(p);
+      return rc;
+    }
+    RM_SlottedPageView tv(pTo, pfHandle->GetPageSize());
+    int tBefore = tv.FreeBytes();
+    int tLen = RM_MIN_STORED + len;
+    bool bFits = (tBefore + tv.GetLength(to.Slot()) >= tLen);
+    if(bFits) {
+      char * pStored = tv.Resize(to.Slot(), tLen);
+      SetMovedIn(pStored, rid);
+      Encode(pData, RM_REC, MovedInRec(pStored));
+    }
+    int tAfter = tv.FreeBytes();
+    if((rc = pfHandle->UnpinPage(to.Page())) ||
+       (rc = SetSlottedSpace(to.Page(), tBefore, tAfter)) ||
+       (!bFits && (rc = FreeMoved(v.GetRec(s))))) {
+      pfHandle->UnpinPage(p);
+      return rc;
+    }
+    if(bFits)
+      return pfHandle->UnpinPage(p);
+  }
+
+  if(v.FreeBytes() + v.GetLength(s) >= len) {
+    Encode(pData, RM_REC, v.Resize(s, len));
+  } else {
+    // no room left here - it moves and a stub takes its place
+    RID to;
+    if((rc = PlaceMoved(pData, rid, to))) {
+      pfHandle->UnpinPage(p);
+      return rc;
+    }
+    SetStub(v.Resize(s, RM_MIN_STORED), to);
+  }
+  int after = v.FreeBytes();
+  if((rc = pfHandle->UnpinPage(p)))
+    return rc;
+  return SetSlottedSpace(p, before, after);
+}
+
+RC RM_FileHandle::MoveSlotted(PageNum p, SlotNum s, char *rows, RID *from,
+                              RID *to, int &nMoved)
+{
+  RID rid(p, s);
+  char * row = rows + nMoved * this->fullRecordSize();
+  PF_PageHandle ph;
+  char * pPage;
+  RC rc;
+  if((rc = pfHandle->GetThisPage(p, ph)))
+    return rc;
+  ph.GetData(pPage);
+  RM_SlottedPageView v(pPage, pfHandle->GetPageSize());
+  bool bMovedIn = (v.GetRec(s)[0] == RM_MOVEDIN);
+  RID stub;
+  if(bMovedIn) {
+    stub = StubRID(v.GetRec(s));
+    Decode(MovedInRec(v.GetRec(s)), row);
+  }
+  if((rc = pfHandle->UnpinPage(p)))
+    return rc;
+
+  if(!bMovedIn) {
+    // a stub goes too, with the record it leads to
+    char * pData;
+    if((rc = PinSlotted(rid, pData)))
+      return rc;
+    memcpy(row, pData, this->fullRecordSize());
+    if((rc = UnpinRec(rid)) ||
+       (rc = InsertSlotted(row, 1, &to[nMoved])) ||
+       (rc = DeleteSlotted(rid)))
+      return rc;
+    from[nMoved++] = rid;
+    return 0;
+  }
+
+  RID moved;
+  if((rc = PlaceMoved(row, stub, moved)))
+    return rc;
+  if((rc = pfHandle->GetThisPage(stub.Page(), ph)))
+    return rc;
+  if((rc = ph.GetData(pPage)) ||
+     (rc = pfHandle->MarkDirty(stub.Page()))) {
+    pfHandle->UnpinPage(stub.Page());
+    return rc;
+  }
+  SetStub(RM_SlottedPageView(pPage, pfHandle->GetPageSize()).
+          GetRec(stub.Slot()), moved);
+  if((rc = pfHandle->UnpinPage(stub.Page())))
+    return rc;
+
+  if((rc = pfHandle->GetThisPage(p, ph)))
+    return rc;
+  if((rc = ph.GetData(pPage)) ||
+     (rc = pfHandle->MarkDirty(p))) {
+    pfHandle->UnpinPage(p);
+    return rc;
+  }
+  RM_SlottedPageView pv(pPage, pfHandle->GetPageSize());
+  int before = pv.FreeBytes();
+  pv.Free(s);
+  int after = pv.FreeBytes();
+  if((rc = pfHandle->UnpinPage(p)))
+    return rc;
+  return SetSlottedSpace(p, before, after);
+}
@@ -100,6 +100,8 @@ static int get_id(char *s)
       return yylval.ival = RW_EXIT;
    if(!strcmp(string, "print"))
       return yylval.ival = RW_PRINT;
+   if(!strcmp(string, "vacuum"))
+      return yylval.ival = RW_VACUUM;
    if(!strcmp(string, "set"))
       return yylval.ival = RW_SET;
 
@@ -46,6 +46,9 @@ class SM_Manager {
   RC Help       (const char *relName);          // print schema of relName
 
   RC Print      (const char *relName);          // print relName contents
+  // Pack the records of relName into as few pages as they fit on, giving
+  // the rest back.  Its indexes are built again for the records that moved.
+  RC Vacuum     (const char *relName);
 
   RC Set        (const char *paramName,         // set parameter to
                  const char *value);            //   value
@@ -114,6 +117,16 @@ class SM_Manager {
   RM_FileHandle attrfh;
   char cwd[1024];
   map<string, string> params;
+  // page size for new tables and indexes - "pagesize" param if set
+  int PageSize() const;
+  // RM_FIXED, RM_SLOTTED, RM_PAX or RM_COMPRESSED for new tables -
+  // "format" param if set
+  int RecordFormat() const;
+  // buffer a table or index in a pool - "assign" param
+  RC AssignPool(const char *value);
+  // empty the index on attr of relName and index the records of rfh again
+  RC RebuildIndex(const char *relName, const DataAttrInfo &attr,
+                  RM_FileHandle &rfh);
 };
 
 #endif // SM_H
@@ -5,6 +5,9 @@
 //
 
 #include <cstdio>
+#include <cstdlib>
+#include <climits>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -20,6 +23,10 @@
 
 using namespace std;
 
+// list of the pages that were in the buffer when the database was last
+// closed, kept in the database directory; no relation can have this name
+static const char *SM_HOTPAGES = ".hotpages";
+
 SM_Manager::SM_Manager(IX_Manager &ixm_, RM_Manager &rmm_)
   :rmm(rmm_), ixm(ixm_), bDBOpen(false)
 {
@@ -49,6 +56,10 @@ RC SM_Manager::OpenDb(const char *dbName)
     return SM_NOSUCHDB;
   }
 
+  // start reading the pages that were hot before the last close; a list
+  // that cannot be read only means a cold start
+  rmm.GetPF_Manager().WarmUp(SM_HOTPAGES);
+
   RC rc;
   if((rc =	rmm.OpenFile("attrcat", attrfh))
      || (rc =	rmm.OpenFile("relcat", relfh))
@@ -70,6 +81,9 @@ RC SM_Manager::CloseDb()
     ) 
     return(rc);
 
+  // remember the hot pages for the next OpenDb
+  rmm.GetPF_Manager().SaveHotPages(SM_HOTPAGES);
+
   if (chdir(cwd) < 0) {
     cerr << " chdir error to " << cwd 
          << ".\n";
@@ -120,8 +134,20 @@ RC SM_Manager::CreateTable(const char *relName,
       return(rc);
   }
 
+  // a slotted table stores its strings at their real length, a PAX or
+  // compressed table gives every attribute a minipage
+  RM_Fields fields;
+  fields.n = 0;
+  for (int i = 0; i < attrCount; i++) {
+    if(d[i].attrType != STRING && RecordFormat() == RM_SLOTTED)
+      continue;
+    fields.offset[fields.n] = d[i].offset;
+    fields.length[fields.n] = d[i].attrLength;
+    fields.n++;
+  }
+
   if(
-    (rc = rmm.CreateFile(relName, size)) 
+    (rc = rmm.CreateFile(relName, size, PageSize(), RecordFormat(), &fields)) 
     ) 
     return(rc);
 
@@ -353,7 +379,8 @@ RC SM_Manager::CreateIndex(const char *relName,
 
   if(
     (rc = ixm.CreateIndex(relName, data->indexNo, 
-                          data->attrType, data->attrLength)) 
+                          data->attrType, data->attrLength,
+                          PageSize())) 
     )
     return(rc);
 
@@ -710,10 +737,33 @@ RC SM_Manager::Load(const char *relName,
     }
   }
 
-  char * buf = new char[size];
+  // rows are inserted a batch at a time so that pages are filled whole
+  int nBatch = 8 * rfh.GetNumSlots();
+  char * rows = new char[nBatch * size];
+  RID * rids = new RID[nBatch];
+  int nRows = 0;
+  auto insertRows = [&]() -> RC {
+    RC rc;
+    if ((rc = rfh.InsertRecs(rows, nRows, rids)) < 0
+      )
+      return(rc);
+
+    for (int j = 0; j < nRows; j++) {
+      for (int i = 0; i < attrCount; i++) {
+        if(attributes[i].indexNo != -1) {
+          rc = indexes[i].InsertEntry(rows + j * size + attributes[i].offset,
+                                      rids[j]);
+          if (rc != 0) return rc;
+        }
+      }
+    }
+    nRows = 0;
+    return 0;
+  };
 
   int numLines = 0;
   while(!ifs.eof()) {
+    char * buf = rows + nRows * size;
     memset(buf, 0, size);
 
     string line;
@@ -755,21 +805,11 @@ RC SM_Manager::Load(const char *relName,
       }
       i++;
     }
-    RID rid;
-    if ((rc = rfh.InsertRec(buf, rid)) < 0
-      )
+    if (++nRows == nBatch && (rc = insertRows()))
       return(rc);
-    
-    for (int i = 0; i < attrCount; i++) {
-      if(attributes[i].indexNo != -1) {
-        // cerr << "SM load index - inserting {" << *(char*)(buf + attributes[i].offset) << "} " << rid << endl;
-        rc = indexes[i].InsertEntry(buf + attributes[i].offset, 
-                                    rid);
-        if (rc != 0) return rc;
-      }
-    }
-
   }
+  if (nRows > 0 && (rc = insertRows()))
+    return(rc);
 
 
   // update numRecords in relcat
@@ -797,7 +837,8 @@ RC SM_Manager::Load(const char *relName,
     }
   }
 
-  delete [] buf;
+  delete [] rows;
+  delete [] rids;
   delete [] attributes;
   delete [] indexes;
   ifs.close();
@@ -867,12 +908,196 @@ RC SM_Manager::Print(const char *relName)
   return (0);
 }
 
+RC SM_Manager::Vacuum(const char *relName)
+{
+  RC invalid = IsValid(); if(invalid) return invalid;
+
+  if(relName == NULL) {
+    return SM_BADTABLE;
+  }
+
+  if(strcmp(relName, "relcat") == 0 ||
+     strcmp(relName, "attrcat") == 0
+    ) {
+    return SM_BADTABLE;
+  }
+
+  RM_FileHandle rfh;
+  RC rc;
+  if((rc =	rmm.OpenFile(relName, rfh))
+    )
+    return(rc);
+
+  int attrCount = -1;
+  DataAttrInfo * attributes;
+  rc = GetFromTable(relName, attrCount, attributes);
+  if(rc != 0) return rc;
+
+  // records move a batch at a time
+  int size = rfh.fullRecordSize();
+  int nBatch = rfh.GetNumSlots();
+  char * rows = new char[nBatch * size];
+  RID * from = new RID[nBatch];
+  RID * to = new RID[nBatch];
+  int nMoved;
+  do {
+    rc = rfh.Vacuum(nBatch, rows, from, to, nMoved);
+  } while(rc == 0 && nMoved == nBatch);
+  delete [] rows;
+  delete [] from;
+  delete [] to;
+  if(rc != 0) return rc;
+
+  // Indexes are built again from the records where they are now rather
+  // than following each one that moved - entries for duplicate keys are
+  // not reliably found to delete.  Only then do the emptied pages go, so
+  // that no entry is left holding a RID on them.
+  for (int i = 0; i < attrCount; i++) {
+    if(attributes[i].indexNo != -1) {
+      if ((rc = RebuildIndex(relName, attributes[i], rfh)))
+        return rc;
+    }
+  }
+  if ((rc = rfh.Truncate()))
+    return rc;
+
+  // update numPages in relcat
+  DataRelInfo r;
+  RID rid;
+  rc = GetRelFromCat(relName, r, rid);
+  if(rc != 0) return rc;
+
+  r.numPages = rfh.GetNumPages();
+  RM_Record rec;
+  rec.Set((char*)&r, DataRelInfo::size(), rid);
+  if ((rc = relfh.UpdateRec(rec)) != 0)
+    return rc;
+
+  if((rc =	rmm.CloseFile(rfh))
+    )
+    return(rc);
+
+  delete [] attributes;
+  return (0);
+}
+
+RC SM_Manager::RebuildIndex(const char *relName,
+                            const DataAttrInfo &attr,
+                            RM_FileHandle &rfh)
+{
+  IX_IndexHandle ixh;
+  RC rc;
+  if ((rc = ixm.OpenIndex(relName, attr.indexNo, ixh)))
+    return rc;
+  int pageSize = ixh.GetPageSize();
+  if ((rc = ixm.CloseIndex(ixh)) ||
+      (rc = ixm.DestroyIndex(relName, attr.indexNo)) ||
+      (rc = ixm.CreateIndex(relName, attr.indexNo,
+                            attr.attrType, attr.attrLength, pageSize)) ||
+      (rc = ixm.OpenIndex(relName, attr.indexNo, ixh)))
+    return rc;
+
+  RM_FileScan rfs;
+  if ((rc = rfs.OpenScan(rfh, attr.attrType, attr.attrLength, attr.offset,
+                         NO_OP, NULL)))
+    return (rc);
+
+  RM_Record rec;
+  while ((rc = rfs.GetNextRec(rec)) == 0) {
+    char * pdata;
+    RID rid;
+    rec.GetData(pdata);
+    rec.GetRid(rid);
+    if ((rc = ixh.InsertEntry(pdata + attr.offset, rid)))
+      return rc;
+  }
+  if (rc != RM_EOF)
+    return rc;
+
+  if ((rc = rfs.CloseScan()))
+    return (rc);
+  return ixm.CloseIndex(ixh);
+}
+
 RC SM_Manager::Set(const char *paramName, const char *value)
 {
   RC invalid = IsValid(); if(invalid) return invalid;
   if(paramName == NULL || value  == NULL)
     return SM_BADPARAM;
 
+  // the replacement policy, read-ahead, I/O backend and page cleaner
+  // live in the buffer manager, the extent size in the PF manager
+  if(strcmp(paramName, "replacement") == 0) {
+    RC rc = rmm.GetPF_Manager().SetReplacementPolicy(value);
+    if(rc != 0) return rc;
+  }
+  if(strcmp(paramName, "readahead") == 0) {
+    char *end;
+    long pages = strtol(value, &end, 10);
+    if(*value == '\0' || *end != '\0')
+      return SM_BADPARAM;
+    RC rc = rmm.GetPF_Manager().SetReadAhead((int)pages);
+    if(rc != 0) return rc;
+  }
+  if(strcmp(paramName, "io") == 0) {
+    RC rc = rmm.GetPF_Manager().SetIOBackend(value);
+    if(rc != 0) return rc;
+  }
+  // "high,low" watermarks in percent of the buffer, or "off"
+  if(strcmp(paramName, "cleaner") == 0) {
+    int high = 0, low = 0, len = -1;
+    if(strcmp(value, "off") != 0 &&
+       (sscanf(value, "%d,%d%n", &high, &low, &len) != 2 ||
+        value[len] != '\0'))
+      return SM_BADPARAM;
+    RC rc = rmm.GetPF_Manager().SetCleaner(high, low);
+    if(rc != 0) return rc;
+  }
+  // pages that files opened from now on grow by
+  if(strcmp(paramName, "extent") == 0) {
+    char *end;
+    long pages = strtol(value, &end, 10);
+    if(*value == '\0' || *end != '\0')
+      return SM_BADPARAM;
+    RC rc = rmm.GetPF_Manager().SetExtentSize((int)pages);
+    if(rc != 0) return rc;
+  }
+  // "name pages" sets up a buffer pool of that many pages
+  if(strcmp(paramName, "pool") == 0) {
+    char name[MAXNAME+1];
+    int pages = 0, len = -1;
+    if(sscanf(value, "%24s %d%n", name, &pages, &len) != 2 ||
+       value[len] != '\0')
+      return SM_BADPARAM;
+    RC rc = rmm.GetPF_Manager().CreatePool(name, pages);
+    if(rc != 0) return rc;
+  }
+  if(strcmp(paramName, "assign") == 0) {
+    RC rc = AssignPool(value);
+    if(rc != 0) return rc;
+  }
+  // bytes per page for tables and indexes created from now on
+  if(strcmp(paramName, "pagesize") == 0) {
+    char *end;
+    long bytes = strtol(value, &end, 10);
+    if(*value == '\0' || *end != '\0' ||
+       bytes <= 0 || bytes > PF_MAX_PAGE_SIZE)
+      return SM_BADPARAM;
+  }
+  // scratch blocks a query's sorts and joins may use
+  if(strcmp(paramName, "workmem") == 0) {
+    char *end;
+    long blocks = strtol(value, &end, 10);
+    if(*value == '\0' || *end != '\0' ||
+       blocks <= 0 || blocks > INT_MAX)
+      return SM_BADPARAM;
+  }
+  // record format of tables created from now on
+  if(strcmp(paramName, "format") == 0 &&
+     strcmp(value, "fixed") != 0 && strcmp(value, "slotted") != 0 &&
+     strcmp(value, "pax") != 0 && strcmp(value, "compressed") != 0)
+    return SM_BADPARAM;
+
   params[paramName] = string(value);
   cout << "Set\n"
        << "   paramName=" << paramName << "\n"
@@ -892,6 +1117,59 @@ RC SM_Manager::Get(const string& paramName, string& value) const
   return 0;
 }
 
+// "rel pool" buffers table rel in a pool, "rel.attr pool" the index on
+// rel.attr; "rel" or "rel.attr" alone goes back to the default pool.
+// Takes effect the next time the file is opened.
+RC SM_Manager::AssignPool(const char *value)
+{
+  char target[2*MAXNAME+2], pool[MAXNAME+1] = "";
+  int len = -1;
+  if(sscanf(value, "%49s%n %24s%n", target, &len, pool, &len) < 1 ||
+     value[len] != '\0')
+    return SM_BADPARAM;
+
+  string fileName(target);
+  char *dot = strchr(target, '.');
+  RC rc;
+  RID rid;
+  if(dot == NULL) {
+    DataRelInfo rel;
+    if((rc = GetRelFromCat(target, rel, rid)))
+      return rc;
+  } else {
+    *dot = '\0';
+    DataAttrInfo attr;
+    if((rc = GetAttrFromCat(target, dot + 1, attr, rid)))
+      return rc;
+    if(attr.indexNo == -1)
+      return SM_BADATTR;
+    ostringstream indexName;
+    indexName << target << "." << attr.indexNo;
+    fileName = indexName.str();
+  }
+  return rmm.GetPF_Manager().AssignPool(fileName.c_str(), pool);
+}
+
+int SM_Manager::PageSize() const
+{
+  map<string, string>::const_iterator it = params.find("pagesize");
+  if(it == params.end())
+    return PF_PAGE_SIZE;
+  return atoi(it->second.c_str());
+}
+
+int SM_Manager::RecordFormat() const
+{
+  map<string, string>::const_iterator it = params.find("format");
+  if(it != params.end() && it->second == "slotted")
+    return RM_SLOTTED;
+  if(it != params.end() && it->second == "pax")
+    return RM_PAX;
+  if(it != params.end() && it->second == "compressed")
+    return RM_COMPRESSED;
+  return RM_FIXED;
+}
+
 RC SM_Manager::Help()
 {
   RC invalid = IsValid(); if(invalid) return invalid;
@@ -482,3 +482,105 @@ TEST_F(SM_ManagerTest, SemCheck) {
     rc = system (command2.str().c_str());
     ASSERT_EQ(rc, 0);
 }
+
+TEST_F(SM_ManagerTest, Vacuum) {
+    RC rc;
+    PF_Manager pfm;
+    IX_Manager ixm(pfm);
+    RM_Manager rmm(pfm);
+    SM_Manager smm(ixm, rmm);
+
+    const char * dbname = "vactest";
+    stringstream command;
+    command << "rm -rf " << dbname;
+    rc = system (command.str().c_str());
+
+    command.str("");
+    command << "./dbcreate " << dbname;
+    rc = system (command.str().c_str());
+    ASSERT_EQ(rc, 0);
+
+    // d has only 7 values, so its index is mostly duplicate keys
+    const int count = 3000;
+    FILE * data = fopen("vacuum.data", "w");
+    ASSERT_TRUE(data != NULL);
+    for (int i = 0; i < count; i++)
+      fprintf(data, "%d,r%d,%d,%d\n", i, i, i % 4, i % 7);
+    fclose(data);
+
+    command.str("");
+    command << "echo \"create table t(a i, b c20, c i, d i);"
+            << " create index t(a); create index t(d);"
+            << " load t(\\\"../vacuum.data\\\");"
+            << " delete from t where c <> 0;\" | ./redbase "
+            << dbname << " > /dev/null";
+    rc = system (command.str().c_str());
+    ASSERT_EQ(rc, 0);
+
+    ASSERT_EQ(0, smm.OpenDb(dbname));
+    int numPages = smm.GetNumPages("t");
+    ASSERT_EQ(0, smm.Vacuum("t"));
+    ASSERT_LT(smm.GetNumPages("t"), numPages);
+    DataAttrInfo a, c, d;
+    RID arid;
+    ASSERT_EQ(0, smm.GetAttrFromCat("t", "a", a, arid));
+    ASSERT_EQ(0, smm.GetAttrFromCat("t", "c", c, arid));
+    ASSERT_EQ(0, smm.GetAttrFromCat("t", "d", d, arid));
+    ASSERT_EQ(0, smm.CloseDb());
+
+    if (chdir(dbname) < 0) {
+      cerr << " chdir error to " << dbname
+           << ". Does the db exist ?\n";
+    }
+    RM_FileHandle rfh;
+    ASSERT_EQ(0, rmm.OpenFile("t", rfh));
+
+    // every entry of either index leads to the record with its key
+    int val = 3;
+    DataAttrInfo * attrs[2] = { &a, &d };
+    int expected[2] = { count / 4, 0 };
+    for (int i = 0; i < count; i += 4)
+      if (i % 7 == val)
+        expected[1]++;
+    for (int k = 0; k < 2; k++) {
+      IX_IndexHandle ixh;
+      ASSERT_EQ(0, ixm.OpenIndex("t", attrs[k]->indexNo, ixh));
+      IX_IndexScan is;
+      if (k == 0) {
+        ASSERT_EQ(0, is.OpenScan(ixh, NO_OP, NULL, NO_HINT));
+      } else {
+        ASSERT_EQ(0, is.OpenScan(ixh, EQ_OP, &val, NO_HINT));
+      }
+      int ns = 0;
+      RID rid;
+      while ((rc = is.GetNextEntry(rid)) == 0) {
+        RM_Record rec;
+        ASSERT_EQ(0, rfh.GetRec(rid, rec));
+        char * pData;
+        rec.GetData(pData);
+        int cval;
+        memcpy(&cval, pData + c.offset, sizeof(int));
+        EXPECT_EQ(0, cval);
+        if (k == 1) {
+          int key;
+          memcpy(&key, pData + attrs[k]->offset, sizeof(int));
+          EXPECT_EQ(val, key);
+        }
+        ns++;
+      }
+      ASSERT_EQ(IX_EOF, rc);
+      EXPECT_EQ(expected[k], ns);
+      ASSERT_EQ(0, is.CloseScan());
+      ASSERT_EQ(0, ixm.CloseIndex(ixh));
+    }
+    ASSERT_EQ(0, rmm.CloseFile(rfh));
+
+    if (chdir("..") < 0) {
+      cerr << " chdir error to ..\n";
+    }
+    stringstream command2;
+    command2 << "./dbdestroy " << dbname;
+    rc = system (command2.str().c_str());
+    ASSERT_EQ(rc, 0);
+    unlink("vacuum.data");
+}
@@ -0,0 +1,204 @@
+//
+// File:        sort.cc
+//
+
+#include "sort.h"
+#include <algorithm>
+
+using namespace std;
+
+RC Sort::Open()
+{
+  if(bIterOpen)
+    return RM_HANDLEOPEN;
+
+  RC rc = lhsIt->Open();
+  if(rc != 0) return rc;
+  if((rc = grant.Reserve()))
+    return rc;
+
+  int length = TupleLength();
+  perBlock = grant.GetBlockSize() / length;
+  if(perBlock < 1)
+    return QL_INVALIDSIZE;
+
+  Tuple t = lhsIt->GetTuple();
+  while((rc = lhsIt->GetNext(t)) != lhsIt->Eof()) {
+    if(rc != 0) return rc;
+    if(nInMem == grant.GetNumBlocks() * perBlock) {
+      char* block;
+      rc = grant.Grow(block);
+      if(rc == QL_NOMEM && nInMem > 0) {
+        // refused - the blocks are full, so they become a run
+        if((rc = SpillRun()))
+          return rc;
+      } else if(rc != 0) {
+        return rc;
+      }
+    }
+    char* slot = grant.GetBlock(nInMem / perBlock) +
+      (nInMem % perBlock) * length;
+    const char* buf;
+    t.GetData(buf);
+    memcpy(slot, buf, length);
+    recs.push_back(slot);
+    nInMem++;
+  }
+
+  // equal keys keep their input order - reversed for a descending sort
+  stable_sort(recs.begin(), recs.end(),
+              [this](const char* a, const char* b) { return Less(a, b); });
+  outPos = desc ? nInMem - 1 : 0;
+
+  if(pSpill != NULL) {
+    if(nInMem > 0 && (rc = SpillRun()))
+      return rc;
+    // each run being merged keeps a page pinned - the grant's blocks go
+    // back to make room for them
+    if((rc = grant.Release()))
+      return rc;
+    int fanIn = max(2, grant.GetLimit());
+    while((int)pending.size() > fanIn)
+      if((rc = MergeRuns(fanIn)))
+        return rc;
+    if((rc = OpenRuns(pending.size(), cursors, heads)))
+      return rc;
+  }
+
+  bIterOpen = true;
+  return 0;
+}
+
+RC Sort::GetNext(Tuple &t)
+{
+  if(!bIterOpen)
+    return RM_FNOTOPEN;
+
+  if(pSpill == NULL) {
+    if(outPos < 0 || outPos >= nInMem)
+      return Eof();
+    t.Set(recs[outPos]);
+    outPos += desc ? -1 : 1;
+    return 0;
+  }
+
+  int i = Pick(heads);
+  if(i == -1)
+    return Eof();
+  t.Set(heads[i]);
+  return Advance(cursors[i], heads[i]);
+}
+
+RC Sort::Close()
+{
+  if(!bIterOpen)
+    return RM_FNOTOPEN;
+
+  RC rc = lhsIt->Close();
+  if(rc != 0 ) return rc;
+  Reset();
+  if((rc = grant.Release()))
+    return rc;
+
+  bIterOpen = false;
+  return 0;
+}
+
+// Sort the tuples in the blocks and write them out as one run
+RC Sort::SpillRun()
+{
+  RC rc;
+  if(pSpill == NULL)
+    pSpill = new SpillFile(grant.GetBroker()->GetPF_Manager(), TupleLength());
+
+  stable_sort(recs.begin(), recs.end(),
+              [this](const char* a, const char* b) { return Less(a, b); });
+  for(int i = 0; i < nInMem; i++)
+    if((rc = pSpill->Append(recs[desc ? nInMem - 1 - i : i])))
+      return rc;
+  if((rc = pSpill->EndRun()))
+    return rc;
+
+  pending.push_back(pSpill->GetNumRuns() - 1);
+  recs.clear();
+  nInMem = 0;
+  return 0;
+}
+
+// Cursors on the first n pending runs, each on its first tuple
+RC Sort::OpenRuns(int n, vector<SpillCursor>& cs, vector<const char*>& hs)
+{
+  RC rc;
+  cs.resize(n);
+  hs.assign(n, (const char*)NULL);
+  for(int i = 0; i < n; i++) {
+    if((rc = pSpill->OpenCursor(pending[i], cs[i])) ||
+       (rc = Advance(cs[i], hs[i])))
+      return rc;
+  }
+  return 0;
+}
+
+RC Sort::Advance(SpillCursor& c, const char*& head)
+{
+  RC rc = pSpill->Next(c, head);
+  if(rc == QL_EOF) {
+    head = NULL;
+    return 0;
+  }
+  return rc;
+}
+
+// Cursor whose tuple comes next, -1 when all are done.  Runs are in input
+// order, so on equal keys the earlier run wins - the later one when
+// descending.
+int Sort::Pick(const vector<const char*>& hs) const
+{
+  int best = -1;
+  for(int i = 0; i < (int)hs.size(); i++) {
+    if(hs[i] == NULL)
+      continue;
+    if(best == -1 ||
+       (!desc && Less(hs[i], hs[best])) ||
+       (desc && !Less(hs[i], hs[best])))
+      best = i;
+  }
+  return best;
+}
+
+// Merge the first n pending runs into one that takes their place
+RC Sort::MergeRuns(int n)
+{
+  RC rc;
+  vector<SpillCursor> cs;
+  vector<const char*> hs;
+  if((rc = OpenRuns(n, cs, hs)))
+    return rc;
+  for(int i = Pick(hs); i != -1; i = Pick(hs)) {
+    if((rc = pSpill->Append(hs[i])) ||
+       (rc = Advance(cs[i], hs[i])))
+      return rc;
+  }
+  if((rc = pSpill->EndRun()))
+    return rc;
+
+  pending.erase(pending.begin(), pending.begin() + n);
+  pending.insert(pending.begin(), pSpill->GetNumRuns() - 1);
+  return 0;
+}
+
+void Sort::Reset()
+{
+  if(pSpill != NULL) {
+    for(unsigned int i = 0; i < cursors.size(); i++)
+      pSpill->CloseCursor(cursors[i]);
+    delete pSpill;
+    pSpill = NULL;
+  }
+  cursors.clear();
+  heads.clear();
+  pending.clear();
+  recs.clear();
+  nInMem = 0;
+  outPos = 0;
+}
@@ -9,12 +9,15 @@
 #include "iterator.h"
 #include "sm.h"
 #include "ql_error.h"
-#include <set>
 #include "predicate.h"
+#include "memory_grant.h"
+#include <vector>
 
 using namespace std;
 
-// Single key, single pass sort operator. Uses memory directly.
+// Single key sort operator.  Sorts in the blocks of its memory grant and
+// when the grant is refused writes sorted runs to a spill file, which are
+// merged as the output is read.  Without a broker it sorts in memory.
 class Sort: public Iterator {
  public:
    Sort(Iterator *    lhsIt,
@@ -22,9 +25,12 @@ class Sort: public Iterator {
         int    sortKeyLength,
         int     sortKeyOffset,
         RC& status,
-        bool desc_=false) 
-     :cmp(sortKeyType, sortKeyLength, sortKeyOffset, (desc == true ? GT_OP : LT_OP)),
-    lhsIt(lhsIt), set(cmp)
+        bool desc_=false,
+        MemoryBroker* broker = NULL) 
+     :lhsIt(lhsIt),
+    keyCmp(sortKeyType, sortKeyLength, sortKeyOffset, LT_OP, NULL, NO_HINT),
+    keyOffset(sortKeyOffset), grant(broker), nInMem(0), pSpill(NULL),
+    outPos(0)
     {
       if(lhsIt == NULL || 
          sortKeyLength < 1 || 
@@ -43,8 +49,6 @@ class Sort: public Iterator {
         attrs[i] = cattrs[i];
       }
 
-      it = set.begin();
-
       string attr;
       for (int i = 0; i < attrCount; i++) {
         if(attrs[i].offset == sortKeyOffset) {
@@ -75,64 +79,40 @@ class Sort: public Iterator {
     return dyn.str();
   }
 
-  virtual ~Sort() {}
-
-  virtual RC Open() {
-    if(bIterOpen)
-      return RM_HANDLEOPEN;
-
-    RC rc = lhsIt->Open();
-    if(rc != 0 ) return rc;
-
-    Tuple t = lhsIt->GetTuple();
-    while(lhsIt->GetNext(t) != lhsIt->Eof()) {
-      set.insert(t);
-    }
-    
-    it = set.begin();
-    rit = set.rbegin();
-
-    bIterOpen = true;
-    return 0;
-  }
-
-  virtual RC GetNext(Tuple &t) {
-    if(!bIterOpen)
-      return RM_FNOTOPEN;
+  virtual ~Sort() { Reset(); }
 
-    if (it == set.end() || rit == set.rend())
-      return Eof();
-    if(!desc)
-      t = *it;
-    else
-      t = *rit;
-    it++;
-    rit++;
-    return 0;
-  }
-
-  virtual RC Close() {
-    if(!bIterOpen)
-      return RM_FNOTOPEN;
-
-    RC rc = lhsIt->Close();
-    if(rc != 0 ) return rc;
-    set.clear();
-    it = set.begin();
-    rit = set.rbegin();
-
-    bIterOpen = false;
-    return 0;
-  }
+  virtual RC Open();
+  virtual RC GetNext(Tuple &t);
+  virtual RC Close();
   
   virtual RC Eof() const { return QL_EOF; }
 
+  // spill runs written by the last Open, 0 if it sorted in memory
+  int GetNumRuns() const { return pSpill ? pSpill->GetNumRuns() : 0; }
+
  private:
-  TupleCmp cmp;
+  bool Less(const char* a, const char* b) const {
+    return keyCmp.eval(a, b + keyOffset, LT_OP);
+  }
+  RC SpillRun();
+  RC OpenRuns(int n, vector<SpillCursor>& cs, vector<const char*>& hs);
+  RC Advance(SpillCursor& c, const char*& head);
+  int Pick(const vector<const char*>& hs) const;
+  RC MergeRuns(int n);
+  void Reset();
+
   Iterator* lhsIt;
-  multiset<Tuple, TupleCmp> set;
-  multiset<Tuple>::const_iterator it;
-  multiset<Tuple>::const_reverse_iterator rit;
+  Predicate keyCmp;
+  int keyOffset;
+  MemoryGrant grant;
+  int perBlock;
+  int nInMem;
+  vector<char*> recs;        // tuples in the grant's blocks
+  SpillFile* pSpill;
+  vector<int> pending;       // spill runs still to merge, in input order
+  vector<SpillCursor> cursors;
+  vector<const char*> heads; // next tuple of each cursor, NULL at its end
+  int outPos;                // next of recs when nothing was spilled
 };
 
 #endif // SORT_H
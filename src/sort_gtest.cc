@@ -138,3 +138,126 @@ TEST_F(SortTest, Cons) {
     (rc=fs.Close());
     ASSERT_EQ(rc, 0);
 }
+
+// n tuples of (key, seq) - keys repeat so the order of equal keys shows
+class KeyGen: public Iterator {
+ public:
+  KeyGen(int n_, int nKeys_): n(n_), nKeys(nKeys_), i(0) {
+    attrCount = 2;
+    attrs = new DataAttrInfo[attrCount];
+    for (int j = 0; j < attrCount; j++) {
+      strcpy(attrs[j].relName, "gen");
+      attrs[j].attrType = INT;
+      attrs[j].attrLength = sizeof(int);
+      attrs[j].offset = j * sizeof(int);
+      attrs[j].indexNo = -1;
+    }
+    strcpy(attrs[0].attrName, "key");
+    strcpy(attrs[1].attrName, "seq");
+  }
+  virtual ~KeyGen() { delete [] attrs; }
+  virtual RC Open() { i = 0; return 0; }
+  virtual RC GetNext(Tuple &t) {
+    if(i == n) return Eof();
+    int key = (i * 7919) % nKeys;
+    t.Set(0, &key);
+    t.Set(sizeof(int), &i);
+    i++;
+    return 0;
+  }
+  virtual RC Close() { return 0; }
+  virtual RC Eof() const { return QL_EOF; }
+  virtual string Explain() { return "KeyGen\n"; }
+ private:
+  int n, nKeys, i;
+};
+
+TEST_F(SortTest, Spill) {
+    PF_Manager pfm;
+    RC status = -1;
+
+    for (int d = 0; d < 2; d++) {
+        bool desc = (d == 1);
+        KeyGen gen(5000, 1000);
+        // two blocks hold about a fifth of the input
+        MemoryBroker broker(pfm, 2);
+        Sort s(&gen, INT, sizeof(int), 0, status, desc, &broker);
+        ASSERT_EQ(0, status);
+        ASSERT_EQ(0, s.Open());
+        EXPECT_GT(s.GetNumRuns(), 4);
+
+        Tuple t = s.GetTuple();
+        int ns = 0, lastKey = -1, lastSeq = -1;
+        while(s.GetNext(t) != s.Eof()) {
+            int key, seq;
+            t.Get("key", key);
+            t.Get("seq", seq);
+            if(ns > 0) {
+                if(!desc) EXPECT_LE(lastKey, key);
+                else EXPECT_GE(lastKey, key);
+                // equal keys in input order, reversed when descending
+                if(key == lastKey) {
+                    EXPECT_EQ(!desc, lastSeq < seq);
+                }
+            }
+            lastKey = key;
+            lastSeq = seq;
+            ns++;
+        }
+        EXPECT_EQ(5000, ns);
+        ASSERT_EQ(0, s.Close());
+        EXPECT_EQ(0, broker.GetGranted());
+    }
+
+    // without a broker everything stays in memory
+    KeyGen gen(5000, 1000);
+    Sort s(&gen, INT, sizeof(int), 0, status);
+    ASSERT_EQ(0, status);
+    ASSERT_EQ(0, s.Open());
+    EXPECT_EQ(0, s.GetNumRuns());
+    ASSERT_EQ(0, s.Close());
+}
+
+TEST_F(SortTest, MemoryGrant) {
+    PF_Manager pfm;
+    MemoryBroker broker(pfm, 4);
+    char* block;
+
+    // two grants split the budget
+    MemoryGrant g1(&broker), g2(&broker);
+    EXPECT_EQ(2, g1.GetLimit());
+    ASSERT_EQ(0, g1.Reserve());
+    ASSERT_EQ(0, g2.Reserve());
+    ASSERT_EQ(0, g1.Grow(block));
+    ASSERT_EQ(0, g1.Grow(block));
+    EXPECT_EQ(QL_NOMEM, g1.Grow(block));
+    ASSERT_EQ(0, g2.Grow(block));
+    EXPECT_EQ(3, broker.GetGranted());
+    ASSERT_EQ(0, g1.Release());
+    ASSERT_EQ(0, g2.Release());
+    EXPECT_EQ(0, broker.GetGranted());
+
+    // a spool refused more blocks spills and still reads back in order
+    MemoryBroker small(pfm, 1);
+    MemoryGrant g(&small);
+    ASSERT_EQ(0, g.Reserve());
+    TupleSpool spool(g, 2 * sizeof(int));
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < 2000; i++) {
+            int tup[2] = { i, -i };
+            ASSERT_EQ(0, spool.Append((char*)tup));
+        }
+        EXPECT_TRUE(spool.IsSpilled());
+        ASSERT_EQ(0, spool.Rewind());
+        const char* buf;
+        for (int i = 0; i < 2000; i++) {
+            ASSERT_EQ(0, spool.Next(buf));
+            EXPECT_EQ(i, ((int*)buf)[0]);
+            EXPECT_EQ(-i, ((int*)buf)[1]);
+        }
+        EXPECT_TRUE(spool.AtEnd());
+        EXPECT_EQ(QL_EOF, spool.Next(buf));
+        ASSERT_EQ(0, spool.Clear());
+    }
+    EXPECT_EQ(1, small.GetGranted());
+}
@@ -32,6 +32,10 @@ const char *PF_PAGENOTFOUND = "PAGENOTFOUND";
 const char *PF_READPAGE = "READPAGE";           // IO
 const char *PF_WRITEPAGE = "WRITEPAGE";         // IO
 const char *PF_FLUSHPAGES = "FLUSHPAGES";
+const char *PF_READAHEAD = "READAHEAD";         // IO, pages read ahead
+const char *PF_RINGREUSE = "RINGREUSE";         // followed by the ring number
+const char *PF_WRITESAVED = "WRITESAVED";       // IO, writes saved by coalescing
+const char *PF_CLEANERWRITE = "CLEANERWRITE";   // IO, part of WRITEPAGE
 
 //
 // Statistic class
@@ -130,6 +134,7 @@ RC StatisticsMgr::Register (const char *psKey, const Stat_Operation op,
    if (psKey==NULL || (op != STAT_ADDONE && piValue == NULL))
       return STAT_INVALID_ARGS;
 
+   std::lock_guard<std::mutex> guard(llMutex);
    iCount = llStats.GetLength();
 
    for (i=0; i < iCount; i++) {
@@ -213,6 +218,7 @@ int *StatisticsMgr::Get(const char *psKey)
    int i, iCount;
    Statistic *pStat = NULL;
 
+   std::lock_guard<std::mutex> guard(llMutex);
    iCount = llStats.GetLength();
 
    for (i=0; i < iCount; i++) {
@@ -238,6 +244,7 @@ void StatisticsMgr::Print()
    int i, iCount;
    Statistic *pStat = NULL;
 
+   std::lock_guard<std::mutex> guard(llMutex);
    iCount = llStats.GetLength();
 
    for (i=0; i < iCount; i++) {
@@ -260,6 +267,7 @@ RC StatisticsMgr::Reset(const char *psKey)
    if (psKey==NULL)
       return STAT_INVALID_ARGS;
 
+   std::lock_guard<std::mutex> guard(llMutex);
    iCount = llStats.GetLength();
 
    for (i=0; i < iCount; i++) {
@@ -285,6 +293,7 @@ RC StatisticsMgr::Reset(const char *psKey)
 //
 void StatisticsMgr::Reset()
 {
+   std::lock_guard<std::mutex> guard(llMutex);
    llStats.Erase();
 }
 
@@ -47,6 +47,7 @@ const int STAT_BASE = 9000;
 
 // This include must come after the common defines
 #include "linkedlist.h"    // Template class for the link list
+#include <mutex>
 
 // A single statistic will be tracked by a Statistic class
 class Statistic {
@@ -85,7 +86,8 @@ enum Stat_Operation {
     STAT_SUBVALUE
 };
 
-// The StatisticsMgr will track a group of statistics
+// The StatisticsMgr will track a group of statistics.  Several threads
+// may register statistics at the same time.
 class StatisticsMgr {
 
 public:
@@ -117,6 +119,7 @@ public:
 
 private:
     LinkList<Statistic> llStats;
+    std::mutex          llMutex;   // guards llStats
 };
 
 //
@@ -136,6 +139,10 @@ extern const char *PF_PAGENOTFOUND;
 extern const char *PF_READPAGE;         // IO
 extern const char *PF_WRITEPAGE;        // IO
 extern const char *PF_FLUSHPAGES;
+extern const char *PF_READAHEAD;        // IO
+extern const char *PF_RINGREUSE;        // frames reused by a buffer ring
+extern const char *PF_WRITESAVED;       // writes saved by coalescing
+extern const char *PF_CLEANERWRITE;     // writes by the page cleaner
 
 #endif
 